@@ -9,6 +9,10 @@
  *            The user's processing code to execute is located in a callback function
  *            that will be called for each frame acquired (see ProcessingFunction()).
  *
+ *            Optionally (see REPLAY_SOURCE), recorded 3D containers are replayed
+ *            into the same callback function instead of being grabbed (see
+ *            General/MdigReplay/C++/MdigReplay.h), to run without a 3D camera.
+ *
  *      Note: The average processing time must be shorter than the grab time or some
  *            frames will be missed. Also, if the processing results are not displayed
  *            the CPU usage is reduced significantly.
@@ -18,12 +22,20 @@
  */
 #include <mil.h>
 #include <vector>
+#include "../../../General/MdigReplay/C++/MdigReplay.h"
 
  /* Number of images in the buffering grab queue.
     Generally, increasing this number gives a better real-time grab.
  */
 #define BUFFERING_SIZE_MAX 5
 
+/* Set to a folder of .mbufc 3D container files (ending with a path separator)
+   to replay it at REPLAY_FRAME_RATE frames/sec instead of grabbing from the
+   3D camera.
+ */
+#define REPLAY_SOURCE      M_NULL
+#define REPLAY_FRAME_RATE  10.0
+
  /* User's processing function prototype. */
 MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr);
 
@@ -46,7 +58,7 @@ int MosMain(void)
    {
    MIL_ID MilApplication;
    MIL_ID MilSystem;
-   MIL_ID MilDigitizer;
+   ReplayDigitizer Digitizer = { M_NULL, M_NULL };
    MIL_ID MilDisplay;
    MIL_ID MilContainerDisp;
    MIL_ID MilGrabBufferList[BUFFERING_SIZE_MAX] = {0};
@@ -55,6 +67,8 @@ int MosMain(void)
    MIL_DOUBLE ProcessFrameRate = 0;
    MIL_INT NbFrames = 0, n = 0;
    HookDataStruct UserHookData;
+   MIL_CONST_TEXT_PTR ReplaySource = REPLAY_SOURCE;
+   ReplaySettings ReplaySettingsData = { REPLAY_FRAME_RATE, 0.0, 0, 0.0, true };
 
    /* Allocate defaults. */
    MappAlloc(M_NULL, M_DEFAULT, &MilApplication);
@@ -67,7 +81,22 @@ int MosMain(void)
       MosGetch();
       return -1;
       }
-   MdigAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, &MilDigitizer);
+
+   /* When replaying, the replay source replaces the digitizer. */
+   if(ReplaySource)
+      {
+      if(!ReplayAlloc(MilSystem, ReplaySource, &ReplaySettingsData, &Digitizer))
+         {
+         MbufFree(MilContainerDisp);
+         M3ddispFree(MilDisplay);
+         MsysFree(MilSystem);
+         MappFree(MilApplication);
+         MosGetch();
+         return -1;
+         }
+      }
+   else
+      MdigAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, &Digitizer.MilDigitizer);
 
    /* Print a message. */
    MosPrintf(MIL_TEXT("\nMULTIPLE 3D CONTAINERS PROCESSING.\n"));
@@ -80,16 +109,16 @@ int MosMain(void)
    MsysInquire(MilSystem, M_BOARD_TYPE, &BoardType);
    SkipFeatureBrowser = BoardType & M_CL;
 #endif
-   if(MsysInquire(MilSystem, M_GENICAM_AVAILABLE, M_NULL) && !SkipFeatureBrowser)
+   if(!ReplaySource && MsysInquire(MilSystem, M_GENICAM_AVAILABLE, M_NULL) && !SkipFeatureBrowser)
       {
-      MdigControl(MilDigitizer, M_GC_FEATURE_BROWSER, M_OPEN + M_ASYNCHRONOUS);
+      MdigControl(Digitizer.MilDigitizer, M_GC_FEATURE_BROWSER, M_OPEN + M_ASYNCHRONOUS);
       MosPrintf(MIL_TEXT("Please setup your 3D camera using the feature browser.\n"));
       MosPrintf(MIL_TEXT("Press <Enter> to start the acquisition.\n\n"));
       MosGetch();
       }
 
    /* Do a first acquisition to determine what is included in the type camera output. */
-   MdigGrab(MilDigitizer, MilContainerDisp);
+   ReplayDigGrab(&Digitizer, MilContainerDisp);
 
    /* Print the acquired MIL Container detailed informations. */
    PrintContainerInfo(MilContainerDisp);
@@ -102,14 +131,14 @@ int MosMain(void)
       M3ddispSelect(MilDisplay, MilContainerDisp, M_DEFAULT, M_DEFAULT);
 
       /* Grab continuously on the 3D display and wait for a key press. */
-      MdigGrabContinuous(MilDigitizer, MilContainerDisp);
+      ReplayDigGrabContinuous(&Digitizer, MilContainerDisp);
 
       MosPrintf(MIL_TEXT("Live 3D acquisition in progress...\n"));
       MosPrintf(MIL_TEXT("Press <Enter> to start the processing.\n"));
       MosGetch();
 
       /* Halt continuous grab. */
-      MdigHalt(MilDigitizer);
+      ReplayDigHalt(&Digitizer);
 
       /* Allocate the grab Containers for processing. */
       for(MilGrabBufferListSize = 0; MilGrabBufferListSize < BUFFERING_SIZE_MAX; MilGrabBufferListSize++)
@@ -118,12 +147,12 @@ int MosMain(void)
          }
 
       /* Initialize the user's processing function data structure. */
-      UserHookData.MilDigitizer = MilDigitizer;
+      UserHookData.MilDigitizer = Digitizer.MilDigitizer;
       UserHookData.MilContainerDisp = MilContainerDisp;
       UserHookData.ProcessedImageCount = 0;
 
       /* Start the processing. The processing function is called with every frame grabbed. */
-      MdigProcess(MilDigitizer, MilGrabBufferList, MilGrabBufferListSize, M_START, M_DEFAULT, ProcessingFunction, &UserHookData);
+      ReplayDigProcess(&Digitizer, MilGrabBufferList, MilGrabBufferListSize, M_START, M_DEFAULT, ProcessingFunction, &UserHookData);
 
 
       /* Here the main() is free to perform other tasks while the processing is executing. */
@@ -136,11 +165,11 @@ int MosMain(void)
       MosGetch();
 
       /* Stop the processing. */
-      MdigProcess(MilDigitizer, MilGrabBufferList, MilGrabBufferListSize, M_STOP, M_DEFAULT, ProcessingFunction, &UserHookData);
+      ReplayDigProcess(&Digitizer, MilGrabBufferList, MilGrabBufferListSize, M_STOP, M_DEFAULT, ProcessingFunction, &UserHookData);
 
       /* Print statistics. */
-      MdigInquire(MilDigitizer, M_PROCESS_FRAME_COUNT, &ProcessFrameCount);
-      MdigInquire(MilDigitizer, M_PROCESS_FRAME_RATE, &ProcessFrameRate);
+      ReplayDigInquire(&Digitizer, M_PROCESS_FRAME_COUNT, &ProcessFrameCount);
+      ReplayDigInquire(&Digitizer, M_PROCESS_FRAME_RATE, &ProcessFrameRate);
       MosPrintf(MIL_TEXT("\n\n%d 3D containers grabbed at %.1f frames/sec (%.1f ms/frame).\n"),
          (int)ProcessFrameCount, ProcessFrameRate, 1000.0 / ProcessFrameRate);
       MosPrintf(MIL_TEXT("Press <Enter> to end.\n\n"));
@@ -159,7 +188,10 @@ int MosMain(void)
    /* Release. */
    MbufFree(MilContainerDisp);
    M3ddispFree(MilDisplay);
-   MdigFree(MilDigitizer);
+   if(ReplaySource)
+      ReplayFree(&Digitizer);
+   else
+      MdigFree(Digitizer.MilDigitizer);
    MsysFree(MilSystem);
    MappFree(MilApplication);
 
@@ -179,7 +211,7 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID HookId, void* HookDat
    MIL_TEXT_CHAR Text[STRING_LENGTH_MAX] = {MIL_TEXT('\0'),};
 
    /* Retrieve the MIL_ID of the grabbed buffer. */
-   MdigGetHookInfo(HookId, M_MODIFIED_BUFFER + M_BUFFER_ID, &ModifiedBufferId);
+   ReplayDigGetHookInfo(HookId, M_MODIFIED_BUFFER + M_BUFFER_ID, &ModifiedBufferId);
 
    /* Increment the frame counter. */
    UserHookDataPtr->ProcessedImageCount++;
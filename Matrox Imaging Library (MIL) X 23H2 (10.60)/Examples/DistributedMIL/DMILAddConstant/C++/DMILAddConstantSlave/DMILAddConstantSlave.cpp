@@ -10,8 +10,13 @@
  *            and calls a Target processing function that adds a constant to the source
  *            buffer and writes the result to the target image.
  *
- *            Note: For simplicity, the images are assumed to be 8-bit unsigned and of
- *            the same dimensions.
+ *            The constant is added with saturated arithmetic kernels vectorized with
+ *            SSE2, AVX2, AVX-512 or NEON, selected at run time from the CPU of the
+ *            Target system. The buffer access and the type dispatch are done by the
+ *            PixelKernel template layer.
+ *
+ *            Note: The images must be of the same type, 8 or 16-bit, signed or
+ *            unsigned. The processed area is the smallest of the two images.
  *
  * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
  * All Rights Reserved
@@ -20,6 +25,10 @@
 /* Standard MIL header. */
 #include <mil.h>
 
+/* Saturated arithmetic kernels. */
+#include "../../../../General/MfuncUtil/C++/PixelArith.h"
+#include "../../../../General/MfuncUtil/C++/PixelKernel.h"
+
 
 
 /* Slave and Target MIL functions declarations */
@@ -58,81 +67,54 @@ void MFTYPE SlaveAddConstantC(MIL_ID Func)
 /*
  * This function adds a constant to a MIL buffer.
  *
- * For simplicity, it assumes that the buffers are 8-bit unsigned
- * buffers of the same dimensions.
+ * It assumes that the buffers are 8 or 16-bit buffers of the
+ * same type.
  */
 
-/* Target function restrictions and error code. */
-#define FUNCTION_SUPPORTED_IMAGE_DEPTH    (8+M_UNSIGNED)
+/* Target function error code. */
 #define FUNCTION_PARAMETER_ERROR_CODE     1
 
-void MFTYPE TargetAddConstantC(MIL_ID Src, MIL_ID Dst, MIL_UINT Constant)
+/* Image types supported by the kernels. */
+#define FUNCTION_SUPPORTED_IMAGE_TYPES    (PixelKernel::TYPE_8U  | PixelKernel::TYPE_8S | \
+                                           PixelKernel::TYPE_16U | PixelKernel::TYPE_16S)
+
+/* Row functor called by the PixelKernel layer for each row of each band. */
+struct AddConstantRowFunctor
    {
-   unsigned char* pSrc, *pDst;
-   MIL_UINT       PixelValue;
-   MIL_INT        SizeX, SizeY, SrcPitch, DstPitch, x, y;
-
-   /* Read the MIL buffers informations assuming same buffer dimensions. */
-   MbufInquire(Src, M_HOST_ADDRESS, &pSrc);
-   MbufInquire(Src, M_PITCH, &SrcPitch);
-   MbufInquire(Dst, M_HOST_ADDRESS, &pDst);
-   MbufInquire(Dst, M_SIZE_X, &SizeX);
-   MbufInquire(Dst, M_SIZE_Y, &SizeY);
-   MbufInquire(Dst, M_PITCH, &DstPitch);
-
-    /* Lock the source and destination for direct access. */
-   MbufControl(Src, M_LOCK, M_DEFAULT);
-   MbufControl(Dst, M_LOCK, M_DEFAULT);
-
-   if((pSrc != M_NULL) && (pDst != M_NULL))
+   PixelArith::KernelStruct Kernel;
+
+   template <class T>
+   void operator()(const PixelKernel::BandRow<const T>& Src, const PixelKernel::BandRow<T>& Dst,
+                   MIL_INT NumPixels) const
       {
-      /* If the images have the proper type and dimensions, process them.*/
-      if ((MbufInquire(Src, M_TYPE, M_NULL) == FUNCTION_SUPPORTED_IMAGE_DEPTH) &&
-          (MbufInquire(Dst, M_TYPE, M_NULL) == FUNCTION_SUPPORTED_IMAGE_DEPTH) &&
-          (MbufInquire(Src, M_SIZE_X, M_NULL) == SizeX) &&
-          (MbufInquire(Src, M_SIZE_Y, M_NULL) == SizeY)
-         )
-         {
-         /* Add the constant using C code (taking saturation into account). */
-         for(y = 0; y < SizeY; y++)
-            {
-            for(x = 0; x < SizeX; x++)
-               {
-               PixelValue = pSrc[x] + (unsigned char)Constant;
-               pDst[x] = (PixelValue < 255) ? (unsigned char)PixelValue : 255;
-               }
-            
-            /* Go to next line. */
-            pSrc += SrcPitch;
-            pDst += DstPitch;
-            }
-
-         /* Signal MIL that the destination buffer has been modified. */
-         MbufControl(Dst, M_MODIFIED, M_DEFAULT);
-         }
+      if ((Src.Stride == 1) && (Dst.Stride == 1))
+         PixelArith::ProcessRow(Kernel, Src.Ptr, Dst.Ptr, NumPixels);
       else
          {
-         /* Report a MIL error. */
-         MfuncErrorReport(M_DEFAULT, M_FUNC_ERROR + FUNCTION_PARAMETER_ERROR_CODE,
-                MIL_TEXT("Invalid parameter."),
-                MIL_TEXT("Images must have the same dimensions and must be 8-bit unsigned."),
-                M_NULL,
-                M_NULL
-                );
+         for (MIL_INT x = 0; x < NumPixels; x++)
+            PixelArith::ProcessRow(Kernel, &Src[x], &Dst[x], 1);
          }
       }
-   else
+   };
+
+void MFTYPE TargetAddConstantC(MIL_ID Src, MIL_ID Dst, MIL_UINT Constant)
+   {
+   AddConstantRowFunctor   RowFunctor;
+   PixelKernel::StatusEnum Status = PixelKernel::enUnsupportedType;
+
+   /* Prepare the kernel of the image type with the best instruction set of the CPU
+      (taking saturation into account).
+   */
+   if (PixelArith::GetKernel(PixelArith::GetBestInstructionSet(), PixelArith::enAdd,
+                             MbufInquire(Src, M_TYPE, M_NULL), (MIL_INT)Constant, &RowFunctor.Kernel))
       {
-      /* Report a MIL error. */
-      MfuncErrorReport(M_DEFAULT, M_FUNC_ERROR + FUNCTION_PARAMETER_ERROR_CODE,
-            MIL_TEXT("Invalid parameter."),
-            MIL_TEXT("One of the buffer has a NULL host address."),
-            M_NULL,
-            M_NULL
-            );
+      /* Lock the source and destination, add the constant to each row and unlock them.
+         The destination is signaled as modified.
+      */
+      Status = PixelKernel::Transform(Src, Dst, RowFunctor, FUNCTION_SUPPORTED_IMAGE_TYPES);
       }
-   
-   /* Unlock the source and destination. */
-   MbufControl(Src, M_UNLOCK, M_DEFAULT);
-   MbufControl(Dst, M_UNLOCK, M_DEFAULT);
+
+   /* Report a MIL error if the images cannot be processed. */
+   if (Status != PixelKernel::enOk)
+      PixelKernel::ReportError(M_DEFAULT, FUNCTION_PARAMETER_ERROR_CODE, Status);
    }
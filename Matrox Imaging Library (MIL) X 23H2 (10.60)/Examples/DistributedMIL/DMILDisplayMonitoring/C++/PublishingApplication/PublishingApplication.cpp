@@ -7,10 +7,17 @@
  *            The published MIL objects can then be accessed by an external MIL application.
  *            (see MonitoringApplication.cpp example).
  *
+ *            The display can be published at every frame at full resolution, or 
+ *            through published copies that are refreshed at a maximum rate, at a 
+ *            decimated preview resolution and with only the modified rectangle, so 
+ *            that the monitoring does not slow down the processing. The published 
+ *            bytes per second and the publishing cost are reported.
+ *
  * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
  * All Rights Reserved
  */
 #include <mil.h>
+#include <string.h>
 
 // Target image specifications.
 #define IMAGE_FILE               M_IMAGE_PATH MIL_TEXT("BaboonMono.mim")
@@ -18,6 +25,53 @@
 // Title for the display window.
 #define WINDOW_TITLE   MIL_TEXT("Publishing Application")
 
+// Publishing modes (choose one).
+#define PUBLISH_FULL             0  // Publish the display image and overlay at every frame.
+#define PUBLISH_THROTTLED        1  // Publish copies with the settings below.
+#define PUBLISH_MODE             PUBLISH_THROTTLED
+
+// Throttled publishing settings.
+#define PUBLISH_MAX_RATE         10.0   // Maximum refresh rate of the published images (Hz).
+#define PUBLISH_DECIMATION       2      // Decimation factor of the published images.
+#define PUBLISH_DELTA            M_YES  // Publish only the rectangle modified since the last update.
+
+// Interval of the publishing statistics (s).
+#define STATISTICS_INTERVAL      1.0
+
+// Maximum number of bands of the published images.
+#define MAX_BANDS                3
+
+// Published copy of an image.
+struct PublishedImageStruct
+   {
+   MIL_ID     SourceImage;                   // Image of the processing.
+   MIL_ID     PreviewImage;                  // Decimated copy of the current frame.
+   MIL_ID     PublishedImage;                // Published image (last update).
+   MIL_ID     PreviewBands[MAX_BANDS];
+   MIL_ID     PublishedBands[MAX_BANDS];
+   MIL_INT    NbBands;
+   MIL_INT    SizeX;
+   MIL_INT    SizeY;
+   };
+
+// Publishing statistics.
+struct PublishStatisticsStruct
+   {
+   MIL_INT    NbFrames;
+   MIL_INT    NbUpdates;
+   MIL_DOUBLE NbBytes;
+   MIL_DOUBLE PublishTime;
+   MIL_DOUBLE StartTime;
+   };
+
+void PublishedImageAlloc(MIL_ID MilSystem, MIL_ID SourceImage, MIL_INT Decimation,
+                         MIL_CONST_TEXT_PTR Name, PublishedImageStruct* PublishedPtr);
+void PublishedImageFree(PublishedImageStruct* PublishedPtr);
+MIL_INT PublishedImageUpdate(PublishedImageStruct* PublishedPtr, MIL_INT Decimation, bool Delta);
+bool FindModifiedRect(PublishedImageStruct* PublishedPtr, MIL_INT* StartX, MIL_INT* StartY,
+                      MIL_INT* EndX, MIL_INT* EndY);
+void PrintStatistics(PublishStatisticsStruct* StatisticsPtr, MIL_DOUBLE Time);
+
 int MosMain(void)
 {
    MIL_ID MilApplication   = M_NULL,
@@ -76,6 +130,7 @@ int MosMain(void)
    //************** Allow Monitoring ***************************
    MappControl(M_DEFAULT, M_DMIL_CONNECTION, M_DMIL_CONTROL);
 
+#if (PUBLISH_MODE == PUBLISH_FULL)
    MobjControl(MilDisplayImage, M_OBJECT_NAME,
                      MIL_TEXT("DisplayImage"));
    MobjControl(MilDisplayImage, M_DMIL_PUBLISH, M_READ_ONLY);
@@ -83,6 +138,32 @@ int MosMain(void)
    MobjControl(MilOverlayImage, M_OBJECT_NAME,
                      MIL_TEXT("OverlayImage"));
    MobjControl(MilOverlayImage, M_DMIL_PUBLISH, M_READ_ONLY);
+
+   MIL_DOUBLE FullFrameBytes = 
+      (MIL_DOUBLE)(MbufInquire(MilDisplayImage, M_SIZE_BYTE, M_NULL) +
+                   MbufInquire(MilOverlayImage, M_SIZE_BYTE, M_NULL));
+#else
+   // The decimation requires the image processing module.
+   MIL_INT Decimation = PUBLISH_DECIMATION;
+#if (!M_MIL_LITE)
+   if(!(LicenseModules & M_LICENSE_IM))
+#endif
+      Decimation = 1;
+
+   // Publish copies of the display image and overlay, with the same names, 
+   // that are only updated by the publishing.
+   PublishedImageStruct PublishedDisplay, PublishedOverlay;
+   PublishedImageAlloc(MilSystem, MilDisplayImage, Decimation, MIL_TEXT("DisplayImage"), 
+                       &PublishedDisplay);
+   PublishedImageAlloc(MilSystem, MilOverlayImage, Decimation, MIL_TEXT("OverlayImage"), 
+                       &PublishedOverlay);
+   MIL_DOUBLE LastPublishTime = -1.0;
+#endif
+
+   PublishStatisticsStruct Statistics;
+   memset(&Statistics, 0, sizeof(Statistics));
+   MIL_DOUBLE StartTime, EndTime;
+   MappTimer(M_DEFAULT, M_TIMER_RESET+M_SYNCHRONOUS, M_NULL);
    
    //************** Processsing *********************************
    MIL_INT Angle = 0;
@@ -95,6 +176,13 @@ int MosMain(void)
    MosPrintf(MIL_TEXT("The image displayed is published using DMIL in order to\n"));
    MosPrintf(MIL_TEXT("make it available for external monitoring.\n\n"));
    MosPrintf(MIL_TEXT("You can now run the monitoring example.\n\n"));
+#if (PUBLISH_MODE == PUBLISH_FULL)
+   MosPrintf(MIL_TEXT("Publishing: full resolution at every frame.\n\n"));
+#else
+   MosPrintf(MIL_TEXT("Publishing: maximum %.1f Hz, decimation %d, %s updates.\n\n"),
+             PUBLISH_MAX_RATE, (int)Decimation, 
+             PUBLISH_DELTA ? MIL_TEXT("modified rectangle") : MIL_TEXT("full image"));
+#endif
    MosPrintf(MIL_TEXT("Press <Enter> to end.\n"));
 
    while(!MosKbhit())
@@ -104,8 +192,10 @@ int MosMain(void)
       // In order to optimize display updates and network transfers,
       // modifications hooks and display updates are disabled.
       MdispControl(MilDisplay, M_UPDATE, M_DISABLE);
+#if (PUBLISH_MODE == PUBLISH_FULL)
       MbufControl(MilDisplayImage, M_MODIFICATION_HOOK, M_DISABLE);
       MbufControl(MilOverlayImage, M_MODIFICATION_HOOK, M_DISABLE);
+#endif
       
       // Rotate the image.
 #if (!M_MIL_LITE)
@@ -130,12 +220,218 @@ int MosMain(void)
       MosSprintf(Text, 64, MIL_TEXT(" - MIL Overlay Text (%d)- "), (int)Angle);
       MgraText(M_DEFAULT, MilOverlayImage, CenterX, CenterX, Text);
       MdispControl(MilDisplay, M_UPDATE, M_ENABLE);
+
+      // Publish the frame. The timer reads are synchronous so the publishing
+      // cost does not include the processing.
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &StartTime);
+#if (PUBLISH_MODE == PUBLISH_FULL)
       MbufControl(MilDisplayImage, M_MODIFICATION_HOOK, M_ENABLE);
       MbufControl(MilOverlayImage, M_MODIFICATION_HOOK, M_ENABLE);
       MbufControl(MilDisplayImage, M_MODIFIED, M_DEFAULT);
       MbufControl(MilOverlayImage, M_MODIFIED, M_DEFAULT);
+      Statistics.NbUpdates++;
+      Statistics.NbBytes += FullFrameBytes;
+#else
+      if((LastPublishTime < 0.0) || (StartTime - LastPublishTime >= 1.0/PUBLISH_MAX_RATE))
+         {
+         bool Delta = (PUBLISH_DELTA == M_YES);
+         MIL_INT NbBytes = PublishedImageUpdate(&PublishedDisplay, Decimation, Delta) +
+                           PublishedImageUpdate(&PublishedOverlay, Decimation, Delta);
+         if(NbBytes > 0)
+            Statistics.NbUpdates++;
+         Statistics.NbBytes += (MIL_DOUBLE)NbBytes;
+         LastPublishTime = StartTime;
+         }
+#endif
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &EndTime);
+      Statistics.PublishTime += EndTime - StartTime;
+      Statistics.NbFrames++;
+
+      if(EndTime - Statistics.StartTime >= STATISTICS_INTERVAL)
+         PrintStatistics(&Statistics, EndTime);
       }
+   MosPrintf(MIL_TEXT("\n"));
 
+#if (PUBLISH_MODE != PUBLISH_FULL)
+   PublishedImageFree(&PublishedOverlay);
+   PublishedImageFree(&PublishedDisplay);
+#endif
    MbufFree(MilSrcImage);
    MappFreeDefault(MilApplication, MilSystem, MilDisplay, M_NULL, MilDisplayImage);
 }  
+
+//*****************************************************************************
+// PublishedImageAlloc. Allocates the published copy of an image, at the 
+// decimated resolution, and publishes it under the given name.
+//*****************************************************************************
+void PublishedImageAlloc(MIL_ID MilSystem, MIL_ID SourceImage, MIL_INT Decimation,
+                         MIL_CONST_TEXT_PTR Name, PublishedImageStruct* PublishedPtr)
+   {
+   static const MIL_INT BandNames[MAX_BANDS] = {M_RED, M_GREEN, M_BLUE};
+
+   PublishedPtr->SourceImage = SourceImage;
+   PublishedPtr->NbBands = MbufInquire(SourceImage, M_SIZE_BAND, M_NULL);
+   PublishedPtr->SizeX   = MbufInquire(SourceImage, M_SIZE_X, M_NULL)/Decimation;
+   PublishedPtr->SizeY   = MbufInquire(SourceImage, M_SIZE_Y, M_NULL)/Decimation;
+
+   // The images are planar so the bands can be compared in host memory.
+   MbufAllocColor(MilSystem, PublishedPtr->NbBands, PublishedPtr->SizeX, PublishedPtr->SizeY,
+                  8+M_UNSIGNED, M_IMAGE+M_PROC+M_PLANAR, &PublishedPtr->PreviewImage);
+   MbufAllocColor(MilSystem, PublishedPtr->NbBands, PublishedPtr->SizeX, PublishedPtr->SizeY,
+                  8+M_UNSIGNED, M_IMAGE+M_PROC+M_PLANAR, &PublishedPtr->PublishedImage);
+   MbufClear(PublishedPtr->PublishedImage, 0);
+
+   for(MIL_INT b = 0; b < PublishedPtr->NbBands; b++)
+      {
+      if(PublishedPtr->NbBands == 1)
+         {
+         PublishedPtr->PreviewBands[b]   = PublishedPtr->PreviewImage;
+         PublishedPtr->PublishedBands[b] = PublishedPtr->PublishedImage;
+         }
+      else
+         {
+         MbufChildColor(PublishedPtr->PreviewImage, BandNames[b], &PublishedPtr->PreviewBands[b]);
+         MbufChildColor(PublishedPtr->PublishedImage, BandNames[b], &PublishedPtr->PublishedBands[b]);
+         }
+      }
+
+   MobjControl(PublishedPtr->PublishedImage, M_OBJECT_NAME, Name);
+   MobjControl(PublishedPtr->PublishedImage, M_DMIL_PUBLISH, M_READ_ONLY);
+   }
+
+//*****************************************************************************
+// PublishedImageFree. Frees the published copy of an image.
+//*****************************************************************************
+void PublishedImageFree(PublishedImageStruct* PublishedPtr)
+   {
+   if(PublishedPtr->NbBands > 1)
+      {
+      for(MIL_INT b = 0; b < PublishedPtr->NbBands; b++)
+         {
+         MbufFree(PublishedPtr->PreviewBands[b]);
+         MbufFree(PublishedPtr->PublishedBands[b]);
+         }
+      }
+   MbufFree(PublishedPtr->PublishedImage);
+   MbufFree(PublishedPtr->PreviewImage);
+   }
+
+//*****************************************************************************
+// PublishedImageUpdate. Updates the published copy with the current frame and
+// returns the number of bytes published. In delta mode, only the rectangle 
+// that differs from the last update is copied, through a child buffer, so only
+// this region is signaled as modified to the monitoring applications.
+//*****************************************************************************
+MIL_INT PublishedImageUpdate(PublishedImageStruct* PublishedPtr, MIL_INT Decimation, bool Delta)
+   {
+   // Get the current frame at the published resolution.
+   if(Decimation > 1)
+      MimResize(PublishedPtr->SourceImage, PublishedPtr->PreviewImage, 
+                M_FILL_DESTINATION, M_FILL_DESTINATION, M_NEAREST_NEIGHBOR);
+   else
+      MbufCopy(PublishedPtr->SourceImage, PublishedPtr->PreviewImage);
+
+   MIL_INT StartX = 0, StartY = 0;
+   MIL_INT EndX = PublishedPtr->SizeX-1, EndY = PublishedPtr->SizeY-1;
+   if(Delta && !FindModifiedRect(PublishedPtr, &StartX, &StartY, &EndX, &EndY))
+      return 0;
+
+   MIL_INT SizeX = EndX - StartX + 1;
+   MIL_INT SizeY = EndY - StartY + 1;
+   if((SizeX == PublishedPtr->SizeX) && (SizeY == PublishedPtr->SizeY))
+      MbufCopy(PublishedPtr->PreviewImage, PublishedPtr->PublishedImage);
+   else
+      {
+      MIL_ID MilSrcChild, MilDstChild;
+      MbufChild2d(PublishedPtr->PreviewImage, StartX, StartY, SizeX, SizeY, &MilSrcChild);
+      MbufChild2d(PublishedPtr->PublishedImage, StartX, StartY, SizeX, SizeY, &MilDstChild);
+      MbufCopy(MilSrcChild, MilDstChild);
+      MbufFree(MilDstChild);
+      MbufFree(MilSrcChild);
+      }
+
+   return SizeX*SizeY*PublishedPtr->NbBands;
+   }
+
+//*****************************************************************************
+// FindModifiedRect. Finds the bounding rectangle of the pixels that differ 
+// between the current frame and the published image. Returns false if they
+// are identical.
+//*****************************************************************************
+bool FindModifiedRect(PublishedImageStruct* PublishedPtr, MIL_INT* StartX, MIL_INT* StartY,
+                      MIL_INT* EndX, MIL_INT* EndY)
+   {
+   MIL_INT MinX = PublishedPtr->SizeX, MinY = PublishedPtr->SizeY, MaxX = -1, MaxY = -1;
+
+   for(MIL_INT b = 0; b < PublishedPtr->NbBands; b++)
+      {
+      const MIL_UINT8* PreviewPtr = (const MIL_UINT8*)
+         MbufInquire(PublishedPtr->PreviewBands[b], M_HOST_ADDRESS, M_NULL);
+      const MIL_UINT8* PublishedPtr8 = (const MIL_UINT8*)
+         MbufInquire(PublishedPtr->PublishedBands[b], M_HOST_ADDRESS, M_NULL);
+      MIL_INT PreviewPitch   = MbufInquire(PublishedPtr->PreviewBands[b], M_PITCH_BYTE, M_NULL);
+      MIL_INT PublishedPitch = MbufInquire(PublishedPtr->PublishedBands[b], M_PITCH_BYTE, M_NULL);
+
+      // The whole image is modified if the buffers are not in host memory.
+      if(PreviewPtr == M_NULL || PublishedPtr8 == M_NULL)
+         {
+         *StartX = 0;
+         *StartY = 0;
+         *EndX   = PublishedPtr->SizeX-1;
+         *EndY   = PublishedPtr->SizeY-1;
+         return true;
+         }
+
+      for(MIL_INT y = 0; y < PublishedPtr->SizeY; y++)
+         {
+         const MIL_UINT8* Row1 = PreviewPtr + y*PreviewPitch;
+         const MIL_UINT8* Row2 = PublishedPtr8 + y*PublishedPitch;
+         if(memcmp(Row1, Row2, (size_t)PublishedPtr->SizeX) == 0)
+            continue;
+
+         // Find the first and last modified pixels of the row.
+         MIL_INT x1 = 0, x2 = PublishedPtr->SizeX-1;
+         while(Row1[x1] == Row2[x1])
+            x1++;
+         while(Row1[x2] == Row2[x2])
+            x2--;
+
+         if(x1 < MinX) MinX = x1;
+         if(x2 > MaxX) MaxX = x2;
+         if(y < MinY)  MinY = y;
+         if(y > MaxY)  MaxY = y;
+         }
+      }
+
+   if(MaxX < 0)
+      return false;
+
+   *StartX = MinX;
+   *StartY = MinY;
+   *EndX   = MaxX;
+   *EndY   = MaxY;
+   return true;
+   }
+
+//*****************************************************************************
+// PrintStatistics. Prints the publishing statistics of the last interval and
+// resets them.
+//*****************************************************************************
+void PrintStatistics(PublishStatisticsStruct* StatisticsPtr, MIL_DOUBLE Time)
+   {
+   MIL_DOUBLE Interval = Time - StatisticsPtr->StartTime;
+
+   MosPrintf(MIL_TEXT("Frame rate: %6.1f fps, Updates: %5.1f/s, Published: %8.1f KB/s, ")
+             MIL_TEXT("Publishing cost: %5.2f ms/frame (%4.1f%%)   \r"),
+             StatisticsPtr->NbFrames/Interval,
+             StatisticsPtr->NbUpdates/Interval,
+             StatisticsPtr->NbBytes/Interval/1024.0,
+             StatisticsPtr->PublishTime*1000.0/StatisticsPtr->NbFrames,
+             StatisticsPtr->PublishTime*100.0/Interval);
+
+   StatisticsPtr->NbFrames    = 0;
+   StatisticsPtr->NbUpdates   = 0;
+   StatisticsPtr->NbBytes     = 0.0;
+   StatisticsPtr->PublishTime = 0.0;
+   StatisticsPtr->StartTime   = Time;
+   }
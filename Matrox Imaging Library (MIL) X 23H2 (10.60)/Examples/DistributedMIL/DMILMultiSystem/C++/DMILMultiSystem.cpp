@@ -10,6 +10,24 @@
  *           To process each grabbed buffer only once and dispatch the processing to all the
  *           target systems in round robin set PROCESS_EACH_IMAGE_ON_ALL_SYSTEMS to N0.
  *
+ *           The example then processes each grabbed buffer once on the least-loaded
+ *           system (See LOAD_AWARE_DISPATCH). A thread per system processes its jobs
+ *           and measures their time, so that fast systems receive more frames than
+ *           slow or busy ones. The results are displayed in frame order and the
+ *           utilization of each system is reported.
+ *
+ *           The grabbed buffers can be sent to the processing systems in full, as a
+ *           region of interest, as a downscaled preview that the target system
+ *           upscales, or as a lossless JPEG buffer that the target system
+ *           decompresses (See TRANSFER_MODE). The bytes sent per frame and the 
+ *           transfer time are reported against the processing time.
+ *
+ *           Finally, a scaling harness allocates 1 to 16 slave systems (See SCALING_HARNESS
+ *           and SYSTEM_ADDRESSES) and processes a fixed number of frames on each 
+ *           configuration. The throughput, the overhead of a call and of a round trip
+ *           to a slave, and the number of systems after which the overhead of the
+ *           transfers and of the calls wipes out the gain of a new system are reported.
+ *
  *           The grab system is the one specified by MilConfig default values.
  *           The type of the processing systems is specified below (See PROCESSING_SYSTEM_TYPE).
  *
@@ -32,6 +50,7 @@
 #define USE_GRAB_SYSTEM_AS_ONE_PROCESSOR     M_YES /* Use the grabbing system as one of the processing system. */
 #define PROCESS_EACH_IMAGE_ON_ALL_SYSTEMS    M_YES /* Force each grabbed image to be processed by all the systems. */
 #define DISPLAY_EACH_IMAGE_PROCESSED         M_YES /* Force each processed image to be displayed (might affect frame rate). */
+#define LOAD_AWARE_DISPATCH                  M_YES /* Also process each grabbed image once on the least-loaded system. */
 
 /* Protocol used by Distributed MIL for inter-systems communication. */
 #define DISTRIBUTED_MIL_PROTOCOL             MIL_TEXT("dmiltcp")
@@ -61,6 +80,111 @@ MIL_CONST_TEXT_PTR SYSTEM_ADDRESSES[] = {
 /* Number of grab buffers for MdigProcess(). */
 #define GRAB_BUFFER_NUMBER             (2 * PROCESSING_SYSTEM_NUMBER)
 
+/* Transfer of the grabbed buffers to the processing systems. */
+#define TRANSFER_FULL                  0     /* Copy the whole buffer.                                  */
+#define TRANSFER_ROI                   1     /* Copy only the centered region of interest.              */
+#define TRANSFER_PREVIEW               2     /* Copy a downscaled buffer, upscaled by the target.       */
+#define TRANSFER_LOSSLESS              3     /* Copy a lossless JPEG buffer, decompressed by the target. */
+#define TRANSFER_MODE                  TRANSFER_FULL
+#define TRANSFER_ROI_SCALE             0.5   /* Size of the region of interest, relative to the buffer. */
+#define TRANSFER_PREVIEW_SCALE         0.5   /* Scale of the downscaled preview.                        */
+
+/* Load-aware dispatch specification. */
+#define JOB_TIME_SMOOTHING             0.25  /* Weight of the last job in the mean job time of a system. */
+#define REORDER_BUFFER_NUMBER          (4 * PROCESSING_SYSTEM_NUMBER) /* Results waiting to be displayed in order. */
+#define FRAME_NONE                     -1
+
+/* Scaling harness specification. */
+#define SCALING_HARNESS                M_YES /* Also measure the throughput with 1 to SCALING_MAX_SYSTEMS slave systems. */
+#define SCALING_MAX_SYSTEMS            16    /* Maximum number of slave systems (Maximum 16, see SYSTEM_ADDRESSES). */
+#define SCALING_NB_FRAMES              100   /* Frames processed by each configuration.                      */
+#define SCALING_NB_CALLS               200   /* Calls used to measure the call and round trip overheads.     */
+#define SCALING_MIN_GAIN               0.10  /* Minimum gain of a new system, relative to a single system.   */
+
+/* Transfer of the grabbed buffers and its statistics. */
+typedef struct
+   {
+   int     Mode;
+   MIL_ID  HostStageBuffer;              /* Downscaled or compressed grabbed buffer.      */
+   MIL_INT SizeX, SizeY, SizeBand;
+   MIL_INT RoiOffsetX, RoiOffsetY, RoiSizeX, RoiSizeY;
+   MIL_INT ProcSizeX, ProcSizeY;         /* Size of the processing buffers.               */
+   MIL_INT StageSizeX, StageSizeY;
+   MIL_INT StageAttribute;
+   int     NbTransfer;
+   double  NbByte;
+   double  TransferTime;                 /* Measured with the load-aware dispatch only. */
+   } TransferStruct;
+
+/* Processing buffers of a system, with the frame they hold. */
+typedef struct
+   {
+   MIL_ID  SrcBuffer;
+   MIL_ID  DstBuffer;
+   MIL_ID  StageBuffer;
+   int     FrameIndex;
+   } JobSlotStruct;
+
+/* Jobs and load of a processing system. */
+struct DispatcherStruct;
+typedef struct
+   {
+   struct DispatcherStruct *DispatcherPtr;
+   MIL_ID        MilSystem;
+   MIL_ID        MilThread;
+   MIL_ID        JobReadyEvent;
+   JobSlotStruct Slots[BUFFER_PER_PROCESSOR];
+   int           JobQueue[BUFFER_PER_PROCESSOR];   /* Slots to process, in dispatch order. */
+   int           QueueHead, QueueCount;
+   int           NbOutstanding;                    /* Jobs queued or being processed.      */
+   int           NbJobDone;
+   double        MeanJobTime;                      /* Smoothed time of a job, in seconds.  */
+   double        BusyTime;                         /* Total time of the jobs, in seconds.  */
+   double        ProcessTime;                      /* Part of the jobs spent processing.   */
+   } SystemWorkerStruct;
+
+/* Result waiting to be displayed in frame order. */
+typedef struct
+   {
+   MIL_ID  HostBuffer;
+   int     FrameIndex;
+   int     Ready;
+   } ReorderSlotStruct;
+
+/* Dispatcher of the frames to the least-loaded system. */
+typedef struct DispatcherStruct
+   {
+   MIL_ID             MilMutex;
+   MIL_ID             JobDoneEvent;
+   MIL_ID             DispBuffer;
+   TransferStruct    *TransferPtr;
+   SystemWorkerStruct Workers[PROCESSING_SYSTEM_NUMBER];
+   ReorderSlotStruct  Reorder[REORDER_BUFFER_NUMBER];
+   int                NbSystem;
+   int                NbOutstanding;
+   int                NextFrameToDisplay;
+   int                Exit;
+   MIL_INT            SizeX, SizeY;
+   } DispatcherStruct;
+
+/* Slave system of the scaling harness and its processing buffers. */
+typedef struct
+   {
+   MIL_ID  MilSystem;
+   MIL_ID  SrcBuffer[BUFFER_PER_PROCESSOR];
+   MIL_ID  DstBuffer[BUFFER_PER_PROCESSOR];
+   MIL_ID  CallBuffer;                  /* Single pixel buffer used to measure the call overheads. */
+   } ScalingSystemStruct;
+
+/* Measures of a configuration of the scaling harness. */
+typedef struct
+   {
+   int     NbSystem;
+   double  FrameRate;                   /* Frames per second.                                   */
+   double  CallOverhead;                /* Time of an asynchronous call on a slave, in seconds. */
+   double  RoundTrip;                   /* Time of a synchronous call on a slave, in seconds.   */
+   } ScalingResultStruct;
+
 /* User's Processing call back function and data structure. */
 MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID EventId, void* CallBackDataPtr);
 typedef struct
@@ -69,13 +193,35 @@ typedef struct
    MIL_ID  DispBuffer;
    MIL_ID *SrcProcBufferListPtr;
    MIL_ID *DstProcBufferListPtr;
+   MIL_ID *StageProcBufferListPtr;
    MIL_INT SizeX, SizeY, SizeBand;
    int     NbSystem;
    int     NbProc;
+   MIL_INT LastGrabbedIndex;
    double  Time;
    int    ProcessEachImageOnAllSystems;
+   DispatcherStruct *DispatcherPtr;
+   TransferStruct   *TransferPtr;
    } ProcessingDataStruct;
 
+/* Transfer, processing and load-aware dispatch functions. */
+void TransferAlloc(TransferStruct *TransferPtr, MIL_ID MilSystem, int Mode, MIL_INT SizeX, MIL_INT SizeY, MIL_INT SizeBand);
+void TransferFree(TransferStruct *TransferPtr);
+void TransferAllocStageBuffer(TransferStruct *TransferPtr, MIL_ID ProcSystem, MIL_ID *StageBufIdPtr);
+void TransferPrepare(TransferStruct *TransferPtr, MIL_ID GrabbedBufferId);
+void TransferSend(TransferStruct *TransferPtr, MIL_ID GrabbedBufferId, MIL_ID StageBufId, MIL_ID SrcBufId);
+void TransferPrintStatistics(TransferStruct *TransferPtr, int NbProc);
+void ProcessBuffer(MIL_ID SrcBufId, MIL_ID DstBufId, int FrameIndex, MIL_INT SizeX, MIL_INT SizeY);
+void DispatcherAlloc(DispatcherStruct *DispatcherPtr, MIL_ID MilSystem, MIL_ID *ProcSystemList, int NbSystem,
+                     MIL_ID *SrcProcBufferList, MIL_ID *DstProcBufferList, MIL_ID *StageProcBufferList,
+                     MIL_ID DispBuffer, TransferStruct *TransferPtr, MIL_INT SizeX, MIL_INT SizeY, MIL_INT SizeBand);
+void DispatcherFree(DispatcherStruct *DispatcherPtr);
+void DispatchToLeastLoadedSystem(DispatcherStruct *DispatcherPtr, MIL_ID GrabbedBufferId, int FrameIndex);
+void DispatcherFlush(DispatcherStruct *DispatcherPtr);
+void DispatcherPrintUtilization(DispatcherStruct *DispatcherPtr, double Time);
+MIL_UINT32 MFTYPE SystemWorkerThread(void *WorkerPtrVoid);
+void RunScalingHarness(MIL_ID HostSrcBuffer, MIL_INT SizeX, MIL_INT SizeY, MIL_INT SizeBand);
+
 
 /* ************************************************************************ */
 /* This example performs multiple buffers processing using MdigProcess() on 
@@ -91,16 +237,20 @@ int MosMain(void)
    MIL_ID MilDigitizer  ;
    MIL_ID MilDisplay    ;
    MIL_ID MilImageDisp  ;
+   MIL_ID MilImageDispResult;
    MIL_ID GrabBufferList[GRAB_BUFFER_NUMBER];
    MIL_ID ProcSystemList[PROCESSING_SYSTEM_NUMBER];  
    MIL_ID SrcProcBufferList[BUFFER_NUMBER];
    MIL_ID DstProcBufferList[BUFFER_NUMBER];
+   MIL_ID StageProcBufferList[BUFFER_NUMBER];
    MIL_INT SizeX, SizeY, SizeBand;
    MIL_TEXT_CHAR SystemDescriptor[SYSTEM_DESCRIPTOR_SIZE];
    int     NbSystem = 0, NbSystemToAllocate = PROCESSING_SYSTEM_NUMBER;
    MIL_INT    GrabFrameCount, n; 
    double SingleSystemProcessingRate, MultipleSystemProcessingRate;
    ProcessingDataStruct ProcessingData;
+   DispatcherStruct     Dispatcher;
+   TransferStruct       Transfer;
 
    /* Allocations and setup. */
    /* ---------------------- */
@@ -130,6 +280,7 @@ int MosMain(void)
    SizeX    = ProcessingData.SizeX = (MIL_INT)(MdigInquire(MilDigitizer, M_SIZE_X, M_NULL)*BUFFER_SCALE);
    SizeY    = ProcessingData.SizeY = (MIL_INT)(MdigInquire(MilDigitizer, M_SIZE_Y, M_NULL)*BUFFER_SCALE);
    SizeBand = ProcessingData.SizeBand = (MIL_INT)(MdigInquire(MilDigitizer, M_SIZE_BAND, M_NULL));
+   ProcessingData.LastGrabbedIndex = 0;
    
    /* Allocate a display buffer and clear it. */
    MbufAllocColor(MilSystem, SizeBand, SizeX, SizeY, 8L+M_UNSIGNED, M_IMAGE+M_GRAB+M_DISP, &MilImageDisp);
@@ -170,13 +321,30 @@ int MosMain(void)
       NbSystem++;
       }
 
-   /* Allocate and order the source and destination processing buffers alternating the target system. */
+   /* Allocate the host buffer of the transfer mode. */
+   TransferAlloc(&Transfer, MilSystem, TRANSFER_MODE, SizeX, SizeY, SizeBand);
+
+   /* Only the region of interest is processed and displayed when it is the only part transferred. */
+   ProcessingData.SizeX = Transfer.ProcSizeX;
+   ProcessingData.SizeY = Transfer.ProcSizeY;
+   if (Transfer.Mode == TRANSFER_ROI)
+      MbufChild2d(MilImageDisp, Transfer.RoiOffsetX, Transfer.RoiOffsetY, Transfer.RoiSizeX, Transfer.RoiSizeY,
+                  &MilImageDispResult);
+   else
+      MilImageDispResult = MilImageDisp;
+
+   /* Allocate and order the source and destination processing buffers alternating the target system. 
+      The stage buffers receive the downscaled or compressed transfers, if any.
+   */
+   for (n=0; n<BUFFER_NUMBER; n++)
+      StageProcBufferList[n] = M_NULL;
    for (n=0; n<(NbSystem*BUFFER_PER_PROCESSOR); n++)
       {
-      MbufAllocColor(ProcSystemList[n%NbSystem], SizeBand, SizeX, SizeY, 8L+M_UNSIGNED, 
+      MbufAllocColor(ProcSystemList[n%NbSystem], SizeBand, Transfer.ProcSizeX, Transfer.ProcSizeY, 8L+M_UNSIGNED, 
                                                  M_IMAGE+M_PROC, &SrcProcBufferList[n]);
-      MbufAllocColor(ProcSystemList[n%NbSystem], SizeBand, SizeX, SizeY, 8L+M_UNSIGNED, 
+      MbufAllocColor(ProcSystemList[n%NbSystem], SizeBand, Transfer.ProcSizeX, Transfer.ProcSizeY, 8L+M_UNSIGNED, 
                                                  M_IMAGE+M_PROC, &DstProcBufferList[n]);
+      TransferAllocStageBuffer(&Transfer, ProcSystemList[n%NbSystem], &StageProcBufferList[n]);
       }
 
    /* Set the specified grab scale. */
@@ -195,10 +363,13 @@ int MosMain(void)
    ProcessingData.NbSystem = 1;
    ProcessingData.ProcessEachImageOnAllSystems = M_NO;
    ProcessingData.NbProc = 0;
+   ProcessingData.DispatcherPtr = M_NULL;
+   ProcessingData.TransferPtr = &Transfer;
    ProcessingData.MilDigitizer = MilDigitizer;
-   ProcessingData.DispBuffer = MilImageDisp; 
+   ProcessingData.DispBuffer = MilImageDispResult; 
    ProcessingData.SrcProcBufferListPtr = SrcProcBufferList;
    ProcessingData.DstProcBufferListPtr = DstProcBufferList;
+   ProcessingData.StageProcBufferListPtr = StageProcBufferList;
       
    /* Start processing the buffers. */
    MdigProcess(MilDigitizer, GrabBufferList, GRAB_BUFFER_NUMBER, M_START, M_DEFAULT, 
@@ -217,6 +388,7 @@ int MosMain(void)
       MdigInquire(MilDigitizer, M_PROCESS_FRAME_COUNT, &GrabFrameCount);
       MosPrintf(MIL_TEXT("%lld Frames grabbed, %d Frames processed at %.1f frames/sec (%.1f ms/frame).\n"),
                 (long long)GrabFrameCount, ProcessingData.NbProc, SingleSystemProcessingRate, 1000.0/SingleSystemProcessingRate); 
+      TransferPrintStatistics(&Transfer, ProcessingData.NbProc);
       }
    else
       MosPrintf(MIL_TEXT("No frame has been grabbed.\n"));
@@ -236,9 +408,11 @@ int MosMain(void)
    ProcessingData.NbSystem = NbSystem;
    ProcessingData.ProcessEachImageOnAllSystems = PROCESS_EACH_IMAGE_ON_ALL_SYSTEMS;
    ProcessingData.NbProc = 0;
-   ProcessingData.DispBuffer = MilImageDisp; 
+   ProcessingData.DispatcherPtr = M_NULL;
+   ProcessingData.DispBuffer = MilImageDispResult; 
    ProcessingData.SrcProcBufferListPtr = SrcProcBufferList;
    ProcessingData.DstProcBufferListPtr = DstProcBufferList;
+   ProcessingData.StageProcBufferListPtr = StageProcBufferList;
    
    
    /* Start processing the buffers. */
@@ -258,12 +432,83 @@ int MosMain(void)
       MdigInquire(MilDigitizer, M_PROCESS_FRAME_COUNT, &GrabFrameCount);
       MosPrintf(MIL_TEXT("%lld Frames grabbed, %d Frames processed at %.1f frames/sec (%.1f ms/frame).\n\n"),
                 (long long)GrabFrameCount, ProcessingData.NbProc, MultipleSystemProcessingRate, 1000.0/MultipleSystemProcessingRate); 
-      MosPrintf(MIL_TEXT("Speedup factor: %.1f.\n\n"),MultipleSystemProcessingRate/SingleSystemProcessingRate);
+      MosPrintf(MIL_TEXT("Speedup factor: %.1f.\n"),MultipleSystemProcessingRate/SingleSystemProcessingRate);
+      TransferPrintStatistics(&Transfer, ProcessingData.NbProc);
       if (DISPLAY_EACH_IMAGE_PROCESSED && ((long)((MultipleSystemProcessingRate/SingleSystemProcessingRate)+0.1) < NbSystem))
           MosPrintf(MIL_TEXT("Warning: Display might limit the processing speed. Disable it and retry.\n\n"));
       }
    else
       MosPrintf(MIL_TEXT("No frame has been grabbed.\n"));
+
+   /* Load-aware multiple systems processing. */
+   /* --------------------------------------- */
+
+   if (LOAD_AWARE_DISPATCH)
+      {
+      MosPrintf(MIL_TEXT("Press <Enter> to continue.\n\n"));
+      MosGetch();
+
+      /* Print a message. */
+      MosPrintf(MIL_TEXT("%d Systems processing with load-aware dispatch:\n"), NbSystem);
+
+      /* Halt continuous grab. */
+      MdigHalt(MilDigitizer);
+
+      /* Allocate the dispatcher and start the thread of each system. */
+      DispatcherAlloc(&Dispatcher, MilSystem, ProcSystemList, NbSystem, SrcProcBufferList, DstProcBufferList,
+                      StageProcBufferList, MilImageDispResult, &Transfer, Transfer.ProcSizeX, Transfer.ProcSizeY,
+                      SizeBand);
+
+      /* Initialize processing variables. */
+      ProcessingData.NbSystem = NbSystem;
+      ProcessingData.ProcessEachImageOnAllSystems = M_NO;
+      ProcessingData.NbProc = 0;
+      ProcessingData.DispatcherPtr = &Dispatcher;
+
+      /* Start processing the buffers. */
+      MdigProcess(MilDigitizer, GrabBufferList, GRAB_BUFFER_NUMBER, M_START, M_DEFAULT, 
+                                                    ProcessingFunction, &ProcessingData);
+
+      /* Wait for a key and stop the processing. */
+      MosPrintf(MIL_TEXT("Press <Enter> to stop.\n\n"));  
+      MosGetch();   
+      MdigProcess(MilDigitizer, GrabBufferList, GRAB_BUFFER_NUMBER, M_STOP+M_WAIT, M_DEFAULT, 
+                                                          ProcessingFunction, &ProcessingData);
+
+      /* Wait for the jobs in progress and display their results. */
+      DispatcherFlush(&Dispatcher);
+      if (ProcessingData.NbProc != 0)
+         MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &ProcessingData.Time);
+
+      /* Print statistics. */
+      if (ProcessingData.NbProc != 0)
+         {
+         MultipleSystemProcessingRate = ProcessingData.NbProc/ProcessingData.Time;
+         MdigInquire(MilDigitizer, M_PROCESS_FRAME_COUNT, &GrabFrameCount);
+         MosPrintf(MIL_TEXT("%lld Frames grabbed, %d Frames processed at %.1f frames/sec (%.1f ms/frame).\n\n"),
+                   (long long)GrabFrameCount, ProcessingData.NbProc, MultipleSystemProcessingRate, 1000.0/MultipleSystemProcessingRate); 
+         MosPrintf(MIL_TEXT("Speedup factor: %.1f.\n"),MultipleSystemProcessingRate/SingleSystemProcessingRate);
+         TransferPrintStatistics(&Transfer, ProcessingData.NbProc);
+         DispatcherPrintUtilization(&Dispatcher, ProcessingData.Time);
+         }
+      else
+         MosPrintf(MIL_TEXT("No frame has been grabbed.\n"));
+
+      DispatcherFree(&Dispatcher);
+      }
+
+   /* Scaling of the throughput with the number of slave systems. */
+   /* ----------------------------------------------------------- */
+
+   if (SCALING_HARNESS)
+      {
+      MosPrintf(MIL_TEXT("Press <Enter> to continue.\n\n"));
+      MosGetch();
+
+      /* Halt continuous grab and process the last grabbed frame. */
+      MdigHalt(MilDigitizer);
+      RunScalingHarness(GrabBufferList[ProcessingData.LastGrabbedIndex], SizeX, SizeY, SizeBand);
+      }
    MosPrintf(MIL_TEXT("Press <Enter> to end.\n\n"));
    MosGetch();
    
@@ -276,11 +521,16 @@ int MosMain(void)
       {
       MbufFree(SrcProcBufferList[n]);
       MbufFree(DstProcBufferList[n]);
+      if (StageProcBufferList[n])
+         MbufFree(StageProcBufferList[n]);
       }
+   TransferFree(&Transfer);
    if (USE_GRAB_SYSTEM_AS_ONE_PROCESSOR)
       NbSystem--;
    for (n=0; n<NbSystem; n++)
       MsysFree(ProcSystemList[n]);
+   if (MilImageDispResult != MilImageDisp)
+      MbufFree(MilImageDispResult);
    MbufFree(MilImageDisp);
    MdispFree(MilDisplay);
    MdigFree(MilDigitizer);
@@ -300,9 +550,6 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID EventId, void* CallBa
    MIL_ID CurrentProcSrcBufId, CurrentProcDstBufId; 
    MIL_ID GrabbedBufferId;
    MIL_INT GrabbedBufferIndex;
-   MIL_TEXT_CHAR Text[BUFFER_MAX_STRING_LENGTH];
-   MIL_DOUBLE RectHalfSizeStep = 0.0;
-   long RectStep = 0;
    long NbSystem = ProcessingDataPtr->NbSystem;
    long NbProcInitial = ProcessingDataPtr->NbProc;
    long NbBufferToProcess, n;
@@ -310,10 +557,32 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID EventId, void* CallBa
    /* Retrieve the buffer to process and it's index */
    MdigGetHookInfo(EventId, M_MODIFIED_BUFFER+M_BUFFER_ID,    &GrabbedBufferId);
    MdigGetHookInfo(EventId, M_MODIFIED_BUFFER+M_BUFFER_INDEX, &GrabbedBufferIndex);
+   ProcessingDataPtr->LastGrabbedIndex = GrabbedBufferIndex;
 
-   /* Reset the timer. */
+   /* Reset the timer and the transfer statistics. */
    if (ProcessingDataPtr->NbProc == 0)
+      {
       MappTimer(M_DEFAULT, M_TIMER_RESET+M_SYNCHRONOUS,&ProcessingDataPtr->Time);
+      ProcessingDataPtr->TransferPtr->NbTransfer   = 0;
+      ProcessingDataPtr->TransferPtr->NbByte       = 0.0;
+      ProcessingDataPtr->TransferPtr->TransferTime = 0.0;
+      }
+
+   /* With load-aware dispatch, the frame is sent to the least-loaded system and its
+      result is displayed by the dispatcher in frame order.
+   */
+   if (ProcessingDataPtr->DispatcherPtr)
+      {
+      DispatchToLeastLoadedSystem(ProcessingDataPtr->DispatcherPtr, GrabbedBufferId, ProcessingDataPtr->NbProc);
+
+      /* Count processed buffers. */
+      ProcessingDataPtr->NbProc++;
+      MosPrintf(MIL_TEXT("Processing #%d.\r"), ProcessingDataPtr->NbProc);
+
+      /* Read the timer. */
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &ProcessingDataPtr->Time);
+      return(0);
+      }
 
    /* If PROCESS_EACH_IMAGE_ON_ALL_SYSTEMS is set, each grabbed image is processed on all the systems. 
       To have each frame processed only once by one system in round robin fashion, set the define to M_NO.  
@@ -323,6 +592,9 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID EventId, void* CallBa
    else
       NbBufferToProcess = 1;
 
+   /* Downscale or compress the grabbed buffer once for all the systems, if required. */
+   TransferPrepare(ProcessingDataPtr->TransferPtr, GrabbedBufferId);
+
    /* Dispatch the job to the target processing system(s) */ 
    for(n=0; n<NbBufferToProcess; n++)
       {
@@ -331,42 +603,13 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID EventId, void* CallBa
       CurrentProcDstBufId = ProcessingDataPtr->DstProcBufferListPtr[(ProcessingDataPtr->NbProc)%(NbSystem*BUFFER_PER_PROCESSOR)];
 
       /* Copy the grabbed buffer to a processing platform. */
-      MbufCopy(GrabbedBufferId, CurrentProcSrcBufId);
-
-      /* Draw the buffer index in the source. */
-      MosSprintf(Text, BUFFER_MAX_STRING_LENGTH, MIL_TEXT("#%d."), ProcessingDataPtr->NbProc);
-      MgraText(M_DEFAULT, CurrentProcSrcBufId, 50, 50, Text);
+      TransferSend(ProcessingDataPtr->TransferPtr, GrabbedBufferId,
+                   ProcessingDataPtr->StageProcBufferListPtr[(ProcessingDataPtr->NbProc)%(NbSystem*BUFFER_PER_PROCESSOR)],
+                   CurrentProcSrcBufId);
 
       /* Process the buffer. */
-      #if (!M_MIL_LITE)
-          {
-          MimArith(CurrentProcSrcBufId, 0x10, CurrentProcDstBufId, M_SUB_CONST+M_SATURATION);
-          MimArith(CurrentProcDstBufId, M_NULL, CurrentProcSrcBufId, M_NOT);
-          MimRotate(CurrentProcSrcBufId, CurrentProcDstBufId,
-                    (ProcessingDataPtr->NbProc*10)%360, 
-                    (MIL_DOUBLE) ProcessingDataPtr->SizeX/2,
-                    (MIL_DOUBLE) ProcessingDataPtr->SizeY/2,
-                    (MIL_DOUBLE) ProcessingDataPtr->SizeX/2,
-                    (MIL_DOUBLE) ProcessingDataPtr->SizeY/2,
-                    M_NEAREST_NEIGHBOR);
-          }
-      #else
-         {
-         RectStep = (ProcessingDataPtr->NbProc % BUFFER_DRAW_RECT_NUMBER);
-          if(RectStep < BUFFER_DRAW_INWARD_STEP_NUMBER)
-             RectHalfSizeStep = RectStep * BUFFER_DRAW_RECT_STEP;
-          else
-             RectHalfSizeStep = (BUFFER_DRAW_RECT_NUMBER - RectStep) * BUFFER_DRAW_RECT_STEP;
-
-          MgraColor(M_DEFAULT, 0xff);
-          MgraRectFill(M_DEFAULT,
-                       CurrentProcDstBufId,
-                       ProcessingDataPtr->SizeX/2 - RectHalfSizeStep,
-                       ProcessingDataPtr->SizeY/2 - RectHalfSizeStep,
-                       ProcessingDataPtr->SizeX/2 + RectHalfSizeStep,
-                       ProcessingDataPtr->SizeY/2 + RectHalfSizeStep);
-         }
-      #endif
+      ProcessBuffer(CurrentProcSrcBufId, CurrentProcDstBufId, ProcessingDataPtr->NbProc,
+                    ProcessingDataPtr->SizeX, ProcessingDataPtr->SizeY);
 
       /* Count processed buffers. */
       ProcessingDataPtr->NbProc++;
@@ -392,3 +635,693 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID EventId, void* CallBa
 
    return(0);
    }
+
+/* Transfer of the grabbed buffers to the processing systems. */
+/* ---------------------------------------------------------- */
+
+static MIL_CONST_TEXT_PTR TransferModeName(int Mode)
+   {
+   switch (Mode)
+      {
+      case TRANSFER_ROI:      return MIL_TEXT("region of interest");
+      case TRANSFER_PREVIEW:  return MIL_TEXT("downscaled preview");
+      case TRANSFER_LOSSLESS: return MIL_TEXT("lossless JPEG");
+      default:                return MIL_TEXT("full buffer");
+      }
+   }
+
+/* Allocates the host buffer of the transfer mode. */
+void TransferAlloc(TransferStruct *TransferPtr, MIL_ID MilSystem, int Mode, MIL_INT SizeX, MIL_INT SizeY, MIL_INT SizeBand)
+   {
+   /* Image processing is not available to upscale the preview with MIL Lite. */
+   #if (M_MIL_LITE)
+   if (Mode == TRANSFER_PREVIEW)
+      Mode = TRANSFER_FULL;
+   #endif
+
+   TransferPtr->Mode            = Mode;
+   TransferPtr->HostStageBuffer = M_NULL;
+   TransferPtr->SizeX           = SizeX;
+   TransferPtr->SizeY           = SizeY;
+   TransferPtr->SizeBand        = SizeBand;
+   TransferPtr->RoiSizeX        = (MIL_INT)(SizeX*TRANSFER_ROI_SCALE);
+   TransferPtr->RoiSizeY        = (MIL_INT)(SizeY*TRANSFER_ROI_SCALE);
+   TransferPtr->RoiOffsetX      = (SizeX - TransferPtr->RoiSizeX)/2;
+   TransferPtr->RoiOffsetY      = (SizeY - TransferPtr->RoiSizeY)/2;
+   TransferPtr->ProcSizeX       = (Mode == TRANSFER_ROI)? TransferPtr->RoiSizeX: SizeX;
+   TransferPtr->ProcSizeY       = (Mode == TRANSFER_ROI)? TransferPtr->RoiSizeY: SizeY;
+   TransferPtr->StageSizeX      = SizeX;
+   TransferPtr->StageSizeY      = SizeY;
+   TransferPtr->StageAttribute  = M_NULL;
+   TransferPtr->NbTransfer      = 0;
+   TransferPtr->NbByte          = 0.0;
+   TransferPtr->TransferTime    = 0.0;
+
+   if (Mode == TRANSFER_PREVIEW)
+      {
+      TransferPtr->StageSizeX     = (MIL_INT)(SizeX*TRANSFER_PREVIEW_SCALE);
+      TransferPtr->StageSizeY     = (MIL_INT)(SizeY*TRANSFER_PREVIEW_SCALE);
+      TransferPtr->StageAttribute = M_IMAGE+M_PROC;
+      }
+   else if (Mode == TRANSFER_LOSSLESS)
+      TransferPtr->StageAttribute = M_IMAGE+M_COMPRESS+M_JPEG_LOSSLESS;
+
+   if (TransferPtr->StageAttribute)
+      MbufAllocColor(MilSystem, SizeBand, TransferPtr->StageSizeX, TransferPtr->StageSizeY, 8L+M_UNSIGNED,
+                     TransferPtr->StageAttribute, &TransferPtr->HostStageBuffer);
+
+   MosPrintf(MIL_TEXT("Transfer of the grabbed buffers: %s.\n"), TransferModeName(Mode));
+   }
+
+void TransferFree(TransferStruct *TransferPtr)
+   {
+   if (TransferPtr->HostStageBuffer)
+      MbufFree(TransferPtr->HostStageBuffer);
+   }
+
+/* Allocates the buffer of a processing system that receives the downscaled or 
+   compressed transfers. No buffer is needed to copy the full buffer or a region.
+*/
+void TransferAllocStageBuffer(TransferStruct *TransferPtr, MIL_ID ProcSystem, MIL_ID *StageBufIdPtr)
+   {
+   *StageBufIdPtr = M_NULL;
+   if (TransferPtr->StageAttribute)
+      MbufAllocColor(ProcSystem, TransferPtr->SizeBand, TransferPtr->StageSizeX, TransferPtr->StageSizeY,
+                     8L+M_UNSIGNED, TransferPtr->StageAttribute, StageBufIdPtr);
+   }
+
+/* Downscales or compresses the grabbed buffer on the grab system, once per frame. */
+void TransferPrepare(TransferStruct *TransferPtr, MIL_ID GrabbedBufferId)
+   {
+   switch (TransferPtr->Mode)
+      {
+      #if (!M_MIL_LITE)
+      case TRANSFER_PREVIEW:
+         MimResize(GrabbedBufferId, TransferPtr->HostStageBuffer, M_FILL_DESTINATION, M_FILL_DESTINATION, M_AVERAGE);
+         break;
+      #endif
+      case TRANSFER_LOSSLESS:
+         MbufCopy(GrabbedBufferId, TransferPtr->HostStageBuffer);
+         break;
+      default:
+         break;
+      }
+   }
+
+/* Sends the grabbed buffer to the source buffer of a processing system. The downscaled
+   and compressed buffers are sent to the stage buffer of the system, and upscaled or
+   decompressed there by the processing system itself. The region of interest fills
+   the source buffer, which has the size of the region.
+*/
+void TransferSend(TransferStruct *TransferPtr, MIL_ID GrabbedBufferId, MIL_ID StageBufId, MIL_ID SrcBufId)
+   {
+   MIL_INT NbByte;
+
+   switch (TransferPtr->Mode)
+      {
+      case TRANSFER_ROI:
+         MbufCopyColor2d(GrabbedBufferId, SrcBufId, M_ALL_BANDS, TransferPtr->RoiOffsetX, TransferPtr->RoiOffsetY,
+                         M_ALL_BANDS, 0, 0, TransferPtr->RoiSizeX, TransferPtr->RoiSizeY);
+         NbByte = TransferPtr->RoiSizeX*TransferPtr->RoiSizeY*TransferPtr->SizeBand;
+         break;
+
+      #if (!M_MIL_LITE)
+      case TRANSFER_PREVIEW:
+         MbufCopy(TransferPtr->HostStageBuffer, StageBufId);
+         MimResize(StageBufId, SrcBufId, M_FILL_DESTINATION, M_FILL_DESTINATION, M_BILINEAR);
+         NbByte = TransferPtr->StageSizeX*TransferPtr->StageSizeY*TransferPtr->SizeBand;
+         break;
+      #endif
+
+      case TRANSFER_LOSSLESS:
+         MbufCopy(TransferPtr->HostStageBuffer, StageBufId);
+         MbufCopy(StageBufId, SrcBufId);
+         NbByte = MbufInquire(TransferPtr->HostStageBuffer, M_COMPRESSED_DATA_SIZE_BYTE, M_NULL);
+         break;
+
+      default:
+         MbufCopy(GrabbedBufferId, SrcBufId);
+         NbByte = TransferPtr->SizeX*TransferPtr->SizeY*TransferPtr->SizeBand;
+         break;
+      }
+
+   TransferPtr->NbTransfer++;
+   TransferPtr->NbByte += (double)NbByte;
+   }
+
+/* Prints the bytes sent and the pixels processed per frame and, when measured, the transfer time.
+   The bytes are counted in every run, but the transfer time is only measured with the load-aware
+   dispatch: the round-robin runs queue the copy with the processing of the previous frames, and
+   waiting for it to end to time it would serialize the systems. The output says so.
+*/
+void TransferPrintStatistics(TransferStruct *TransferPtr, int NbProc)
+   {
+   double FullSize = (double)(TransferPtr->SizeX*TransferPtr->SizeY*TransferPtr->SizeBand);
+
+   if (TransferPtr->NbTransfer == 0)
+      return;
+
+   MosPrintf(MIL_TEXT("Transfer (%s): %.1f KB/frame, %.0f%% of a full copy"), TransferModeName(TransferPtr->Mode),
+             TransferPtr->NbByte/TransferPtr->NbTransfer/1024.0,
+             100.0*(TransferPtr->NbByte/TransferPtr->NbTransfer)/FullSize);
+   MosPrintf(MIL_TEXT(", %lldx%lld pixels processed"), (long long)TransferPtr->ProcSizeX, (long long)TransferPtr->ProcSizeY);
+   if (TransferPtr->TransferTime > 0.0)
+      MosPrintf(MIL_TEXT(", %.2f ms/frame"), 1000.0*TransferPtr->TransferTime/NbProc);
+   else
+      MosPrintf(MIL_TEXT(".\nThe transfer time is not measured in the round-robin runs, only with the load-aware dispatch"));
+   MosPrintf(MIL_TEXT(".\n\n"));
+   }
+
+/* Processing of a buffer on its system. */
+/* ------------------------------------- */
+
+void ProcessBuffer(MIL_ID SrcBufId, MIL_ID DstBufId, int FrameIndex, MIL_INT SizeX, MIL_INT SizeY)
+   {
+   MIL_TEXT_CHAR Text[BUFFER_MAX_STRING_LENGTH];
+   MIL_DOUBLE RectHalfSizeStep = 0.0;
+   long RectStep = 0;
+
+   /* Draw the buffer index in the source. */
+   MosSprintf(Text, BUFFER_MAX_STRING_LENGTH, MIL_TEXT("#%d."), FrameIndex);
+   MgraText(M_DEFAULT, SrcBufId, 50, 50, Text);
+
+   /* Process the buffer. */
+   #if (!M_MIL_LITE)
+       {
+       MimArith(SrcBufId, 0x10, DstBufId, M_SUB_CONST+M_SATURATION);
+       MimArith(DstBufId, M_NULL, SrcBufId, M_NOT);
+       MimRotate(SrcBufId, DstBufId,
+                 (FrameIndex*10)%360, 
+                 (MIL_DOUBLE) SizeX/2,
+                 (MIL_DOUBLE) SizeY/2,
+                 (MIL_DOUBLE) SizeX/2,
+                 (MIL_DOUBLE) SizeY/2,
+                 M_NEAREST_NEIGHBOR);
+       }
+   #else
+      {
+      RectStep = (FrameIndex % BUFFER_DRAW_RECT_NUMBER);
+       if(RectStep < BUFFER_DRAW_INWARD_STEP_NUMBER)
+          RectHalfSizeStep = RectStep * BUFFER_DRAW_RECT_STEP;
+       else
+          RectHalfSizeStep = (BUFFER_DRAW_RECT_NUMBER - RectStep) * BUFFER_DRAW_RECT_STEP;
+
+       MgraColor(M_DEFAULT, 0xff);
+       MgraRectFill(M_DEFAULT,
+                    DstBufId,
+                    SizeX/2 - RectHalfSizeStep,
+                    SizeY/2 - RectHalfSizeStep,
+                    SizeX/2 + RectHalfSizeStep,
+                    SizeY/2 + RectHalfSizeStep);
+      }
+   #endif
+   }
+
+/* Load-aware dispatch of the frames to the processing systems. */
+/* ------------------------------------------------------------ */
+
+/* Allocates the dispatcher and starts a thread per processing system. The processing
+   buffers were allocated alternating the systems, so the buffers of system n are the
+   ones at n, n+NbSystem, ...
+*/
+void DispatcherAlloc(DispatcherStruct *DispatcherPtr, MIL_ID MilSystem, MIL_ID *ProcSystemList, int NbSystem,
+                     MIL_ID *SrcProcBufferList, MIL_ID *DstProcBufferList, MIL_ID *StageProcBufferList,
+                     MIL_ID DispBuffer, TransferStruct *TransferPtr, MIL_INT SizeX, MIL_INT SizeY, MIL_INT SizeBand)
+   {
+   SystemWorkerStruct *WorkerPtr;
+   int n, b;
+
+   DispatcherPtr->NbSystem           = NbSystem;
+   DispatcherPtr->NbOutstanding      = 0;
+   DispatcherPtr->NextFrameToDisplay = 0;
+   DispatcherPtr->Exit               = M_NO;
+   DispatcherPtr->DispBuffer         = DispBuffer;
+   DispatcherPtr->TransferPtr        = TransferPtr;
+   DispatcherPtr->SizeX              = SizeX;
+   DispatcherPtr->SizeY              = SizeY;
+   MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &DispatcherPtr->MilMutex);
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &DispatcherPtr->JobDoneEvent);
+
+   /* Allocate the host buffers of the results waiting to be displayed in order. */
+   for (n=0; n<REORDER_BUFFER_NUMBER; n++)
+      {
+      DispatcherPtr->Reorder[n].HostBuffer = M_NULL;
+      DispatcherPtr->Reorder[n].FrameIndex = FRAME_NONE;
+      DispatcherPtr->Reorder[n].Ready      = M_NO;
+      if (DISPLAY_EACH_IMAGE_PROCESSED)
+         MbufAllocColor(MilSystem, SizeBand, SizeX, SizeY, 8L+M_UNSIGNED, M_IMAGE+M_PROC,
+                        &DispatcherPtr->Reorder[n].HostBuffer);
+      }
+
+   for (n=0; n<NbSystem; n++)
+      {
+      WorkerPtr = &DispatcherPtr->Workers[n];
+      WorkerPtr->DispatcherPtr = DispatcherPtr;
+      WorkerPtr->MilSystem     = ProcSystemList[n];
+      WorkerPtr->QueueHead     = 0;
+      WorkerPtr->QueueCount    = 0;
+      WorkerPtr->NbOutstanding = 0;
+      WorkerPtr->NbJobDone     = 0;
+      WorkerPtr->MeanJobTime   = 0.0;
+      WorkerPtr->BusyTime      = 0.0;
+      WorkerPtr->ProcessTime   = 0.0;
+      for (b=0; b<BUFFER_PER_PROCESSOR; b++)
+         {
+         WorkerPtr->Slots[b].SrcBuffer  = SrcProcBufferList[n + b*NbSystem];
+         WorkerPtr->Slots[b].DstBuffer  = DstProcBufferList[n + b*NbSystem];
+         WorkerPtr->Slots[b].StageBuffer = StageProcBufferList[n + b*NbSystem];
+         WorkerPtr->Slots[b].FrameIndex = FRAME_NONE;
+         }
+      MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &WorkerPtr->JobReadyEvent);
+      MthrAlloc(MilSystem, M_THREAD, M_DEFAULT, &SystemWorkerThread, WorkerPtr, &WorkerPtr->MilThread);
+      }
+   }
+
+/* Stops the threads of the systems and frees the dispatcher. */
+void DispatcherFree(DispatcherStruct *DispatcherPtr)
+   {
+   int n;
+
+   MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+   DispatcherPtr->Exit = M_YES;
+   MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+   for (n=0; n<DispatcherPtr->NbSystem; n++)
+      {
+      MthrControl(DispatcherPtr->Workers[n].JobReadyEvent, M_EVENT_SET, M_SIGNALED);
+      MthrWait(DispatcherPtr->Workers[n].MilThread, M_THREAD_END_WAIT, M_NULL);
+      MthrFree(DispatcherPtr->Workers[n].MilThread);
+      MthrFree(DispatcherPtr->Workers[n].JobReadyEvent);
+      }
+   for (n=0; n<REORDER_BUFFER_NUMBER; n++)
+      {
+      if (DispatcherPtr->Reorder[n].HostBuffer)
+         MbufFree(DispatcherPtr->Reorder[n].HostBuffer);
+      }
+   MthrFree(DispatcherPtr->JobDoneEvent);
+   MthrFree(DispatcherPtr->MilMutex);
+   }
+
+/* Returns the system with a free buffer that should finish a new job first, from its
+   jobs in progress and its mean job time, or M_NULL if all the buffers are in use.
+   Systems without a measured job time are tried first. Called with the mutex locked.
+*/
+static SystemWorkerStruct* FindLeastLoadedSystem(DispatcherStruct *DispatcherPtr)
+   {
+   SystemWorkerStruct *BestWorkerPtr = M_NULL;
+   double Load, BestLoad = 0.0;
+   int n;
+
+   for (n=0; n<DispatcherPtr->NbSystem; n++)
+      {
+      SystemWorkerStruct *WorkerPtr = &DispatcherPtr->Workers[n];
+      if (WorkerPtr->NbOutstanding >= BUFFER_PER_PROCESSOR)
+         continue;
+
+      Load = (WorkerPtr->NbOutstanding + 1) * WorkerPtr->MeanJobTime;
+      if ((BestWorkerPtr == M_NULL) || (Load < BestLoad))
+         {
+         BestWorkerPtr = WorkerPtr;
+         BestLoad      = Load;
+         }
+      }
+   return BestWorkerPtr;
+   }
+
+/* Displays the results that are ready, in frame order, and frees their reorder slot. */
+static void DisplayReadyFrames(DispatcherStruct *DispatcherPtr)
+   {
+   ReorderSlotStruct *ReorderPtr;
+
+   while (1)
+      {
+      MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+      ReorderPtr = &DispatcherPtr->Reorder[DispatcherPtr->NextFrameToDisplay % REORDER_BUFFER_NUMBER];
+      if ((ReorderPtr->FrameIndex != DispatcherPtr->NextFrameToDisplay) || !ReorderPtr->Ready)
+         {
+         MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+         break;
+         }
+      MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+      /* Only this thread frees the reorder slots, so the copy is done unlocked. */
+      if (DISPLAY_EACH_IMAGE_PROCESSED)
+         MbufCopy(ReorderPtr->HostBuffer, DispatcherPtr->DispBuffer);
+
+      MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+      ReorderPtr->FrameIndex = FRAME_NONE;
+      ReorderPtr->Ready      = M_NO;
+      DispatcherPtr->NextFrameToDisplay++;
+      MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+      }
+   }
+
+/* Sends a grabbed frame to the least-loaded system. Waits for a job to complete if
+   all the buffers are in use, or if the results of the frames older than the reorder 
+   window are not displayed yet.
+*/
+void DispatchToLeastLoadedSystem(DispatcherStruct *DispatcherPtr, MIL_ID GrabbedBufferId, int FrameIndex)
+   {
+   SystemWorkerStruct *WorkerPtr;
+   ReorderSlotStruct  *ReorderPtr = &DispatcherPtr->Reorder[FrameIndex % REORDER_BUFFER_NUMBER];
+   double StartTime, EndTime;
+   int Slot;
+
+   while (1)
+      {
+      DisplayReadyFrames(DispatcherPtr);
+
+      MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+      WorkerPtr = FindLeastLoadedSystem(DispatcherPtr);
+      if ((WorkerPtr != M_NULL) && (ReorderPtr->FrameIndex == FRAME_NONE))
+         break;
+      MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+      MthrWait(DispatcherPtr->JobDoneEvent, M_EVENT_WAIT, M_NULL);
+      }
+
+   /* Reserve a buffer of the system and the reorder slot of the frame. */
+   for (Slot=0; WorkerPtr->Slots[Slot].FrameIndex != FRAME_NONE; Slot++)
+      ;
+   WorkerPtr->Slots[Slot].FrameIndex = FrameIndex;
+   WorkerPtr->NbOutstanding++;
+   DispatcherPtr->NbOutstanding++;
+   ReorderPtr->FrameIndex = FrameIndex;
+   ReorderPtr->Ready      = M_NO;
+   MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+   /* Copy the grabbed buffer to the processing system. The copy is completed before 
+      the job is queued, since the thread of the system sends its commands separately.
+   */
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &StartTime);
+   TransferPrepare(DispatcherPtr->TransferPtr, GrabbedBufferId);
+   TransferSend(DispatcherPtr->TransferPtr, GrabbedBufferId, WorkerPtr->Slots[Slot].StageBuffer,
+                WorkerPtr->Slots[Slot].SrcBuffer);
+   MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &EndTime);
+   DispatcherPtr->TransferPtr->TransferTime += EndTime - StartTime;
+
+   /* Queue the job to the thread of the system. */
+   MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+   WorkerPtr->JobQueue[(WorkerPtr->QueueHead + WorkerPtr->QueueCount) % BUFFER_PER_PROCESSOR] = Slot;
+   WorkerPtr->QueueCount++;
+   MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+   MthrControl(WorkerPtr->JobReadyEvent, M_EVENT_SET, M_SIGNALED);
+   }
+
+/* Waits for the jobs in progress and displays their results. */
+void DispatcherFlush(DispatcherStruct *DispatcherPtr)
+   {
+   int NbOutstanding;
+
+   while (1)
+      {
+      DisplayReadyFrames(DispatcherPtr);
+
+      MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+      NbOutstanding = DispatcherPtr->NbOutstanding;
+      MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+      if (NbOutstanding == 0)
+         break;
+
+      MthrWait(DispatcherPtr->JobDoneEvent, M_EVENT_WAIT, M_NULL);
+      }
+   DisplayReadyFrames(DispatcherPtr);
+   }
+
+/* Prints the share of the frames, the mean job time and the utilization of each system. */
+void DispatcherPrintUtilization(DispatcherStruct *DispatcherPtr, double Time)
+   {
+   SystemWorkerStruct *WorkerPtr;
+   int NbFrames = 0, n;
+
+   for (n=0; n<DispatcherPtr->NbSystem; n++)
+      NbFrames += DispatcherPtr->Workers[n].NbJobDone;
+
+   MosPrintf(MIL_TEXT("System  Frames  Share  Mean job (ms)  Process (ms)  Copy back (ms)  Utilization\n"));
+   MosPrintf(MIL_TEXT("------  ------  -----  -------------  ------------  --------------  -----------\n"));
+   for (n=0; n<DispatcherPtr->NbSystem; n++)
+      {
+      WorkerPtr = &DispatcherPtr->Workers[n];
+      MosPrintf(MIL_TEXT("%-6d  %6d  %4.0f%%  %13.1f  %12.1f  %14.1f  %10.0f%%%s\n"), n, WorkerPtr->NbJobDone,
+                NbFrames ? 100.0*WorkerPtr->NbJobDone/NbFrames : 0.0,
+                WorkerPtr->NbJobDone ? 1000.0*WorkerPtr->BusyTime/WorkerPtr->NbJobDone : 0.0,
+                WorkerPtr->NbJobDone ? 1000.0*WorkerPtr->ProcessTime/WorkerPtr->NbJobDone : 0.0,
+                WorkerPtr->NbJobDone ? 1000.0*(WorkerPtr->BusyTime-WorkerPtr->ProcessTime)/WorkerPtr->NbJobDone : 0.0,
+                (Time > 0.0) ? 100.0*WorkerPtr->BusyTime/Time : 0.0,
+                (USE_GRAB_SYSTEM_AS_ONE_PROCESSOR && (n == DispatcherPtr->NbSystem-1)) ? MIL_TEXT(" (grab system)") : MIL_TEXT(""));
+      }
+   MosPrintf(MIL_TEXT("\n"));
+   }
+
+/* Thread of a processing system. Processes the jobs of the system in order, measures
+   their time and makes their results available for display.
+*/
+MIL_UINT32 MFTYPE SystemWorkerThread(void *WorkerPtrVoid)
+   {
+   SystemWorkerStruct *WorkerPtr = (SystemWorkerStruct *)WorkerPtrVoid;
+   DispatcherStruct   *DispatcherPtr = WorkerPtr->DispatcherPtr;
+   JobSlotStruct      *SlotPtr;
+   ReorderSlotStruct  *ReorderPtr;
+   double StartTime, ProcessEndTime, EndTime, JobTime;
+
+   while (1)
+      {
+      /* Take the next job of the system, or exit when there is none left. */
+      MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+      while ((WorkerPtr->QueueCount == 0) && !DispatcherPtr->Exit)
+         {
+         MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+         MthrWait(WorkerPtr->JobReadyEvent, M_EVENT_WAIT, M_NULL);
+         MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+         }
+      if (WorkerPtr->QueueCount == 0)
+         {
+         MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+         break;
+         }
+      SlotPtr = &WorkerPtr->Slots[WorkerPtr->JobQueue[WorkerPtr->QueueHead]];
+      WorkerPtr->QueueHead = (WorkerPtr->QueueHead + 1) % BUFFER_PER_PROCESSOR;
+      WorkerPtr->QueueCount--;
+      ReorderPtr = &DispatcherPtr->Reorder[SlotPtr->FrameIndex % REORDER_BUFFER_NUMBER];
+      MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+      /* Process the frame on the system and wait until it is done, then copy back the result. */
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &StartTime);
+      ProcessBuffer(SlotPtr->SrcBuffer, SlotPtr->DstBuffer, SlotPtr->FrameIndex,
+                    DispatcherPtr->SizeX, DispatcherPtr->SizeY);
+      MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &ProcessEndTime);
+      if (DISPLAY_EACH_IMAGE_PROCESSED)
+         MbufCopy(SlotPtr->DstBuffer, ReorderPtr->HostBuffer);
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &EndTime);
+      JobTime = EndTime - StartTime;
+
+      /* Update the load of the system and release its buffer. */
+      MthrControl(DispatcherPtr->MilMutex, M_LOCK, M_DEFAULT);
+      if (WorkerPtr->NbJobDone == 0)
+         WorkerPtr->MeanJobTime = JobTime;
+      else
+         WorkerPtr->MeanJobTime += JOB_TIME_SMOOTHING * (JobTime - WorkerPtr->MeanJobTime);
+      WorkerPtr->BusyTime += JobTime;
+      WorkerPtr->ProcessTime += ProcessEndTime - StartTime;
+      WorkerPtr->NbJobDone++;
+      WorkerPtr->NbOutstanding--;
+      DispatcherPtr->NbOutstanding--;
+      SlotPtr->FrameIndex = FRAME_NONE;
+      ReorderPtr->Ready   = M_YES;
+      MthrControl(DispatcherPtr->MilMutex, M_UNLOCK, M_DEFAULT);
+      MthrControl(DispatcherPtr->JobDoneEvent, M_EVENT_SET, M_SIGNALED);
+      }
+
+   return 0;
+   }
+
+/* Scaling of the throughput with the number of slave systems. */
+/* ----------------------------------------------------------- */
+
+/* Allocates a slave system and its processing buffers. Each buffer is processed once 
+   so that the first jobs of the measures do not include the setup of the slave.
+*/
+static int ScalingSystemAlloc(ScalingSystemStruct *SystemPtr, int SystemIndex, MIL_INT SizeX, MIL_INT SizeY, MIL_INT SizeBand)
+   {
+   MIL_TEXT_CHAR SystemDescriptor[SYSTEM_DESCRIPTOR_SIZE];
+   int b;
+
+   MosSprintf(SystemDescriptor, SYSTEM_DESCRIPTOR_SIZE, MIL_TEXT("%s://%s/%s"), 
+              DISTRIBUTED_MIL_PROTOCOL, SYSTEM_ADDRESSES[SystemIndex], PROCESSING_SYSTEM_TYPE);
+   MsysAlloc(M_DEFAULT, SystemDescriptor, M_DEFAULT, M_DEFAULT, &SystemPtr->MilSystem);
+   if (SystemPtr->MilSystem == M_NULL)
+      return M_NO;
+
+   for (b=0; b<BUFFER_PER_PROCESSOR; b++)
+      {
+      MbufAllocColor(SystemPtr->MilSystem, SizeBand, SizeX, SizeY, 8L+M_UNSIGNED, M_IMAGE+M_PROC, &SystemPtr->SrcBuffer[b]);
+      MbufAllocColor(SystemPtr->MilSystem, SizeBand, SizeX, SizeY, 8L+M_UNSIGNED, M_IMAGE+M_PROC, &SystemPtr->DstBuffer[b]);
+      MbufClear(SystemPtr->SrcBuffer[b], 0x0);
+      ProcessBuffer(SystemPtr->SrcBuffer[b], SystemPtr->DstBuffer[b], 0, SizeX, SizeY);
+      }
+   MbufAlloc2d(SystemPtr->MilSystem, 1, 1, 8L+M_UNSIGNED, M_IMAGE+M_PROC, &SystemPtr->CallBuffer);
+   MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+
+   return M_YES;
+   }
+
+/* Frees a slave system and its processing buffers. */
+static void ScalingSystemFree(ScalingSystemStruct *SystemPtr)
+   {
+   int b;
+
+   MbufFree(SystemPtr->CallBuffer);
+   for (b=0; b<BUFFER_PER_PROCESSOR; b++)
+      {
+      MbufFree(SystemPtr->SrcBuffer[b]);
+      MbufFree(SystemPtr->DstBuffer[b]);
+      }
+   MsysFree(SystemPtr->MilSystem);
+   }
+
+/* Measures the time of an asynchronous call on a slave, which is the cost of sending 
+   the command, and the time of a synchronous call, which also waits for its reply.
+*/
+static void ScalingMeasureCallOverhead(ScalingSystemStruct *SystemPtr, double *CallOverheadPtr, double *RoundTripPtr)
+   {
+   MIL_UINT8 Value;
+   double StartTime, EndTime;
+   int n;
+
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &StartTime);
+   for (n=0; n<SCALING_NB_CALLS; n++)
+      MbufClear(SystemPtr->CallBuffer, (MIL_DOUBLE)(n & 0xff));
+   MbufGet(SystemPtr->CallBuffer, &Value);
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &EndTime);
+   *CallOverheadPtr = (EndTime - StartTime) / SCALING_NB_CALLS;
+
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &StartTime);
+   for (n=0; n<SCALING_NB_CALLS; n++)
+      {
+      MbufClear(SystemPtr->CallBuffer, (MIL_DOUBLE)(n & 0xff));
+      MbufGet(SystemPtr->CallBuffer, &Value);
+      }
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &EndTime);
+   *RoundTripPtr = (EndTime - StartTime) / SCALING_NB_CALLS;
+   }
+
+/* Processes SCALING_NB_FRAMES frames on the slave systems in round robin and returns 
+   the frame rate. Each frame is sent to a processing buffer, processed, and its result 
+   is copied back before the buffer is reused, so that the transfers of a system overlap 
+   the processing of the others.
+*/
+static double ScalingRunWorkload(ScalingSystemStruct *SystemList, int NbSystem, MIL_ID HostSrcBuffer,
+                                 MIL_ID HostDstBuffer, MIL_INT SizeX, MIL_INT SizeY)
+   {
+   ScalingSystemStruct *SystemPtr;
+   int NbSlot = NbSystem*BUFFER_PER_PROCESSOR;
+   int Frame, Slot, b;
+   double StartTime, EndTime;
+
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &StartTime);
+   for (Frame=0; Frame<SCALING_NB_FRAMES; Frame++)
+      {
+      Slot      = Frame % NbSlot;
+      SystemPtr = &SystemList[Slot % NbSystem];
+      b         = Slot / NbSystem;
+
+      /* Copy back the result of the previous frame of the buffer. */
+      if (Frame >= NbSlot)
+         MbufCopy(SystemPtr->DstBuffer[b], HostDstBuffer);
+
+      MbufCopy(HostSrcBuffer, SystemPtr->SrcBuffer[b]);
+      ProcessBuffer(SystemPtr->SrcBuffer[b], SystemPtr->DstBuffer[b], Frame, SizeX, SizeY);
+      }
+
+   /* Copy back the results of the last frames. */
+   for (Frame=((SCALING_NB_FRAMES > NbSlot) ? SCALING_NB_FRAMES-NbSlot : 0); Frame<SCALING_NB_FRAMES; Frame++)
+      {
+      Slot = Frame % NbSlot;
+      MbufCopy(SystemList[Slot % NbSystem].DstBuffer[Slot / NbSystem], HostDstBuffer);
+      }
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &EndTime);
+
+   return SCALING_NB_FRAMES / (EndTime - StartTime);
+   }
+
+/* Processes a fixed workload with 1 to SCALING_MAX_SYSTEMS slave systems, adding one 
+   system at a time, and prints the scaling of the throughput. The serialization time is
+   the time added to each frame of a system, compared to a single system, by the transfers
+   and the calls of the host that cannot overlap anymore.
+*/
+void RunScalingHarness(MIL_ID HostSrcBuffer, MIL_INT SizeX, MIL_INT SizeY, MIL_INT SizeBand)
+   {
+   ScalingSystemStruct SystemList[SCALING_MAX_SYSTEMS];
+   ScalingResultStruct ResultList[SCALING_MAX_SYSTEMS];
+   ScalingResultStruct *ResultPtr;
+   MIL_ID HostDstBuffer;
+   int NbSystem = 0, BestIndex = 0, SaturationIndex = 0, n;
+   double BaseRate, Speedup, Serialization;
+
+   MosPrintf(MIL_TEXT("Scaling with 1 to %d slave systems (%d frames per configuration):\n\n"),
+             SCALING_MAX_SYSTEMS, SCALING_NB_FRAMES);
+
+   MbufAllocColor(MbufInquire(HostSrcBuffer, M_OWNER_SYSTEM, M_NULL), SizeBand, SizeX, SizeY,
+                  8L+M_UNSIGNED, M_IMAGE+M_PROC, &HostDstBuffer);
+
+   /* Add a slave system and measure the configuration. */
+   for (n=0; n<SCALING_MAX_SYSTEMS; n++)
+      {
+      if (!ScalingSystemAlloc(&SystemList[n], n, SizeX, SizeY, SizeBand))
+         {
+         MosPrintf(MIL_TEXT("Slave system %d could not be allocated.\n"), n);
+         break;
+         }
+      NbSystem++;
+
+      ResultPtr = &ResultList[n];
+      ResultPtr->NbSystem = NbSystem;
+      ScalingMeasureCallOverhead(&SystemList[n], &ResultPtr->CallOverhead, &ResultPtr->RoundTrip);
+      ResultPtr->FrameRate = ScalingRunWorkload(SystemList, NbSystem, HostSrcBuffer, HostDstBuffer, SizeX, SizeY);
+      MosPrintf(MIL_TEXT("Processing with %d system(s).\r"), NbSystem);
+      }
+
+   if (NbSystem == 0)
+      {
+      MosPrintf(MIL_TEXT("No slave system could be allocated.\n\n"));
+      MbufFree(HostDstBuffer);
+      return;
+      }
+
+   /* Print the measures of each configuration. */
+   BaseRate = ResultList[0].FrameRate;
+   MosPrintf(MIL_TEXT("Systems  Frames/sec  Speedup  Efficiency  Call (us)  Round trip (ms)  Serialization (ms/frame)\n"));
+   MosPrintf(MIL_TEXT("-------  ----------  -------  ----------  ---------  ---------------  ------------------------\n"));
+   for (n=0; n<NbSystem; n++)
+      {
+      ResultPtr     = &ResultList[n];
+      Speedup       = ResultPtr->FrameRate / BaseRate;
+      Serialization = (ResultPtr->NbSystem / ResultPtr->FrameRate) - (1.0 / BaseRate);
+      MosPrintf(MIL_TEXT("%-7d  %10.1f  %7.2f  %9.0f%%  %9.1f  %15.2f  %24.2f\n"), ResultPtr->NbSystem,
+                ResultPtr->FrameRate, Speedup, 100.0*Speedup/ResultPtr->NbSystem,
+                1000000.0*ResultPtr->CallOverhead, 1000.0*ResultPtr->RoundTrip, 1000.0*Serialization);
+
+      if (ResultPtr->FrameRate > ResultList[BestIndex].FrameRate)
+         BestIndex = n;
+      if ((SaturationIndex == 0) && (n > 0) && 
+          (ResultPtr->FrameRate - ResultList[n-1].FrameRate < SCALING_MIN_GAIN*BaseRate))
+         SaturationIndex = n;
+      }
+   MosPrintf(MIL_TEXT("\n"));
+
+   /* Print the number of systems after which the overheads wipe out the gain. */
+   MosPrintf(MIL_TEXT("Best throughput: %.1f frames/sec with %d system(s).\n"),
+             ResultList[BestIndex].FrameRate, ResultList[BestIndex].NbSystem);
+   if (SaturationIndex != 0)
+      MosPrintf(MIL_TEXT("Adding systems beyond %d gains less than %.0f%% of a single system.\n\n"),
+                ResultList[SaturationIndex-1].NbSystem, 100.0*SCALING_MIN_GAIN);
+   else
+      MosPrintf(MIL_TEXT("Each system added gains at least %.0f%% of a single system.\n\n"),
+                100.0*SCALING_MIN_GAIN);
+
+   for (n=0; n<NbSystem; n++)
+      ScalingSystemFree(&SystemList[n]);
+   MbufFree(HostDstBuffer);
+   }
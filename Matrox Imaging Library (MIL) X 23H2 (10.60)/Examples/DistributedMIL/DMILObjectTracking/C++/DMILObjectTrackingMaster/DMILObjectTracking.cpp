@@ -11,6 +11,9 @@
  *             job in real time instead of sending each individual commands from the Host. 
  *             The results of each search will be returned in lot at each processing loop 
  *             in a shared Data Exchange structure copied from the Target system to the Host.
+ *             The results are written in a ring of sequence numbered records that the
+ *             Target system flushes to the Host in batches, so the Host is not called
+ *             for every frame and can detect the results that it missed.
  *             
  *             The example will first do a grab controlled from the Host to define the model. 
  *             After it will start the autonomous processing function to follow the model on 
@@ -45,6 +48,15 @@
 /* Number of grab images for Mdigprocess(). */
 #define NB_TARGET_IMAGES      4
 
+/* Result ring specifications. The Target system flushes the results to the Host
+   when RESULT_BATCH_SIZE results are pending or when RESULT_BATCH_TIMEOUT_MS ms
+   elapsed since the last flush. The ring must be larger than the batch so the
+   Target can keep on writing results while the Host reads the previous batch.
+*/
+#define RESULT_RING_CAPACITY     64
+#define RESULT_BATCH_SIZE        8
+#define RESULT_BATCH_TIMEOUT_MS  20.0
+
 #define SLAVE_SYSTEM_DESCRIPTOR   M_SYSTEM_DEFAULT
 
 /* Slave dll path and name */
@@ -62,6 +74,17 @@
 /* Processing functions prototypes. */
 MIL_UINT32 MFTYPE PatternMatchingLoop(void *MilDataExchangeBuffer);
 
+/* Result record of one search written in the result ring. */
+typedef struct
+   {
+   MIL_INT32 SequenceNumber;
+   MIL_INT32 Found;
+   MIL_DOUBLE Timestamp;
+   MIL_DOUBLE PosX;
+   MIL_DOUBLE PosY;
+   MIL_DOUBLE Score;
+   } ResultRecordStruct;
+
 /* Data Exchange structure between Host and Target processors. */
 typedef struct
    {
@@ -79,15 +102,25 @@ typedef struct
    MIL_ID MilResult;   
    MIL_INT32 PatternMatchingMethod;
    MIL_INT32 DisplayUpdateFlag;
-   MIL_INT32 Found;
-   MIL_DOUBLE PosX;
-   MIL_DOUBLE PosY;
-   MIL_DOUBLE Score;
    MIL_DOUBLE Time;
+   MIL_DOUBLE LastFlushTime;
    MIL_INT32 NbFindDone;
+   MIL_INT32 NbResultsWritten;
+   MIL_INT32 NbResultsFlushed;
    MIL_INT32 Error;
+   ResultRecordStruct ResultRing[RESULT_RING_CAPACITY];
    } DataExchangeStruct;
 
+/* Host side state of the result reading. */
+typedef struct
+   {
+   MIL_ID MilDataExchangeBuffer;
+   MIL_INT32 NextSequenceNumber;
+   MIL_INT32 NbBatchesRead;
+   MIL_INT32 NbGaps;
+   MIL_INT32 NbResultsMissed;
+   } HostResultStruct;
+
 /* Host MbufHookFunction() prototype. */
 MIL_INT MFTYPE DataExchangeBufferModified(MIL_INT, MIL_ID, void*);
 static bool SetupDMILExample(MIL_ID MilSystem);
@@ -102,6 +135,7 @@ int MosMain(void)
    MIL_ID             MilApplication;
 
    DataExchangeStruct DataEx;
+   HostResultStruct   HostResult;
    long               i=0;
    long               Error = 0;
    long               NbGrab     = 0;
@@ -153,6 +187,20 @@ int MosMain(void)
    /* Specify which type of pattern matching to perform. */
    DataEx.PatternMatchingMethod = PATTERN_MATCHING_METHOD;
 
+   /* Initialize the result ring. */
+   DataEx.NbResultsWritten = 0;
+   DataEx.NbResultsFlushed = 0;
+   DataEx.LastFlushTime    = 0.0;
+   for (i = 0; i < RESULT_RING_CAPACITY; i++)
+      DataEx.ResultRing[i].SequenceNumber = -1;
+
+   /* Initialize the Host side state of the result reading. */
+   HostResult.MilDataExchangeBuffer = DataEx.MilDataExchangeBuffer;
+   HostResult.NextSequenceNumber    = 0;
+   HostResult.NbBatchesRead         = 0;
+   HostResult.NbGaps                = 0;
+   HostResult.NbResultsMissed       = 0;
+
    /* Initialize the MIL Data Exchange buffer with the structure. */
    MbufPut(DataEx.MilDataExchangeBuffer, &DataEx);
    
@@ -160,7 +208,7 @@ int MosMain(void)
       to get the result on the Host. 
    */
    MbufHookFunction(DataEx.MilDataExchangeBuffer, M_MODIFIED_BUFFER, 
-                    DataExchangeBufferModified, &DataEx.MilDataExchangeBuffer);
+                    DataExchangeBufferModified, &HostResult);
 
    /* START THE TARGET PROCESSING PROCEDURE:
       This function will allocate and start an autonomous thread on the remote system 
@@ -208,7 +256,12 @@ int MosMain(void)
 
    /* Unhook the Data exchange buffer modifications */
    MbufHookFunction(DataEx.MilDataExchangeBuffer, M_MODIFIED_BUFFER+M_UNHOOK, 
-                    DataExchangeBufferModified, &DataEx.MilDataExchangeBuffer);
+                    DataExchangeBufferModified, &HostResult);
+
+   /* Print the result reading statistics. */
+   MosPrintf(MIL_TEXT("\n\nResults read: %ld in %ld batches, %ld gap(s) (%ld result(s) missed).\n"),
+             (long)HostResult.NextSequenceNumber, (long)HostResult.NbBatchesRead,
+             (long)HostResult.NbGaps, (long)HostResult.NbResultsMissed);
 
    /* Free allocations. */
    MthrFree(DataEx.MilDataExchangeBufferReadyEvent);
@@ -235,35 +288,72 @@ int MosMain(void)
 /****************************************************************************** 
  * Data Modified hook function: 
  *      - This function is used to print the position of the model found. It gets 
- *        called each time new results are written in the Data Exchange Buffer
- *        by the slave function.
+ *        called each time a batch of results is flushed in the Data Exchange Buffer
+ *        by the slave function. The sequence numbers of the records are validated
+ *        to detect the results that were overwritten in the ring before being read.
  *
  *  Note: Time spend in the hook function should be minimal. External 
  *        thread waiting on an event should be used to do long processing
  *        otherwise the processing loop will be waiting to continue.
  */
 MIL_INT MFTYPE DataExchangeBufferModified(MIL_INT HookType, MIL_ID EventId, 
-                                             void* DataExchangeIdPtr)
+                                             void* HostResultVoidPtr)
 {
    /* Variables declaration. */
-   DataExchangeStruct DataEx;
+   HostResultStruct         *HostResultPtr = (HostResultStruct *)HostResultVoidPtr;
+   DataExchangeStruct        DataEx;
+   const ResultRecordStruct *LastRecord = M_NULL;
+   MIL_INT32                 FirstAvailable;
+   MIL_INT32                 Seq;
    
    /* Get the pattern matching results by reading the Data Exchange structure. */
-   MbufGet(*(MIL_ID *)DataExchangeIdPtr, &DataEx);
+   MbufGet(HostResultPtr->MilDataExchangeBuffer, &DataEx);
    
    /* Set the Buffer Ready event to signal to the Target system that the results were read. */
    MthrControl(DataEx.MilDataExchangeBufferReadyEvent, M_EVENT_SET, M_SIGNALED);
+
+   HostResultPtr->NbBatchesRead++;
+
+   /* Results older than the ring capacity were overwritten before being read. */
+   FirstAvailable = DataEx.NbResultsWritten - RESULT_RING_CAPACITY;
+   if (HostResultPtr->NextSequenceNumber < FirstAvailable)
+      {
+      HostResultPtr->NbGaps++;
+      HostResultPtr->NbResultsMissed += FirstAvailable - HostResultPtr->NextSequenceNumber;
+      HostResultPtr->NextSequenceNumber = FirstAvailable;
+      }
+
+   /* Read the new records of the ring in sequence. */
+   for (Seq = HostResultPtr->NextSequenceNumber; Seq < DataEx.NbResultsWritten; Seq++)
+      {
+      const ResultRecordStruct *Record = &DataEx.ResultRing[Seq % RESULT_RING_CAPACITY];
+      if (Record->SequenceNumber != Seq)
+         {
+         HostResultPtr->NbGaps++;
+         HostResultPtr->NbResultsMissed++;
+         continue;
+         }
+      LastRecord = Record;
+      }
+   HostResultPtr->NextSequenceNumber = DataEx.NbResultsWritten;
+
+   if (LastRecord == M_NULL)
+      return(M_NULL);
    
-   /* Print the model search results and processing statistics. */
-   if (DataEx.Found)
+   /* Print the last model search results and processing statistics. */
+   if (LastRecord->Found)
       {
-      MosPrintf(MIL_TEXT("Search #%ld: X=%-6.2f, Y=%-6.2f, Score=%5.1f %%, Frame rate=%.1f fps. \r"),
-              DataEx.NbFindDone, DataEx.PosX, DataEx.PosY, DataEx.Score, DataEx.NbFindDone/DataEx.Time);
+      MosPrintf(MIL_TEXT("Search #%ld: X=%-6.2f, Y=%-6.2f, Score=%5.1f %%, Frame rate=%.1f fps, Batches=%ld, Missed=%ld. \r"),
+              (long)LastRecord->SequenceNumber+1, LastRecord->PosX, LastRecord->PosY, LastRecord->Score,
+              (LastRecord->SequenceNumber+1)/LastRecord->Timestamp,
+              (long)HostResultPtr->NbBatchesRead, (long)HostResultPtr->NbResultsMissed);
       }
    else
       {
-      MosPrintf(MIL_TEXT("Search #%ld: Model not found: Score<%5.1f %%, Frame rate=%.1f fps.    \r"), 
-              DataEx.NbFindDone, MODEL_MIN_MATCH_SCORE, DataEx.NbFindDone/DataEx.Time);
+      MosPrintf(MIL_TEXT("Search #%ld: Model not found: Score<%5.1f %%, Frame rate=%.1f fps, Batches=%ld, Missed=%ld.    \r"), 
+              (long)LastRecord->SequenceNumber+1, MODEL_MIN_MATCH_SCORE,
+              (LastRecord->SequenceNumber+1)/LastRecord->Timestamp,
+              (long)HostResultPtr->NbBatchesRead, (long)HostResultPtr->NbResultsMissed);
       }
 
    /* return successful completion status */
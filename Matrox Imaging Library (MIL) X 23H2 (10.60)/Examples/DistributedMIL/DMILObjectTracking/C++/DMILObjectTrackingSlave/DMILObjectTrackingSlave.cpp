@@ -9,6 +9,8 @@
  *    Note :   This example don't run as is under MIL lite because it uses high level modules
  *             to find the model position. The code can however be used as good example of 
  *             event based data exchange between the slave and the master of a DMIL cluster. 
+ *             The results are written in a ring of sequence numbered records which is 
+ *             flushed to the master in batches.
  *
  *             The master function can be found in the DMILObjectTracking project.
  *
@@ -34,6 +36,11 @@
 /* Number of grab images for Mdigprocess(). */
 #define NB_TARGET_IMAGES      4
 
+/* Result ring specifications (must be the same as in the master). */
+#define RESULT_RING_CAPACITY     64
+#define RESULT_BATCH_SIZE        8
+#define RESULT_BATCH_TIMEOUT_MS  20.0
+
 
 /* Processing functions prototypes. */
 #ifdef __cplusplus
@@ -45,6 +52,17 @@ void MFTYPE SlavePatternMatchingLoop(MIL_ID Func);
    }
 #endif
 
+/* Result record of one search written in the result ring. */
+typedef struct
+   {
+   MIL_INT32 SequenceNumber;
+   MIL_INT32 Found;
+   MIL_DOUBLE Timestamp;
+   MIL_DOUBLE PosX;
+   MIL_DOUBLE PosY;
+   MIL_DOUBLE Score;
+   } ResultRecordStruct;
+
 /* Data Exchange structure between Host and Target processors. */
 typedef struct
    {
@@ -62,13 +80,13 @@ typedef struct
    MIL_ID MilResult;   
    MIL_INT32 PatternMatchingMethod;
    MIL_INT32 DisplayUpdateFlag;
-   MIL_INT32 Found;
-   MIL_DOUBLE PosX;
-   MIL_DOUBLE PosY;
-   MIL_DOUBLE Score;
    MIL_DOUBLE Time;
+   MIL_DOUBLE LastFlushTime;
    MIL_INT32 NbFindDone;
+   MIL_INT32 NbResultsWritten;
+   MIL_INT32 NbResultsFlushed;
    MIL_INT32 Error;
+   ResultRecordStruct ResultRing[RESULT_RING_CAPACITY];
    } DataExchangeStruct;
 
 /* Error codes */
@@ -79,6 +97,11 @@ MIL_INT MFTYPE ModelPositionningHook(MIL_INT HookType, MIL_ID EventId, void* Dat
 MIL_INT MFTYPE GeometricPatternMatchingHook(MIL_INT HookType, MIL_ID EventId, void* DataExPtr);
 MIL_INT MFTYPE GrayscalePatternMatchingHook(MIL_INT HookType, MIL_ID EventId, void* DataExPtr);
 
+/* Result ring functions prototypes. */
+static void AddResultRecord(DataExchangeStruct* DataExPtr, MIL_INT32 Found,
+                            MIL_DOUBLE PosX, MIL_DOUBLE PosY, MIL_DOUBLE Score);
+static void FlushResults(DataExchangeStruct* DataExPtr, bool WaitForHost);
+
 /******************************************************************************
  *  Slave function: 
  *      - This slave function does grab and processing autonomously and signals
@@ -158,8 +181,11 @@ void MFTYPE SlavePatternMatchingLoop(MIL_ID Func)
         MmodControl(DataEx.MilModelContext, M_CONTEXT, M_ACCURACY, M_MEDIUM);
         MmodControl(DataEx.MilModelContext, M_ALL, M_ACCEPTANCE, MODEL_MIN_MATCH_SCORE);
         MmodPreprocess(DataEx.MilModelContext, M_DEFAULT);
-        DataEx.Error      = M_FALSE;
-        DataEx.NbFindDone = 0;
+        DataEx.Error            = M_FALSE;
+        DataEx.NbFindDone       = 0;
+        DataEx.NbResultsWritten = 0;
+        DataEx.NbResultsFlushed = 0;
+        DataEx.LastFlushTime    = 0.0;
      
         /* Start the Geometric pattern matching sequence. */
         MdigProcess(DataEx.MilDigitizer, DataEx.MilImage, NB_TARGET_IMAGES, 
@@ -176,6 +202,9 @@ void MFTYPE SlavePatternMatchingLoop(MIL_ID Func)
         /* Stop the pattern matching sequence. */
         MdigProcess(DataEx.MilDigitizer, DataEx.MilImage, NB_TARGET_IMAGES, 
                     M_STOP, M_SYNCHRONOUS, GeometricPatternMatchingHook, &DataEx);
+
+        /* Flush the last results that are still pending. */
+        FlushResults(&DataEx, true);
         }
      else
         {
@@ -216,8 +245,11 @@ void MFTYPE SlavePatternMatchingLoop(MIL_ID Func)
         MpatControl(DataEx.MilModelContext, 0, M_SPEED, M_HIGH);
         MpatControl(DataEx.MilModelContext, 0, M_ACCURACY, M_LOW);
         MpatPreprocess(DataEx.MilModelContext, M_DEFAULT, DataEx.MilImage[0]);
-        DataEx.Error      = M_FALSE;
-        DataEx.NbFindDone = 0;
+        DataEx.Error            = M_FALSE;
+        DataEx.NbFindDone       = 0;
+        DataEx.NbResultsWritten = 0;
+        DataEx.NbResultsFlushed = 0;
+        DataEx.LastFlushTime    = 0.0;
      
         /* Start the Geometric pattern matching sequence. */
         MdigProcess(DataEx.MilDigitizer, DataEx.MilImage, NB_TARGET_IMAGES, 
@@ -234,6 +266,9 @@ void MFTYPE SlavePatternMatchingLoop(MIL_ID Func)
         /* Stop the pattern matching sequence. */
         MdigProcess(DataEx.MilDigitizer, DataEx.MilImage, NB_TARGET_IMAGES, 
                     M_STOP, M_SYNCHRONOUS, GrayscalePatternMatchingHook, &DataEx);
+
+        /* Flush the last results that are still pending. */
+        FlushResults(&DataEx, true);
         }
      else
         {
@@ -294,14 +329,16 @@ MIL_INT MFTYPE ModelPositionningHook(MIL_INT HookType, MIL_ID EventId, void* Dat
  *  Geometric pattern matching hook function: 
  *      - This hook function is called locally every time MdigProcess does a grab.
  *        This avoid to the Host computer to send each processing command individually, 
- *        reducing the inter-computer overhead. It also signals to the host when all the
- *        results are available.
+ *        reducing the inter-computer overhead. It also signals to the host when a
+ *        batch of results is available.
  */
 #if (!M_MIL_LITE)
 MIL_INT MFTYPE GeometricPatternMatchingHook(MIL_INT HookType, MIL_ID EventId, void* DataExVoidPtr) 
 {
     DataExchangeStruct *DataExPtr = (DataExchangeStruct *)DataExVoidPtr;
     MIL_ID GrabBufferId;
+    MIL_INT32 Found;
+    MIL_DOUBLE PosX, PosY, Score;
 
     /* Retrieve the MIL_ID of the grabbed buffer. */
     MdigGetHookInfo(EventId, M_MODIFIED_BUFFER+M_BUFFER_ID, &GrabBufferId);
@@ -316,16 +353,16 @@ MIL_INT MFTYPE GeometricPatternMatchingHook(MIL_INT HookType, MIL_ID EventId, vo
     /* Increment find operation count. */
     DataExPtr->NbFindDone++;
 
-    /* Copy the results in the result structure to be read by the Local system. */
-    MmodGetResult(DataExPtr->MilResult, M_DEFAULT, M_NUMBER+M_TYPE_MIL_INT32, &DataExPtr->Found);
-    MmodGetResult(DataExPtr->MilResult, M_DEFAULT, M_POSITION_X, &DataExPtr->PosX);
-    MmodGetResult(DataExPtr->MilResult, M_DEFAULT, M_POSITION_Y, &DataExPtr->PosY);
-    MmodGetResult(DataExPtr->MilResult, M_DEFAULT, M_SCORE,      &DataExPtr->Score);
+    /* Get the results. */
+    MmodGetResult(DataExPtr->MilResult, M_DEFAULT, M_NUMBER+M_TYPE_MIL_INT32, &Found);
+    MmodGetResult(DataExPtr->MilResult, M_DEFAULT, M_POSITION_X, &PosX);
+    MmodGetResult(DataExPtr->MilResult, M_DEFAULT, M_POSITION_Y, &PosY);
+    MmodGetResult(DataExPtr->MilResult, M_DEFAULT, M_SCORE,      &Score);
 
     /* If required, copy the processed image with the model position drawn to the display. */
     if (DataExPtr->DisplayUpdateFlag)
        {
-       if (DataExPtr->Found)
+       if (Found)
           MmodDraw(M_DEFAULT, DataExPtr->MilResult, GrabBufferId,
                    M_DRAW_POSITION+M_DRAW_BOX, M_DEFAULT, M_DEFAULT);
        else
@@ -337,11 +374,8 @@ MIL_INT MFTYPE GeometricPatternMatchingHook(MIL_INT HookType, MIL_ID EventId, vo
     /* Read the elapsed time. */
     MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &DataExPtr->Time);
 
-    /* Wait for previous results to be read (event set).*/
-    MthrWait(DataExPtr->MilDataExchangeBufferReadyEvent, M_EVENT_WAIT, M_NULL);
-
-    /* Write the new results (This also triggers the Host MbufHookFunction() callback. */
-    MbufPut(DataExPtr->MilDataExchangeBuffer, DataExPtr);
+    /* Write the new results in the result ring and flush them if required. */
+    AddResultRecord(DataExPtr, Found, PosX, PosY, Score);
 
     return (M_NULL);
 }
@@ -351,8 +385,8 @@ MIL_INT MFTYPE GeometricPatternMatchingHook(MIL_INT HookType, MIL_ID EventId, vo
  *  Grayscale pattern matching hook function: 
  *      - This hook function is called locally every time MdigProcess does a grab.
  *        This avoid to the Host computer to send each processing command individually, 
- *        reducing the inter-computer overhead. It also signals to the host when all the
- *        results are available.
+ *        reducing the inter-computer overhead. It also signals to the host when a
+ *        batch of results is available.
  */
 #if (!M_MIL_LITE)
 MIL_INT MFTYPE GrayscalePatternMatchingHook(MIL_INT HookType, MIL_ID EventId, void* DataExVoidPtr) 
@@ -360,6 +394,8 @@ MIL_INT MFTYPE GrayscalePatternMatchingHook(MIL_INT HookType, MIL_ID EventId, vo
     DataExchangeStruct *DataExPtr = (DataExchangeStruct *)DataExVoidPtr;
     MIL_ID GrabBufferId;
     MIL_DOUBLE NbFound;
+    MIL_INT32 Found;
+    MIL_DOUBLE PosX, PosY, Score;
 
     /* Retrieve the MIL_ID of the grabbed buffer. */
     MdigGetHookInfo(EventId, M_MODIFIED_BUFFER+M_BUFFER_ID, &GrabBufferId);
@@ -377,17 +413,17 @@ MIL_INT MFTYPE GrayscalePatternMatchingHook(MIL_INT HookType, MIL_ID EventId, vo
     /* Get the results. */
     
     MpatGetResult(DataExPtr->MilResult, M_GENERAL, M_NUMBER, &NbFound);
-    DataExPtr->Found = (MIL_INT32)NbFound;
-    MpatGetResult(DataExPtr->MilResult, M_DEFAULT, M_POSITION_X, &DataExPtr->PosX);
-    MpatGetResult(DataExPtr->MilResult, M_DEFAULT, M_POSITION_Y, &DataExPtr->PosY);
-    MpatGetResult(DataExPtr->MilResult, M_DEFAULT, M_SCORE, &DataExPtr->Score);
+    Found = (MIL_INT32)NbFound;
+    MpatGetResult(DataExPtr->MilResult, M_DEFAULT, M_POSITION_X, &PosX);
+    MpatGetResult(DataExPtr->MilResult, M_DEFAULT, M_POSITION_Y, &PosY);
+    MpatGetResult(DataExPtr->MilResult, M_DEFAULT, M_SCORE, &Score);
     
     /* If required, update the display with the processed image and the 
        model position drawn in it. 
      */
     if (DataExPtr->DisplayUpdateFlag)
        {
-       if (DataExPtr->Found)
+       if (Found)
           MpatDraw(M_DEFAULT, DataExPtr->MilResult, GrabBufferId, 
                               M_DRAW_BOX+M_DRAW_POSITION, M_DEFAULT, M_DEFAULT);
        else
@@ -399,12 +435,63 @@ MIL_INT MFTYPE GrayscalePatternMatchingHook(MIL_INT HookType, MIL_ID EventId, vo
     /* Read the elapsed time. */
     MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &DataExPtr->Time);
 
-    /* Wait for previous results to be read (event set).*/
-    MthrWait(DataExPtr->MilDataExchangeBufferReadyEvent, M_EVENT_WAIT, M_NULL);
-
-    /* Write the new results (This also triggers the Host MbufHookFunction() callback. */
-    MbufPut(DataExPtr->MilDataExchangeBuffer, DataExPtr);
+    /* Write the new results in the result ring and flush them if required. */
+    AddResultRecord(DataExPtr, Found, PosX, PosY, Score);
 
     return (M_NULL);
 }
 #endif
+
+/******************************************************************************
+ *  Result ring functions: 
+ *      - AddResultRecord() writes the result of a search in the next record of 
+ *        the ring and flushes the pending records to the Host when a batch is 
+ *        complete or when the batch timeout elapsed.
+ *      - FlushResults() writes the Data Exchange structure with the ring to the 
+ *        Host. If the Host did not read the previous batch yet, the flush is 
+ *        skipped so the grab loop is never stalled; the records then stay in the
+ *        ring and the Host detects the ones that get overwritten.
+ */
+static void AddResultRecord(DataExchangeStruct* DataExPtr, MIL_INT32 Found,
+                            MIL_DOUBLE PosX, MIL_DOUBLE PosY, MIL_DOUBLE Score)
+{
+    ResultRecordStruct *Record = 
+       &DataExPtr->ResultRing[DataExPtr->NbResultsWritten % RESULT_RING_CAPACITY];
+
+    /* Write the record. */
+    Record->SequenceNumber = DataExPtr->NbResultsWritten;
+    Record->Found          = Found;
+    Record->Timestamp      = DataExPtr->Time;
+    Record->PosX           = PosX;
+    Record->PosY           = PosY;
+    Record->Score          = Score;
+    DataExPtr->NbResultsWritten++;
+
+    /* Flush the batch if it is complete or if it is pending for too long. */
+    if ((DataExPtr->NbResultsWritten - DataExPtr->NbResultsFlushed >= RESULT_BATCH_SIZE) ||
+        ((DataExPtr->Time - DataExPtr->LastFlushTime)*1000.0 >= RESULT_BATCH_TIMEOUT_MS))
+       FlushResults(DataExPtr, false);
+}
+
+static void FlushResults(DataExchangeStruct* DataExPtr, bool WaitForHost)
+{
+    MIL_INT State = M_SIGNALED;
+
+    /* Nothing to flush. */
+    if (DataExPtr->NbResultsWritten == DataExPtr->NbResultsFlushed)
+       return;
+
+    /* Check if the previous results were read (event set). */
+    if (WaitForHost)
+       MthrWait(DataExPtr->MilDataExchangeBufferReadyEvent, M_EVENT_WAIT, M_NULL);
+    else
+       MthrWait(DataExPtr->MilDataExchangeBufferReadyEvent, M_EVENT_WAIT+M_EVENT_TIMEOUT(0), &State);
+    if (State == M_TIMEOUT)
+       return;
+
+    DataExPtr->NbResultsFlushed = DataExPtr->NbResultsWritten;
+    DataExPtr->LastFlushTime    = DataExPtr->Time;
+
+    /* Write the new results (This also triggers the Host MbufHookFunction() callback. */
+    MbufPut(DataExPtr->MilDataExchangeBuffer, DataExPtr);
+}
@@ -14,6 +14,12 @@
  *            retrieves all the parameters, finds the Max and Min of the source buffer and 
  *            remaps it to have its full range (min at 0x0 and the max at 0xFF).
  *
+ *            It then generalizes the function to a program of operations (LUT remaps, 
+ *            arithmetics, thresholds and copies) that is uploaded once on the target 
+ *            system. The LUTs and temporary buffers of the program stay cached on the 
+ *            target system, so each frame is processed with a single call that only 
+ *            passes the image identifiers.
+ *
  *            The slave function can be found in the DistributedMilRemapSlave project.
  *             
  *            Note: For simplicity, the images are assumed to be 8-bit unsigned.
@@ -24,15 +30,68 @@
 
 /* MIL Header. */
 #include <mil.h>
+#include <math.h>
+
+/* Program specifications (must be the same as in the slave). */
+#define PROGRAM_MAX_OPS          16
+#define PROGRAM_MAX_LUTS         4
+#define PROGRAM_NB_TEMP_IMAGES   2
+
+/* Program operations. */
+#define PROGRAM_OP_COPY          1  /* MbufCopy(Src, Dst).                                  */
+#define PROGRAM_OP_LUT_MAP       2  /* MimLutMap(Src, Dst, Lut[Operation]).                 */
+#define PROGRAM_OP_AUTO_REMAP    3  /* Remap the Src range from its min and max to 0-0xFF.  */
+#define PROGRAM_OP_ARITH         4  /* MimArith(Src, Src2, Dst, Operation).                 */
+#define PROGRAM_OP_ARITH_CONST   5  /* MimArith(Src, Value1, Dst, Operation).               */
+#define PROGRAM_OP_THRESHOLD     6  /* MimBinarize(Src, Dst, Operation, Value1, Value2).    */
+
+/* Image registers of the operations. */
+#define PROGRAM_SRC_IMAGE        0
+#define PROGRAM_DST_IMAGE        1
+#define PROGRAM_TEMP_IMAGE(n)    (2+(n))
+#define PROGRAM_NB_IMAGES        (2+PROGRAM_NB_TEMP_IMAGES)
+
+/* Operation of a program. */
+typedef struct
+   {
+   MIL_INT32  OpCode;
+   MIL_INT32  Src;
+   MIL_INT32  Src2;
+   MIL_INT32  Dst;
+   MIL_INT64  Operation;
+   MIL_DOUBLE Value1;
+   MIL_DOUBLE Value2;
+   } ProgramOpStruct;
+
+/* Program uploaded by the master. */
+typedef struct
+   {
+   MIL_INT32       NbOps;
+   MIL_INT32       NbLuts;
+   ProgramOpStruct Ops[PROGRAM_MAX_OPS];
+   MIL_UINT8       Luts[PROGRAM_MAX_LUTS][256];
+   } ProgramStruct;
 
 /* Master MIL functions declarations */
 void MFTYPE CustomRemap(MIL_ID SrcImage, MIL_ID DstImage, MIL_UINT Option);
+MIL_INT MFTYPE CustomProgramUpload(MIL_ID TargetImage, const ProgramStruct* ProgramPtr);
+void MFTYPE CustomProgramRun(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT ProgramHandle);
+void MFTYPE CustomProgramFree(MIL_ID TargetImage, MIL_INT ProgramHandle);
+
+/* Program building function. */
+static void ProgramAddOp(ProgramStruct* ProgramPtr, MIL_INT OpCode, MIL_INT Src, MIL_INT Src2,
+                         MIL_INT Dst, MIL_INT Operation, MIL_DOUBLE Value1, MIL_DOUBLE Value2);
 
 
 /* Standard I/0 */
 
 /* Target image file name */
 #define IMAGE_FILE   M_IMAGE_PATH MIL_TEXT("Wafer.mim")
+#define NB_LOOP      100
+
+/* Program parameters. */
+#define PROGRAM_GAMMA       0.7
+#define PROGRAM_THRESHOLD   96
 
 #define SLAVE_SYSTEM_DESCRIPTOR   M_SYSTEM_DEFAULT
 
@@ -59,7 +118,19 @@ int MosMain(void)
    MIL_ID MilApplication,           /* Application Identifier.  */
           MilSystem,                /* System Identifier.       */
           MilDisplay,               /* Display Identifier.      */
-          MilImage;                 /* Image buffer Identifier. */
+          MilImage,                 /* Image buffer Identifier. */
+          MilSrcImage,              /* Source image Identifier. */
+          MilTempImage,             /* Temporary image.         */
+          MilMaskImage,             /* Mask image.              */
+          MilRemapLut,              /* Remap LUT.               */
+          MilGammaLut,              /* Gamma LUT.               */
+          MilExtremeResult;         /* Extreme result.          */
+   ProgramStruct Program;           /* Program of operations.   */
+   MIL_INT    ProgramHandle;        /* Uploaded program handle. */
+   MIL_INT    MinAndMax[2];         /* Extreme values.          */
+   MIL_DOUBLE HostCommandsTime,     /* Timer variable.          */
+              ProgramTime;          /* Timer variable.          */
+   int        n;                    /* Counter.                 */
 
    
    /* Allocate application, system and display. */
@@ -98,10 +169,92 @@ int MosMain(void)
    /* Pause */
    MosPrintf(MIL_TEXT("A smart image remapping was done on the image using "));
    MosPrintf(MIL_TEXT("a user made MIL function.\n"));
+   MosPrintf(MIL_TEXT("Press a key to continue.\n\n"));
+   MosGetch();
+
+   /* Program of operations. */
+   /* ---------------------- */
+
+   /* Keep a copy of the original image as the source of each frame. */
+   MbufRestore(IMAGE_FILE, MilSystem, &MilSrcImage);
+
+   /* Build the program: stretch the contrast, apply a gamma correction and 
+      keep only the pixels above a threshold.
+   */
+   Program.NbOps  = 0;
+   Program.NbLuts = 1;
+   for (n = 0; n < 256; n++)
+      Program.Luts[0][n] = (MIL_UINT8)(255.0*pow(n/255.0, PROGRAM_GAMMA) + 0.5);
+
+   ProgramAddOp(&Program, PROGRAM_OP_AUTO_REMAP, PROGRAM_SRC_IMAGE, 0, PROGRAM_TEMP_IMAGE(0),
+                0, 0.0, 0.0);
+   ProgramAddOp(&Program, PROGRAM_OP_LUT_MAP, PROGRAM_TEMP_IMAGE(0), 0, PROGRAM_TEMP_IMAGE(0),
+                0, 0.0, 0.0);
+   ProgramAddOp(&Program, PROGRAM_OP_THRESHOLD, PROGRAM_TEMP_IMAGE(0), 0, PROGRAM_TEMP_IMAGE(1),
+                M_GREATER_OR_EQUAL, PROGRAM_THRESHOLD, M_NULL);
+   ProgramAddOp(&Program, PROGRAM_OP_ARITH, PROGRAM_TEMP_IMAGE(0), PROGRAM_TEMP_IMAGE(1), 
+                PROGRAM_DST_IMAGE, M_AND, 0.0, 0.0);
+
+   /* Upload the program once on the target system. */
+   ProgramHandle = CustomProgramUpload(MilImage, &Program);
+   if (ProgramHandle == 0)
+      {
+      MosPrintf(MIL_TEXT("The program could not be uploaded.\n"));
+      }
+   else
+      {
+      /* Allocate the objects to do the same operations with commands sent from the Host. */
+      MbufAlloc2d(MilSystem, MbufInquire(MilImage, M_SIZE_X, M_NULL),
+                  MbufInquire(MilImage, M_SIZE_Y, M_NULL), 8+M_UNSIGNED, 
+                  M_IMAGE+M_PROC, &MilTempImage);
+      MbufAlloc2d(MilSystem, MbufInquire(MilImage, M_SIZE_X, M_NULL),
+                  MbufInquire(MilImage, M_SIZE_Y, M_NULL), 8+M_UNSIGNED, 
+                  M_IMAGE+M_PROC, &MilMaskImage);
+      MbufAlloc1d(MilSystem, 256, 8+M_UNSIGNED, M_LUT, &MilRemapLut);
+      MbufAlloc1d(MilSystem, 256, 8+M_UNSIGNED, M_LUT, &MilGammaLut);
+      MbufPut1d(MilGammaLut, 0, 256, Program.Luts[0]);
+      MimAllocResult(MilSystem, 2L, M_EXTREME_LIST, &MilExtremeResult);
+
+      /* Process the frames with commands sent from the Host. */
+      MappTimer(M_DEFAULT, M_TIMER_RESET+M_SYNCHRONOUS, M_NULL);
+      for (n = 0; n < NB_LOOP; n++)
+         {
+         MimFindExtreme(MilSrcImage, MilExtremeResult, M_MIN_VALUE+M_MAX_VALUE);
+         MimGetResult(MilExtremeResult, M_VALUE, MinAndMax);
+         MgenLutRamp(MilRemapLut, MinAndMax[0], 0x00, MinAndMax[1], 0xFF);
+         MimLutMap(MilSrcImage, MilTempImage, MilRemapLut);
+         MimLutMap(MilTempImage, MilTempImage, MilGammaLut);
+         MimBinarize(MilTempImage, MilMaskImage, M_GREATER_OR_EQUAL, PROGRAM_THRESHOLD, M_NULL);
+         MimArith(MilTempImage, MilMaskImage, MilImage, M_AND);
+         }
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &HostCommandsTime);
+
+      /* Process the frames with the uploaded program, in a single call per frame. */
+      CustomProgramRun(MilSrcImage, MilImage, ProgramHandle);
+      MappTimer(M_DEFAULT, M_TIMER_RESET+M_SYNCHRONOUS, M_NULL);
+      for (n = 0; n < NB_LOOP; n++)
+         CustomProgramRun(MilSrcImage, MilImage, ProgramHandle);
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &ProgramTime);
+
+      MosPrintf(MIL_TEXT("The contrast was stretched, gamma corrected and thresholded using a\n"));
+      MosPrintf(MIL_TEXT("program of operations uploaded once on the target system.\n\n"));
+      MosPrintf(MIL_TEXT("Commands sent from the Host: %.2f ms per frame.\n"),
+                HostCommandsTime*1000/NB_LOOP);
+      MosPrintf(MIL_TEXT("Uploaded program:            %.2f ms per frame.\n\n"),
+                ProgramTime*1000/NB_LOOP);
+
+      MimFree(MilExtremeResult);
+      MbufFree(MilGammaLut);
+      MbufFree(MilRemapLut);
+      MbufFree(MilMaskImage);
+      MbufFree(MilTempImage);
+      CustomProgramFree(MilImage, ProgramHandle);
+      }
    MosPrintf(MIL_TEXT("Press a key to terminate.\n\n"));
    MosGetch();
 
    /* Free all allocations. */
+   MbufFree(MilSrcImage);
    MbufFree(MilImage);
    MdispFree(MilDisplay);
    MsysFree(MilSystem);
@@ -148,6 +301,120 @@ void MFTYPE CustomRemap(MIL_ID SrcImage, MIL_ID DstImage, MIL_UINT Option)
    MfuncFree(Func);
 }
 
+
+/* Master Program MIL Functions definition. */
+/* ---------------------------------------- */
+
+/* MIL Function specifications */
+#define FUNCTION_OPCODE_PROGRAM_UPLOAD   (M_USER_FUNCTION+2)
+#define FUNCTION_OPCODE_PROGRAM_RUN      (M_USER_FUNCTION+3)
+#define FUNCTION_OPCODE_PROGRAM_FREE     (M_USER_FUNCTION+4)
+#define FUNCTION_PROGRAM_UPLOAD_NB_PARAM 3
+#define FUNCTION_PROGRAM_RUN_NB_PARAM    3
+#define FUNCTION_PROGRAM_FREE_NB_PARAM   2
+
+/* Slave functions name */
+#define SLAVE_PROGRAM_UPLOAD_FUNC_NAME   MIL_TEXT("SlaveProgramUpload")
+#define SLAVE_PROGRAM_RUN_FUNC_NAME      MIL_TEXT("SlaveProgramRun")
+#define SLAVE_PROGRAM_FREE_FUNC_NAME     MIL_TEXT("SlaveProgramFree")
+
+/* Uploads a program on the system of the target image and returns its 
+   handle (0 on error).
+*/
+MIL_INT MFTYPE CustomProgramUpload(MIL_ID TargetImage, const ProgramStruct* ProgramPtr)
+{
+   MIL_ID   Func;
+   MIL_INT  ProgramHandle = 0;
+   
+   MfuncAlloc(MIL_TEXT("CustomProgramUpload"), 
+              FUNCTION_PROGRAM_UPLOAD_NB_PARAM,
+              M_NULL, SLAVE_DLL_NAME, SLAVE_PROGRAM_UPLOAD_FUNC_NAME,  
+              FUNCTION_OPCODE_PROGRAM_UPLOAD, 
+              M_SYNCHRONOUS_FUNCTION, 
+              &Func);
+
+   /* Register the parameters. */
+   MfuncParamMilId      (Func, 1, TargetImage, M_IMAGE, M_IN);
+   MfuncParamDataPointer(Func, 2, (void*)ProgramPtr, sizeof(ProgramStruct), M_IN);
+   MfuncParamArrayMilInt(Func, 3, &ProgramHandle, 1, M_OUT);
+
+   /* Call the target Slave function. */
+   MfuncCall(Func);
+
+   /* Free the MIL function context. */
+   MfuncFree(Func);
+
+   return(ProgramHandle);
+}
+
+/* Runs an uploaded program on a frame. Only the images and the program 
+   handle are sent to the target system.
+*/
+void MFTYPE CustomProgramRun(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT ProgramHandle)
+{
+   MIL_ID   Func;
+   
+   MfuncAlloc(MIL_TEXT("CustomProgramRun"), 
+              FUNCTION_PROGRAM_RUN_NB_PARAM,
+              M_NULL, SLAVE_DLL_NAME, SLAVE_PROGRAM_RUN_FUNC_NAME,  
+              FUNCTION_OPCODE_PROGRAM_RUN, 
+              M_ASYNCHRONOUS_FUNCTION, 
+              &Func);
+
+   /* Register the parameters. */
+   MfuncParamMilId (Func, 1, SrcImage, M_IMAGE, M_IN  + M_PROC);
+   MfuncParamMilId (Func, 2, DstImage, M_IMAGE, M_OUT + M_PROC);
+   MfuncParamMilInt(Func, 3, ProgramHandle);
+
+   /* Call the target Slave function. */
+   MfuncCall(Func);
+
+   /* Free the MIL function context. */
+   MfuncFree(Func);
+}
+
+/* Frees an uploaded program and its cached objects on the target system. */
+void MFTYPE CustomProgramFree(MIL_ID TargetImage, MIL_INT ProgramHandle)
+{
+   MIL_ID   Func;
+   
+   MfuncAlloc(MIL_TEXT("CustomProgramFree"), 
+              FUNCTION_PROGRAM_FREE_NB_PARAM,
+              M_NULL, SLAVE_DLL_NAME, SLAVE_PROGRAM_FREE_FUNC_NAME,  
+              FUNCTION_OPCODE_PROGRAM_FREE, 
+              M_SYNCHRONOUS_FUNCTION, 
+              &Func);
+
+   /* Register the parameters. */
+   MfuncParamMilId (Func, 1, TargetImage, M_IMAGE, M_IN);
+   MfuncParamMilInt(Func, 2, ProgramHandle);
+
+   /* Call the target Slave function. */
+   MfuncCall(Func);
+
+   /* Free the MIL function context. */
+   MfuncFree(Func);
+}
+
+/* Adds an operation at the end of a program. */
+static void ProgramAddOp(ProgramStruct* ProgramPtr, MIL_INT OpCode, MIL_INT Src, MIL_INT Src2,
+                         MIL_INT Dst, MIL_INT Operation, MIL_DOUBLE Value1, MIL_DOUBLE Value2)
+{
+   ProgramOpStruct *OpPtr;
+
+   if (ProgramPtr->NbOps >= PROGRAM_MAX_OPS)
+      return;
+
+   OpPtr = &ProgramPtr->Ops[ProgramPtr->NbOps++];
+   OpPtr->OpCode    = (MIL_INT32)OpCode;
+   OpPtr->Src       = (MIL_INT32)Src;
+   OpPtr->Src2      = (MIL_INT32)Src2;
+   OpPtr->Dst       = (MIL_INT32)Dst;
+   OpPtr->Operation = Operation;
+   OpPtr->Value1    = Value1;
+   OpPtr->Value2    = Value2;
+}
+
 bool SetupDMILExample(MIL_ID MilSystem)
    {
    MIL_ID MilSystemOwnerApplication;/* System owner application.*/
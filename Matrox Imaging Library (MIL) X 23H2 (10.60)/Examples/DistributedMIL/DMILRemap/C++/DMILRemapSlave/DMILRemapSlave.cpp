@@ -6,25 +6,98 @@
  *            create a custom asynchronous MIL function that does a series of MIL 
  *            commands on a target system in a single call from the host.
  *
- *            It contains the SlaveCustomRemap() slave function.
+ *            It contains the SlaveCustomRemap() slave function, and the
+ *            SlaveProgramUpload(), SlaveProgramRun() and SlaveProgramFree() slave 
+ *            functions that execute an uploaded program of processing operations. 
+ *            The LUTs and the temporary buffers of a program stay allocated on the 
+ *            target system between its calls.
  *
  * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
  * All Rights Reserved
  */
 #include <mil.h>
 
+/* Program specifications (must be the same as in the master). */
+#define PROGRAM_MAX_OPS          16
+#define PROGRAM_MAX_LUTS         4
+#define PROGRAM_NB_TEMP_IMAGES   2
 
+/* Program operations. */
+#define PROGRAM_OP_COPY          1  /* MbufCopy(Src, Dst).                                  */
+#define PROGRAM_OP_LUT_MAP       2  /* MimLutMap(Src, Dst, Lut[Operation]).                 */
+#define PROGRAM_OP_AUTO_REMAP    3  /* Remap the Src range from its min and max to 0-0xFF.  */
+#define PROGRAM_OP_ARITH         4  /* MimArith(Src, Src2, Dst, Operation).                 */
+#define PROGRAM_OP_ARITH_CONST   5  /* MimArith(Src, Value1, Dst, Operation).               */
+#define PROGRAM_OP_THRESHOLD     6  /* MimBinarize(Src, Dst, Operation, Value1, Value2).    */
 
+/* Image registers of the operations. */
+#define PROGRAM_SRC_IMAGE        0
+#define PROGRAM_DST_IMAGE        1
+#define PROGRAM_TEMP_IMAGE(n)    (2+(n))
+#define PROGRAM_NB_IMAGES        (2+PROGRAM_NB_TEMP_IMAGES)
+
+/* Operation of a program. */
+typedef struct
+   {
+   MIL_INT32  OpCode;
+   MIL_INT32  Src;
+   MIL_INT32  Src2;
+   MIL_INT32  Dst;
+   MIL_INT64  Operation;
+   MIL_DOUBLE Value1;
+   MIL_DOUBLE Value2;
+   } ProgramOpStruct;
+
+/* Program uploaded by the master. */
+typedef struct
+   {
+   MIL_INT32       NbOps;
+   MIL_INT32       NbLuts;
+   ProgramOpStruct Ops[PROGRAM_MAX_OPS];
+   MIL_UINT8       Luts[PROGRAM_MAX_LUTS][256];
+   } ProgramStruct;
+
+/* Programs kept on the target system with their cached MIL objects. */
+#define SLAVE_MAX_PROGRAMS       8
+
+typedef struct
+   {
+   bool          InUse;
+   ProgramStruct Program;
+   MIL_ID        OwnerSystem;
+   MIL_ID        Luts[PROGRAM_MAX_LUTS];
+   MIL_ID        RemapLut;
+   MIL_ID        ExtremeResult;
+   MIL_ID        TempImages[PROGRAM_NB_TEMP_IMAGES];
+   MIL_INT       SizeX;
+   MIL_INT       SizeY;
+   MIL_INT       Type;
+   } SlaveProgramStruct;
+
+static SlaveProgramStruct SlavePrograms[SLAVE_MAX_PROGRAMS];
+
+/* Error codes */
+#define PROGRAM_UPLOAD_ERROR_CODE   1
+#define PROGRAM_RUN_ERROR_CODE      2
 
 /* Slave MIL Function prototypes. */
 #ifdef __cplusplus
 extern "C" {
 #endif
 void MFTYPE SlaveCustomRemap(MIL_ID Func);
+void MFTYPE SlaveProgramUpload(MIL_ID Func);
+void MFTYPE SlaveProgramRun(MIL_ID Func);
+void MFTYPE SlaveProgramFree(MIL_ID Func);
 
 #ifdef __cplusplus
    }
 #endif
+
+/* Program functions prototypes. */
+static bool ProgramIsValid(const ProgramStruct* ProgramPtr);
+static void ProgramAllocTempImages(SlaveProgramStruct* SlaveProgramPtr, MIL_ID Image);
+static void ProgramFreeTempImages(SlaveProgramStruct* SlaveProgramPtr);
+
 /* Slave MIL Function definition. */
 /* ------------------------------ */
 
@@ -58,3 +131,227 @@ void MFTYPE SlaveCustomRemap(MIL_ID Func)
   //* Free the Lut buffer */
   MbufFree(Lut);
 }
+
+
+/* Slave Program Upload MIL Function definition. */
+/* --------------------------------------------- */
+
+/* Copies the program, allocates its LUTs and temporary buffers on the target 
+   system and returns its handle (0 on error).
+*/
+void MFTYPE SlaveProgramUpload(MIL_ID Func)
+{
+  MIL_ID TargetImage;
+  const ProgramStruct *ProgramPtr;
+  MIL_INT *HandlePtr;
+  SlaveProgramStruct *SlaveProgramPtr = M_NULL;
+  MIL_INT n;
+
+  /* Read the parameters. */
+  MfuncParamValue(Func, 1, &TargetImage);
+  MfuncParamValue(Func, 2, &ProgramPtr);
+  MfuncParamValue(Func, 3, &HandlePtr);
+  *HandlePtr = 0;
+
+  /* Find a free program. */
+  for (n = 0; n < SLAVE_MAX_PROGRAMS && SlaveProgramPtr == M_NULL; n++)
+     {
+     if (!SlavePrograms[n].InUse)
+        {
+        SlaveProgramPtr = &SlavePrograms[n];
+        *HandlePtr = n+1;
+        }
+     }
+
+  if (SlaveProgramPtr == M_NULL || !ProgramIsValid(ProgramPtr))
+     {
+     MfuncErrorReport(Func, M_FUNC_ERROR+PROGRAM_UPLOAD_ERROR_CODE, 
+                      MIL_TEXT("Invalid program or too many programs uploaded."),
+                      M_NULL, M_NULL, M_NULL);
+     *HandlePtr = 0;
+     return;
+     }
+
+  SlaveProgramPtr->InUse   = true;
+  SlaveProgramPtr->Program = *ProgramPtr;
+  MbufInquire(TargetImage, M_OWNER_SYSTEM, &SlaveProgramPtr->OwnerSystem);
+
+  /* Allocate the LUTs with their values. */
+  for (n = 0; n < ProgramPtr->NbLuts; n++)
+     {
+     MbufAlloc1d(SlaveProgramPtr->OwnerSystem, 256, 8+M_UNSIGNED, M_LUT, &SlaveProgramPtr->Luts[n]);
+     MbufPut1d(SlaveProgramPtr->Luts[n], 0, 256, ProgramPtr->Luts[n]);
+     }
+
+  /* Allocate the objects of the remap operation. */
+  MbufAlloc1d(SlaveProgramPtr->OwnerSystem, 256, 8+M_UNSIGNED, M_LUT, &SlaveProgramPtr->RemapLut);
+  MimAllocResult(SlaveProgramPtr->OwnerSystem, 2L, M_EXTREME_LIST, &SlaveProgramPtr->ExtremeResult);
+
+  /* Allocate the temporary buffers with the size of the target image. */
+  ProgramAllocTempImages(SlaveProgramPtr, TargetImage);
+}
+
+
+/* Slave Program Run MIL Function definition. */
+/* ------------------------------------------ */
+
+/* Executes the operations of the program in order. */
+void MFTYPE SlaveProgramRun(MIL_ID Func)
+{
+  MIL_ID SrcImage, DstImage, Images[PROGRAM_NB_IMAGES];
+  MIL_INT Handle, MinAndMax[2], n;
+  SlaveProgramStruct *SlaveProgramPtr;
+
+  /* Read the parameters. */
+  MfuncParamValue(Func, 1, &SrcImage);
+  MfuncParamValue(Func, 2, &DstImage);
+  MfuncParamValue(Func, 3, &Handle);
+
+  if (Handle < 1 || Handle > SLAVE_MAX_PROGRAMS || !SlavePrograms[Handle-1].InUse)
+     {
+     MfuncErrorReport(Func, M_FUNC_ERROR+PROGRAM_RUN_ERROR_CODE, 
+                      MIL_TEXT("Invalid program handle."),
+                      M_NULL, M_NULL, M_NULL);
+     return;
+     }
+  SlaveProgramPtr = &SlavePrograms[Handle-1];
+
+  /* Reallocate the temporary buffers if the image size changed. */
+  if ((MbufInquire(SrcImage, M_SIZE_X, M_NULL) != SlaveProgramPtr->SizeX) ||
+      (MbufInquire(SrcImage, M_SIZE_Y, M_NULL) != SlaveProgramPtr->SizeY) ||
+      (MbufInquire(SrcImage, M_TYPE,   M_NULL) != SlaveProgramPtr->Type))
+     {
+     ProgramFreeTempImages(SlaveProgramPtr);
+     ProgramAllocTempImages(SlaveProgramPtr, SrcImage);
+     }
+
+  /* Set the image registers. */
+  Images[PROGRAM_SRC_IMAGE] = SrcImage;
+  Images[PROGRAM_DST_IMAGE] = DstImage;
+  for (n = 0; n < PROGRAM_NB_TEMP_IMAGES; n++)
+     Images[PROGRAM_TEMP_IMAGE(n)] = SlaveProgramPtr->TempImages[n];
+
+  /* Execute the operations. */
+  for (n = 0; n < SlaveProgramPtr->Program.NbOps; n++)
+     {
+     const ProgramOpStruct *OpPtr = &SlaveProgramPtr->Program.Ops[n];
+
+     switch (OpPtr->OpCode)
+        {
+        case PROGRAM_OP_COPY:
+           MbufCopy(Images[OpPtr->Src], Images[OpPtr->Dst]);
+           break;
+
+        case PROGRAM_OP_LUT_MAP:
+           MimLutMap(Images[OpPtr->Src], Images[OpPtr->Dst], 
+                     SlaveProgramPtr->Luts[OpPtr->Operation]);
+           break;
+
+        case PROGRAM_OP_AUTO_REMAP:
+           /* Find the Minimum and Maximum values of the image. */ 
+           MimFindExtreme(Images[OpPtr->Src], SlaveProgramPtr->ExtremeResult, M_MIN_VALUE+M_MAX_VALUE);
+           MimGetResult(SlaveProgramPtr->ExtremeResult, M_VALUE, MinAndMax);
+
+           /* Remap the values from Min to Max to 0x00-0xFF. */
+           MgenLutRamp(SlaveProgramPtr->RemapLut, MinAndMax[0], 0x00, MinAndMax[1], 0xFF);
+           MimLutMap(Images[OpPtr->Src], Images[OpPtr->Dst], SlaveProgramPtr->RemapLut);
+           break;
+
+        case PROGRAM_OP_ARITH:
+           MimArith(Images[OpPtr->Src], Images[OpPtr->Src2], Images[OpPtr->Dst], 
+                    (MIL_INT)OpPtr->Operation);
+           break;
+
+        case PROGRAM_OP_ARITH_CONST:
+           MimArith(Images[OpPtr->Src], OpPtr->Value1, Images[OpPtr->Dst], 
+                    (MIL_INT)OpPtr->Operation);
+           break;
+
+        case PROGRAM_OP_THRESHOLD:
+           MimBinarize(Images[OpPtr->Src], Images[OpPtr->Dst], (MIL_INT)OpPtr->Operation,
+                       OpPtr->Value1, OpPtr->Value2);
+           break;
+        }
+     }
+}
+
+
+/* Slave Program Free MIL Function definition. */
+/* ------------------------------------------- */
+
+void MFTYPE SlaveProgramFree(MIL_ID Func)
+{
+  MIL_INT Handle, n;
+  SlaveProgramStruct *SlaveProgramPtr;
+
+  /* Read the parameters. */
+  MfuncParamValue(Func, 2, &Handle);
+
+  if (Handle < 1 || Handle > SLAVE_MAX_PROGRAMS || !SlavePrograms[Handle-1].InUse)
+     return;
+  SlaveProgramPtr = &SlavePrograms[Handle-1];
+
+  /* Free the cached objects of the program. */
+  ProgramFreeTempImages(SlaveProgramPtr);
+  MimFree(SlaveProgramPtr->ExtremeResult);
+  MbufFree(SlaveProgramPtr->RemapLut);
+  for (n = 0; n < SlaveProgramPtr->Program.NbLuts; n++)
+     MbufFree(SlaveProgramPtr->Luts[n]);
+
+  SlaveProgramPtr->InUse = false;
+}
+
+
+/* Program functions. */
+/* ------------------ */
+
+/* Validates the operations and their image registers. */
+static bool ProgramIsValid(const ProgramStruct* ProgramPtr)
+{
+  MIL_INT n;
+
+  if (ProgramPtr->NbOps < 0 || ProgramPtr->NbOps > PROGRAM_MAX_OPS ||
+      ProgramPtr->NbLuts < 0 || ProgramPtr->NbLuts > PROGRAM_MAX_LUTS)
+     return false;
+
+  for (n = 0; n < ProgramPtr->NbOps; n++)
+     {
+     const ProgramOpStruct *OpPtr = &ProgramPtr->Ops[n];
+
+     if (OpPtr->OpCode < PROGRAM_OP_COPY || OpPtr->OpCode > PROGRAM_OP_THRESHOLD)
+        return false;
+     if (OpPtr->Src < 0 || OpPtr->Src >= PROGRAM_NB_IMAGES ||
+         OpPtr->Dst < 0 || OpPtr->Dst >= PROGRAM_NB_IMAGES)
+        return false;
+     if (OpPtr->OpCode == PROGRAM_OP_ARITH &&
+         (OpPtr->Src2 < 0 || OpPtr->Src2 >= PROGRAM_NB_IMAGES))
+        return false;
+     if (OpPtr->OpCode == PROGRAM_OP_LUT_MAP &&
+         (OpPtr->Operation < 0 || OpPtr->Operation >= ProgramPtr->NbLuts))
+        return false;
+     }
+  return true;
+}
+
+/* Allocates the temporary buffers with the size and type of an image. */
+static void ProgramAllocTempImages(SlaveProgramStruct* SlaveProgramPtr, MIL_ID Image)
+{
+  MIL_INT n;
+
+  SlaveProgramPtr->SizeX = MbufInquire(Image, M_SIZE_X, M_NULL);
+  SlaveProgramPtr->SizeY = MbufInquire(Image, M_SIZE_Y, M_NULL);
+  SlaveProgramPtr->Type  = MbufInquire(Image, M_TYPE,   M_NULL);
+  for (n = 0; n < PROGRAM_NB_TEMP_IMAGES; n++)
+     {
+     MbufAlloc2d(SlaveProgramPtr->OwnerSystem, SlaveProgramPtr->SizeX, SlaveProgramPtr->SizeY,
+                 SlaveProgramPtr->Type, M_IMAGE+M_PROC, &SlaveProgramPtr->TempImages[n]);
+     }
+}
+
+static void ProgramFreeTempImages(SlaveProgramStruct* SlaveProgramPtr)
+{
+  MIL_INT n;
+
+  for (n = 0; n < PROGRAM_NB_TEMP_IMAGES; n++)
+     MbufFree(SlaveProgramPtr->TempImages[n]);
+}
@@ -0,0 +1,227 @@
+﻿/*****************************************************************************************/
+/*
+ * File name: DMILAsyncCall.cpp
+ *
+ * Synopsis:  Pipelined asynchronous calls of a custom MIL function on a system.
+ *
+ *            AsyncCallSubmit() calls the AsynchronousFunctionWithResult() master 
+ *            function and returns immediately with a completion token, unless the 
+ *            maximum number of calls are already in flight on the system. Each call in 
+ *            flight has its own result buffer; the slave function writes its result 
+ *            in it, which calls the buffer modified hook on the Host where the 
+ *            completion callback is called and the latency of the call is measured.
+ *
+ * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+ * All Rights Reserved
+ */
+#include <mil.h>
+#include "DMILAsyncCall.h"
+
+/* Master MIL function declaration. */
+void MFTYPE AsynchronousFunctionWithResult(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Option,
+                                           MIL_INT CallToken, MIL_ID ResultBuffer);
+
+/* Result buffer modified hook function prototype. */
+static MIL_INT MFTYPE AsyncCallResultModified(MIL_INT HookType, MIL_ID EventId, void* SlotVoidPtr);
+
+/* Token of a slot without call. */
+#define NO_CALL_TOKEN   -1
+
+/* Allocate a pipeline of calls on a system. */
+/* ----------------------------------------- */
+void AsyncCallPipelineAlloc(MIL_ID MilSystem, MIL_INT Depth,
+                            ASYNC_CALL_COMPLETION_FUNCTION_PTR CompletionFunctionPtr,
+                            void* CompletionUserDataPtr, AsyncCallPipelineStruct* PipelinePtr)
+   {
+   AsyncCallResultStruct Result;
+   MIL_INT n;
+
+   if (Depth < 1)
+      Depth = 1;
+   else if (Depth > ASYNC_CALL_MAX_DEPTH)
+      Depth = ASYNC_CALL_MAX_DEPTH;
+
+   PipelinePtr->MilSystem             = MilSystem;
+   PipelinePtr->Depth                 = Depth;
+   PipelinePtr->CompletionFunctionPtr = CompletionFunctionPtr;
+   PipelinePtr->CompletionUserDataPtr = CompletionUserDataPtr;
+   PipelinePtr->NextCallToken         = 0;
+   PipelinePtr->NbInFlight            = 0;
+   PipelinePtr->NbCallsDone           = 0;
+   PipelinePtr->TotalLatency          = 0.0;
+   PipelinePtr->MaxLatency            = 0.0;
+
+   /* The synchronization objects are only used on the Host. */
+   MthrAlloc(M_DEFAULT_HOST, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &PipelinePtr->MilMutex);
+   MthrAlloc(M_DEFAULT_HOST, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL,
+             &PipelinePtr->MilCallDoneEvent);
+
+   /* Allocate the result buffer of each slot on the target system and hook 
+      its modifications to get the completions on the Host.
+   */
+   Result.CallToken   = NO_CALL_TOKEN;
+   Result.ReturnValue = 0;
+   for (n = 0; n < Depth; n++)
+      {
+      AsyncCallSlotStruct *SlotPtr = &PipelinePtr->Slots[n];
+
+      SlotPtr->CallToken   = NO_CALL_TOKEN;
+      SlotPtr->SubmitTime  = 0.0;
+      SlotPtr->InFlight    = false;
+      SlotPtr->PipelinePtr = PipelinePtr;
+      MbufAlloc1d(MilSystem, sizeof(AsyncCallResultStruct), 8L+M_UNSIGNED, M_ARRAY,
+                  &SlotPtr->MilResultBuffer);
+      MbufPut(SlotPtr->MilResultBuffer, &Result);
+      MbufHookFunction(SlotPtr->MilResultBuffer, M_MODIFIED_BUFFER,
+                       AsyncCallResultModified, SlotPtr);
+      }
+   }
+
+/* Free a pipeline of calls after waiting for the calls in flight. */
+/* --------------------------------------------------------------- */
+void AsyncCallPipelineFree(AsyncCallPipelineStruct* PipelinePtr)
+   {
+   MIL_INT n;
+
+   AsyncCallWaitAll(PipelinePtr);
+
+   for (n = 0; n < PipelinePtr->Depth; n++)
+      {
+      AsyncCallSlotStruct *SlotPtr = &PipelinePtr->Slots[n];
+
+      MbufHookFunction(SlotPtr->MilResultBuffer, M_MODIFIED_BUFFER+M_UNHOOK,
+                       AsyncCallResultModified, SlotPtr);
+      MbufFree(SlotPtr->MilResultBuffer);
+      }
+   MthrFree(PipelinePtr->MilCallDoneEvent);
+   MthrFree(PipelinePtr->MilMutex);
+   }
+
+/* Submit a call and return its completion token. Waits for a free slot  */
+/* if the maximum number of calls are already in flight.                 */
+/* --------------------------------------------------------------------- */
+MIL_INT AsyncCallSubmit(AsyncCallPipelineStruct* PipelinePtr, MIL_ID SrcImage, MIL_ID DstImage,
+                        MIL_INT Option)
+   {
+   AsyncCallSlotStruct *SlotPtr = M_NULL;
+   MIL_INT CallToken;
+   MIL_INT n;
+
+   MthrControl(PipelinePtr->MilMutex, M_LOCK, M_DEFAULT);
+   while (PipelinePtr->NbInFlight >= PipelinePtr->Depth)
+      {
+      MthrControl(PipelinePtr->MilMutex, M_UNLOCK, M_DEFAULT);
+      MthrWait(PipelinePtr->MilCallDoneEvent, M_EVENT_WAIT, M_NULL);
+      MthrControl(PipelinePtr->MilMutex, M_LOCK, M_DEFAULT);
+      }
+
+   /* Take a free slot. */
+   for (n = 0; n < PipelinePtr->Depth && SlotPtr == M_NULL; n++)
+      {
+      if (!PipelinePtr->Slots[n].InFlight)
+         SlotPtr = &PipelinePtr->Slots[n];
+      }
+
+   CallToken = PipelinePtr->NextCallToken++;
+   SlotPtr->CallToken = CallToken;
+   SlotPtr->InFlight  = true;
+   MappTimer(M_DEFAULT, M_TIMER_READ, &SlotPtr->SubmitTime);
+   PipelinePtr->NbInFlight++;
+   MthrControl(PipelinePtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+   /* Call the custom MIL asynchronous function. */
+   AsynchronousFunctionWithResult(SrcImage, DstImage, Option, CallToken, SlotPtr->MilResultBuffer);
+
+   return CallToken;
+   }
+
+/* Wait for the completion of a call. */
+/* ---------------------------------- */
+void AsyncCallWait(AsyncCallPipelineStruct* PipelinePtr, MIL_INT CallToken)
+   {
+   bool    Done = false;
+   MIL_INT n;
+
+   while (!Done)
+      {
+      MthrControl(PipelinePtr->MilMutex, M_LOCK, M_DEFAULT);
+      Done = true;
+      for (n = 0; n < PipelinePtr->Depth; n++)
+         {
+         if (PipelinePtr->Slots[n].InFlight && PipelinePtr->Slots[n].CallToken == CallToken)
+            Done = false;
+         }
+      MthrControl(PipelinePtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+      if (!Done)
+         MthrWait(PipelinePtr->MilCallDoneEvent, M_EVENT_WAIT, M_NULL);
+      }
+   }
+
+/* Wait for the completion of all the calls in flight. */
+/* --------------------------------------------------- */
+void AsyncCallWaitAll(AsyncCallPipelineStruct* PipelinePtr)
+   {
+   bool Done = false;
+
+   while (!Done)
+      {
+      MthrControl(PipelinePtr->MilMutex, M_LOCK, M_DEFAULT);
+      Done = (PipelinePtr->NbInFlight == 0);
+      MthrControl(PipelinePtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+      if (!Done)
+         MthrWait(PipelinePtr->MilCallDoneEvent, M_EVENT_WAIT, M_NULL);
+      }
+   }
+
+/****************************************************************************** 
+ * Result buffer modified hook function: 
+ *      - This function is called on the Host each time a slave function writes 
+ *        the result of a call in the result buffer of a slot. It completes the
+ *        call, calls the completion callback and wakes up the waiting functions.
+ */
+static MIL_INT MFTYPE AsyncCallResultModified(MIL_INT HookType, MIL_ID EventId, void* SlotVoidPtr)
+   {
+   AsyncCallSlotStruct     *SlotPtr     = (AsyncCallSlotStruct *)SlotVoidPtr;
+   AsyncCallPipelineStruct *PipelinePtr = SlotPtr->PipelinePtr;
+   AsyncCallResultStruct     Result;
+   AsyncCallCompletionStruct Completion;
+   MIL_DOUBLE                CompletionTime;
+
+   /* Read the result of the call. */
+   MbufGet(SlotPtr->MilResultBuffer, &Result);
+   MappTimer(M_DEFAULT, M_TIMER_READ, &CompletionTime);
+
+   MthrControl(PipelinePtr->MilMutex, M_LOCK, M_DEFAULT);
+
+   /* Ignore the modifications that are not the result of the call in flight. */
+   if (!SlotPtr->InFlight || (MIL_INT)Result.CallToken != SlotPtr->CallToken)
+      {
+      MthrControl(PipelinePtr->MilMutex, M_UNLOCK, M_DEFAULT);
+      return M_NULL;
+      }
+
+   /* Complete the call and update the statistics. */
+   Completion.CallToken   = SlotPtr->CallToken;
+   Completion.ReturnValue = (MIL_INT)Result.ReturnValue;
+   Completion.Latency     = CompletionTime - SlotPtr->SubmitTime;
+
+   SlotPtr->InFlight = false;
+   PipelinePtr->NbInFlight--;
+   PipelinePtr->NbCallsDone++;
+   PipelinePtr->TotalLatency += Completion.Latency;
+   if (Completion.Latency > PipelinePtr->MaxLatency)
+      PipelinePtr->MaxLatency = Completion.Latency;
+
+   /* Call the completion callback. */
+   if (PipelinePtr->CompletionFunctionPtr)
+      (*PipelinePtr->CompletionFunctionPtr)(&Completion, PipelinePtr->CompletionUserDataPtr);
+
+   MthrControl(PipelinePtr->MilMutex, M_UNLOCK, M_DEFAULT);
+
+   /* Wake up the functions waiting for a completion. */
+   MthrControl(PipelinePtr->MilCallDoneEvent, M_EVENT_SET, M_SIGNALED);
+
+   return M_NULL;
+   }
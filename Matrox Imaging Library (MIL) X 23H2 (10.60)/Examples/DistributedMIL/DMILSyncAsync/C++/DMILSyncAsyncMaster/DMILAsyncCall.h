@@ -0,0 +1,81 @@
+﻿/*****************************************************************************************/
+/*
+ * File name: DMILAsyncCall.h
+ *
+ * Synopsis:  Pipelined asynchronous calls of a custom MIL function on a system. 
+ *            Each call returns a completion token, at most a given number of calls
+ *            are in flight on the system and the result of each call is delivered
+ *            to a completion callback.
+ *
+ * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+ * All Rights Reserved
+ */
+#ifndef DMIL_ASYNC_CALL_H
+#define DMIL_ASYNC_CALL_H
+
+/* Maximum number of calls in flight on a system. */
+#define ASYNC_CALL_MAX_DEPTH  16
+
+/* Result written by the slave function at the end of a call
+   (must be the same as in the slave).
+*/
+typedef struct
+   {
+   MIL_INT64 CallToken;
+   MIL_INT64 ReturnValue;
+   } AsyncCallResultStruct;
+
+/* Completion information passed to the completion callback. */
+typedef struct
+   {
+   MIL_INT    CallToken;
+   MIL_INT    ReturnValue;
+   MIL_DOUBLE Latency;
+   } AsyncCallCompletionStruct;
+
+/* Completion callback. The callbacks of a pipeline are serialized. */
+typedef void (MFTYPE *ASYNC_CALL_COMPLETION_FUNCTION_PTR)(const AsyncCallCompletionStruct* CompletionPtr,
+                                                          void* UserDataPtr);
+
+struct AsyncCallPipelineStruct;
+
+/* Slot of a call in flight. */
+typedef struct
+   {
+   MIL_ID     MilResultBuffer;
+   MIL_INT    CallToken;
+   MIL_DOUBLE SubmitTime;
+   bool       InFlight;
+   struct AsyncCallPipelineStruct* PipelinePtr;
+   } AsyncCallSlotStruct;
+
+/* Pipeline of the calls on one system. */
+typedef struct AsyncCallPipelineStruct
+   {
+   MIL_ID     MilSystem;
+   MIL_ID     MilMutex;
+   MIL_ID     MilCallDoneEvent;
+   MIL_INT    Depth;
+   AsyncCallSlotStruct Slots[ASYNC_CALL_MAX_DEPTH];
+   ASYNC_CALL_COMPLETION_FUNCTION_PTR CompletionFunctionPtr;
+   void*      CompletionUserDataPtr;
+   MIL_INT    NextCallToken;
+   MIL_INT    NbInFlight;
+
+   /* Statistics. */
+   MIL_INT    NbCallsDone;
+   MIL_DOUBLE TotalLatency;
+   MIL_DOUBLE MaxLatency;
+   } AsyncCallPipelineStruct;
+
+/* Pipeline functions. */
+void AsyncCallPipelineAlloc(MIL_ID MilSystem, MIL_INT Depth,
+                            ASYNC_CALL_COMPLETION_FUNCTION_PTR CompletionFunctionPtr,
+                            void* CompletionUserDataPtr, AsyncCallPipelineStruct* PipelinePtr);
+void AsyncCallPipelineFree(AsyncCallPipelineStruct* PipelinePtr);
+MIL_INT AsyncCallSubmit(AsyncCallPipelineStruct* PipelinePtr, MIL_ID SrcImage, MIL_ID DstImage,
+                        MIL_INT Option);
+void AsyncCallWait(AsyncCallPipelineStruct* PipelinePtr, MIL_INT CallToken);
+void AsyncCallWaitAll(AsyncCallPipelineStruct* PipelinePtr);
+
+#endif
@@ -6,7 +6,9 @@
  *            call custom synchronous and asynchronous MIL functions.
  *
  *            It contains the main to test the SynchronousFunction() and 
- *            AsynchronousFunction() master functions.
+ *            AsynchronousFunction() master functions, and the pipelined 
+ *            asynchronous calls with completion callbacks of DMILAsyncCall.cpp 
+ *            for different numbers of calls in flight.
  *
  *            The slave functions can be found in the DistributedMILSyncAsyncSlave project.
  *
@@ -14,6 +16,7 @@
  * All Rights Reserved
  */
 #include <mil.h>
+#include "DMILAsyncCall.h"
 
 /* Master MIL functions declarations */
 MIL_INT MFTYPE SynchronousFunction(MIL_ID SrcImage, MIL_ID DstImage,  MIL_INT Option);
@@ -23,6 +26,10 @@ void MFTYPE AsynchronousFunction(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Optio
 #define IMAGE_FILE   M_IMAGE_PATH MIL_TEXT("Wafer.mim")
 #define NB_LOOP      100
 
+/* Numbers of calls in flight tested with the pipelined asynchronous calls. */
+#define NB_PIPELINE_DEPTHS   5
+static const MIL_INT PipelineDepths[NB_PIPELINE_DEPTHS] = {1, 2, 4, 8, ASYNC_CALL_MAX_DEPTH};
+
 #define SLAVE_SYSTEM_DESCRIPTOR   M_SYSTEM_DEFAULT
 
 /* Slave dll path and name */
@@ -38,6 +45,15 @@ void MFTYPE AsynchronousFunction(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Optio
 /* Main to test the functions. */
 /* --------------------------- */
 static bool SetupDMILExample(MIL_ID MilSystem);
+static void MFTYPE CallCompleted(const AsyncCallCompletionStruct* CompletionPtr, void* UserDataPtr);
+
+/* Data of the completion callback. */
+typedef struct
+   {
+   MIL_INT NbCompletions;
+   MIL_INT LastCallToken;
+   MIL_INT NbOutOfOrder;
+   } CompletionDataStruct;
 
 int MosMain(void)
 {
@@ -48,8 +64,11 @@ int MosMain(void)
 
    MIL_INT      ReturnValue;              /* Return Value holder.     */
    MIL_DOUBLE   SynchronousCallTime,      /* Timer variable.          */
-                AsynchronousCallTime;     /* Timer variable.          */
-   int          n;                        /* Counter.                 */
+                AsynchronousCallTime,     /* Timer variable.          */
+                PipelineTime;             /* Timer variable.          */
+   AsyncCallPipelineStruct Pipeline;      /* Pipeline of calls.       */
+   CompletionDataStruct    CompletionData;/* Completion callback data.*/
+   int          n, d;                     /* Counters.                */
 
    
    /* Allocate application, system and display. */
@@ -125,8 +144,59 @@ int MosMain(void)
    MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &AsynchronousCallTime);
       
    /* Print the asynchronous call time. */
-   MosPrintf(MIL_TEXT("Asynchronous function call time: %.1f us.\n"), 
+   MosPrintf(MIL_TEXT("Asynchronous function call time: %.1f us.\n\n"), 
       AsynchronousCallTime*1000000/NB_LOOP);
+
+   /* Pipelined asynchronous function calls. */
+   /* -------------------------------------- */
+
+   /* Each call returns a completion token and its result is delivered to a 
+      completion callback. The number of calls in flight is bounded by the depth 
+      of the pipeline so the transfer of the next calls overlaps the processing 
+      of the previous ones on the system.
+   */
+   MosPrintf(MIL_TEXT("Pipelined asynchronous function calls with completion:\n\n"));
+   MosPrintf(MIL_TEXT("Depth  Throughput (calls/s)  Avg latency (us)  Max latency (us)\n"));
+   MosPrintf(MIL_TEXT("-----  --------------------  ----------------  ----------------\n"));
+
+   for (d = 0; d < NB_PIPELINE_DEPTHS; d++)
+      {
+      CompletionData.NbCompletions = 0;
+      CompletionData.LastCallToken = -1;
+      CompletionData.NbOutOfOrder  = 0;
+      AsyncCallPipelineAlloc(MilSystem, PipelineDepths[d], CallCompleted, &CompletionData,
+                             &Pipeline);
+
+      /* Call the function a first time for more accurate timings later (dll load, ...). */
+      AsyncCallWait(&Pipeline, AsyncCallSubmit(&Pipeline, MilImage, MilImage, M_DEFAULT));
+
+      /* Start the timer */
+      MappTimer(M_DEFAULT, M_TIMER_RESET+M_SYNCHRONOUS, M_NULL);
+      Pipeline.NbCallsDone  = 0;
+      Pipeline.TotalLatency = 0.0;
+      Pipeline.MaxLatency   = 0.0;
+
+      /* Loop many times for more precise timing. */
+      for (n= 0; n < NB_LOOP; n++)
+         AsyncCallSubmit(&Pipeline, MilImage, MilImage, M_DEFAULT);
+      AsyncCallWaitAll(&Pipeline);
+
+      /* Read the timer. */
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &PipelineTime);
+
+      /* Print the throughput and latency of the calls. */
+      MosPrintf(MIL_TEXT("%5d  %20.1f  %16.1f  %16.1f\n"), (int)Pipeline.Depth,
+                NB_LOOP/PipelineTime,
+                Pipeline.TotalLatency*1000000/Pipeline.NbCallsDone,
+                Pipeline.MaxLatency*1000000);
+
+      AsyncCallPipelineFree(&Pipeline);
+
+      if (CompletionData.NbCompletions != NB_LOOP+1 || CompletionData.NbOutOfOrder != 0)
+         MosPrintf(MIL_TEXT("       %d completion(s), %d out of order.\n"),
+                   (int)CompletionData.NbCompletions, (int)CompletionData.NbOutOfOrder);
+      }
+   MosPrintf(MIL_TEXT("\n"));
    MosPrintf(MIL_TEXT("Press a key to terminate.\n\n"));
    MosGetch();
 
@@ -139,6 +209,19 @@ int MosMain(void)
    return 0;
 }
 
+/* Completion callback of the pipelined calls. */
+/* ------------------------------------------- */
+void MFTYPE CallCompleted(const AsyncCallCompletionStruct* CompletionPtr, void* UserDataPtr)
+   {
+   CompletionDataStruct *CompletionDataPtr = (CompletionDataStruct *)UserDataPtr;
+
+   /* The calls of a system are done in order. */
+   if (CompletionPtr->CallToken < CompletionDataPtr->LastCallToken)
+      CompletionDataPtr->NbOutOfOrder++;
+   CompletionDataPtr->LastCallToken = CompletionPtr->CallToken;
+   CompletionDataPtr->NbCompletions++;
+   }
+
 bool SetupDMILExample(MIL_ID MilSystem)
    {
    MIL_ID MilSystemOwnerApplication;/* System owner application.*/
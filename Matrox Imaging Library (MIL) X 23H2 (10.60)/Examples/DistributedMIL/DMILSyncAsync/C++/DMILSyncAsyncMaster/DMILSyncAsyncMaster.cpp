@@ -5,8 +5,8 @@
  * Synopsis:  This example shows how to use the MIL Function Development module to 
  *            create custom synchronous and asynchronous MIL functions.
  *
- *            It contains the SynchronousFunction() and AsynchronousFunction() master 
- *            functions.
+ *            It contains the SynchronousFunction(), AsynchronousFunction() and 
+ *            AsynchronousFunctionWithResult() master functions.
  *
  * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
  * All Rights Reserved
@@ -17,6 +17,8 @@
 /* Master MIL functions declarations */
 MIL_INT MFTYPE SynchronousFunction(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Option);
 void MFTYPE AsynchronousFunction(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Option);
+void MFTYPE AsynchronousFunctionWithResult(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Option,
+                                           MIL_INT CallToken, MIL_ID ResultBuffer);
 
 /* Master Synchronous MIL Function definition. */
 /* ------------------------------------------- */
@@ -89,3 +91,42 @@ void MFTYPE AsynchronousFunction(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Optio
    MfuncFree(Func);
 }
 
+
+/* Master Asynchronous MIL Function with result definition. */
+/* -------------------------------------------------------- */
+
+/* The slave function writes the call token and its return value in the result 
+   array buffer when it is done, which signals the completion of the call to the 
+   Host through the buffer modified hook (see DMILAsyncCall.cpp).
+*/
+#define ASYNC_RESULT_FUNCTION_OPCODE   (M_USER_FUNCTION+4)
+#define ASYNC_RESULT_FUNCTION_NB_PARAM 5
+
+/* Slave function name */
+#define SLAVE_ASYNC_RESULT_FUNC_NAME   MIL_TEXT("SlaveAsynchronousFunctionWithResult")
+
+void MFTYPE AsynchronousFunctionWithResult(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Option,
+                                           MIL_INT CallToken, MIL_ID ResultBuffer)
+{
+   MIL_ID Func;
+   
+   MfuncAlloc(MIL_TEXT("AsynchronousFunctionWithResult"), 
+              ASYNC_RESULT_FUNCTION_NB_PARAM,
+              M_NULL, SLAVE_DLL_NAME, SLAVE_ASYNC_RESULT_FUNC_NAME, 
+              ASYNC_RESULT_FUNCTION_OPCODE, 
+              M_ASYNCHRONOUS_FUNCTION,
+              &Func);
+
+   /* Register the parameters. */
+   MfuncParamMilId (Func, 1, SrcImage, M_IMAGE, M_IN  + M_PROC);
+   MfuncParamMilId (Func, 2, DstImage, M_IMAGE, M_OUT + M_PROC);
+   MfuncParamMilInt(Func, 3, Option);
+   MfuncParamMilInt(Func, 4, CallToken);
+   MfuncParamMilId (Func, 5, ResultBuffer, M_ARRAY, M_OUT);
+
+   /* Call the target Slave function. */
+   MfuncCall(Func);
+
+   /* Free the MIL function context. */
+   MfuncFree(Func);
+}
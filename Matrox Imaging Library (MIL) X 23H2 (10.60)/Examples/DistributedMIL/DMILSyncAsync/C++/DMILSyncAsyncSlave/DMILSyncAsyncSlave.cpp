@@ -5,15 +5,22 @@
  * Synopsis:  This example shows how to use the MIL Function Development module to 
  *            create custom synchronous and asynchronous MIL functions.
  *
- *            It contains the SlaveSynchronousFunction() and SlaveAsynchronousFunction()
- *            slave functions.
+ *            It contains the SlaveSynchronousFunction(), SlaveAsynchronousFunction()
+ *            and SlaveAsynchronousFunctionWithResult() slave functions.
  *
  * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
  * All Rights Reserved
  */
 #include <mil.h>
 
-
+/* Result written at the end of an asynchronous call with result
+   (must be the same as in the master).
+*/
+typedef struct
+   {
+   MIL_INT64 CallToken;
+   MIL_INT64 ReturnValue;
+   } AsyncCallResultStruct;
 
 /* Slave MIL Function prototypes. */
 #ifdef __cplusplus
@@ -21,6 +28,7 @@ extern "C" {
 #endif
 void MFTYPE SlaveSynchronousFunction(MIL_ID Func);
 void MFTYPE SlaveAsynchronousFunction(MIL_ID Func);
+void MFTYPE SlaveAsynchronousFunctionWithResult(MIL_ID Func);
 #ifdef __cplusplus
    }
 #endif
@@ -63,3 +71,29 @@ void MFTYPE SlaveAsynchronousFunction(MIL_ID Func)
   /* Do the processing. */
   //...
 }
+
+
+/* Slave Asynchronous MIL Function with result definition. */
+/* ------------------------------------------------------- */
+
+void MFTYPE SlaveAsynchronousFunctionWithResult(MIL_ID Func)
+{
+  MIL_ID SrcImage, DstImage, ResultBuffer;
+  MIL_INT Option, CallToken, ValueToReturn = M_NULL;
+  AsyncCallResultStruct Result;
+
+  /* Read the parameters. */
+  MfuncParamValue(Func, 1, &SrcImage);
+  MfuncParamValue(Func, 2, &DstImage);
+  MfuncParamValue(Func, 3, &Option); 
+  MfuncParamValue(Func, 4, &CallToken); 
+  MfuncParamValue(Func, 5, &ResultBuffer); 
+
+  /* Do the processing and calculate the value to return. */
+  // ValueToReturn = ...
+
+  /* Write the result (This also triggers the Host MbufHookFunction() callback). */
+  Result.CallToken   = CallToken;
+  Result.ReturnValue = ValueToReturn;
+  MbufPut(ResultBuffer, &Result);
+}
@@ -10,36 +10,136 @@
  *            the timing such as dll load time and OS inaccuracy when 
  *            measuring a very short time.
  *
+ *            The second part runs a suite of registered benchmarks, reports
+ *            the distribution of the per-call time of each of them, saves
+ *            the results in JSON and CSV format and compares them with a
+ *            stored baseline to detect performance regressions.
+ *            The last part sweeps the image size and the number of CPU
+ *            cores to find where multi-processing pays off.
+ *
  * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
  * All Rights Reserved
  */
 #include <mil.h>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <cmath>
+#include <stdexcept>
 
 /* Target MIL image specifications. */
-#define IMAGE_FILE   M_IMAGE_PATH MIL_TEXT("LargeWafer.mim")
+#define IMAGE_FILE      M_IMAGE_PATH MIL_TEXT("LargeWafer.mim")
+#define CODE_IMAGE_FILE M_IMAGE_PATH MIL_TEXT("VariousCodeReadings/BlackAndWhiteDatamatrix.mim")
 #define ROTATE_ANGLE -15
+#define MORPHOLOGY_NB_ITERATION 3
+#define PATTERN_MODEL_SIZE    128
 
 /* Timing loop iterations setting. */
 #define MINIMUM_BENCHMARK_TIME 2.0 /* In seconds (1.0 and more recommended). */
 #define ESTIMATION_NB_LOOP      10
 #define DEFAULT_NB_LOOP        100
 
+/* Benchmark suite settings. */
+#define SUITE_MIN_NB_SAMPLE     30
+#define SUITE_MAX_NB_SAMPLE   2000
+#define CONFIDENCE_Z          1.96 /* 95% two-sided confidence level.          */
+#define REGRESSION_THRESHOLD   5.0 /* In percent of the baseline median time.  */
+#define RESULT_JSON_FILE       M_TEMP_DIR MIL_TEXT("MappBenchmark.json")
+#define RESULT_CSV_FILE        M_TEMP_DIR MIL_TEXT("MappBenchmark.csv")
+#define BASELINE_CSV_FILE      M_TEMP_DIR MIL_TEXT("MappBenchmarkBaseline.csv")
+
+/* Scaling sweep settings. The image size is doubled at each step. */
+#define SWEEP_MIN_IMAGE_SIZE    256
+#define SWEEP_MAX_IMAGE_SIZE  16384
+#define SWEEP_BENCHMARK_TIME    0.5 /* In seconds, for each measured point.     */
+#define SIZE_SWEEP_CSV_FILE    M_TEMP_DIR MIL_TEXT("MappBenchmarkSizeSweep.csv")
+#define CORE_SWEEP_CSV_FILE    M_TEMP_DIR MIL_TEXT("MappBenchmarkCoreSweep.csv")
+
 /* Processing function parameters structure. */
 typedef struct 
    {
    MIL_ID MilSourceImage;        /* Image buffer identifier. */
    MIL_ID MilDestinationImage;   /* Image buffer identifier. */
+   MIL_ID MilAuxiliaryBuffer;    /* Warp matrix or intermediate image, if any. */
+   MIL_ID MilContext;            /* Module context identifier, if any.         */
+   MIL_ID MilResult;             /* Module result identifier, if any.          */
+   MIL_INT ImageSize;            /* Square image size, or 0 for the file size. */
    } PROC_PARAM;
 
-/* Declaration of the benchmarking function. */
-void Benchmark(PROC_PARAM& ProcParamPtr, MIL_DOUBLE& Time, MIL_DOUBLE& FramesPerSecond);
+/* Registered benchmark structure. You can insert your own initialization,
+   execution and free operations in the benchmark list below.
+*/
+typedef struct
+   {
+   MIL_CONST_TEXT_PTR Name;
+   void (*Init)(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr);
+   void (*Execute)(PROC_PARAM& ProcParamPtr);
+   void (*Free)(PROC_PARAM& ProcParamPtr);
+   } BENCHMARK_ENTRY;
 
-/* Declarations of the target processing functions. You can insert your 
-   own intialization, execution and free operations in these functions. 
+/* Timing statistics of a benchmark, in ms. The Low/High values are the
+   bounds of the confidence interval of the associated statistic.
 */
-void ProcessingInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr);
-void ProcessingExecute(PROC_PARAM& ProcParamPtr);
+typedef struct
+   {
+   MIL_INT    NbSample;
+   MIL_DOUBLE Min;
+   MIL_DOUBLE Median, MedianLow, MedianHigh;
+   MIL_DOUBLE P95, P95Low, P95High;
+   MIL_DOUBLE P99, P99Low, P99High;
+   MIL_DOUBLE Mean, MeanLow, MeanHigh;
+   MIL_DOUBLE StdDev;
+   } BENCHMARK_STATS;
+
+/* Declaration of the benchmarking functions. */
+void Benchmark(const BENCHMARK_ENTRY& Entry, PROC_PARAM& ProcParamPtr, MIL_DOUBLE& Time, MIL_DOUBLE& FramesPerSecond,
+               MIL_DOUBLE MinimumTime = MINIMUM_BENCHMARK_TIME);
+void BenchmarkSamples(const BENCHMARK_ENTRY& Entry, PROC_PARAM& ProcParamPtr, BENCHMARK_STATS& Stats);
+void RunBenchmarkSuite(MIL_ID MilSystem);
+void RunSizeSweep(MIL_ID MilSystem, MIL_ID MilApplication);
+void RunCoreSweep(MIL_ID MilSystem, MIL_ID MilApplication);
+
+/* Declaration of the statistics and result file functions. */
+MIL_DOUBLE Percentile(const std::vector<MIL_DOUBLE>& SortedSamples, MIL_DOUBLE Fraction,
+                      MIL_DOUBLE& Low, MIL_DOUBLE& High);
+void ComputeStats(std::vector<MIL_DOUBLE>& Samples, BENCHMARK_STATS& Stats);
+void SaveResultsCsv(MIL_CONST_TEXT_PTR FileName, const std::vector<BENCHMARK_STATS>& Stats);
+void SaveResultsJson(MIL_CONST_TEXT_PTR FileName, MIL_INT NbCoresUsed, const std::vector<BENCHMARK_STATS>& Stats);
+bool LoadBaselineCsv(MIL_CONST_TEXT_PTR FileName, std::vector<MIL_STRING>& Names, std::vector<BENCHMARK_STATS>& Stats);
+MIL_INT CompareWithBaseline(const std::vector<BENCHMARK_STATS>& Stats);
+
+/* Declarations of the target processing functions. */
+void ProcessingInit(MIL_ID MilSystem, MIL_CONST_TEXT_PTR FileName, PROC_PARAM& ProcParamPtr);
 void ProcessingFree(PROC_PARAM& ProcParamPtr);
+void RotateInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr);
+void RotateExecute(PROC_PARAM& ProcParamPtr);
+void WarpInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr);
+void WarpExecute(PROC_PARAM& ProcParamPtr);
+void ConvolveExecute(PROC_PARAM& ProcParamPtr);
+void MorphologyExecute(PROC_PARAM& ProcParamPtr);
+void BlobInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr);
+void BlobExecute(PROC_PARAM& ProcParamPtr);
+void BlobFree(PROC_PARAM& ProcParamPtr);
+void PatternInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr);
+void PatternExecute(PROC_PARAM& ProcParamPtr);
+void PatternFree(PROC_PARAM& ProcParamPtr);
+void CodeInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr);
+void CodeExecute(PROC_PARAM& ProcParamPtr);
+void CodeFree(PROC_PARAM& ProcParamPtr);
+
+/* Benchmark registry. The first entry is used for the multi-processing comparison. */
+static const BENCHMARK_ENTRY BenchmarkList[] =
+   {
+   { MIL_TEXT("Rotate"),     RotateInit,  RotateExecute,     ProcessingFree },
+   { MIL_TEXT("Warp"),       WarpInit,    WarpExecute,       ProcessingFree },
+   { MIL_TEXT("Convolve"),   RotateInit,  ConvolveExecute,   ProcessingFree },
+   { MIL_TEXT("Morphology"), RotateInit,  MorphologyExecute, ProcessingFree },
+   { MIL_TEXT("Blob"),       BlobInit,    BlobExecute,       BlobFree       },
+   { MIL_TEXT("Pattern"),    PatternInit, PatternExecute,    PatternFree    },
+   { MIL_TEXT("CodeRead"),   CodeInit,    CodeExecute,       CodeFree       },
+   };
+static const MIL_INT NB_BENCHMARK = sizeof(BenchmarkList) / sizeof(BenchmarkList[0]);
 
 int MosMain(void)
    {
@@ -49,7 +149,8 @@ int MosMain(void)
           MilDisplayImage,             /* Image buffer identifier. */   
           MilSystemOwnerApplication,   /* System's owner application.          */
           MilSystemCurrentThreadId;    /* System's current thread identifier.  */
-   PROC_PARAM ProcessingParam;         /* Processing parameters.               */
+   PROC_PARAM ProcessingParam = {};    /* Processing parameters.               */
+   const BENCHMARK_ENTRY& Entry = BenchmarkList[0]; /* Benchmark to compare.   */
    MIL_DOUBLE TimeAllCores, TimeAllCoresNoCS, TimeOneCore; /* Timer variables. */
    MIL_DOUBLE FPSAllCores, FPSAllCoresNoCS, FPSOneCore;    /* FPS variables.   */
    MIL_INT    NbCoresUsed, NbCoresUsedNoCS;                /* Number of CPU Core used.   */
@@ -73,7 +174,7 @@ int MosMain(void)
    MdispSelect(MilDisplay, MilDisplayImage);
 
    /* Allocate the processing objects. */
-   ProcessingInit(MilSystem, ProcessingParam);
+   Entry.Init(MilSystem, ProcessingParam);
 
    /* Pause to show the original image. */
    MosPrintf(MIL_TEXT("\nPROCESSING FUNCTION BENCHMARKING:\n"));
@@ -90,7 +191,7 @@ int MosMain(void)
    /* Benchmark the processing function without multi-processing. */
    /* ------------------------------------------------------------*/
    MappControlMp(MilSystemOwnerApplication, M_MP_USE, M_DEFAULT, M_DISABLE, M_NULL);   
-   Benchmark(ProcessingParam, TimeOneCore, FPSOneCore);
+   Benchmark(Entry, ProcessingParam, TimeOneCore, FPSOneCore);
 
    /* Show the resulting image and the timing results. */
    MbufCopy(ProcessingParam.MilDestinationImage, MilDisplayImage);
@@ -120,7 +221,7 @@ int MosMain(void)
       MthrInquireMp(MilSystemCurrentThreadId, M_CORE_NUM_EFFECTIVE, M_DEFAULT, M_DEFAULT, &NbCoresUsed);
       if (NbCoresUsed > 1)
          {
-         Benchmark(ProcessingParam, TimeAllCores, FPSAllCores);
+         Benchmark(Entry, ProcessingParam, TimeAllCores, FPSAllCores);
 
          /* Show the resulting image and the timing results. */
          MbufCopy(ProcessingParam.MilDestinationImage, MilDisplayImage);
@@ -143,7 +244,7 @@ int MosMain(void)
       MthrInquireMp(MilSystemCurrentThreadId, M_CORE_NUM_EFFECTIVE, M_DEFAULT, M_DEFAULT, &NbCoresUsedNoCS);
       if (NbCoresUsedNoCS != NbCoresUsed)
          {
-         Benchmark(ProcessingParam, TimeAllCoresNoCS, FPSAllCoresNoCS);
+         Benchmark(Entry, ProcessingParam, TimeAllCoresNoCS, FPSAllCoresNoCS);
 
          /* Show the resulting image and the timing results. */
          MbufCopy(ProcessingParam.MilDestinationImage, MilDisplayImage);
@@ -169,12 +270,26 @@ int MosMain(void)
          }
       }
      
+   /* Restore all performance levels for the benchmark suite. */
+   MappControlMp(MilSystemOwnerApplication, M_MP_USE_PERFORMANCE_LEVEL, M_ALL, M_DEFAULT, M_NULL);
+   Entry.Free(ProcessingParam);
+
+   /* Run the registered benchmark suite. */
+   MosPrintf(MIL_TEXT("\nPress <Enter> to run the benchmark suite.\n\n"));
+   MosGetch();
+   RunBenchmarkSuite(MilSystem);
+
+   /* Run the image size and core count scaling sweeps. */
+   MosPrintf(MIL_TEXT("Press <Enter> to run the image size and core count sweeps.\n\n"));
+   MosGetch();
+   RunSizeSweep(MilSystem, MilSystemOwnerApplication);
+   RunCoreSweep(MilSystem, MilSystemOwnerApplication);
+
    /* Wait for a key press. */
    MosPrintf(MIL_TEXT("Press <Enter> to end.\n"));
    MosGetch();
 
    /* Free all allocations. */
-   ProcessingFree(ProcessingParam);
    MdispSelect(MilDisplay, M_NULL);
    MbufFree(MilDisplayImage);
    MappFreeDefault(MilApplication, MilSystem, MilDisplay, M_NULL, M_NULL);   
@@ -184,7 +299,8 @@ int MosMain(void)
 /*****************************************************************************
 Benchmark function. 
 *****************************************************************************/
-void Benchmark(PROC_PARAM& ProcParamPtr, MIL_DOUBLE& Time, MIL_DOUBLE& FramesPerSecond)
+void Benchmark(const BENCHMARK_ENTRY& Entry, PROC_PARAM& ProcParamPtr, MIL_DOUBLE& Time, MIL_DOUBLE& FramesPerSecond,
+               MIL_DOUBLE MinimumTime)
    {
    MIL_INT EstimatedNbLoop = DEFAULT_NB_LOOP;
    MIL_DOUBLE StartTime, EndTime;
@@ -198,7 +314,7 @@ void Benchmark(PROC_PARAM& ProcParamPtr, MIL_DOUBLE& Time, MIL_DOUBLE& FramesPer
       This compensates for Dll load time, etc.
    */
    MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
-   ProcessingExecute(ProcParamPtr);  
+   Entry.Execute(ProcParamPtr);
    MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
    MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
 
@@ -210,7 +326,7 @@ void Benchmark(PROC_PARAM& ProcParamPtr, MIL_DOUBLE& Time, MIL_DOUBLE& FramesPer
    for (n = 0; n < ESTIMATION_NB_LOOP; n++)
       {
       MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
-      ProcessingExecute(ProcParamPtr);
+      Entry.Execute(ProcParamPtr);
       MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
       MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
 
@@ -218,12 +334,12 @@ void Benchmark(PROC_PARAM& ProcParamPtr, MIL_DOUBLE& Time, MIL_DOUBLE& FramesPer
       MinTime = (Time<MinTime)?Time:MinTime;
       }
    if (MinTime > 0) 
-      EstimatedNbLoop = (MIL_INT)(MINIMUM_BENCHMARK_TIME/MinTime)+1;
+      EstimatedNbLoop = (MIL_INT)(MinimumTime/MinTime)+1;
 
    /* Benchmark the processing according to the estimated number of loops. */
    MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
    for (n = 0; n < EstimatedNbLoop; n++)
-      ProcessingExecute(ProcParamPtr);
+      Entry.Execute(ProcParamPtr);
    MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
    MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
 
@@ -234,45 +350,698 @@ void Benchmark(PROC_PARAM& ProcParamPtr, MIL_DOUBLE& Time, MIL_DOUBLE& FramesPer
    }
 
 /*****************************************************************************
-Processing initialization function.
+Sampling benchmark function. Unlike Benchmark(), each call is timed
+individually so that the distribution of the processing time is known.
 *****************************************************************************/
-void ProcessingInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr)
+void BenchmarkSamples(const BENCHMARK_ENTRY& Entry, PROC_PARAM& ProcParamPtr, BENCHMARK_STATS& Stats)
    {
+   std::vector<MIL_DOUBLE> Samples;
+   MIL_INT NbSample = SUITE_MIN_NB_SAMPLE;
+   MIL_DOUBLE StartTime, EndTime;
+   MIL_DOUBLE MinTime;
+   MIL_INT n;
+
+   /* Wait for the completion of all functions in this thread. */
+   MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+
+   /* Warm up and estimate the number of samples to take in the specified
+      minimum time, as Benchmark() does.
+   */
+   MinTime = -1;
+   for (n = 0; n < ESTIMATION_NB_LOOP; n++)
+      {
+      MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+      Entry.Execute(ProcParamPtr);
+      MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+      MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+
+      if (n > 0 && (MinTime < 0 || EndTime-StartTime < MinTime))
+         MinTime = EndTime-StartTime;
+      }
+   if (MinTime > 0)
+      NbSample = (MIL_INT)(MINIMUM_BENCHMARK_TIME/MinTime)+1;
+   NbSample = std::min<MIL_INT>(std::max<MIL_INT>(NbSample, SUITE_MIN_NB_SAMPLE), SUITE_MAX_NB_SAMPLE);
+
+   /* Time each call individually. */
+   Samples.reserve(NbSample);
+   for (n = 0; n < NbSample; n++)
+      {
+      MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+      Entry.Execute(ProcParamPtr);
+      MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+      MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+
+      Samples.push_back((EndTime-StartTime)*1000);
+      }
+
+   ComputeStats(Samples, Stats);
+   }
+
+/*****************************************************************************
+Benchmark suite function. Runs all the registered benchmarks, saves the
+results and compares them with the baseline.
+*****************************************************************************/
+void RunBenchmarkSuite(MIL_ID MilSystem)
+   {
+   std::vector<BENCHMARK_STATS> Stats(NB_BENCHMARK);
+   MIL_INT NbCoresUsed;
+   MIL_INT NbRegression;
+   MIL_INT i;
+
+   MthrInquireMp(M_DEFAULT, M_CORE_NUM_EFFECTIVE, M_DEFAULT, M_DEFAULT, &NbCoresUsed);
+
+   MosPrintf(MIL_TEXT("BENCHMARK SUITE (%d CPU cores, times in ms, 95%% confidence intervals):\n"),
+             (int)NbCoresUsed);
+   MosPrintf(MIL_TEXT("--------------------------------------------------------------------------\n\n"));
+   MosPrintf(MIL_TEXT("%-12s %6s %9s %9s %21s %9s %9s %17s\n"),
+             MIL_TEXT("Benchmark"), MIL_TEXT("Calls"), MIL_TEXT("Min"), MIL_TEXT("Median"),
+             MIL_TEXT("Median CI"), MIL_TEXT("P95"), MIL_TEXT("P99"), MIL_TEXT("Mean"));
+
+   for (i = 0; i < NB_BENCHMARK; i++)
+      {
+      const BENCHMARK_ENTRY& Entry = BenchmarkList[i];
+      PROC_PARAM ProcessingParam = {};
+
+      Entry.Init(MilSystem, ProcessingParam);
+      BenchmarkSamples(Entry, ProcessingParam, Stats[i]);
+      Entry.Free(ProcessingParam);
+
+      MosPrintf(MIL_TEXT("%-12s %6d %9.3f %9.3f [%9.3f,%9.3f] %9.3f %9.3f %9.3f +-%6.3f\n"),
+                Entry.Name, (int)Stats[i].NbSample, Stats[i].Min, Stats[i].Median,
+                Stats[i].MedianLow, Stats[i].MedianHigh, Stats[i].P95, Stats[i].P99,
+                Stats[i].Mean, Stats[i].MeanHigh - Stats[i].Mean);
+      }
+
+   /* Save the results. */
+   SaveResultsCsv(RESULT_CSV_FILE, Stats);
+   SaveResultsJson(RESULT_JSON_FILE, NbCoresUsed, Stats);
+   MosPrintf(MIL_TEXT("\nResults were saved in %s and %s.\n\n"), RESULT_CSV_FILE, RESULT_JSON_FILE);
+
+   /* Compare with the baseline. */
+   NbRegression = CompareWithBaseline(Stats);
+   if (NbRegression > 0)
+      MosPrintf(MIL_TEXT("%d benchmark(s) regressed by more than %.1f%%.\n\n"),
+                (int)NbRegression, REGRESSION_THRESHOLD);
+   }
+
+/*****************************************************************************
+Image size sweep function. Times each registered benchmark on square images
+of increasing size, without and with multi-processing, and reports the
+speedup, the efficiency and the crossover size, the smallest size from which
+multi-processing stays faster than a single core at all the larger sizes.
+*****************************************************************************/
+void RunSizeSweep(MIL_ID MilSystem, MIL_ID MilApplication)
+   {
+   MIL_DOUBLE TimeOneCore, TimeAllCores, FPS;
+   MIL_DOUBLE Speedup, Efficiency;
+   MIL_INT    NbCoresUsed, CrossoverSize, Size, NbSize, NbSlower;
+   MIL_FILE   OutFile;
+
+   OutFile = MosFopen(SIZE_SWEEP_CSV_FILE, MIL_TEXT("w"));
+   if (OutFile)
+      MosFprintf(OutFile, MIL_TEXT("Name,Size,Cores,TimeOneCore,TimeAllCores,Speedup,Efficiency\n"));
+
+   MappControlMp(MilApplication, M_MP_USE, M_DEFAULT, M_ENABLE, M_NULL);
+   MthrInquireMp(M_DEFAULT, M_CORE_NUM_EFFECTIVE, M_DEFAULT, M_DEFAULT, &NbCoresUsed);
+   MappControlMp(MilApplication, M_MP_USE, M_DEFAULT, M_DEFAULT, M_NULL);
+
+   MosPrintf(MIL_TEXT("IMAGE SIZE SWEEP (1 CPU core vs %d CPU cores, times in ms):\n"), (int)NbCoresUsed);
+   MosPrintf(MIL_TEXT("----------------------------------------------------------\n\n"));
+
+   for (MIL_INT i = 0; i < NB_BENCHMARK; i++)
+      {
+      const BENCHMARK_ENTRY& Entry = BenchmarkList[i];
+
+      MosPrintf(MIL_TEXT("%s\n"), Entry.Name);
+      MosPrintf(MIL_TEXT("%13s %10s %10s %8s %10s\n"), MIL_TEXT("Size"), MIL_TEXT("1 core"),
+                MIL_TEXT("MP"), MIL_TEXT("Speedup"), MIL_TEXT("Efficiency"));
+
+      CrossoverSize = 0;
+      NbSize = 0;
+      NbSlower = 0;
+      for (Size = SWEEP_MIN_IMAGE_SIZE; Size <= SWEEP_MAX_IMAGE_SIZE; Size *= 2)
+         {
+         PROC_PARAM ProcessingParam = {};
+         ProcessingParam.ImageSize = Size;
+         Entry.Init(MilSystem, ProcessingParam);
+
+         MappControlMp(MilApplication, M_MP_USE, M_DEFAULT, M_DISABLE, M_NULL);
+         Benchmark(Entry, ProcessingParam, TimeOneCore, FPS, SWEEP_BENCHMARK_TIME);
+         MappControlMp(MilApplication, M_MP_USE, M_DEFAULT, M_ENABLE, M_NULL);
+         Benchmark(Entry, ProcessingParam, TimeAllCores, FPS, SWEEP_BENCHMARK_TIME);
+         MappControlMp(MilApplication, M_MP_USE, M_DEFAULT, M_DEFAULT, M_NULL);
+
+         Entry.Free(ProcessingParam);
+
+         Speedup    = TimeOneCore/TimeAllCores;
+         Efficiency = Speedup/NbCoresUsed;
+
+         /* Multi-processing must be faster from the crossover size and up. */
+         NbSize++;
+         if (Speedup < 1.0)
+            {
+            NbSlower++;
+            CrossoverSize = 0;
+            }
+         else if (CrossoverSize == 0)
+            CrossoverSize = Size;
+
+         MosPrintf(MIL_TEXT("%6dx%-6d %10.3f %10.3f %7.2fx %9.1f%%\n"), (int)Size, (int)Size,
+                   TimeOneCore, TimeAllCores, Speedup, 100.0*Efficiency);
+         if (OutFile)
+            MosFprintf(OutFile, MIL_TEXT("%s,%d,%d,%.6f,%.6f,%.4f,%.4f\n"), Entry.Name, (int)Size,
+                       (int)NbCoresUsed, TimeOneCore, TimeAllCores, Speedup, Efficiency);
+         }
+
+      if (NbSlower == 0)
+         MosPrintf(MIL_TEXT("Multi-processing is faster at all the tested sizes.\n\n"));
+      else if (NbSlower == NbSize)
+         MosPrintf(MIL_TEXT("Multi-processing is slower at all the tested sizes.\n\n"));
+      else if (CrossoverSize == 0)
+         MosPrintf(MIL_TEXT("Multi-processing is slower at the largest tested size.\n\n"));
+      else
+         MosPrintf(MIL_TEXT("Multi-processing is faster from %dx%d and up.\n\n"), (int)CrossoverSize, (int)CrossoverSize);
+      }
+
+   if (OutFile)
+      {
+      MosFclose(OutFile);
+      MosPrintf(MIL_TEXT("Results were saved in %s.\n\n"), SIZE_SWEEP_CSV_FILE);
+      }
+   }
+
+/*****************************************************************************
+Core count sweep function. Times each registered benchmark with the number
+of cores limited from 1 to the number of effective cores using M_CORE_MAX.
+On hybrid processors, the sweep is repeated while removing the performance
+levels one at a time, as done in the main function. The speedup and the
+efficiency are relative to the time without multi-processing.
+*****************************************************************************/
+void RunCoreSweep(MIL_ID MilSystem, MIL_ID MilApplication)
+   {
+   MIL_DOUBLE TimeOneCore, Time, FPS;
+   MIL_DOUBLE Speedup, Efficiency, BestSpeedup;
+   MIL_INT    NbCoresUsed, NbCores, BestNbCores;
+   MIL_INT    NbPerformanceLevel, CurrentMaxPerfLevel;
+   MIL_FILE   OutFile;
+
+   OutFile = MosFopen(CORE_SWEEP_CSV_FILE, MIL_TEXT("w"));
+   if (OutFile)
+      MosFprintf(OutFile, MIL_TEXT("Name,PerformanceLevels,Cores,TimeOneCore,Time,Speedup,Efficiency\n"));
+
+   MappInquireMp(MilApplication, M_MP_NB_PERFORMANCE_LEVEL, M_DEFAULT, M_DEFAULT, &NbPerformanceLevel);
+
+   MosPrintf(MIL_TEXT("CORE COUNT SWEEP (times in ms):\n"));
+   MosPrintf(MIL_TEXT("-------------------------------\n\n"));
+
+   for (MIL_INT i = 0; i < NB_BENCHMARK; i++)
+      {
+      const BENCHMARK_ENTRY& Entry = BenchmarkList[i];
+      PROC_PARAM ProcessingParam = {};
+
+      Entry.Init(MilSystem, ProcessingParam);
+
+      /* Reference time without multi-processing. */
+      MappControlMp(MilApplication, M_MP_USE, M_DEFAULT, M_DISABLE, M_NULL);
+      Benchmark(Entry, ProcessingParam, TimeOneCore, FPS, SWEEP_BENCHMARK_TIME);
+
+      MosPrintf(MIL_TEXT("%s (%.3f ms without multi-processing)\n"), Entry.Name, TimeOneCore);
+
+      MappControlMp(MilApplication, M_MP_USE, M_DEFAULT, M_ENABLE, M_NULL);
+      MappControlMp(MilApplication, M_MP_USE_PERFORMANCE_LEVEL, M_ALL, M_ENABLE, M_NULL);
+      for (CurrentMaxPerfLevel = NbPerformanceLevel; CurrentMaxPerfLevel > 0; CurrentMaxPerfLevel--)
+         {
+         MthrInquireMp(M_DEFAULT, M_CORE_NUM_EFFECTIVE, M_DEFAULT, M_DEFAULT, &NbCoresUsed);
+         if (NbPerformanceLevel > 1)
+            MosPrintf(MIL_TEXT("Core performance level 1 to %d:\n"), (int)CurrentMaxPerfLevel);
+         MosPrintf(MIL_TEXT("%6s %10s %8s %10s\n"), MIL_TEXT("Cores"), MIL_TEXT("Time"),
+                   MIL_TEXT("Speedup"), MIL_TEXT("Efficiency"));
+
+         BestNbCores = 1;
+         BestSpeedup = 0;
+         for (NbCores = 1; NbCores <= NbCoresUsed; NbCores++)
+            {
+            MappControlMp(MilApplication, M_CORE_MAX, M_DEFAULT, NbCores, M_NULL);
+            Benchmark(Entry, ProcessingParam, Time, FPS, SWEEP_BENCHMARK_TIME);
+
+            Speedup    = TimeOneCore/Time;
+            Efficiency = Speedup/NbCores;
+            if (Speedup > BestSpeedup)
+               {
+               BestSpeedup = Speedup;
+               BestNbCores = NbCores;
+               }
+
+            MosPrintf(MIL_TEXT("%6d %10.3f %7.2fx %9.1f%%\n"), (int)NbCores, Time, Speedup, 100.0*Efficiency);
+            if (OutFile)
+               MosFprintf(OutFile, MIL_TEXT("%s,%d,%d,%.6f,%.6f,%.4f,%.4f\n"), Entry.Name, (int)CurrentMaxPerfLevel,
+                          (int)NbCores, TimeOneCore, Time, Speedup, Efficiency);
+            }
+         MappControlMp(MilApplication, M_CORE_MAX, M_DEFAULT, M_DEFAULT, M_NULL);
+
+         MosPrintf(MIL_TEXT("Best: %d CPU cores (%.2fx).\n\n"), (int)BestNbCores, BestSpeedup);
+
+         /* Disable the last performance level. */
+         MappControlMp(MilApplication, M_MP_USE_PERFORMANCE_LEVEL, CurrentMaxPerfLevel, M_DISABLE, M_NULL);
+         }
+      MappControlMp(MilApplication, M_MP_USE_PERFORMANCE_LEVEL, M_ALL, M_DEFAULT, M_NULL);
+      MappControlMp(MilApplication, M_MP_USE, M_DEFAULT, M_DEFAULT, M_NULL);
+
+      Entry.Free(ProcessingParam);
+      }
+
+   if (OutFile)
+      {
+      MosFclose(OutFile);
+      MosPrintf(MIL_TEXT("Results were saved in %s.\n\n"), CORE_SWEEP_CSV_FILE);
+      }
+   }
+
+/*****************************************************************************
+Percentile function. Returns the interpolated percentile of sorted samples
+and the bounds of its distribution-free confidence interval, obtained from
+the normal approximation of the binomial distribution of the sample ranks.
+*****************************************************************************/
+MIL_DOUBLE Percentile(const std::vector<MIL_DOUBLE>& SortedSamples, MIL_DOUBLE Fraction,
+                      MIL_DOUBLE& Low, MIL_DOUBLE& High)
+   {
+   MIL_INT    NbSample = (MIL_INT)SortedSamples.size();
+   MIL_DOUBLE Rank = Fraction*(NbSample-1);
+   MIL_INT    RankIndex = (MIL_INT)Rank;
+   MIL_DOUBLE RankSpread = CONFIDENCE_Z*sqrt(NbSample*Fraction*(1-Fraction));
+   MIL_INT    LowIndex, HighIndex;
+   MIL_DOUBLE Value;
+
+   /* Interpolate between the two closest ranks. */
+   Value = SortedSamples[RankIndex];
+   if (RankIndex+1 < NbSample)
+      Value += (Rank-RankIndex)*(SortedSamples[RankIndex+1]-SortedSamples[RankIndex]);
+
+   /* Confidence interval bounds, clamped to the available samples. */
+   LowIndex  = (MIL_INT)floor(NbSample*Fraction - RankSpread);
+   HighIndex = (MIL_INT)ceil(NbSample*Fraction + RankSpread);
+   LowIndex  = std::min<MIL_INT>(std::max<MIL_INT>(LowIndex, 0), NbSample-1);
+   HighIndex = std::min<MIL_INT>(std::max<MIL_INT>(HighIndex, 0), NbSample-1);
+   Low  = SortedSamples[LowIndex];
+   High = SortedSamples[HighIndex];
+
+   return Value;
+   }
+
+/*****************************************************************************
+Statistics function.
+*****************************************************************************/
+void ComputeStats(std::vector<MIL_DOUBLE>& Samples, BENCHMARK_STATS& Stats)
+   {
+   MIL_INT    NbSample = (MIL_INT)Samples.size();
+   MIL_DOUBLE Sum = 0, SumSquare = 0;
+   MIL_DOUBLE Variance, HalfWidth;
+   MIL_INT n;
+
+   std::sort(Samples.begin(), Samples.end());
+
+   for (n = 0; n < NbSample; n++)
+      {
+      Sum += Samples[n];
+      SumSquare += Samples[n]*Samples[n];
+      }
+
+   Stats.NbSample = NbSample;
+   Stats.Min      = Samples[0];
+   Stats.Median   = Percentile(Samples, 0.50, Stats.MedianLow, Stats.MedianHigh);
+   Stats.P95      = Percentile(Samples, 0.95, Stats.P95Low, Stats.P95High);
+   Stats.P99      = Percentile(Samples, 0.99, Stats.P99Low, Stats.P99High);
+
+   /* Mean and its confidence interval. */
+   Variance = (NbSample > 1) ? (SumSquare - Sum*Sum/NbSample)/(NbSample-1) : 0;
+   Stats.StdDev   = (Variance > 0) ? sqrt(Variance) : 0;
+   Stats.Mean     = Sum/NbSample;
+   HalfWidth      = CONFIDENCE_Z*Stats.StdDev/sqrt((MIL_DOUBLE)NbSample);
+   Stats.MeanLow  = Stats.Mean - HalfWidth;
+   Stats.MeanHigh = Stats.Mean + HalfWidth;
+   }
+
+/*****************************************************************************
+Result file functions. The CSV file is also the baseline file format.
+*****************************************************************************/
+void SaveResultsCsv(MIL_CONST_TEXT_PTR FileName, const std::vector<BENCHMARK_STATS>& Stats)
+   {
+   MIL_FILE OutFile = MosFopen(FileName, MIL_TEXT("w"));
+   if (!OutFile)
+      {
+      MosPrintf(MIL_TEXT("Unable to write %s.\n"), FileName);
+      return;
+      }
+
+   MosFprintf(OutFile, MIL_TEXT("Name,Samples,Min,Median,MedianLow,MedianHigh,P95,P95Low,P95High,")
+                       MIL_TEXT("P99,P99Low,P99High,Mean,MeanLow,MeanHigh,StdDev\n"));
+   for (MIL_INT i = 0; i < NB_BENCHMARK; i++)
+      {
+      const BENCHMARK_STATS& S = Stats[i];
+      MosFprintf(OutFile, MIL_TEXT("%s,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n"),
+                 BenchmarkList[i].Name, (int)S.NbSample, S.Min, S.Median, S.MedianLow, S.MedianHigh,
+                 S.P95, S.P95Low, S.P95High, S.P99, S.P99Low, S.P99High,
+                 S.Mean, S.MeanLow, S.MeanHigh, S.StdDev);
+      }
+   MosFclose(OutFile);
+   }
+
+void SaveResultsJson(MIL_CONST_TEXT_PTR FileName, MIL_INT NbCoresUsed, const std::vector<BENCHMARK_STATS>& Stats)
+   {
+   MIL_FILE OutFile = MosFopen(FileName, MIL_TEXT("w"));
+   if (!OutFile)
+      {
+      MosPrintf(MIL_TEXT("Unable to write %s.\n"), FileName);
+      return;
+      }
+
+   MosFprintf(OutFile, MIL_TEXT("{\n  \"units\": \"ms\",\n  \"confidenceZ\": %.2f,\n  \"cores\": %d,\n  \"benchmarks\": [\n"),
+              CONFIDENCE_Z, (int)NbCoresUsed);
+   for (MIL_INT i = 0; i < NB_BENCHMARK; i++)
+      {
+      const BENCHMARK_STATS& S = Stats[i];
+      MosFprintf(OutFile, MIL_TEXT("    { \"name\": \"%s\", \"samples\": %d, \"min\": %.6f,\n"),
+                 BenchmarkList[i].Name, (int)S.NbSample, S.Min);
+      MosFprintf(OutFile, MIL_TEXT("      \"median\": %.6f, \"medianCI\": [%.6f, %.6f],\n"),
+                 S.Median, S.MedianLow, S.MedianHigh);
+      MosFprintf(OutFile, MIL_TEXT("      \"p95\": %.6f, \"p95CI\": [%.6f, %.6f],\n"),
+                 S.P95, S.P95Low, S.P95High);
+      MosFprintf(OutFile, MIL_TEXT("      \"p99\": %.6f, \"p99CI\": [%.6f, %.6f],\n"),
+                 S.P99, S.P99Low, S.P99High);
+      MosFprintf(OutFile, MIL_TEXT("      \"mean\": %.6f, \"meanCI\": [%.6f, %.6f], \"stdDev\": %.6f }%s\n"),
+                 S.Mean, S.MeanLow, S.MeanHigh, S.StdDev, (i+1 < NB_BENCHMARK) ? MIL_TEXT(",") : MIL_TEXT(""));
+      }
+   MosFprintf(OutFile, MIL_TEXT("  ]\n}\n"));
+   MosFclose(OutFile);
+   }
+
+bool LoadBaselineCsv(MIL_CONST_TEXT_PTR FileName, std::vector<MIL_STRING>& Names, std::vector<BENCHMARK_STATS>& Stats)
+   {
+   std::basic_ifstream<MIL_TEXT_CHAR> InFile(FileName);
+   MIL_STRING Line;
+   MIL_INT LineNumber = 1;
+
+   if (!InFile.is_open())
+      return false;
+
+   /* Skip the header line. */
+   std::getline(InFile, Line);
+
+   while (std::getline(InFile, Line))
+      {
+      LineNumber++;
+      std::vector<MIL_STRING> Fields;
+      BENCHMARK_STATS S;
+      size_t Start = 0, End;
+
+      /* Split the line on the commas. */
+      while ((End = Line.find(MIL_TEXT(','), Start)) != MIL_STRING::npos)
+         {
+         Fields.push_back(Line.substr(Start, End-Start));
+         Start = End+1;
+         }
+      Fields.push_back(Line.substr(Start));
+      if (Fields.size() < 16)
+         continue;
+
+      /* Skip the lines with a malformed number. */
+      try
+         {
+         S.NbSample   = (MIL_INT)std::stoll(Fields[1]);
+         S.Min        = std::stod(Fields[2]);
+         S.Median     = std::stod(Fields[3]);
+         S.MedianLow  = std::stod(Fields[4]);
+         S.MedianHigh = std::stod(Fields[5]);
+         S.P95        = std::stod(Fields[6]);
+         S.P95Low     = std::stod(Fields[7]);
+         S.P95High    = std::stod(Fields[8]);
+         S.P99        = std::stod(Fields[9]);
+         S.P99Low     = std::stod(Fields[10]);
+         S.P99High    = std::stod(Fields[11]);
+         S.Mean       = std::stod(Fields[12]);
+         S.MeanLow    = std::stod(Fields[13]);
+         S.MeanHigh   = std::stod(Fields[14]);
+         S.StdDev     = std::stod(Fields[15]);
+         }
+      catch (const std::logic_error&)
+         {
+         MosPrintf(MIL_TEXT("Line %d of the baseline is malformed and was skipped.\n"), (int)LineNumber);
+         continue;
+         }
+      Names.push_back(Fields[0]);
+      Stats.push_back(S);
+      }
+   return true;
+   }
+
+/*****************************************************************************
+Baseline comparison function. A benchmark regresses when its median time
+increased by more than the threshold and the confidence intervals of the
+baseline and current medians do not overlap. Returns the number of
+regressions. If there is no baseline yet, the current results become the
+baseline; delete the baseline file to take a new one.
+*****************************************************************************/
+MIL_INT CompareWithBaseline(const std::vector<BENCHMARK_STATS>& Stats)
+   {
+   std::vector<MIL_STRING>      BaselineNames;
+   std::vector<BENCHMARK_STATS> BaselineStats;
+   MIL_INT NbRegression = 0;
+
+   if (!LoadBaselineCsv(BASELINE_CSV_FILE, BaselineNames, BaselineStats))
+      {
+      SaveResultsCsv(BASELINE_CSV_FILE, Stats);
+      MosPrintf(MIL_TEXT("No baseline found. The results were saved as the baseline in\n%s.\n\n"),
+                BASELINE_CSV_FILE);
+      return 0;
+      }
+
+   MosPrintf(MIL_TEXT("COMPARISON WITH THE BASELINE (regression threshold: %.1f%%):\n"), REGRESSION_THRESHOLD);
+   MosPrintf(MIL_TEXT("-------------------------------------------------------------\n\n"));
+   MosPrintf(MIL_TEXT("%-12s %16s %16s %9s  %s\n"), MIL_TEXT("Benchmark"),
+             MIL_TEXT("Baseline median"), MIL_TEXT("Current median"), MIL_TEXT("Change"), MIL_TEXT("Status"));
+
+   for (MIL_INT i = 0; i < NB_BENCHMARK; i++)
+      {
+      const BENCHMARK_STATS& S = Stats[i];
+      MIL_CONST_TEXT_PTR Status = MIL_TEXT("not in baseline");
+      size_t b;
+
+      for (b = 0; b < BaselineNames.size(); b++)
+         {
+         if (BaselineNames[b] == BenchmarkList[i].Name)
+            break;
+         }
+      if (b == BaselineNames.size())
+         {
+         MosPrintf(MIL_TEXT("%-12s %16s %16.3f %9s  %s\n"), BenchmarkList[i].Name,
+                   MIL_TEXT("-"), S.Median, MIL_TEXT("-"), Status);
+         continue;
+         }
+
+      const BENCHMARK_STATS& B = BaselineStats[b];
+      MIL_DOUBLE Change = (B.Median > 0) ? 100.0*(S.Median - B.Median)/B.Median : 0;
+
+      if (Change > REGRESSION_THRESHOLD && S.MedianLow > B.MedianHigh)
+         {
+         Status = MIL_TEXT("REGRESSION");
+         NbRegression++;
+         }
+      else if (Change < -REGRESSION_THRESHOLD && S.MedianHigh < B.MedianLow)
+         Status = MIL_TEXT("improved");
+      else
+         Status = MIL_TEXT("ok");
+
+      MosPrintf(MIL_TEXT("%-12s %16.3f %16.3f %+8.1f%%  %s\n"), BenchmarkList[i].Name,
+                B.Median, S.Median, Change, Status);
+      }
+   MosPrintf(MIL_TEXT("\n"));
+
+   return NbRegression;
+   }
+
+/*****************************************************************************
+Processing initialization function. Allocates the source and destination
+buffers from the specified image file. If an image size is specified in the
+processing parameters, the image is resized to a square image of that size.
+*****************************************************************************/
+void ProcessingInit(MIL_ID MilSystem, MIL_CONST_TEXT_PTR FileName, PROC_PARAM& ProcParamPtr)
+   {
+   MIL_INT SizeX = MbufDiskInquire(FileName, M_SIZE_X, M_NULL);
+   MIL_INT SizeY = MbufDiskInquire(FileName, M_SIZE_Y, M_NULL);
+   MIL_ID  MilFileImage;
+
+   if (ProcParamPtr.ImageSize > 0)
+      SizeX = SizeY = ProcParamPtr.ImageSize;
+
    /* Allocate a MIL source buffer. */
    MbufAllocColor(MilSystem, 
-            MbufDiskInquire(IMAGE_FILE, M_SIZE_BAND, M_NULL),
-            MbufDiskInquire(IMAGE_FILE, M_SIZE_X, M_NULL),
-            MbufDiskInquire(IMAGE_FILE, M_SIZE_Y, M_NULL),
-            MbufDiskInquire(IMAGE_FILE, M_SIZE_BIT, M_NULL)+M_UNSIGNED,
+            MbufDiskInquire(FileName, M_SIZE_BAND, M_NULL),
+            SizeX,
+            SizeY,
+            MbufDiskInquire(FileName, M_SIZE_BIT, M_NULL)+M_UNSIGNED,
             M_IMAGE+M_PROC, &ProcParamPtr.MilSourceImage);
 
    /* Load the image into the source image. */ 
-   MbufLoad(IMAGE_FILE, ProcParamPtr.MilSourceImage);
+   if (ProcParamPtr.ImageSize > 0)
+      {
+      MbufRestore(FileName, MilSystem, &MilFileImage);
+      MimResize(MilFileImage, ProcParamPtr.MilSourceImage, M_FILL_DESTINATION, M_FILL_DESTINATION, M_BILINEAR);
+      MbufFree(MilFileImage);
+      }
+   else
+      MbufLoad(FileName, ProcParamPtr.MilSourceImage);
 
    /* Allocate a MIL destination buffer. */
    MbufAllocColor(MilSystem, 
-            MbufDiskInquire(IMAGE_FILE, M_SIZE_BAND, M_NULL),
-            MbufDiskInquire(IMAGE_FILE, M_SIZE_X, M_NULL),
-            MbufDiskInquire(IMAGE_FILE, M_SIZE_Y, M_NULL),
-            MbufDiskInquire(IMAGE_FILE, M_SIZE_BIT, M_NULL)+M_UNSIGNED,
+            MbufDiskInquire(FileName, M_SIZE_BAND, M_NULL),
+            SizeX,
+            SizeY,
+            MbufDiskInquire(FileName, M_SIZE_BIT, M_NULL)+M_UNSIGNED,
             M_IMAGE+M_PROC, &ProcParamPtr.MilDestinationImage);
    }
 
 /*****************************************************************************
-Processing execution function.
+Processing free function.
+*****************************************************************************/
+void ProcessingFree(PROC_PARAM& ProcParamPtr)
+   {
+   /* Free all processing allocations. */ 
+   if (ProcParamPtr.MilAuxiliaryBuffer)
+      MbufFree(ProcParamPtr.MilAuxiliaryBuffer);
+   MbufFree(ProcParamPtr.MilSourceImage);
+   MbufFree(ProcParamPtr.MilDestinationImage);
+   ProcParamPtr = PROC_PARAM();
+   }
+
+/*****************************************************************************
+Rotation benchmark. The initialization is shared by the benchmarks that
+only need the source and destination images.
 *****************************************************************************/
-void ProcessingExecute(PROC_PARAM& ProcParamPtr)
+void RotateInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr)
+   {
+   ProcessingInit(MilSystem, IMAGE_FILE, ProcParamPtr);
+   }
+
+void RotateExecute(PROC_PARAM& ProcParamPtr)
    {
    MimRotate(ProcParamPtr.MilSourceImage, ProcParamPtr.MilDestinationImage, ROTATE_ANGLE,
              M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT, M_BILINEAR+M_OVERSCAN_CLEAR);
    }
 
 /*****************************************************************************
-Processing free function.
+Warp benchmark (rotation about the image center using a warp matrix).
 *****************************************************************************/
-void ProcessingFree(PROC_PARAM& ProcParamPtr)
+void WarpInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr)
    {
-   /* Free all processing allocations. */ 
-   MbufFree(ProcParamPtr.MilSourceImage);
-   MbufFree(ProcParamPtr.MilDestinationImage);
+   MIL_DOUBLE CenterX, CenterY;
+
+   ProcessingInit(MilSystem, IMAGE_FILE, ProcParamPtr);
+   CenterX = MbufInquire(ProcParamPtr.MilSourceImage, M_SIZE_X, M_NULL)/2.0;
+   CenterY = MbufInquire(ProcParamPtr.MilSourceImage, M_SIZE_Y, M_NULL)/2.0;
+
+   MbufAlloc2d(MilSystem, 3, 3, 32+M_FLOAT, M_ARRAY, &ProcParamPtr.MilAuxiliaryBuffer);
+   MgenWarpParameter(M_NULL, ProcParamPtr.MilAuxiliaryBuffer, M_NULL, M_WARP_POLYNOMIAL, M_TRANSLATE, -CenterX, -CenterY);
+   MgenWarpParameter(ProcParamPtr.MilAuxiliaryBuffer, ProcParamPtr.MilAuxiliaryBuffer, M_NULL, M_WARP_POLYNOMIAL, M_ROTATE, ROTATE_ANGLE, M_NULL);
+   MgenWarpParameter(ProcParamPtr.MilAuxiliaryBuffer, ProcParamPtr.MilAuxiliaryBuffer, M_NULL, M_WARP_POLYNOMIAL, M_TRANSLATE, CenterX, CenterY);
+   }
+
+void WarpExecute(PROC_PARAM& ProcParamPtr)
+   {
+   MimWarp(ProcParamPtr.MilSourceImage, ProcParamPtr.MilDestinationImage, ProcParamPtr.MilAuxiliaryBuffer,
+           M_NULL, M_WARP_POLYNOMIAL, M_BILINEAR+M_OVERSCAN_CLEAR);
+   }
+
+/*****************************************************************************
+Convolution and morphology benchmarks.
+*****************************************************************************/
+void ConvolveExecute(PROC_PARAM& ProcParamPtr)
+   {
+   MimConvolve(ProcParamPtr.MilSourceImage, ProcParamPtr.MilDestinationImage, M_SMOOTH);
+   }
+
+void MorphologyExecute(PROC_PARAM& ProcParamPtr)
+   {
+   MimOpen(ProcParamPtr.MilSourceImage, ProcParamPtr.MilDestinationImage, MORPHOLOGY_NB_ITERATION, M_GRAYSCALE);
+   }
+
+/*****************************************************************************
+Blob analysis benchmark (binarization and blob calculation).
+*****************************************************************************/
+void BlobInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr)
+   {
+   ProcessingInit(MilSystem, IMAGE_FILE, ProcParamPtr);
+   MbufAlloc2d(MilSystem,
+               MbufInquire(ProcParamPtr.MilSourceImage, M_SIZE_X, M_NULL),
+               MbufInquire(ProcParamPtr.MilSourceImage, M_SIZE_Y, M_NULL),
+               1+M_UNSIGNED, M_IMAGE+M_PROC, &ProcParamPtr.MilAuxiliaryBuffer);
+
+   MblobAlloc(MilSystem, M_DEFAULT, M_DEFAULT, &ProcParamPtr.MilContext);
+   MblobControl(ProcParamPtr.MilContext, M_BOX, M_ENABLE);
+   MblobAllocResult(MilSystem, M_DEFAULT, M_DEFAULT, &ProcParamPtr.MilResult);
+   }
+
+void BlobExecute(PROC_PARAM& ProcParamPtr)
+   {
+   MimBinarize(ProcParamPtr.MilSourceImage, ProcParamPtr.MilAuxiliaryBuffer, M_BIMODAL+M_GREATER, M_NULL, M_NULL);
+   MblobCalculate(ProcParamPtr.MilContext, ProcParamPtr.MilAuxiliaryBuffer, M_NULL, ProcParamPtr.MilResult);
+   }
+
+void BlobFree(PROC_PARAM& ProcParamPtr)
+   {
+   MblobFree(ProcParamPtr.MilResult);
+   MblobFree(ProcParamPtr.MilContext);
+   ProcessingFree(ProcParamPtr);
+   }
+
+/*****************************************************************************
+Pattern matching benchmark (normalized grayscale correlation of a model
+taken at the center of the image).
+*****************************************************************************/
+void PatternInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr)
+   {
+   ProcessingInit(MilSystem, IMAGE_FILE, ProcParamPtr);
+
+   MpatAlloc(MilSystem, M_NORMALIZED, M_DEFAULT, &ProcParamPtr.MilContext);
+   MpatDefine(ProcParamPtr.MilContext, M_REGULAR_MODEL, ProcParamPtr.MilSourceImage,
+              (MbufInquire(ProcParamPtr.MilSourceImage, M_SIZE_X, M_NULL) - PATTERN_MODEL_SIZE)/2,
+              (MbufInquire(ProcParamPtr.MilSourceImage, M_SIZE_Y, M_NULL) - PATTERN_MODEL_SIZE)/2,
+              PATTERN_MODEL_SIZE, PATTERN_MODEL_SIZE, M_DEFAULT);
+   MpatPreprocess(ProcParamPtr.MilContext, M_DEFAULT, ProcParamPtr.MilSourceImage);
+   MpatAllocResult(MilSystem, M_DEFAULT, &ProcParamPtr.MilResult);
+   }
+
+void PatternExecute(PROC_PARAM& ProcParamPtr)
+   {
+   MpatFind(ProcParamPtr.MilContext, ProcParamPtr.MilSourceImage, ProcParamPtr.MilResult);
+   }
+
+void PatternFree(PROC_PARAM& ProcParamPtr)
+   {
+   MpatFree(ProcParamPtr.MilResult);
+   MpatFree(ProcParamPtr.MilContext);
+   ProcessingFree(ProcParamPtr);
+   }
+
+/*****************************************************************************
+Code reading benchmark (Data Matrix).
+*****************************************************************************/
+void CodeInit(MIL_ID MilSystem, PROC_PARAM& ProcParamPtr)
+   {
+   ProcessingInit(MilSystem, CODE_IMAGE_FILE, ProcParamPtr);
+
+   McodeAlloc(MilSystem, M_DEFAULT, M_DEFAULT, &ProcParamPtr.MilContext);
+   McodeModel(ProcParamPtr.MilContext, M_ADD, M_DATAMATRIX, M_NULL, M_DEFAULT, M_NULL);
+   McodeAllocResult(MilSystem, M_DEFAULT, &ProcParamPtr.MilResult);
+   }
+
+void CodeExecute(PROC_PARAM& ProcParamPtr)
+   {
+   McodeRead(ProcParamPtr.MilContext, ProcParamPtr.MilSourceImage, ProcParamPtr.MilResult);
+   }
+
+void CodeFree(PROC_PARAM& ProcParamPtr)
+   {
+   McodeFree(ProcParamPtr.MilResult);
+   McodeFree(ProcParamPtr.MilContext);
+   ProcessingFree(ProcParamPtr);
    }
@@ -8,6 +8,12 @@
 *            MIL Control Center) and select 'Generate New Trace' from the 'File' menu 
 *            before to run your MIL application.
 * 
+*            The example also records its own spans (begin/end of each processing
+*            stage, per frame and per thread) in memory, with a few tens of ns of
+*            overhead per span, and saves them as a Chrome trace-event JSON file.
+*            This file can be opened in Perfetto (ui.perfetto.dev) or in
+*            chrome://tracing on any platform, without Matrox Profiler.
+*
 * Note:      By default, all MIL applications are traceable without code modifications.
 *            You can try this using Matrox Profiler with any MIL example (Ex: MappStart).
 *
@@ -15,12 +21,52 @@
 * All Rights Reserved
 */
 #include <mil.h>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
 /* Trace related defines. */
 #define TRACE_TAG_HOOK_START                       1
 #define TRACE_TAG_PROCESSING                       2
 #define TRACE_TAG_PREPROCESSING                    3
 
+/* Span recorder defines. Each thread records its spans in its own ring buffer;
+   when the ring is full, the oldest spans are overwritten. */
+#define SPAN_TRACE_FILE                            M_TEMP_DIR MIL_TEXT("MappTrace.json")
+#define SPAN_BUFFER_SIZE                           4096   /* Power of 2. */
+#define SPAN_THREAD_NB_MAX                         16
+#define SPAN_OVERHEAD_LOOP_COUNT                   100000
+
+/* Span record: one stage of one frame on one thread, in ns. */
+typedef struct
+{
+   MIL_INT64 Begin;
+   MIL_INT64 End;
+   MIL_INT64 FrameId;
+   MIL_INT   Tag;
+} SpanRecord;
+
+/* Per-thread span ring buffer. Only its thread writes in it. */
+typedef struct
+{
+   SpanRecord             Span[SPAN_BUFFER_SIZE];
+   std::atomic<MIL_INT64> Count;
+   MIL_CONST_TEXT_PTR     ThreadName;
+} SpanThreadBuffer;
+
+static SpanThreadBuffer     SpanBufferList[SPAN_THREAD_NB_MAX];
+static std::atomic<MIL_INT> SpanThreadCount(0);
+static MIL_INT64            SpanOrigin = 0;
+
+/* Span recorder function prototypes. */
+MIL_INT64 SpanNow();
+void SpanSetThreadName(MIL_CONST_TEXT_PTR ThreadName);
+void SpanRecordSpan(MIL_INT Tag, MIL_INT64 FrameId, MIL_INT64 Begin);
+MIL_CONST_TEXT_PTR SpanTagName(MIL_INT Tag);
+MIL_DOUBLE SpanMeasureOverhead();
+bool SpanSaveChromeTrace(MIL_CONST_TEXT_PTR FileName);
+void SpanPrintStatistics();
+
 /* General defines. */
 #define COLOR_BROWN                                M_RGB888(100,65,50)
 #define BUFFERING_SIZE_MAX                         3
@@ -52,6 +98,12 @@ int MosMain(void)
    MIL_INT SizeX = 0, SizeY = 0;
 
    HookDataStruct UserHookData;
+   MIL_DOUBLE SpanOverhead = 0;
+
+   /* Start the span recorder. */
+   SpanOrigin = SpanNow();
+   SpanSetThreadName(MIL_TEXT("Main"));
+   SpanOverhead = SpanMeasureOverhead();
 
    MosPrintf(MIL_TEXT("\nMIL PROGRAM TRACING AND PROFILING:\n"));
    MosPrintf(MIL_TEXT(  "----------------------------------\n\n"));
@@ -216,6 +268,19 @@ int MosMain(void)
       MosPrintf(MIL_TEXT("ERROR: No active tracing detected in 'MIL Profiler trace' page of MILConfig!\n\n"));
 #endif
    }
+   /* Save the spans recorded by the example itself. */
+   MosPrintf(MIL_TEXT("SPANS RECORDED BY THE EXAMPLE:\n\n"));
+   MosPrintf(MIL_TEXT("Span recording overhead: %.0f ns per span.\n\n"), SpanOverhead);
+   SpanPrintStatistics();
+   if (SpanSaveChromeTrace(SPAN_TRACE_FILE))
+   {
+      MosPrintf(MIL_TEXT("\nThe spans were saved in %s.\n"), SPAN_TRACE_FILE);
+      MosPrintf(MIL_TEXT("Open this file in Perfetto (ui.perfetto.dev) or chrome://tracing\n"));
+      MosPrintf(MIL_TEXT("to see the stages of each frame and the thread overlap.\n\n"));
+   }
+   else
+      MosPrintf(MIL_TEXT("\nERROR: Unable to write %s.\n\n"), SPAN_TRACE_FILE);
+
    MosPrintf(MIL_TEXT("Press <Enter> to end."));
    MosGetch();
 
@@ -228,6 +293,11 @@ MIL_INT MFTYPE HookFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr)
    MIL_ID CurrentImage = M_NULL;
 
    HookDataStruct *UserDataPtr = (HookDataStruct *)HookDataPtr;
+   MIL_INT64 FrameId = UserDataPtr->ProcessedImageCount;
+   MIL_INT64 HookBegin = SpanNow();
+   MIL_INT64 StageBegin;
+
+   SpanSetThreadName(MIL_TEXT("MdigProcess"));
 
    /* Add a marker to indicate the reception of a new grabbed image. */
    MappTrace(M_DEFAULT,
@@ -252,11 +322,13 @@ MIL_INT MFTYPE HookFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr)
       TRACE_TAG_PREPROCESSING,
       UserDataPtr->ProcessedImageCount,
       MIL_TEXT("Start Preprocessing"));
+   StageBegin = SpanNow();
 
    /* Do the preprocessing. */
    MimConvert(CurrentImage, UserDataPtr->MilImageTemp1, M_RGB_TO_L);
    MimHistogramEqualize(UserDataPtr->MilImageTemp1, UserDataPtr->MilImageTemp1, 
       M_UNIFORM, M_NULL, 55, 200);
+   SpanRecordSpan(TRACE_TAG_PREPROCESSING, FrameId, StageBegin);
 
    /* Add a Marker to indicate the end of the preprocessing section. */
    MappTrace(M_DEFAULT,
@@ -266,12 +338,14 @@ MIL_INT MFTYPE HookFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr)
       MIL_TEXT("End Preprocessing"));
 
    /* Do the main processing. */
+   StageBegin = SpanNow();
    MimBinarize(UserDataPtr->MilImageTemp1, UserDataPtr->MilImageTemp2,
       M_IN_RANGE, 120, 140);
    MimBinarize(UserDataPtr->MilImageTemp1, UserDataPtr->MilImageTemp1,
       M_IN_RANGE, 220, 255);
    MimArith(UserDataPtr->MilImageTemp1, UserDataPtr->MilImageTemp2, 
       UserDataPtr->MilImageDisp, M_OR);
+   SpanRecordSpan(TRACE_TAG_PROCESSING, FrameId, StageBegin);
 
    /* End the Section that highlights the processing. */
    MappTrace(M_DEFAULT,
@@ -280,8 +354,168 @@ MIL_INT MFTYPE HookFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr)
       UserDataPtr->ProcessedImageCount,
       MIL_TEXT("Processing Image End"));
 
+   /* The hook span covers the frame from its reception to its result. */
+   SpanRecordSpan(TRACE_TAG_HOOK_START, FrameId, HookBegin);
+
    /* Signal that processing has been completed. */
    if (++(UserDataPtr->ProcessedImageCount) >= NUMBER_OF_FRAMES_TO_PROCESS)
       MthrControl(UserDataPtr->DoneEvent, M_EVENT_SET, M_SIGNALED);
    return 0;
 }
+
+/* Span recorder. */
+/* -------------- */
+
+/* Returns the ring buffer of the calling thread; it is assigned at the first call. */
+static SpanThreadBuffer* SpanThreadBufferGet()
+{
+   static thread_local SpanThreadBuffer* ThreadBuffer = M_NULL;
+
+   if (!ThreadBuffer)
+   {
+      MIL_INT Index = SpanThreadCount++;
+      if (Index >= SPAN_THREAD_NB_MAX)
+         return M_NULL;
+      ThreadBuffer = &SpanBufferList[Index];
+      ThreadBuffer->Count = 0;
+      ThreadBuffer->ThreadName = M_NULL;
+   }
+   return ThreadBuffer;
+}
+
+/* Returns the current time in ns. */
+MIL_INT64 SpanNow()
+{
+   return (MIL_INT64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Names the calling thread in the trace. */
+void SpanSetThreadName(MIL_CONST_TEXT_PTR ThreadName)
+{
+   SpanThreadBuffer* ThreadBuffer = SpanThreadBufferGet();
+   if (ThreadBuffer && !ThreadBuffer->ThreadName)
+      ThreadBuffer->ThreadName = ThreadName;
+}
+
+/* Records a span that started at Begin and ends now. No lock is taken: */
+/* the ring buffer belongs to the calling thread.                       */
+void SpanRecordSpan(MIL_INT Tag, MIL_INT64 FrameId, MIL_INT64 Begin)
+{
+   SpanThreadBuffer* ThreadBuffer = SpanThreadBufferGet();
+   if (!ThreadBuffer)
+      return;
+
+   MIL_INT64 Count = ThreadBuffer->Count.load(std::memory_order_relaxed);
+   SpanRecord& Span = ThreadBuffer->Span[Count & (SPAN_BUFFER_SIZE - 1)];
+   Span.Begin   = Begin;
+   Span.End     = SpanNow();
+   Span.FrameId = FrameId;
+   Span.Tag     = Tag;
+   ThreadBuffer->Count.store(Count + 1, std::memory_order_release);
+}
+
+MIL_CONST_TEXT_PTR SpanTagName(MIL_INT Tag)
+{
+   switch (Tag)
+   {
+      case TRACE_TAG_HOOK_START:    return MIL_TEXT("Grab Callback");
+      case TRACE_TAG_PROCESSING:    return MIL_TEXT("Processing");
+      case TRACE_TAG_PREPROCESSING: return MIL_TEXT("Preprocessing");
+      default:                      return MIL_TEXT("Span");
+   }
+}
+
+/* Measures the time taken to record a span, in ns, then discards the spans. */
+MIL_DOUBLE SpanMeasureOverhead()
+{
+   SpanThreadBuffer* ThreadBuffer = SpanThreadBufferGet();
+   MIL_INT64 Begin, End;
+
+   if (!ThreadBuffer)
+      return 0;
+
+   Begin = SpanNow();
+   for (MIL_INT i = 0; i < SPAN_OVERHEAD_LOOP_COUNT; i++)
+      SpanRecordSpan(TRACE_TAG_PROCESSING, i, SpanNow());
+   End = SpanNow();
+
+   ThreadBuffer->Count = 0;
+   return (MIL_DOUBLE)(End - Begin) / SPAN_OVERHEAD_LOOP_COUNT;
+}
+
+/* Saves the spans of all the threads as Chrome trace-event JSON (complete */
+/* "X" events, in us). Call it once the recording threads are stopped.    */
+bool SpanSaveChromeTrace(MIL_CONST_TEXT_PTR FileName)
+{
+   MIL_FILE TraceFile = MosFopen(FileName, MIL_TEXT("w"));
+   MIL_INT  NbThreads = std::min<MIL_INT>(SpanThreadCount, SPAN_THREAD_NB_MAX);
+   bool     FirstEvent = true;
+
+   if (!TraceFile)
+      return false;
+
+   MosFprintf(TraceFile, MIL_TEXT("{\"traceEvents\":[\n"));
+   for (MIL_INT ThreadIndex = 0; ThreadIndex < NbThreads; ThreadIndex++)
+   {
+      SpanThreadBuffer* ThreadBuffer = &SpanBufferList[ThreadIndex];
+      MIL_INT64 Count = ThreadBuffer->Count.load(std::memory_order_acquire);
+      MIL_INT64 First = (Count > SPAN_BUFFER_SIZE) ? Count - SPAN_BUFFER_SIZE : 0;
+
+      MosFprintf(TraceFile,
+         MIL_TEXT("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,")
+         MIL_TEXT("\"args\":{\"name\":\"%s\"}}"),
+         FirstEvent ? MIL_TEXT("") : MIL_TEXT(",\n"), (int)ThreadIndex,
+         ThreadBuffer->ThreadName ? ThreadBuffer->ThreadName : MIL_TEXT("Thread"));
+      FirstEvent = false;
+
+      for (MIL_INT64 i = First; i < Count; i++)
+      {
+         const SpanRecord& Span = ThreadBuffer->Span[i & (SPAN_BUFFER_SIZE - 1)];
+         MosFprintf(TraceFile,
+            MIL_TEXT(",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,")
+            MIL_TEXT("\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%lld}}"),
+            SpanTagName(Span.Tag), (int)ThreadIndex,
+            (Span.Begin - SpanOrigin) / 1000.0, (Span.End - Span.Begin) / 1000.0,
+            (long long)Span.FrameId);
+      }
+   }
+   MosFprintf(TraceFile, MIL_TEXT("\n],\"displayTimeUnit\":\"ms\"}\n"));
+   MosFclose(TraceFile);
+   return true;
+}
+
+/* Prints the count, mean and maximum duration of each kind of span. */
+void SpanPrintStatistics()
+{
+   const MIL_INT TagList[] = { TRACE_TAG_PREPROCESSING, TRACE_TAG_PROCESSING, TRACE_TAG_HOOK_START };
+   MIL_INT NbThreads = std::min<MIL_INT>(SpanThreadCount, SPAN_THREAD_NB_MAX);
+
+   for (MIL_INT TagIndex = 0; TagIndex < 3; TagIndex++)
+   {
+      MIL_INT64 NbSpans = 0;
+      MIL_DOUBLE Total = 0, Max = 0;
+
+      for (MIL_INT ThreadIndex = 0; ThreadIndex < NbThreads; ThreadIndex++)
+      {
+         SpanThreadBuffer* ThreadBuffer = &SpanBufferList[ThreadIndex];
+         MIL_INT64 Count = ThreadBuffer->Count.load(std::memory_order_acquire);
+         MIL_INT64 First = (Count > SPAN_BUFFER_SIZE) ? Count - SPAN_BUFFER_SIZE : 0;
+         for (MIL_INT64 i = First; i < Count; i++)
+         {
+            const SpanRecord& Span = ThreadBuffer->Span[i & (SPAN_BUFFER_SIZE - 1)];
+            if (Span.Tag != TagList[TagIndex])
+               continue;
+            MIL_DOUBLE Duration = (Span.End - Span.Begin) / 1.0e6;
+            NbSpans++;
+            Total += Duration;
+            if (Duration > Max)
+               Max = Duration;
+         }
+      }
+      MosPrintf(MIL_TEXT("%-14s %4d spans, mean %7.3f ms, max %7.3f ms.\n"),
+         SpanTagName(TagList[TagIndex]), (int)NbSpans,
+         NbSpans ? Total / NbSpans : 0.0, Max);
+   }
+   MosPrintf(MIL_TEXT("(The grab callback spans give the hook-to-result latency.)\n"));
+}
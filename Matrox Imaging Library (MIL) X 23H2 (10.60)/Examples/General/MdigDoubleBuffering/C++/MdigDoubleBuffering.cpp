@@ -9,6 +9,12 @@
  *            The example also uses a hook callback function to the start of frames in 
  *            order to print the index of the current frame being acquired.
  *
+ *            The double-buffering toggle can also be generalized into an N-stage
+ *            pipeline (grab -> convert -> analyze -> annotate/display). Each stage
+ *            runs in its own thread and passes frames to the next stage through a
+ *            bounded queue; a full queue blocks the stage before it (back-pressure)
+ *            up to the grab. The throughput and latency of each stage are reported.
+ *
  *     Note:  The double-buffering method is not recommended for real-time processing, 
  *            especially when the CPU usage is high. For more robust real-time behavior,
  *            use the MdigProcess() function. See MdigProcess.cpp for a complete example.
@@ -18,6 +24,7 @@
  */
 #include <mil.h>
 #include <stdlib.h>
+#include <atomic>
 
 /* Start of grab callback functions and data structure prototypes. */
 MIL_INT MFTYPE GrabStart(MIL_INT, MIL_ID, void*);
@@ -28,6 +35,104 @@ typedef struct
 
 #define STRING_LENGTH_MAX  20
 
+/* Pipeline settings. */
+#define PIPELINE_NB_FRAMES      8     /* Frames in flight in the whole pipeline.  */
+#define PIPELINE_QUEUE_SIZE     2     /* Capacity of the queue between 2 stages.  */
+#define PIPELINE_GRAB_BUFFERS   4     /* Grab buffers used by MdigProcess().      */
+#define PIPELINE_WAIT_TIMEOUT   100   /* Queue polling period, in ms.             */
+
+/* Frame passed from stage to stage. */
+typedef struct
+   {
+   MIL_ID     SrcImage;     /* Copy of the grabbed image.                      */
+   MIL_ID     MonoImage;    /* Converted monochrome image.                     */
+   MIL_ID     ResultImage;  /* Analysis result, annotated and displayed.       */
+   MIL_INT    FrameIndex;
+   MIL_DOUBLE GrabTime;     /* Time the frame entered the pipeline.            */
+   MIL_DOUBLE QueuedTime;   /* Time the frame entered its current stage queue. */
+   } PipelineFrame;
+
+/* Bounded queue of frames between two stages. There is a single producer and a
+   single consumer, so the ring itself is lock-free; the events only put the
+   stages to sleep when the queue is empty or full.
+ */
+typedef struct
+   {
+   PipelineFrame*        FramePtr[PIPELINE_NB_FRAMES];
+   MIL_UINT              Capacity;
+   std::atomic<MIL_UINT> Head;
+   std::atomic<MIL_UINT> Tail;
+   MIL_ID                NotEmptyEvent;
+   MIL_ID                NotFullEvent;
+   } FrameQueue;
+
+/* Per-stage counters. */
+typedef struct
+   {
+   MIL_INT    FrameCount;
+   MIL_DOUBLE BusyTime;     /* Time spent doing the stage's work.               */
+   MIL_DOUBLE BlockedTime;  /* Time waiting for room in the next queue.         */
+   MIL_DOUBLE LatencySum;   /* Time in the input queue plus time in the stage.  */
+   MIL_DOUBLE LatencyMax;
+   } StageStats;
+
+struct PipelineStruct;
+typedef void (*PIPELINE_STAGE_FUNCTION_PTR)(PipelineFrame* FramePtr, PipelineStruct* PipelinePtr);
+
+/* Processing stages, run in this order after the grab. Add a stage here to
+   lengthen the pipeline; each stage gets its own thread and input queue.
+ */
+void ConvertStage(PipelineFrame* FramePtr, PipelineStruct* PipelinePtr);
+void AnalyzeStage(PipelineFrame* FramePtr, PipelineStruct* PipelinePtr);
+void DisplayStage(PipelineFrame* FramePtr, PipelineStruct* PipelinePtr);
+
+typedef struct
+   {
+   const MIL_TEXT_CHAR*        Name;
+   PIPELINE_STAGE_FUNCTION_PTR Function;
+   } PipelineStageDesc;
+
+static const PipelineStageDesc ProcessingStageList[] =
+   {
+   { MIL_TEXT("Convert"),          ConvertStage },
+   { MIL_TEXT("Analyze"),          AnalyzeStage },
+   { MIL_TEXT("Annotate/display"), DisplayStage },
+   };
+#define NB_PROCESSING_STAGES ((MIL_INT)(sizeof(ProcessingStageList)/sizeof(ProcessingStageList[0])))
+
+/* Stage thread parameters. */
+typedef struct
+   {
+   PipelineStruct* PipelinePtr;
+   MIL_INT         StageIndex;
+   } StageThreadParam;
+
+/* Pipeline data. Index 0 of the statistics and done flags is the grab stage. */
+struct PipelineStruct
+   {
+   MIL_ID            MilImageDisp;
+   MIL_INT           SizeBand;
+   PipelineFrame     FrameList[PIPELINE_NB_FRAMES];
+   FrameQueue        FreeFrames;
+   FrameQueue        StageQueue[NB_PROCESSING_STAGES];
+   MIL_ID            StageThread[NB_PROCESSING_STAGES];
+   StageThreadParam  StageParam[NB_PROCESSING_STAGES];
+   StageStats        Stats[NB_PROCESSING_STAGES + 1];
+   std::atomic<bool> StageDone[NB_PROCESSING_STAGES + 1];
+   MIL_INT           GrabbedFrameCount;
+   MIL_DOUBLE        EndToEndLatencySum;
+   MIL_DOUBLE        EndToEndLatencyMax;
+   };
+
+void RunPipeline(MIL_ID MilSystem, MIL_ID MilDigitizer, MIL_ID MilImageDisp);
+MIL_INT MFTYPE PipelineGrabHook(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr);
+MIL_UINT32 MFTYPE PipelineStageThread(void* ThreadParamPtr);
+void FrameQueueAlloc(MIL_ID MilSystem, FrameQueue* QueuePtr, MIL_UINT Capacity);
+void FrameQueueFree(FrameQueue* QueuePtr);
+void FrameQueuePush(FrameQueue* QueuePtr, PipelineFrame* FramePtr, MIL_DOUBLE* BlockedTimePtr);
+bool FrameQueuePop(FrameQueue* QueuePtr, PipelineFrame** FramePtrPtr,
+                   const std::atomic<bool>* UpstreamDonePtr);
+
 
 /* Main function. */
 int MosMain(void)
@@ -59,6 +164,20 @@ int MosMain(void)
    /* Display the image buffer. */
    MdispSelect(MilDisplay, MilImageDisp);
 
+   /* Ask for the acquisition and processing structure. */
+   MosPrintf(MIL_TEXT("\nChoose the acquisition and processing structure:\n"));
+   MosPrintf(MIL_TEXT("1) Double buffering: grab and process alternate between 2 buffers.\n"));
+   MosPrintf(MIL_TEXT("2) Pipeline: %d stages, each in its own thread.\n"),
+             (int)(NB_PROCESSING_STAGES + 1));
+   if (MosGetch() == '2')
+      {
+      RunPipeline(MilSystem, MilDigitizer, MilImageDisp);
+
+      MbufFree(MilImageDisp);
+      MappFreeDefault(MilApplication, MilSystem, MilDisplay, MilDigitizer, M_NULL);
+      return 0;
+      }
+
    /* Allocate 2 grab buffers. */
    for (n = 0; n < 2; n++)
        MbufAlloc2d(MilSystem,
@@ -146,3 +265,297 @@ MIL_INT MFTYPE GrabStart(MIL_INT HookType, MIL_ID EventId, void* UserStructPtr)
 
   return(0);
 }
+
+
+/* N-stage pipelined acquisition, processing and display. */
+/* ------------------------------------------------------ */
+void RunPipeline(MIL_ID MilSystem, MIL_ID MilDigitizer, MIL_ID MilImageDisp)
+   {
+   static PipelineStruct Pipeline;
+   MIL_ID     MilGrabBufferList[PIPELINE_GRAB_BUFFERS];
+   MIL_INT    SizeX = MdigInquire(MilDigitizer, M_SIZE_X, M_NULL);
+   MIL_INT    SizeY = MdigInquire(MilDigitizer, M_SIZE_Y, M_NULL);
+   MIL_INT    n, StageIdx, FramesMissed = 0;
+   MIL_DOUBLE StartTime, EndTime, Elapsed;
+
+   Pipeline.MilImageDisp       = MilImageDisp;
+   Pipeline.SizeBand           = MdigInquire(MilDigitizer, M_SIZE_BAND, M_NULL);
+   Pipeline.GrabbedFrameCount  = 0;
+   Pipeline.EndToEndLatencySum = 0.0;
+   Pipeline.EndToEndLatencyMax = 0.0;
+
+   /* Allocate the grab buffers and the frames; all the frames start in the free queue. */
+   for (n = 0; n < PIPELINE_GRAB_BUFFERS; n++)
+      MbufAllocColor(MilSystem, Pipeline.SizeBand, SizeX, SizeY, 8L+M_UNSIGNED,
+                     M_IMAGE + M_GRAB + M_PROC, &MilGrabBufferList[n]);
+
+   FrameQueueAlloc(MilSystem, &Pipeline.FreeFrames, PIPELINE_NB_FRAMES);
+   for (n = 0; n < PIPELINE_NB_FRAMES; n++)
+      {
+      PipelineFrame* FramePtr = &Pipeline.FrameList[n];
+      MbufAllocColor(MilSystem, Pipeline.SizeBand, SizeX, SizeY, 8L+M_UNSIGNED,
+                     M_IMAGE + M_PROC, &FramePtr->SrcImage);
+      MbufAlloc2d(MilSystem, SizeX, SizeY, 8L+M_UNSIGNED, M_IMAGE + M_PROC, &FramePtr->MonoImage);
+      MbufAlloc2d(MilSystem, SizeX, SizeY, 8L+M_UNSIGNED, M_IMAGE + M_PROC, &FramePtr->ResultImage);
+      FrameQueuePush(&Pipeline.FreeFrames, FramePtr, M_NULL);
+      }
+
+   /* Allocate the stage queues and start one thread per processing stage. */
+   for (StageIdx = 0; StageIdx <= NB_PROCESSING_STAGES; StageIdx++)
+      {
+      Pipeline.Stats[StageIdx].FrameCount  = 0;
+      Pipeline.Stats[StageIdx].BusyTime    = 0.0;
+      Pipeline.Stats[StageIdx].BlockedTime = 0.0;
+      Pipeline.Stats[StageIdx].LatencySum  = 0.0;
+      Pipeline.Stats[StageIdx].LatencyMax  = 0.0;
+      Pipeline.StageDone[StageIdx]         = false;
+      }
+   for (StageIdx = 0; StageIdx < NB_PROCESSING_STAGES; StageIdx++)
+      {
+      FrameQueueAlloc(MilSystem, &Pipeline.StageQueue[StageIdx], PIPELINE_QUEUE_SIZE);
+      Pipeline.StageParam[StageIdx].PipelinePtr = &Pipeline;
+      Pipeline.StageParam[StageIdx].StageIndex  = StageIdx;
+      MthrAlloc(MilSystem, M_THREAD, M_DEFAULT, &PipelineStageThread,
+                &Pipeline.StageParam[StageIdx], &Pipeline.StageThread[StageIdx]);
+      }
+
+   /* Print a message. */
+   MosPrintf(MIL_TEXT("\nPIPELINED ACQUISITION AND PROCESSING:\n"));
+   MosPrintf(MIL_TEXT("-------------------------------------\n\n"));
+   MosPrintf(MIL_TEXT("Grab"));
+   for (StageIdx = 0; StageIdx < NB_PROCESSING_STAGES; StageIdx++)
+      MosPrintf(MIL_TEXT(" -> %s"), ProcessingStageList[StageIdx].Name);
+   MosPrintf(MIL_TEXT("\n\nPress <Enter> to stop.\n\n"));
+
+   /* The grab stage is the MdigProcess() hook; it blocks when no frame is free, */
+   /* which lets the grab queue absorb the back-pressure.                      */
+   MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+   MdigProcess(MilDigitizer, MilGrabBufferList, PIPELINE_GRAB_BUFFERS,
+               M_START, M_DEFAULT, PipelineGrabHook, &Pipeline);
+
+   while (!MosKbhit())
+      {
+      MosPrintf(MIL_TEXT("Frames grabbed: %d, displayed: %d.\r"),
+                (int)Pipeline.Stats[0].FrameCount,
+                (int)Pipeline.Stats[NB_PROCESSING_STAGES].FrameCount);
+      MosSleep(200);
+      }
+   MosGetch();
+
+   /* Stop the grab, then let each stage empty its queue and exit. */
+   MdigProcess(MilDigitizer, MilGrabBufferList, PIPELINE_GRAB_BUFFERS,
+               M_STOP + M_WAIT, M_DEFAULT, PipelineGrabHook, &Pipeline);
+   MdigInquire(MilDigitizer, M_PROCESS_FRAME_MISSED, &FramesMissed);
+   Pipeline.StageDone[0] = true;
+   for (StageIdx = 0; StageIdx < NB_PROCESSING_STAGES; StageIdx++)
+      MthrWait(Pipeline.StageThread[StageIdx], M_THREAD_END_WAIT, M_NULL);
+   MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+   Elapsed = EndTime - StartTime;
+
+   /* Print statistics. */
+   MosPrintf(MIL_TEXT("\n\n%d frames processed in %.2f s (%d frames missed by the grab).\n\n"),
+             (int)Pipeline.Stats[NB_PROCESSING_STAGES].FrameCount, Elapsed, (int)FramesMissed);
+   MosPrintf(MIL_TEXT("Stage              Frames   Frames/s   Busy(ms)   Latency(ms)   Max(ms)   Blocked\n"));
+   for (StageIdx = 0; StageIdx <= NB_PROCESSING_STAGES; StageIdx++)
+      {
+      const StageStats* StatsPtr = &Pipeline.Stats[StageIdx];
+      MIL_INT Count = StatsPtr->FrameCount ? StatsPtr->FrameCount : 1;
+      MosPrintf(MIL_TEXT("%-17s %7d %10.1f %10.2f %13.2f %9.2f %8.1f%%\n"),
+                StageIdx ? ProcessingStageList[StageIdx-1].Name : MIL_TEXT("Grab"),
+                (int)StatsPtr->FrameCount, StatsPtr->FrameCount / Elapsed,
+                1000.0 * StatsPtr->BusyTime / Count, 1000.0 * StatsPtr->LatencySum / Count,
+                1000.0 * StatsPtr->LatencyMax, 100.0 * StatsPtr->BlockedTime / Elapsed);
+      }
+   MosPrintf(MIL_TEXT("\nGrab-to-display latency: %.2f ms mean, %.2f ms max.\n"),
+             1000.0 * Pipeline.EndToEndLatencySum /
+                (Pipeline.Stats[NB_PROCESSING_STAGES].FrameCount ?
+                 Pipeline.Stats[NB_PROCESSING_STAGES].FrameCount : 1),
+             1000.0 * Pipeline.EndToEndLatencyMax);
+   MosPrintf(MIL_TEXT("Press <Enter> to end.\n\n"));
+   MosGetch();
+
+   /* Free allocations. */
+   for (StageIdx = 0; StageIdx < NB_PROCESSING_STAGES; StageIdx++)
+      {
+      MthrFree(Pipeline.StageThread[StageIdx]);
+      FrameQueueFree(&Pipeline.StageQueue[StageIdx]);
+      }
+   FrameQueueFree(&Pipeline.FreeFrames);
+   for (n = 0; n < PIPELINE_NB_FRAMES; n++)
+      {
+      MbufFree(Pipeline.FrameList[n].ResultImage);
+      MbufFree(Pipeline.FrameList[n].MonoImage);
+      MbufFree(Pipeline.FrameList[n].SrcImage);
+      }
+   for (n = 0; n < PIPELINE_GRAB_BUFFERS; n++)
+      MbufFree(MilGrabBufferList[n]);
+   }
+
+/* Grab stage: copies each grabbed image into a free frame and queues it. */
+MIL_INT MFTYPE PipelineGrabHook(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr)
+   {
+   PipelineStruct* PipelinePtr = (PipelineStruct*)HookDataPtr;
+   StageStats*     StatsPtr    = &PipelinePtr->Stats[0];
+   PipelineFrame*  FramePtr;
+   MIL_ID          ModifiedBufferId;
+   MIL_DOUBLE      GrabTime, StartTime, EndTime;
+
+   MappTimer(M_DEFAULT, M_TIMER_READ, &GrabTime);
+   MdigGetHookInfo(HookId, M_MODIFIED_BUFFER+M_BUFFER_ID, &ModifiedBufferId);
+
+   /* Wait for a free frame; the time spent waiting is back-pressure. */
+   FrameQueuePop(&PipelinePtr->FreeFrames, &FramePtr, M_NULL);
+   MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+   StatsPtr->BlockedTime += StartTime - GrabTime;
+
+   MbufCopy(ModifiedBufferId, FramePtr->SrcImage);
+   FramePtr->FrameIndex = ++PipelinePtr->GrabbedFrameCount;
+   FramePtr->GrabTime   = GrabTime;
+
+   MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+   StatsPtr->FrameCount++;
+   StatsPtr->BusyTime   += EndTime - StartTime;
+   StatsPtr->LatencySum += EndTime - GrabTime;
+   if (EndTime - GrabTime > StatsPtr->LatencyMax)
+      StatsPtr->LatencyMax = EndTime - GrabTime;
+
+   FrameQueuePush(&PipelinePtr->StageQueue[0], FramePtr, &StatsPtr->BlockedTime);
+   return 0;
+   }
+
+/* Processing stage thread: runs its stage on each frame and passes it on. */
+MIL_UINT32 MFTYPE PipelineStageThread(void* ThreadParamPtr)
+   {
+   StageThreadParam* ParamPtr    = (StageThreadParam*)ThreadParamPtr;
+   PipelineStruct*   PipelinePtr = ParamPtr->PipelinePtr;
+   MIL_INT           StageIdx    = ParamPtr->StageIndex;
+   StageStats*       StatsPtr    = &PipelinePtr->Stats[StageIdx + 1];
+   bool              LastStage   = (StageIdx == NB_PROCESSING_STAGES - 1);
+   PipelineFrame*    FramePtr;
+   MIL_DOUBLE        StartTime, EndTime;
+
+   /* Run until the previous stage is done and the input queue is empty. */
+   while (FrameQueuePop(&PipelinePtr->StageQueue[StageIdx], &FramePtr,
+                        &PipelinePtr->StageDone[StageIdx]))
+      {
+      MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+      ProcessingStageList[StageIdx].Function(FramePtr, PipelinePtr);
+      MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+      MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+
+      StatsPtr->FrameCount++;
+      StatsPtr->BusyTime   += EndTime - StartTime;
+      StatsPtr->LatencySum += EndTime - FramePtr->QueuedTime;
+      if (EndTime - FramePtr->QueuedTime > StatsPtr->LatencyMax)
+         StatsPtr->LatencyMax = EndTime - FramePtr->QueuedTime;
+
+      if (LastStage)
+         {
+         /* The frame is done; measure its end-to-end latency and recycle it. */
+         PipelinePtr->EndToEndLatencySum += EndTime - FramePtr->GrabTime;
+         if (EndTime - FramePtr->GrabTime > PipelinePtr->EndToEndLatencyMax)
+            PipelinePtr->EndToEndLatencyMax = EndTime - FramePtr->GrabTime;
+         FrameQueuePush(&PipelinePtr->FreeFrames, FramePtr, M_NULL);
+         }
+      else
+         FrameQueuePush(&PipelinePtr->StageQueue[StageIdx + 1], FramePtr, &StatsPtr->BlockedTime);
+      }
+
+   /* Tell the next stage that no more frames will come. */
+   PipelinePtr->StageDone[StageIdx + 1] = true;
+   if (!LastStage)
+      MthrControl(PipelinePtr->StageQueue[StageIdx + 1].NotEmptyEvent, M_EVENT_SET, M_SIGNALED);
+
+   return 0;
+   }
+
+/* Convert stage: brings the grabbed image to monochrome. */
+void ConvertStage(PipelineFrame* FramePtr, PipelineStruct* PipelinePtr)
+   {
+   if (PipelinePtr->SizeBand == 3)
+      MimConvert(FramePtr->SrcImage, FramePtr->MonoImage, M_RGB_TO_L);
+   else
+      MbufCopy(FramePtr->SrcImage, FramePtr->MonoImage);
+   }
+
+/* Analyze stage: the processing of the double-buffering loop. */
+void AnalyzeStage(PipelineFrame* FramePtr, PipelineStruct* PipelinePtr)
+   {
+   MimArith(FramePtr->MonoImage, M_NULL, FramePtr->ResultImage, M_NOT);
+   }
+
+/* Annotate/display stage: writes the frame counter and updates the display. */
+void DisplayStage(PipelineFrame* FramePtr, PipelineStruct* PipelinePtr)
+   {
+   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX];
+
+   MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%ld"), (long)FramePtr->FrameIndex);
+   MgraText(M_DEFAULT, FramePtr->ResultImage, 32, 32, Text);
+   MbufCopy(FramePtr->ResultImage, PipelinePtr->MilImageDisp);
+   }
+
+/* Frame queue functions. */
+void FrameQueueAlloc(MIL_ID MilSystem, FrameQueue* QueuePtr, MIL_UINT Capacity)
+   {
+   QueuePtr->Capacity = Capacity;
+   QueuePtr->Head     = 0;
+   QueuePtr->Tail     = 0;
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL,
+             &QueuePtr->NotEmptyEvent);
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL,
+             &QueuePtr->NotFullEvent);
+   }
+
+void FrameQueueFree(FrameQueue* QueuePtr)
+   {
+   MthrFree(QueuePtr->NotEmptyEvent);
+   MthrFree(QueuePtr->NotFullEvent);
+   }
+
+/* Push a frame, waiting while the queue is full. */
+void FrameQueuePush(FrameQueue* QueuePtr, PipelineFrame* FramePtr, MIL_DOUBLE* BlockedTimePtr)
+   {
+   MIL_UINT Head = QueuePtr->Head.load(std::memory_order_relaxed);
+   MIL_DOUBLE StartTime = 0, EndTime;
+
+   if (BlockedTimePtr)
+      MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+
+   while (Head - QueuePtr->Tail.load(std::memory_order_acquire) >= QueuePtr->Capacity)
+      MthrWait(QueuePtr->NotFullEvent, M_EVENT_WAIT+M_EVENT_TIMEOUT(PIPELINE_WAIT_TIMEOUT), M_NULL);
+
+   MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+   if (BlockedTimePtr)
+      *BlockedTimePtr += EndTime - StartTime;
+
+   FramePtr->QueuedTime = EndTime;
+   QueuePtr->FramePtr[Head % QueuePtr->Capacity] = FramePtr;
+   QueuePtr->Head.store(Head + 1, std::memory_order_release);
+   MthrControl(QueuePtr->NotEmptyEvent, M_EVENT_SET, M_SIGNALED);
+   }
+
+/* Pop a frame, waiting while the queue is empty. Returns false once the */
+/* queue is empty and the upstream stage is done.                        */
+bool FrameQueuePop(FrameQueue* QueuePtr, PipelineFrame** FramePtrPtr,
+                   const std::atomic<bool>* UpstreamDonePtr)
+   {
+   MIL_UINT Tail = QueuePtr->Tail.load(std::memory_order_relaxed);
+
+   while (Tail == QueuePtr->Head.load(std::memory_order_acquire))
+      {
+      /* Check the queue again after seeing the done flag, since the last */
+      /* frame may have been pushed just before the flag was set.         */
+      if (UpstreamDonePtr && *UpstreamDonePtr)
+         {
+         if (Tail == QueuePtr->Head.load(std::memory_order_acquire))
+            return false;
+         break;
+         }
+      MthrWait(QueuePtr->NotEmptyEvent, M_EVENT_WAIT+M_EVENT_TIMEOUT(PIPELINE_WAIT_TIMEOUT), M_NULL);
+      }
+
+   *FramePtrPtr = QueuePtr->FramePtr[Tail % QueuePtr->Capacity];
+   QueuePtr->Tail.store(Tail + 1, std::memory_order_release);
+   MthrControl(QueuePtr->NotFullEvent, M_EVENT_SET, M_SIGNALED);
+   return true;
+   }
@@ -6,6 +6,12 @@
  *            real time. the acquisition can be done in memory only or to 
  *            an AVI file. 
  *
+ *            A "black box" mode is also available: the last seconds of
+ *            uncompressed frames are kept in a pre-allocated, memory-mapped ring
+ *            file. The grab hook only copies each frame into its ring slot, and
+ *            a dedicated I/O thread writes the slots to disk in batches. When a
+ *            reject occurs, the ring is frozen and exported to an AVI file.
+ *
  * NOTE:      This example assumes that the hard disk is sufficiently fast 
  *            to keep up with the grab. Also, removing the sequence display or 
  *            the text annotation while grabbing will reduce the CPU usage and
@@ -17,6 +23,14 @@
  * All Rights Reserved
  */
 #include <mil.h>
+#include <atomic>
+#if M_MIL_USE_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 /* Sequence file name.*/
 #define SEQUENCE_FILE M_TEMP_DIR MIL_TEXT("MilSequence.avi")
@@ -32,6 +46,65 @@
 /* Maximum number of images for the multiple buffering grab. */
 #define NB_GRAB_IMAGE_MAX 20
 
+/* Black box ring recorder settings. */
+#define RING_FILE                M_TEMP_DIR MIL_TEXT("MilBlackBox.raw")
+#define RING_DURATION            10.0     /* Seconds of frames kept in the ring.   */
+#define RING_DEFAULT_FRAME_RATE  30.0     /* Used if the frame rate is unknown.    */
+#define RING_SIZE_BYTE_MAX       ((MIL_INT64)8 << 30)
+#define RING_ALIGNMENT           4096     /* Slot alignment in the file, in bytes. */
+#define RING_FLUSH_BATCH         8        /* Frames per write on the I/O thread.   */
+#define RING_WAIT_TIMEOUT        100      /* I/O thread polling period, in ms.     */
+
+/* Ring file header, stored in the first RING_ALIGNMENT bytes of the file so
+   that the ring can also be recovered offline.
+ */
+typedef struct
+   {
+   MIL_INT64  SizeBand;
+   MIL_INT64  SizeX;
+   MIL_INT64  SizeY;
+   MIL_INT64  SlotSize;
+   MIL_INT64  NbSlots;
+   MIL_INT64  WrittenFrameCount;
+   } RingFileHeader;
+
+/* Header at the start of each slot; the frame data follows at RING_SLOT_DATA_OFFSET. */
+typedef struct
+   {
+   MIL_INT64  FrameIndex;
+   MIL_DOUBLE TimeStamp;
+   } RingSlotHeader;
+#define RING_SLOT_DATA_OFFSET    64
+
+/* Black box ring recorder. */
+typedef struct
+   {
+   MIL_UINT8*             MappedPtr;
+   MIL_INT64              FileSize;
+   MIL_INT64              SlotSize;
+   MIL_INT64              FrameSize;
+   MIL_INT64              NbSlots;
+   MIL_INT64              SizeBand, SizeX, SizeY;
+   std::atomic<MIL_INT64> WrittenFrameCount;  /* Frames copied by the grab hook.   */
+   MIL_INT64              FlushedFrameCount;  /* Frames written by the I/O thread. */
+   std::atomic<bool>      Frozen;
+   std::atomic<bool>      Exit;
+   MIL_ID                 IoThread;
+   MIL_ID                 FramesReadyEvent;
+#if M_MIL_USE_WINDOWS
+   HANDLE                 FileHandle;
+   HANDLE                 MappingHandle;
+#else
+   int                    FileDescriptor;
+#endif
+   } RingRecorderStruct;
+
+bool RingRecorderAlloc(MIL_ID MilSystem, MIL_ID MilDigitizer, RingRecorderStruct* RingPtr);
+void RingRecorderFree(RingRecorderStruct* RingPtr);
+void RingRecorderWrite(RingRecorderStruct* RingPtr, MIL_ID ImageId, MIL_DOUBLE TimeStamp);
+MIL_INT RingRecorderExport(MIL_ID MilSystem, RingRecorderStruct* RingPtr, MIL_DOUBLE FrameRate);
+MIL_UINT32 MFTYPE RingRecorderIoThread(void* RingRecorderPtr);
+
 /* User's record hook function prototype (called for every grabbed frame). */
 MIL_INT MFTYPE RecordFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr);
 
@@ -44,6 +117,7 @@ typedef struct
    MIL_ID MilCompressedImage;
    MIL_INT NbGrabbedFrames;
    MIL_INT SaveSequenceToDisk;
+   RingRecorderStruct* RingRecorderPtr;
    } HookDataStruct;
 
 
@@ -59,6 +133,8 @@ int MosMain(void)
    MIL_INT    FrameCount=0, FrameMissed=0, NbFramesReplayed=0, Exit=0;
    MIL_DOUBLE FrameRate=0,  TimeWait=0,    TotalReplay=0;
    MIL_INT    SaveSequenceToDisk = M_NO;
+   bool       RecordToRingFile = false;
+   RingRecorderStruct RingRecorder;
    HookDataStruct UserHookData;   
 
    /* Allocate defaults. */
@@ -97,6 +173,8 @@ int MosMain(void)
       if(LicenseModules & M_LICENSE_JPEG2000)
          MosPrintf(MIL_TEXT("4) Compressed lossy JPEG2000 images to an AVI file.\n"));
       }
+   MosPrintf(MIL_TEXT("5) Black box: the last %.0f seconds of uncompressed images to a ring file.\n"),
+             RING_DURATION);
    
    bool ValidSelection = false;
    /* Set the buffer attribute. */
@@ -131,6 +209,13 @@ int MosMain(void)
             SaveSequenceToDisk = M_YES;
             break;
 
+         case '5':
+            MosPrintf(MIL_TEXT("\nBlack box ring file selected.\n"));
+            CompressAttribute = M_NULL;
+            SaveSequenceToDisk = M_NO;
+            RecordToRingFile = true;
+            break;
+
          default:
             MosPrintf(MIL_TEXT("\nInvalid selection !.\n"));
             ValidSelection = false;
@@ -174,8 +259,21 @@ int MosMain(void)
    /* Halt continuous grab. */
    MdigHalt(MilDigitizer);
 
+   /* If the frames must be kept in the black box ring file. */
+   if (RecordToRingFile)
+       {
+       RecordToRingFile = RingRecorderAlloc(MilSystem, MilDigitizer, &RingRecorder);
+       if (!RecordToRingFile)
+          MosPrintf(MIL_TEXT("\nUnable to create the ring file, saving to memory instead.\n\n"));
+       }
+
    /* If the sequence must be saved to disk. */
-   if (SaveSequenceToDisk)
+   if (RecordToRingFile)
+       {
+       MosPrintf(MIL_TEXT("\nRecording %d frames (%.1f MB) in the ring file...\n"),
+                 (int)RingRecorder.NbSlots, RingRecorder.FileSize / 1.0e6);
+       }
+   else if (SaveSequenceToDisk)
        {
        /* Open the AVI file if required. */
        MosPrintf(MIL_TEXT("\nSaving the sequence to an AVI file...\n"));
@@ -191,17 +289,26 @@ int MosMain(void)
    UserHookData.MilCompressedImage  = MilCompressedImage;
    UserHookData.SaveSequenceToDisk  = SaveSequenceToDisk;
    UserHookData.NbGrabbedFrames     = 0;
+   UserHookData.RingRecorderPtr     = RecordToRingFile ? &RingRecorder : M_NULL;
 
    /* Acquire the sequence. The processing hook function will
       be called for each image grabbed to record and display it. 
       If sequence is not saved to disk, stop after NbFrames.
    */
    MdigProcess(MilDigitizer, MilGrabImages, NbFrames, 
-               SaveSequenceToDisk ? M_START : M_SEQUENCE, 
+               (SaveSequenceToDisk || RecordToRingFile) ? M_START : M_SEQUENCE, 
                M_DEFAULT, RecordFunction, &UserHookData);
 
    /* Wait for a key press. */
-   if (SaveSequenceToDisk)
+   if (RecordToRingFile)
+      {
+      MosPrintf(MIL_TEXT("\nPress <Enter> to simulate a reject and freeze the ring.\n\n"));
+      MosGetch();
+
+      /* Freeze the ring: the following frames are no longer recorded. */
+      RingRecorder.Frozen = true;
+      }
+   else if (SaveSequenceToDisk)
       {
       MosPrintf(MIL_TEXT("\nPress <Enter> to stop recording.\n\n"));
       MosGetch();
@@ -230,6 +337,16 @@ int MosMain(void)
    if (SaveSequenceToDisk)
        MbufExportSequence(SEQUENCE_FILE, M_DEFAULT, M_NULL, M_NULL, FrameRate, M_CLOSE);
 
+   /* Export the frozen ring to an AVI file, then play it back from that file. */
+   if (RecordToRingFile)
+       {
+       MosPrintf(MIL_TEXT("Exporting the frozen ring to an AVI file...\n"));
+       UserHookData.NbGrabbedFrames = RingRecorderExport(MilSystem, &RingRecorder, FrameRate);
+       MosPrintf(MIL_TEXT("%d frames exported.\n\n"), (int)UserHookData.NbGrabbedFrames);
+       RingRecorderFree(&RingRecorder);
+       SaveSequenceToDisk = M_YES;
+       }
+
    /* Wait for a key to playback. */
    MosPrintf(MIL_TEXT("Press <Enter> to start the sequence playback.\n"));
    MosGetch();
@@ -357,6 +474,14 @@ MIL_INT MFTYPE RecordFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr
    /* Copy the new grabbed image to the display. */
    MbufCopy(ModifiedImage, UserHookDataPtr->MilImageDisp);
 
+   /* Copy the new image in the black box ring. */
+   if (UserHookDataPtr->RingRecorderPtr)
+      {
+      MIL_DOUBLE TimeStamp = 0;
+      MdigGetHookInfo(HookId, M_TIME_STAMP, &TimeStamp);
+      RingRecorderWrite(UserHookDataPtr->RingRecorderPtr, ModifiedImage, TimeStamp);
+      }
+
    /* Compress the new image if required. */
    if (UserHookDataPtr->MilCompressedImage)
       {
@@ -373,3 +498,247 @@ MIL_INT MFTYPE RecordFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr
 
    return 0;
    }
+
+
+/* Black box ring recorder. */
+/* ------------------------ */
+
+/* Round a size up to the ring alignment. */
+static MIL_INT64 RingAlign(MIL_INT64 Size)
+   {
+   return ((Size + RING_ALIGNMENT - 1) / RING_ALIGNMENT) * RING_ALIGNMENT;
+   }
+
+/* Create the ring file at its final size, map it and start the I/O thread. */
+bool RingRecorderAlloc(MIL_ID MilSystem, MIL_ID MilDigitizer, RingRecorderStruct* RingPtr)
+   {
+   MIL_DOUBLE FrameRate = 0;
+   RingFileHeader* HeaderPtr;
+
+   RingPtr->SizeBand  = MdigInquire(MilDigitizer, M_SIZE_BAND, M_NULL);
+   RingPtr->SizeX     = MdigInquire(MilDigitizer, M_SIZE_X, M_NULL);
+   RingPtr->SizeY     = MdigInquire(MilDigitizer, M_SIZE_Y, M_NULL);
+   RingPtr->FrameSize = RingPtr->SizeBand * RingPtr->SizeX * RingPtr->SizeY;
+   RingPtr->SlotSize  = RingAlign(RING_SLOT_DATA_OFFSET + RingPtr->FrameSize);
+
+   /* Keep RING_DURATION seconds of frames, within the maximum file size. */
+   MdigInquire(MilDigitizer, M_SELECTED_FRAME_RATE, &FrameRate);
+   if (FrameRate <= 0)
+      FrameRate = RING_DEFAULT_FRAME_RATE;
+   RingPtr->NbSlots = (MIL_INT64)(RING_DURATION * FrameRate + 0.5);
+   if (RingPtr->NbSlots * RingPtr->SlotSize > RING_SIZE_BYTE_MAX)
+      RingPtr->NbSlots = RING_SIZE_BYTE_MAX / RingPtr->SlotSize;
+   if (RingPtr->NbSlots < RING_FLUSH_BATCH)
+      RingPtr->NbSlots = RING_FLUSH_BATCH;
+   RingPtr->FileSize = RING_ALIGNMENT + RingPtr->NbSlots * RingPtr->SlotSize;
+
+   /* Pre-allocate the whole file so that the disk blocks are not allocated */
+   /* during the capture, then map it. On failure, the file is deleted.     */
+#if M_MIL_USE_WINDOWS
+   LARGE_INTEGER FileSize;
+   FileSize.QuadPart = RingPtr->FileSize;
+   RingPtr->FileHandle = CreateFile(RING_FILE, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                                    CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (RingPtr->FileHandle == INVALID_HANDLE_VALUE)
+      return false;
+   if (!SetFilePointerEx(RingPtr->FileHandle, FileSize, NULL, FILE_BEGIN) ||
+       !SetEndOfFile(RingPtr->FileHandle))
+      {
+      CloseHandle(RingPtr->FileHandle);
+      MappFileOperation(M_DEFAULT, RING_FILE, M_NULL, M_NULL, M_FILE_DELETE, M_DEFAULT, M_NULL);
+      return false;
+      }
+   RingPtr->MappingHandle = CreateFileMapping(RingPtr->FileHandle, NULL, PAGE_READWRITE,
+                                              FileSize.HighPart, FileSize.LowPart, NULL);
+   RingPtr->MappedPtr = RingPtr->MappingHandle ?
+      (MIL_UINT8*)MapViewOfFile(RingPtr->MappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0) : NULL;
+   if (!RingPtr->MappedPtr)
+      {
+      if (RingPtr->MappingHandle)
+         CloseHandle(RingPtr->MappingHandle);
+      CloseHandle(RingPtr->FileHandle);
+      MappFileOperation(M_DEFAULT, RING_FILE, M_NULL, M_NULL, M_FILE_DELETE, M_DEFAULT, M_NULL);
+      return false;
+      }
+#else
+   RingPtr->FileDescriptor = open(RING_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (RingPtr->FileDescriptor < 0)
+      return false;
+   if (posix_fallocate(RingPtr->FileDescriptor, 0, (off_t)RingPtr->FileSize) != 0)
+      {
+      close(RingPtr->FileDescriptor);
+      MappFileOperation(M_DEFAULT, RING_FILE, M_NULL, M_NULL, M_FILE_DELETE, M_DEFAULT, M_NULL);
+      return false;
+      }
+   void* MappedPtr = mmap(NULL, (size_t)RingPtr->FileSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, RingPtr->FileDescriptor, 0);
+   if (MappedPtr == MAP_FAILED)
+      {
+      close(RingPtr->FileDescriptor);
+      MappFileOperation(M_DEFAULT, RING_FILE, M_NULL, M_NULL, M_FILE_DELETE, M_DEFAULT, M_NULL);
+      return false;
+      }
+   RingPtr->MappedPtr = (MIL_UINT8*)MappedPtr;
+   madvise(MappedPtr, (size_t)RingPtr->FileSize, MADV_SEQUENTIAL);
+#endif
+
+   /* Write the file header. */
+   HeaderPtr = (RingFileHeader*)RingPtr->MappedPtr;
+   HeaderPtr->SizeBand          = RingPtr->SizeBand;
+   HeaderPtr->SizeX             = RingPtr->SizeX;
+   HeaderPtr->SizeY             = RingPtr->SizeY;
+   HeaderPtr->SlotSize          = RingPtr->SlotSize;
+   HeaderPtr->NbSlots           = RingPtr->NbSlots;
+   HeaderPtr->WrittenFrameCount = 0;
+
+   RingPtr->WrittenFrameCount = 0;
+   RingPtr->FlushedFrameCount = 0;
+   RingPtr->Frozen            = false;
+   RingPtr->Exit              = false;
+
+   /* Start the I/O thread. */
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL,
+             &RingPtr->FramesReadyEvent);
+   MthrAlloc(MilSystem, M_THREAD, M_DEFAULT, &RingRecorderIoThread, RingPtr,
+             &RingPtr->IoThread);
+   return true;
+   }
+
+/* Called from the grab hook: copy the frame in its slot and hand it off. */
+void RingRecorderWrite(RingRecorderStruct* RingPtr, MIL_ID ImageId, MIL_DOUBLE TimeStamp)
+   {
+   if (RingPtr->Frozen)
+      return;
+
+   MIL_INT64 FrameIndex = RingPtr->WrittenFrameCount.load(std::memory_order_relaxed);
+   MIL_UINT8* SlotPtr = RingPtr->MappedPtr + RING_ALIGNMENT +
+                        (FrameIndex % RingPtr->NbSlots) * RingPtr->SlotSize;
+   RingSlotHeader* SlotHeaderPtr = (RingSlotHeader*)SlotPtr;
+
+   SlotHeaderPtr->FrameIndex = FrameIndex;
+   SlotHeaderPtr->TimeStamp  = TimeStamp;
+   MbufGet(ImageId, SlotPtr + RING_SLOT_DATA_OFFSET);
+   RingPtr->WrittenFrameCount.store(FrameIndex + 1, std::memory_order_release);
+
+   /* Wake up the I/O thread once a full batch is ready. */
+   if (((FrameIndex + 1) % RING_FLUSH_BATCH) == 0)
+      MthrControl(RingPtr->FramesReadyEvent, M_EVENT_SET, M_SIGNALED);
+   }
+
+/* Start writing back a range of contiguous slots. The slots are aligned on */
+/* RING_ALIGNMENT so the writes are page aligned.                           */
+static void RingFlushSlots(RingRecorderStruct* RingPtr, MIL_INT64 FirstSlot, MIL_INT64 NbSlots)
+   {
+   MIL_INT64 Offset = RING_ALIGNMENT + FirstSlot * RingPtr->SlotSize;
+   MIL_INT64 Size   = NbSlots * RingPtr->SlotSize;
+#if M_MIL_USE_WINDOWS
+   FlushViewOfFile(RingPtr->MappedPtr + Offset, (SIZE_T)Size);
+#elif defined(__linux__)
+   sync_file_range(RingPtr->FileDescriptor, (off64_t)Offset, (off64_t)Size,
+                   SYNC_FILE_RANGE_WRITE);
+#else
+   /* sync_file_range() is Linux only; start the write-back of the mapped range. */
+   msync(RingPtr->MappedPtr + Offset, (size_t)Size, MS_ASYNC);
+#endif
+   }
+
+/* Touch the pages of the next slots so that the grab hook does not take the */
+/* page faults.                                                              */
+static void RingPrefaultSlots(RingRecorderStruct* RingPtr, MIL_INT64 FirstFrame)
+   {
+   for (MIL_INT64 Frame = FirstFrame; Frame < FirstFrame + RING_FLUSH_BATCH; Frame++)
+      {
+      volatile MIL_UINT8* SlotPtr = RingPtr->MappedPtr + RING_ALIGNMENT +
+                                    (Frame % RingPtr->NbSlots) * RingPtr->SlotSize;
+      for (MIL_INT64 Offset = 0; Offset < RingPtr->SlotSize; Offset += RING_ALIGNMENT)
+         (void)SlotPtr[Offset];
+      }
+   }
+
+/* I/O thread: writes the recorded frames to disk in batches. */
+MIL_UINT32 MFTYPE RingRecorderIoThread(void* RingRecorderPtr)
+   {
+   RingRecorderStruct* RingPtr = (RingRecorderStruct*)RingRecorderPtr;
+   bool LastPass = false;
+
+   while (!LastPass)
+      {
+      LastPass = RingPtr->Exit;
+      MIL_INT64 WrittenCount = RingPtr->WrittenFrameCount.load(std::memory_order_acquire);
+      MIL_INT64 FirstFrame   = RingPtr->FlushedFrameCount;
+
+      /* If the disk fell more than a ring behind, only the last ring matters. */
+      if (WrittenCount - FirstFrame > RingPtr->NbSlots)
+         FirstFrame = WrittenCount - RingPtr->NbSlots;
+
+      /* Write full batches, or whatever is left on the last pass. */
+      if (WrittenCount - FirstFrame >= RING_FLUSH_BATCH || (LastPass && WrittenCount > FirstFrame))
+         {
+         MIL_INT64 FirstSlot = FirstFrame % RingPtr->NbSlots;
+         MIL_INT64 NbFrames  = WrittenCount - FirstFrame;
+
+         /* Split the range where it wraps around the end of the ring. */
+         if (FirstSlot + NbFrames > RingPtr->NbSlots)
+            {
+            RingFlushSlots(RingPtr, FirstSlot, RingPtr->NbSlots - FirstSlot);
+            RingFlushSlots(RingPtr, 0, FirstSlot + NbFrames - RingPtr->NbSlots);
+            }
+         else
+            RingFlushSlots(RingPtr, FirstSlot, NbFrames);
+
+         RingPtr->FlushedFrameCount = WrittenCount;
+         ((RingFileHeader*)RingPtr->MappedPtr)->WrittenFrameCount = WrittenCount;
+         RingPrefaultSlots(RingPtr, WrittenCount);
+         }
+
+      if (!LastPass)
+         MthrWait(RingPtr->FramesReadyEvent, M_EVENT_WAIT+M_EVENT_TIMEOUT(RING_WAIT_TIMEOUT),
+                  M_NULL);
+      }
+
+   return 0;
+   }
+
+/* Export the frames of the frozen ring to the sequence file, oldest first. */
+MIL_INT RingRecorderExport(MIL_ID MilSystem, RingRecorderStruct* RingPtr, MIL_DOUBLE FrameRate)
+   {
+   MIL_ID MilExportImage;
+   MIL_INT64 WrittenCount = RingPtr->WrittenFrameCount;
+   MIL_INT64 FirstFrame   = (WrittenCount > RingPtr->NbSlots) ? WrittenCount - RingPtr->NbSlots : 0;
+
+   MbufAllocColor(MilSystem, RingPtr->SizeBand, RingPtr->SizeX, RingPtr->SizeY,
+                  8L+M_UNSIGNED, M_IMAGE, &MilExportImage);
+
+   MbufExportSequence(SEQUENCE_FILE, M_DEFAULT, M_NULL, M_NULL, M_DEFAULT, M_OPEN);
+   for (MIL_INT64 Frame = FirstFrame; Frame < WrittenCount; Frame++)
+      {
+      MIL_UINT8* SlotPtr = RingPtr->MappedPtr + RING_ALIGNMENT +
+                           (Frame % RingPtr->NbSlots) * RingPtr->SlotSize;
+      MbufPut(MilExportImage, SlotPtr + RING_SLOT_DATA_OFFSET);
+      MbufExportSequence(SEQUENCE_FILE, M_DEFAULT, &MilExportImage, 1, M_DEFAULT, M_WRITE);
+      }
+   MbufExportSequence(SEQUENCE_FILE, M_DEFAULT, M_NULL, M_NULL, FrameRate, M_CLOSE);
+
+   MbufFree(MilExportImage);
+   return (MIL_INT)(WrittenCount - FirstFrame);
+   }
+
+/* Stop the I/O thread after a last write and unmap the ring file. */
+void RingRecorderFree(RingRecorderStruct* RingPtr)
+   {
+   RingPtr->Exit = true;
+   MthrControl(RingPtr->FramesReadyEvent, M_EVENT_SET, M_SIGNALED);
+   MthrWait(RingPtr->IoThread, M_THREAD_END_WAIT, M_NULL);
+   MthrFree(RingPtr->IoThread);
+   MthrFree(RingPtr->FramesReadyEvent);
+
+#if M_MIL_USE_WINDOWS
+   FlushViewOfFile(RingPtr->MappedPtr, 0);
+   UnmapViewOfFile(RingPtr->MappedPtr);
+   CloseHandle(RingPtr->MappingHandle);
+   CloseHandle(RingPtr->FileHandle);
+#else
+   munmap(RingPtr->MappedPtr, (size_t)RingPtr->FileSize);
+   close(RingPtr->FileDescriptor);
+#endif
+   }
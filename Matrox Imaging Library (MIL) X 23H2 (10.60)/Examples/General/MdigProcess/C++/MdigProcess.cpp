@@ -8,6 +8,21 @@
  *            The user's processing code to execute is located in a callback function 
  *            that will be called for each frame acquired (see ProcessingFunction()).
  *
+ *            Optionally (see PIPELINED_PROCESSING), the callback function only hands
+ *            the grabbed frame off to a lock-free frame queue, and a pool of worker
+ *            threads does the processing. This keeps the grab queue serviced even
+ *            when the processing time of some frames is much longer than the
+ *            frame period.
+ *
+ *            Optionally (see BUFFERING_SIZE_AUTO), a warm-up measures the frame
+ *            period and the processing time, then the grab buffer list is resized
+ *            to the smallest count that gives no missed frames.
+ *
+ *            Optionally (see REPLAY_SOURCE), recorded frames are replayed into the
+ *            same callback function instead of being grabbed (see
+ *            General/MdigReplay/C++/MdigReplay.h), at a configurable rate or as
+ *            fast as possible.
+ *
  *      Note: The average processing time must be shorter than the grab time or some
  *            frames will be missed. Also, if the processing results are not displayed
  *            and the frame count is not drawn or printed, the CPU usage is reduced 
@@ -17,14 +32,62 @@
  * All Rights Reserved
  */
 #include <mil.h>
+#include <atomic>
+#include <algorithm>
+#include "../../MdigReplay/C++/MdigReplay.h"
 
 /* Number of images in the buffering grab queue.
    Generally, increasing this number gives a better real-time grab.
  */
 #define BUFFERING_SIZE_MAX 20
 
-/* User's processing function prototype. */
+/* Set to M_YES to size the grab buffer list automatically. Only
+   BUFFERING_SIZE_WARMUP buffers are allocated for the warm-up; trial runs then
+   grow or shrink the list to the smallest count without missed frames.
+ */
+#define BUFFERING_SIZE_AUTO      M_NO
+#define BUFFERING_SIZE_MIN       2
+#define BUFFERING_SIZE_WARMUP    8
+#define WARMUP_FRAME_COUNT       300
+#define TRIAL_FRAME_COUNT        300
+#define TIMING_HISTORY_SIZE      1024
+#define PROCESSING_TIME_PERCENTILE 0.99
+
+/* Set to M_YES to process the frames in a pool of worker threads instead of
+   directly in the MdigProcess() callback function.
+ */
+#define PIPELINED_PROCESSING     M_NO
+
+/* Pipeline settings. The ring size must be a power of 2 and larger than the
+   number of processing buffers (queue depth + number of workers).
+ */
+#define PIPELINE_RING_SIZE       64
+#define PIPELINE_QUEUE_DEPTH     8
+#define PIPELINE_WORKER_NB_MAX   32
+
+/* Policy applied by the callback function when no processing buffer is free. */
+#define PIPELINE_DROP_OLDEST     0  /* Discard the oldest queued frame.             */
+#define PIPELINE_DROP_NEWEST     1  /* Discard the frame that was just grabbed.     */
+#define PIPELINE_BLOCK           2  /* Wait for a worker to free a buffer.          */
+#define PIPELINE_QUEUE_POLICY    PIPELINE_DROP_OLDEST
+
+/* Set to a folder of .mim or .mbufc files (ending with a path separator) or to
+   an AVI file to replay it instead of grabbing from the digitizer. The frames
+   come at REPLAY_FRAME_RATE frames/sec, or as fast as they are processed with
+   REPLAY_MAX_SPEED. Jitter is a fraction of the frame period; every
+   REPLAY_BURST_LENGTH frames, the replay pauses for REPLAY_BURST_PAUSE sec.
+ */
+#define REPLAY_SOURCE            M_NULL
+#define REPLAY_FRAME_RATE        30.0
+#define REPLAY_JITTER            0.0
+#define REPLAY_BURST_LENGTH      0
+#define REPLAY_BURST_PAUSE       0.0
+
+/* User's processing function prototypes. */
 MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr);
+MIL_INT MFTYPE PipelineHookFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr);
+MIL_UINT32 MFTYPE PipelineWorkerFunction(void* WorkerDataPtr);
+void ProcessFrame(MIL_ID ImageId, MIL_ID MilImageDisp, MIL_INT FrameIndex);
 
 /* User's processing function hook data structure. */
 typedef struct
@@ -33,6 +96,82 @@ typedef struct
    MIL_INT ProcessedImageCount;
    } HookDataStruct;
 
+/* Bounded lock-free multi-producer/multi-consumer ring of buffer identifiers.
+   Each cell carries a sequence number that tells whether it is ready to be
+   written or read at a given position, so no lock is needed on either side.
+ */
+typedef struct
+   {
+   std::atomic<MIL_UINT> Sequence;
+   MIL_ID                BufferId;
+   } FrameRingCell;
+
+typedef struct
+   {
+   FrameRingCell         Cells[PIPELINE_RING_SIZE];
+   std::atomic<MIL_UINT> EnqueuePos;
+   std::atomic<MIL_UINT> DequeuePos;
+   } FrameRing;
+
+void FrameRingInit(FrameRing* RingPtr);
+bool FrameRingPush(FrameRing* RingPtr, MIL_ID BufferId);
+bool FrameRingPop(FrameRing* RingPtr, MIL_ID* BufferIdPtr);
+
+/* Pipeline data structure, shared by the callback function and the workers. */
+typedef struct
+   {
+   MIL_ID               MilImageDisp;
+   FrameRing            PendingFrames;     /* Frames waiting to be processed.  */
+   FrameRing            FreeBuffers;       /* Processing buffers not in use.   */
+   MIL_ID               ProcBufferList[PIPELINE_RING_SIZE];
+   MIL_INT              ProcFrameIndex[PIPELINE_RING_SIZE]; /* Grab order of the frame in each buffer. */
+   MIL_INT              ProcBufferListSize;
+   MIL_ID               DisplayMutex;      /* Serializes the display updates.  */
+   MIL_INT              LastDisplayedIndex;
+   MIL_ID               FrameReadyEvent;   /* Signaled when a frame is queued. */
+   MIL_ID               BufferFreeEvent;   /* Signaled when a buffer is freed. */
+   MIL_ID               WorkerThreadList[PIPELINE_WORKER_NB_MAX];
+   MIL_INT              WorkerProcessedCount[PIPELINE_WORKER_NB_MAX];
+   MIL_INT              NbWorkers;
+   MIL_INT              QueuePolicy;
+   std::atomic<MIL_INT> GrabbedFrameCount;
+   std::atomic<MIL_INT> ProcessedFrameCount;
+   std::atomic<MIL_INT> DroppedFrameCount;
+   MIL_INT              LateFrameCount;    /* Frames done after a newer one was displayed. */
+   std::atomic<bool>    Exit;
+   } PipelineDataStruct;
+
+/* Worker thread data structure. */
+typedef struct
+   {
+   PipelineDataStruct* PipelinePtr;
+   MIL_INT             WorkerIndex;
+   } WorkerDataStruct;
+
+void PipelineAlloc(MIL_ID MilSystem, ReplayDigitizer* DigitizerPtr, MIL_ID MilImageDisp,
+                   PipelineDataStruct* PipelinePtr, WorkerDataStruct* WorkerDataList);
+void PipelineFree(PipelineDataStruct* PipelinePtr);
+MIL_INT PipelineBufferIndex(PipelineDataStruct* PipelinePtr, MIL_ID ProcBufferId);
+
+/* Grab buffer list auto-sizing data structure. The timing hook wraps the user's
+   hook to measure the grab period and the processing time of the last frames.
+ */
+typedef struct
+   {
+   MIL_DIG_HOOK_FUNCTION_PTR HookFunctionPtr;
+   void*      HookDataPtr;
+   MIL_DOUBLE GrabTimeStamp[TIMING_HISTORY_SIZE];
+   MIL_DOUBLE ProcessingTime[TIMING_HISTORY_SIZE];
+   MIL_INT    TimingCount;
+   } SizingDataStruct;
+
+MIL_INT MFTYPE TimingHookFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr);
+MIL_INT AutoSizeGrabBufferList(MIL_ID MilSystem, ReplayDigitizer* DigitizerPtr,
+                               MIL_ID* MilGrabBufferList, MIL_INT MilGrabBufferListSize,
+                               MIL_DIG_HOOK_FUNCTION_PTR HookFunctionPtr, void* HookDataPtr);
+MIL_INT ResizeGrabBufferList(MIL_ID MilSystem, ReplayDigitizer* DigitizerPtr, MIL_ID* MilGrabBufferList,
+                             MIL_INT MilGrabBufferListSize, MIL_INT RequestedSize);
+
 
 /* Main function. */
 /* ---------------*/
@@ -41,7 +180,7 @@ int MosMain(void)
 {
    MIL_ID MilApplication;
    MIL_ID MilSystem     ;
-   MIL_ID MilDigitizer  ;
+   ReplayDigitizer Digitizer = { M_NULL, M_NULL };
    MIL_ID MilDisplay    ;
    MIL_ID MilImageDisp  ;
    MIL_ID MilGrabBufferList[BUFFERING_SIZE_MAX] = { 0 };
@@ -49,15 +188,33 @@ int MosMain(void)
    MIL_INT ProcessFrameCount   = 0;
    MIL_DOUBLE ProcessFrameRate = 0;
    HookDataStruct UserHookData;
-
-   /* Allocate defaults. */
-   MappAllocDefault(M_DEFAULT, &MilApplication, &MilSystem, &MilDisplay,
-      &MilDigitizer, M_NULL);
+   MIL_DIG_HOOK_FUNCTION_PTR HookFunctionPtr = ProcessingFunction;
+   void* HookDataPtr = &UserHookData;
+   PipelineDataStruct PipelineData;
+   WorkerDataStruct   WorkerDataList[PIPELINE_WORKER_NB_MAX];
+   MIL_CONST_TEXT_PTR ReplaySource = REPLAY_SOURCE;
+   ReplaySettings     ReplaySettingsData = { REPLAY_FRAME_RATE, REPLAY_JITTER,
+                                             REPLAY_BURST_LENGTH, REPLAY_BURST_PAUSE, false };
+
+   /* Allocate defaults. When replaying, the replay source replaces the digitizer. */
+   if (ReplaySource)
+      {
+      MappAllocDefault(M_DEFAULT, &MilApplication, &MilSystem, &MilDisplay,
+         M_NULL, M_NULL);
+      if (!ReplayAlloc(MilSystem, ReplaySource, &ReplaySettingsData, &Digitizer))
+         {
+         MappFreeDefault(MilApplication, MilSystem, MilDisplay, M_NULL, M_NULL);
+         return 0;
+         }
+      }
+   else
+      MappAllocDefault(M_DEFAULT, &MilApplication, &MilSystem, &MilDisplay,
+         &Digitizer.MilDigitizer, M_NULL);
 
    /* Allocate a monochrome display buffer. */
    MbufAlloc2d(MilSystem,
-      MdigInquire(MilDigitizer, M_SIZE_X, M_NULL),
-      MdigInquire(MilDigitizer, M_SIZE_Y, M_NULL),
+      ReplayDigInquire(&Digitizer, M_SIZE_X, M_NULL),
+      ReplayDigInquire(&Digitizer, M_SIZE_Y, M_NULL),
       8 + M_UNSIGNED,
       M_IMAGE + M_GRAB + M_PROC + M_DISP,
       &MilImageDisp);
@@ -72,14 +229,16 @@ int MosMain(void)
    MosPrintf(MIL_TEXT("Press <Enter> to start processing.\n\n"));
 
    /* Grab continuously on the display and wait for a key press. */
-   MdigGrabContinuous(MilDigitizer, MilImageDisp);
+   ReplayDigGrabContinuous(&Digitizer, MilImageDisp);
    MosGetch();
 
    /* Halt continuous grab. */
-   MdigHalt(MilDigitizer);
+   ReplayDigHalt(&Digitizer);
 
    /* Allocate the grab buffers and clear them. */
-   for (MilGrabBufferListSize = 0; MilGrabBufferListSize<BUFFERING_SIZE_MAX;
+   for (MilGrabBufferListSize = 0;
+      MilGrabBufferListSize < ((BUFFERING_SIZE_AUTO == M_YES) ? BUFFERING_SIZE_WARMUP :
+                                                                BUFFERING_SIZE_MAX);
       MilGrabBufferListSize++)
       {
       /* Minimum number of buffers required. */
@@ -87,8 +246,8 @@ int MosMain(void)
          MappControl(M_DEFAULT, M_ERROR, M_PRINT_DISABLE);
 
       MbufAlloc2d(MilSystem,
-         MdigInquire(MilDigitizer, M_SIZE_X, M_NULL),
-         MdigInquire(MilDigitizer, M_SIZE_Y, M_NULL),
+         ReplayDigInquire(&Digitizer, M_SIZE_X, M_NULL),
+         ReplayDigInquire(&Digitizer, M_SIZE_Y, M_NULL),
          8 + M_UNSIGNED,
          M_IMAGE + M_GRAB + M_PROC,
          &MilGrabBufferList[MilGrabBufferListSize]);
@@ -103,9 +262,23 @@ int MosMain(void)
    UserHookData.MilImageDisp        = MilImageDisp;
    UserHookData.ProcessedImageCount = 0;
 
+   /* In pipelined mode, allocate the processing buffers and start the workers. */
+   if (PIPELINED_PROCESSING == M_YES)
+      {
+      PipelineAlloc(MilSystem, &Digitizer, MilImageDisp, &PipelineData, WorkerDataList);
+      HookFunctionPtr = PipelineHookFunction;
+      HookDataPtr     = &PipelineData;
+      }
+
+   /* Find the smallest number of grab buffers that does not miss frames. */
+   if (BUFFERING_SIZE_AUTO == M_YES)
+      MilGrabBufferListSize = AutoSizeGrabBufferList(MilSystem, &Digitizer,
+                                                     MilGrabBufferList, MilGrabBufferListSize,
+                                                     HookFunctionPtr, HookDataPtr);
+
    /* Start the processing. The processing function is called with every frame grabbed. */
-   MdigProcess(MilDigitizer, MilGrabBufferList, MilGrabBufferListSize,
-               M_START, M_DEFAULT, ProcessingFunction, &UserHookData);
+   ReplayDigProcess(&Digitizer, MilGrabBufferList, MilGrabBufferListSize,
+                    M_START, M_DEFAULT, HookFunctionPtr, HookDataPtr);
 
 
    /* Here the main() is free to perform other tasks while the processing is executing. */
@@ -117,14 +290,19 @@ int MosMain(void)
    MosGetch();
 
    /* Stop the processing. */
-   MdigProcess(MilDigitizer, MilGrabBufferList, MilGrabBufferListSize,
-               M_STOP, M_DEFAULT, ProcessingFunction, &UserHookData);
+   ReplayDigProcess(&Digitizer, MilGrabBufferList, MilGrabBufferListSize,
+                    M_STOP, M_DEFAULT, HookFunctionPtr, HookDataPtr);
 
    /* Print statistics. */
-   MdigInquire(MilDigitizer, M_PROCESS_FRAME_COUNT,  &ProcessFrameCount);
-   MdigInquire(MilDigitizer, M_PROCESS_FRAME_RATE,   &ProcessFrameRate);
+   ReplayDigInquire(&Digitizer, M_PROCESS_FRAME_COUNT,  &ProcessFrameCount);
+   ReplayDigInquire(&Digitizer, M_PROCESS_FRAME_RATE,   &ProcessFrameRate);
    MosPrintf(MIL_TEXT("\n\n%d frames grabbed at %.1f frames/sec (%.1f ms/frame).\n"),
                         (int)ProcessFrameCount, ProcessFrameRate, 1000.0/ProcessFrameRate);
+
+   /* In pipelined mode, let the workers empty the queue and print their statistics. */
+   if (PIPELINED_PROCESSING == M_YES)
+      PipelineFree(&PipelineData);
+
    MosPrintf(MIL_TEXT("Press <Enter> to end.\n\n"));
    MosGetch();
 
@@ -136,7 +314,13 @@ int MosMain(void)
    MbufFree(MilImageDisp);
 
    /* Release defaults. */
-   MappFreeDefault(MilApplication, MilSystem, MilDisplay, MilDigitizer, M_NULL);
+   if (ReplaySource)
+      {
+      ReplayFree(&Digitizer);
+      MappFreeDefault(MilApplication, MilSystem, MilDisplay, M_NULL, M_NULL);
+      }
+   else
+      MappFreeDefault(MilApplication, MilSystem, MilDisplay, Digitizer.MilDigitizer, M_NULL);
 
    return 0;
 }
@@ -154,23 +338,488 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID HookId, void* HookDat
    {
    HookDataStruct *UserHookDataPtr = (HookDataStruct *)HookDataPtr;
    MIL_ID ModifiedBufferId;
-   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX]= {MIL_TEXT('\0'),};
 
    /* Retrieve the MIL_ID of the grabbed buffer. */
-   MdigGetHookInfo(HookId, M_MODIFIED_BUFFER+M_BUFFER_ID, &ModifiedBufferId);
+   ReplayDigGetHookInfo(HookId, M_MODIFIED_BUFFER+M_BUFFER_ID, &ModifiedBufferId);
 
    /* Increment the frame counter. */
    UserHookDataPtr->ProcessedImageCount++;
 
    /* Print and draw the frame count (remove to reduce CPU usage). */
    MosPrintf(MIL_TEXT("Processing frame #%d.\r"), (int)UserHookDataPtr->ProcessedImageCount);
-   MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), 
-                                       (int)UserHookDataPtr->ProcessedImageCount);
-   MgraText(M_DEFAULT, ModifiedBufferId, STRING_POS_X, STRING_POS_Y, Text);
 
    /* Execute the processing and update the display. */
-   MimArith(ModifiedBufferId, M_NULL, UserHookDataPtr->MilImageDisp, M_NOT);
-   
+   ProcessFrame(ModifiedBufferId, UserHookDataPtr->MilImageDisp,
+                UserHookDataPtr->ProcessedImageCount);
 
    return 0;
    }
+
+/* User's processing executed on each frame, either directly in the callback */
+/* function or in a pipeline worker thread.                                   */
+/* -------------------------------------------------------------------------- */
+void ProcessFrame(MIL_ID ImageId, MIL_ID MilImageDisp, MIL_INT FrameIndex)
+   {
+   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX]= {MIL_TEXT('\0'),};
+
+   /* Draw the frame count (remove to reduce CPU usage). */
+   MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), (int)FrameIndex);
+   MgraText(M_DEFAULT, ImageId, STRING_POS_X, STRING_POS_Y, Text);
+
+   /* Execute the processing and update the display. */
+   MimArith(ImageId, M_NULL, MilImageDisp, M_NOT);
+   }
+
+
+/* Pipelined processing: the callback function only hands the frame off. */
+/* ---------------------------------------------------------------------- */
+
+/* Time to wait for an event before checking the exit flag again, in ms. */
+#define PIPELINE_WAIT_TIMEOUT    100
+
+MIL_INT MFTYPE PipelineHookFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr)
+   {
+   PipelineDataStruct *PipelinePtr = (PipelineDataStruct *)HookDataPtr;
+   MIL_ID ModifiedBufferId;
+   MIL_ID ProcBufferId = M_NULL;
+   MIL_INT FrameIndex, BufIdx;
+
+   /* Retrieve the MIL_ID of the grabbed buffer. */
+   ReplayDigGetHookInfo(HookId, M_MODIFIED_BUFFER+M_BUFFER_ID, &ModifiedBufferId);
+   FrameIndex = ++PipelinePtr->GrabbedFrameCount;
+
+   /* Get a free processing buffer, applying the queue policy if there is none. */
+   while (!FrameRingPop(&PipelinePtr->FreeBuffers, &ProcBufferId))
+      {
+      if (PipelinePtr->QueuePolicy == PIPELINE_DROP_OLDEST &&
+          FrameRingPop(&PipelinePtr->PendingFrames, &ProcBufferId))
+         {
+         /* Reuse the buffer of the oldest frame that is still waiting. */
+         PipelinePtr->DroppedFrameCount++;
+         break;
+         }
+      else if (PipelinePtr->QueuePolicy == PIPELINE_BLOCK)
+         {
+         /* Wait for a worker to free a buffer. The grab queue absorbs the delay. */
+         MthrWait(PipelinePtr->BufferFreeEvent,
+                  M_EVENT_WAIT+M_EVENT_TIMEOUT(PIPELINE_WAIT_TIMEOUT), M_NULL);
+         }
+      else
+         {
+         /* Discard the frame that was just grabbed. */
+         PipelinePtr->DroppedFrameCount++;
+         return 0;
+         }
+      }
+
+   /* A buffer that is not in the processing buffer list has no pipeline */
+   /* state; report it and drop the frame.                               */
+   BufIdx = PipelineBufferIndex(PipelinePtr, ProcBufferId);
+   if (BufIdx < 0)
+      {
+      MosPrintf(MIL_TEXT("Frame #%d dropped: unknown processing buffer.\n"), (int)FrameIndex);
+      PipelinePtr->DroppedFrameCount++;
+      return 0;
+      }
+
+   /* The grab buffer is requeued as soon as this function returns, so its */
+   /* content is copied before being handed off to the workers.           */
+   MbufCopy(ModifiedBufferId, ProcBufferId);
+   PipelinePtr->ProcFrameIndex[BufIdx] = FrameIndex;
+   FrameRingPush(&PipelinePtr->PendingFrames, ProcBufferId);
+   MthrControl(PipelinePtr->FrameReadyEvent, M_EVENT_SET, M_SIGNALED);
+
+   return 0;
+   }
+
+/* Worker thread: processes the queued frames until the pipeline is freed. */
+/* ----------------------------------------------------------------------- */
+MIL_UINT32 MFTYPE PipelineWorkerFunction(void* WorkerDataPtr)
+   {
+   WorkerDataStruct   *WorkerPtr   = (WorkerDataStruct *)WorkerDataPtr;
+   PipelineDataStruct *PipelinePtr = WorkerPtr->PipelinePtr;
+   MIL_ID ProcBufferId;
+   MIL_INT FrameIndex, BufIdx;
+
+   /* The workers already run in parallel, so do not also split each */
+   /* operation across the cores.                                    */
+   MthrControlMp(M_DEFAULT, M_MP_USE, M_DEFAULT, M_DISABLE, M_NULL);
+
+   while (true)
+      {
+      if (FrameRingPop(&PipelinePtr->PendingFrames, &ProcBufferId))
+         {
+         /* The event is auto-reset and wakes a single worker; pass the */
+         /* wake-up on if more frames are waiting.                      */
+         MthrControl(PipelinePtr->FrameReadyEvent, M_EVENT_SET, M_SIGNALED);
+
+         /* Skip a buffer that is not in the processing buffer list. */
+         BufIdx = PipelineBufferIndex(PipelinePtr, ProcBufferId);
+         if (BufIdx < 0)
+            {
+            MosPrintf(MIL_TEXT("Frame skipped: unknown processing buffer.\n"));
+            continue;
+            }
+
+         /* Process the frame in its own buffer. */
+         FrameIndex = PipelinePtr->ProcFrameIndex[BufIdx];
+         ProcessFrame(ProcBufferId, ProcBufferId, FrameIndex);
+         MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+         PipelinePtr->ProcessedFrameCount++;
+         PipelinePtr->WorkerProcessedCount[WorkerPtr->WorkerIndex]++;
+
+         /* Update the display one worker at a time and in grab order. A frame */
+         /* done after a newer one was displayed is not displayed.            */
+         MthrControl(PipelinePtr->DisplayMutex, M_LOCK, M_DEFAULT);
+         if (FrameIndex > PipelinePtr->LastDisplayedIndex)
+            {
+            MbufCopy(ProcBufferId, PipelinePtr->MilImageDisp);
+            PipelinePtr->LastDisplayedIndex = FrameIndex;
+            }
+         else
+            PipelinePtr->LateFrameCount++;
+         MthrControl(PipelinePtr->DisplayMutex, M_UNLOCK, M_DEFAULT);
+
+         /* Return the buffer to the free list. */
+         FrameRingPush(&PipelinePtr->FreeBuffers, ProcBufferId);
+         MthrControl(PipelinePtr->BufferFreeEvent, M_EVENT_SET, M_SIGNALED);
+         }
+      else if (PipelinePtr->Exit)
+         {
+         /* The queue is empty; wake the next worker so that it exits too. */
+         MthrControl(PipelinePtr->FrameReadyEvent, M_EVENT_SET, M_SIGNALED);
+         break;
+         }
+      else
+         {
+         MthrWait(PipelinePtr->FrameReadyEvent,
+                  M_EVENT_WAIT+M_EVENT_TIMEOUT(PIPELINE_WAIT_TIMEOUT), M_NULL);
+         }
+      }
+
+   return 0;
+   }
+
+/* Allocate the processing buffers, the events and the worker threads. */
+/* ------------------------------------------------------------------- */
+void PipelineAlloc(MIL_ID MilSystem, ReplayDigitizer* DigitizerPtr, MIL_ID MilImageDisp,
+                   PipelineDataStruct* PipelinePtr, WorkerDataStruct* WorkerDataList)
+   {
+   MIL_INT NbCores = 1;
+   MIL_INT BufIdx, WorkerIdx;
+
+   /* Use one worker per effective core. */
+   MthrInquireMp(M_DEFAULT, M_CORE_NUM_EFFECTIVE, M_DEFAULT, M_DEFAULT, &NbCores);
+   PipelinePtr->NbWorkers = (NbCores < 1) ? 1 :
+      ((NbCores > PIPELINE_WORKER_NB_MAX) ? PIPELINE_WORKER_NB_MAX : NbCores);
+
+   PipelinePtr->MilImageDisp        = MilImageDisp;
+   PipelinePtr->QueuePolicy         = PIPELINE_QUEUE_POLICY;
+   PipelinePtr->GrabbedFrameCount   = 0;
+   PipelinePtr->ProcessedFrameCount = 0;
+   PipelinePtr->DroppedFrameCount   = 0;
+   PipelinePtr->LateFrameCount      = 0;
+   PipelinePtr->LastDisplayedIndex  = 0;
+   PipelinePtr->Exit                = false;
+   FrameRingInit(&PipelinePtr->PendingFrames);
+   FrameRingInit(&PipelinePtr->FreeBuffers);
+
+   /* Allocate enough buffers for each worker plus the queued frames. */
+   PipelinePtr->ProcBufferListSize = PIPELINE_QUEUE_DEPTH + PipelinePtr->NbWorkers;
+   if (PipelinePtr->ProcBufferListSize > PIPELINE_RING_SIZE)
+      PipelinePtr->ProcBufferListSize = PIPELINE_RING_SIZE;
+   for (BufIdx = 0; BufIdx < PipelinePtr->ProcBufferListSize; BufIdx++)
+      {
+      MbufAlloc2d(MilSystem,
+         ReplayDigInquire(DigitizerPtr, M_SIZE_X, M_NULL),
+         ReplayDigInquire(DigitizerPtr, M_SIZE_Y, M_NULL),
+         8 + M_UNSIGNED,
+         M_IMAGE + M_PROC,
+         &PipelinePtr->ProcBufferList[BufIdx]);
+      FrameRingPush(&PipelinePtr->FreeBuffers, PipelinePtr->ProcBufferList[BufIdx]);
+      }
+
+   /* Allocate the display mutex and the synchronization events. */
+   MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &PipelinePtr->DisplayMutex);
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL,
+             &PipelinePtr->FrameReadyEvent);
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL,
+             &PipelinePtr->BufferFreeEvent);
+
+   /* Start the workers. */
+   for (WorkerIdx = 0; WorkerIdx < PipelinePtr->NbWorkers; WorkerIdx++)
+      {
+      WorkerDataList[WorkerIdx].PipelinePtr = PipelinePtr;
+      WorkerDataList[WorkerIdx].WorkerIndex = WorkerIdx;
+      PipelinePtr->WorkerProcessedCount[WorkerIdx] = 0;
+      MthrAlloc(MilSystem, M_THREAD, M_DEFAULT, &PipelineWorkerFunction,
+                &WorkerDataList[WorkerIdx], &PipelinePtr->WorkerThreadList[WorkerIdx]);
+      }
+
+   MosPrintf(MIL_TEXT("Pipelined processing: %d worker threads, %d queued frames max.\n\n"),
+             (int)PipelinePtr->NbWorkers, PIPELINE_QUEUE_DEPTH);
+   }
+
+/* Stop the workers once the queue is empty, print statistics and free. */
+/* -------------------------------------------------------------------- */
+void PipelineFree(PipelineDataStruct* PipelinePtr)
+   {
+   MIL_INT BufIdx, WorkerIdx;
+
+   /* Signal the workers to exit once the remaining frames are processed. */
+   PipelinePtr->Exit = true;
+   MthrControl(PipelinePtr->FrameReadyEvent, M_EVENT_SET, M_SIGNALED);
+   for (WorkerIdx = 0; WorkerIdx < PipelinePtr->NbWorkers; WorkerIdx++)
+      {
+      MthrWait(PipelinePtr->WorkerThreadList[WorkerIdx], M_THREAD_END_WAIT, M_NULL);
+      MthrFree(PipelinePtr->WorkerThreadList[WorkerIdx]);
+      }
+
+   /* Print the pipeline statistics. */
+   MosPrintf(MIL_TEXT("%d frames handed off, %d processed, %d dropped by the queue policy.\n"),
+             (int)PipelinePtr->GrabbedFrameCount, (int)PipelinePtr->ProcessedFrameCount,
+             (int)PipelinePtr->DroppedFrameCount);
+   MosPrintf(MIL_TEXT("%d frames not displayed because a newer frame was already displayed.\n"),
+             (int)PipelinePtr->LateFrameCount);
+   for (WorkerIdx = 0; WorkerIdx < PipelinePtr->NbWorkers; WorkerIdx++)
+      MosPrintf(MIL_TEXT("   Worker #%d processed %d frames.\n"), (int)WorkerIdx,
+                (int)PipelinePtr->WorkerProcessedCount[WorkerIdx]);
+
+   /* Free the mutex, the events and the processing buffers. */
+   MthrFree(PipelinePtr->DisplayMutex);
+   MthrFree(PipelinePtr->FrameReadyEvent);
+   MthrFree(PipelinePtr->BufferFreeEvent);
+   for (BufIdx = 0; BufIdx < PipelinePtr->ProcBufferListSize; BufIdx++)
+      MbufFree(PipelinePtr->ProcBufferList[BufIdx]);
+   }
+
+/* Returns the index of a processing buffer in the list, or -1 if it is not in the list. */
+MIL_INT PipelineBufferIndex(PipelineDataStruct* PipelinePtr, MIL_ID ProcBufferId)
+   {
+   MIL_INT BufIdx;
+
+   for (BufIdx = 0; BufIdx < PipelinePtr->ProcBufferListSize; BufIdx++)
+      {
+      if (PipelinePtr->ProcBufferList[BufIdx] == ProcBufferId)
+         return BufIdx;
+      }
+   return -1;
+   }
+
+
+/* Lock-free frame ring (bounded MPMC queue). */
+/* ------------------------------------------ */
+void FrameRingInit(FrameRing* RingPtr)
+   {
+   for (MIL_UINT i = 0; i < PIPELINE_RING_SIZE; i++)
+      RingPtr->Cells[i].Sequence.store(i, std::memory_order_relaxed);
+   RingPtr->EnqueuePos.store(0, std::memory_order_relaxed);
+   RingPtr->DequeuePos.store(0, std::memory_order_relaxed);
+   }
+
+bool FrameRingPush(FrameRing* RingPtr, MIL_ID BufferId)
+   {
+   MIL_UINT Pos = RingPtr->EnqueuePos.load(std::memory_order_relaxed);
+   while (true)
+      {
+      FrameRingCell* CellPtr = &RingPtr->Cells[Pos & (PIPELINE_RING_SIZE - 1)];
+      MIL_INT Diff = (MIL_INT)CellPtr->Sequence.load(std::memory_order_acquire) - (MIL_INT)Pos;
+      if (Diff == 0)
+         {
+         /* The cell is free at this position; try to claim it. */
+         if (RingPtr->EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+            {
+            CellPtr->BufferId = BufferId;
+            CellPtr->Sequence.store(Pos + 1, std::memory_order_release);
+            return true;
+            }
+         }
+      else if (Diff < 0)
+         return false; /* The ring is full. */
+      else
+         Pos = RingPtr->EnqueuePos.load(std::memory_order_relaxed);
+      }
+   }
+
+bool FrameRingPop(FrameRing* RingPtr, MIL_ID* BufferIdPtr)
+   {
+   MIL_UINT Pos = RingPtr->DequeuePos.load(std::memory_order_relaxed);
+   while (true)
+      {
+      FrameRingCell* CellPtr = &RingPtr->Cells[Pos & (PIPELINE_RING_SIZE - 1)];
+      MIL_INT Diff = (MIL_INT)CellPtr->Sequence.load(std::memory_order_acquire) - (MIL_INT)(Pos + 1);
+      if (Diff == 0)
+         {
+         /* The cell holds a value at this position; try to claim it. */
+         if (RingPtr->DequeuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+            {
+            *BufferIdPtr = CellPtr->BufferId;
+            CellPtr->Sequence.store(Pos + PIPELINE_RING_SIZE, std::memory_order_release);
+            return true;
+            }
+         }
+      else if (Diff < 0)
+         return false; /* The ring is empty. */
+      else
+         Pos = RingPtr->DequeuePos.load(std::memory_order_relaxed);
+      }
+   }
+
+
+/* Grab buffer list auto-sizing. */
+/* ----------------------------- */
+
+/* Timing hook: measures the processing time of the user's hook. */
+MIL_INT MFTYPE TimingHookFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr)
+   {
+   SizingDataStruct *SizingPtr = (SizingDataStruct *)HookDataPtr;
+   MIL_INT Index = SizingPtr->TimingCount % TIMING_HISTORY_SIZE;
+   MIL_DOUBLE StartTime, EndTime;
+
+   ReplayDigGetHookInfo(HookId, M_TIME_STAMP, &SizingPtr->GrabTimeStamp[Index]);
+
+   MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+   SizingPtr->HookFunctionPtr(HookType, HookId, SizingPtr->HookDataPtr);
+   MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+
+   SizingPtr->ProcessingTime[Index] = EndTime - StartTime;
+   SizingPtr->TimingCount++;
+   return 0;
+   }
+
+/* Grow or shrink the grab buffer list; returns the number of buffers allocated. */
+MIL_INT ResizeGrabBufferList(MIL_ID MilSystem, ReplayDigitizer* DigitizerPtr, MIL_ID* MilGrabBufferList,
+                             MIL_INT MilGrabBufferListSize, MIL_INT RequestedSize)
+   {
+   while (MilGrabBufferListSize > RequestedSize)
+      MbufFree(MilGrabBufferList[--MilGrabBufferListSize]);
+
+   MappControl(M_DEFAULT, M_ERROR, M_PRINT_DISABLE);
+   while (MilGrabBufferListSize < RequestedSize)
+      {
+      MbufAlloc2d(MilSystem,
+         ReplayDigInquire(DigitizerPtr, M_SIZE_X, M_NULL),
+         ReplayDigInquire(DigitizerPtr, M_SIZE_Y, M_NULL),
+         8 + M_UNSIGNED,
+         M_IMAGE + M_GRAB + M_PROC,
+         &MilGrabBufferList[MilGrabBufferListSize]);
+      if (MilGrabBufferList[MilGrabBufferListSize])
+         MbufClear(MilGrabBufferList[MilGrabBufferListSize++], 0xFF);
+      else
+         break;
+      }
+   MappControl(M_DEFAULT, M_ERROR, M_PRINT_ENABLE);
+
+   return MilGrabBufferListSize;
+   }
+
+/* Run a warm-up to measure the frame period and the processing time, then use */
+/* trial sequences to find the smallest grab buffer list without missed frames. */
+MIL_INT AutoSizeGrabBufferList(MIL_ID MilSystem, ReplayDigitizer* DigitizerPtr,
+                               MIL_ID* MilGrabBufferList, MIL_INT MilGrabBufferListSize,
+                               MIL_DIG_HOOK_FUNCTION_PTR HookFunctionPtr, void* HookDataPtr)
+   {
+   SizingDataStruct SizingData;
+   MIL_DOUBLE SortedTime[TIMING_HISTORY_SIZE];
+   MIL_INT NbSamples, Index, FramesMissed = 0;
+   MIL_INT TrialSize, GoodSize = 0, FailedSize = 0;
+   MIL_DOUBLE FramePeriod, ProcessingTimeMean = 0, ProcessingTimePercentile;
+
+   SizingData.HookFunctionPtr = HookFunctionPtr;
+   SizingData.HookDataPtr     = HookDataPtr;
+   SizingData.TimingCount     = 0;
+
+   MosPrintf(MIL_TEXT("Sizing the grab buffer list: warm-up with %d buffers...\n"),
+             (int)MilGrabBufferListSize);
+
+   /* Warm-up: process a fixed number of frames while measuring. */
+   ReplayDigProcess(DigitizerPtr, MilGrabBufferList, MilGrabBufferListSize,
+                    M_SEQUENCE + M_COUNT(WARMUP_FRAME_COUNT), M_SYNCHRONOUS,
+                    TimingHookFunction, &SizingData, WARMUP_FRAME_COUNT);
+
+   NbSamples = std::min<MIL_INT>(SizingData.TimingCount, TIMING_HISTORY_SIZE);
+   if (NbSamples < 2)
+      return MilGrabBufferListSize;
+
+   /* The frame period is the median of the grab time stamp differences, */
+   /* which is not affected by the frames missed during the warm-up.     */
+   for (Index = 1; Index < NbSamples; Index++)
+      SortedTime[Index-1] = SizingData.GrabTimeStamp[Index] - SizingData.GrabTimeStamp[Index-1];
+   std::sort(SortedTime, SortedTime + NbSamples - 1);
+   FramePeriod = SortedTime[(NbSamples - 1) / 2];
+
+   /* Get the mean and the percentile of the processing time. */
+   for (Index = 0; Index < NbSamples; Index++)
+      {
+      SortedTime[Index] = SizingData.ProcessingTime[Index];
+      ProcessingTimeMean += SortedTime[Index] / NbSamples;
+      }
+   std::sort(SortedTime, SortedTime + NbSamples);
+   ProcessingTimePercentile =
+      SortedTime[(MIL_INT)(PROCESSING_TIME_PERCENTILE * (NbSamples - 1))];
+
+   MosPrintf(MIL_TEXT("   Frame period:                   %.2f ms\n"), FramePeriod * 1000.0);
+   MosPrintf(MIL_TEXT("   Mean processing time:           %.2f ms\n"), ProcessingTimeMean * 1000.0);
+   MosPrintf(MIL_TEXT("   P%d processing time:            %.2f ms\n"),
+             (int)(PROCESSING_TIME_PERCENTILE * 100), ProcessingTimePercentile * 1000.0);
+
+   if (FramePeriod <= 0 || ProcessingTimeMean >= FramePeriod)
+      {
+      /* No buffer count can keep up; keep as many buffers as possible. */
+      MosPrintf(MIL_TEXT("   The mean processing time exceeds the frame period.\n\n"));
+      return ResizeGrabBufferList(MilSystem, DigitizerPtr, MilGrabBufferList,
+                                  MilGrabBufferListSize, BUFFERING_SIZE_MAX);
+      }
+
+   /* Start with the number of frames grabbed during a slow processing, */
+   /* plus the buffer being grabbed.                                   */
+   TrialSize = (MIL_INT)(ProcessingTimePercentile / FramePeriod) + 2;
+   TrialSize = std::max<MIL_INT>(BUFFERING_SIZE_MIN, std::min<MIL_INT>(TrialSize, BUFFERING_SIZE_MAX));
+
+   /* Grow until no frame is missed, or shrink until a frame is missed. */
+   while (true)
+      {
+      MilGrabBufferListSize = ResizeGrabBufferList(MilSystem, DigitizerPtr, MilGrabBufferList,
+                                                   MilGrabBufferListSize, TrialSize);
+      if (MilGrabBufferListSize < TrialSize)
+         {
+         /* Out of memory for grab buffers. */
+         TrialSize = MilGrabBufferListSize;
+         break;
+         }
+
+      ReplayDigProcess(DigitizerPtr, MilGrabBufferList, MilGrabBufferListSize,
+                       M_SEQUENCE + M_COUNT(TRIAL_FRAME_COUNT), M_SYNCHRONOUS,
+                       TimingHookFunction, &SizingData, TRIAL_FRAME_COUNT);
+      ReplayDigInquire(DigitizerPtr, M_PROCESS_FRAME_MISSED, &FramesMissed);
+      MosPrintf(MIL_TEXT("   Trial with %2d buffers: %d frames missed.\n"),
+                (int)TrialSize, (int)FramesMissed);
+
+      if (FramesMissed == 0)
+         {
+         GoodSize = TrialSize;
+         if (TrialSize <= BUFFERING_SIZE_MIN || TrialSize - 1 <= FailedSize)
+            break;
+         TrialSize--;
+         }
+      else
+         {
+         FailedSize = TrialSize;
+         if (GoodSize)
+            {
+            TrialSize = GoodSize;
+            break;
+            }
+         if (TrialSize >= BUFFERING_SIZE_MAX)
+            break;
+         TrialSize++;
+         }
+      }
+
+   MilGrabBufferListSize = ResizeGrabBufferList(MilSystem, DigitizerPtr, MilGrabBufferList,
+                                                MilGrabBufferListSize, TrialSize);
+   MosPrintf(MIL_TEXT("   Using %d grab buffers (maximum %d).\n\n"),
+             (int)MilGrabBufferListSize, BUFFERING_SIZE_MAX);
+
+   return MilGrabBufferListSize;
+   }
@@ -0,0 +1,515 @@
+﻿/***************************************************************************************/
+/*
+ * File name: MdigReplay.h
+ *
+ * Synopsis:  Replay source that plays recorded frames into an MdigProcess()-style
+ *            callback function, to run an acquisition pipeline without a camera.
+ *
+ *            The source is a folder of .mim or .mbufc files, or an AVI file. All
+ *            the frames are loaded in memory, then played in a loop at a given
+ *            frame rate, optionally with jitter and bursts, or as fast as the
+ *            processing allows (REPLAY_MAX_SPEED).
+ *
+ *            The ReplayDig...() functions take a ReplayDigitizer in place of the
+ *            digitizer identifier. It holds either a digitizer, in which case
+ *            the matching Mdig...() function is called, or the replay source
+ *            allocated by ReplayAlloc(), so the same code runs with both sources.
+ *            A .mbufc file is replayed through the image component of its
+ *            container, or as a whole container when the settings keep the
+ *            containers, for grab buffers that are containers. In the callback
+ *            function, use ReplayDigGetHookInfo() instead of MdigGetHookInfo().
+ *
+ *            The replay is shared by the MdigProcess()-based examples: include
+ *            it from General/MdigReplay/C++.
+ *
+ *            As with MdigProcess(), a frame is missed when all the buffers are
+ *            waiting to be processed, except at REPLAY_MAX_SPEED where the
+ *            replay waits for a free buffer.
+ *
+ * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+ * All Rights Reserved
+ */
+#ifndef MDIGREPLAY_H
+#define MDIGREPLAY_H
+
+#include <mil.h>
+#include <atomic>
+
+#define REPLAY_MAX_SPEED         0.0   /* Frame rate to replay as fast as possible.  */
+#define REPLAY_FRAME_NB_MAX      256   /* Frames loaded from the source.             */
+#define REPLAY_BUFFER_NB_MAX     64    /* Buffers in the replay queue.               */
+#define REPLAY_WAIT_TIMEOUT      100   /* Event polling period, in ms.               */
+
+/* Replay pacing settings. */
+typedef struct
+   {
+   MIL_DOUBLE FrameRate;    /* Frames/sec, or REPLAY_MAX_SPEED.                      */
+   MIL_DOUBLE Jitter;       /* Random variation of the frame period, as a fraction. */
+   MIL_INT    BurstLength;  /* Frames per burst, or 0 for a steady rate.            */
+   MIL_DOUBLE BurstPause;   /* Pause after each burst, in sec.                      */
+   bool       KeepContainers; /* Replay .mbufc files as whole containers.         */
+   } ReplaySettings;
+
+/* Replay source data structure. */
+typedef struct
+   {
+   MIL_ID                    MilSystem;
+   MIL_ID                    FrameReadyEvent;    /* Signaled when a frame is queued. */
+   MIL_ID                    BufferFreeEvent;    /* Signaled when a buffer is freed. */
+   ReplaySettings            Settings;
+   MIL_ID                    FrameList[REPLAY_FRAME_NB_MAX];
+   MIL_INT                   NbFrames;
+   MIL_UINT32                RandomSeed;
+
+   /* Current processing. */
+   MIL_ID*                   BufferList;
+   MIL_INT                   NbBuffers;
+   MIL_DIG_HOOK_FUNCTION_PTR HookFunctionPtr;
+   void*                     HookDataPtr;
+   MIL_INT                   FrameCountMax;      /* 0 to replay until stopped.       */
+   MIL_ID                    ProducerThread;
+   MIL_ID                    HookThread;
+   bool                      Running;
+   MIL_ID                    SlotBuffer[REPLAY_BUFFER_NB_MAX];
+   MIL_DOUBLE                SlotTimeStamp[REPLAY_BUFFER_NB_MAX];
+   std::atomic<MIL_INT>      Head;
+   std::atomic<MIL_INT>      Tail;
+   std::atomic<bool>         Stop;
+   std::atomic<bool>         ProducerDone;
+   MIL_INT                   ProcessedCount;
+   MIL_INT                   MissedCount;
+   MIL_DOUBLE                StartTime;
+   MIL_DOUBLE                EndTime;
+   } ReplayStruct;
+
+/* Acquisition source of the ReplayDig...() functions: a digitizer, or a */
+/* replay source when ReplayPtr is set.                                  */
+typedef struct
+   {
+   MIL_ID        MilDigitizer;
+   ReplayStruct* ReplayPtr;
+   } ReplayDigitizer;
+
+/* Information on the frame being processed, returned by ReplayDigGetHookInfo(). */
+typedef struct
+   {
+   bool       Active;
+   MIL_ID     BufferId;
+   MIL_INT    BufferIndex;
+   MIL_DOUBLE TimeStamp;
+   } ReplayHookInfo;
+
+/* The callback function runs in the replay's hook thread; its frame */
+/* information is kept per thread.                                   */
+inline ReplayHookInfo& ReplayCurrentHookInfo()
+   {
+   static thread_local ReplayHookInfo Info = { false, M_NULL, 0, 0.0 };
+   return Info;
+   }
+
+/* Wait until the given time, sleeping while it is more than 2 ms away. */
+inline void ReplayWaitUntil(MIL_DOUBLE Time)
+   {
+   MIL_DOUBLE Now;
+
+   MappTimer(M_DEFAULT, M_TIMER_READ, &Now);
+   while (Now < Time)
+      {
+      if (Time - Now > 0.002)
+         MosSleep(1);
+      MappTimer(M_DEFAULT, M_TIMER_READ, &Now);
+      }
+   }
+
+/* Returns a pseudo-random value between -1 and 1. */
+inline MIL_DOUBLE ReplayRandom(ReplayStruct* ReplayPtr)
+   {
+   ReplayPtr->RandomSeed = ReplayPtr->RandomSeed * 1664525u + 1013904223u;
+   return (ReplayPtr->RandomSeed >> 8) / (MIL_DOUBLE)(1 << 23) - 1.0;
+   }
+
+/* Producer thread: queues the source frames at the replay's pace. */
+inline MIL_UINT32 MFTYPE ReplayProducerThread(void* ReplayDataPtr)
+   {
+   ReplayStruct* ReplayPtr = (ReplayStruct*)ReplayDataPtr;
+   MIL_INT    NbSlots = ReplayPtr->BufferList ? ReplayPtr->NbBuffers : REPLAY_BUFFER_NB_MAX;
+   bool       MaxSpeed = (ReplayPtr->Settings.FrameRate <= REPLAY_MAX_SPEED);
+   MIL_INT    FrameIndex = 0, FrameCount = 0;
+   MIL_DOUBLE NextTime = ReplayPtr->StartTime, Now;
+
+   while (!ReplayPtr->Stop &&
+          (ReplayPtr->FrameCountMax == 0 || FrameCount < ReplayPtr->FrameCountMax))
+      {
+      MIL_INT Head = ReplayPtr->Head.load(std::memory_order_relaxed);
+
+      if (!MaxSpeed)
+         {
+         ReplayWaitUntil(NextTime);
+
+         /* Next frame time; the schedule is absolute so errors do not accumulate. */
+         NextTime += (1.0 + ReplayPtr->Settings.Jitter * ReplayRandom(ReplayPtr)) /
+                     ReplayPtr->Settings.FrameRate;
+         if (ReplayPtr->Settings.BurstLength > 0 &&
+             (FrameCount + 1) % ReplayPtr->Settings.BurstLength == 0)
+            NextTime += ReplayPtr->Settings.BurstPause;
+         }
+
+      /* All the buffers are waiting to be processed. */
+      if (Head - ReplayPtr->Tail.load(std::memory_order_acquire) >= NbSlots)
+         {
+         if (!MaxSpeed)
+            {
+            ReplayPtr->MissedCount++;
+            FrameCount++;
+            FrameIndex = (FrameIndex + 1) % ReplayPtr->NbFrames;
+            continue;
+            }
+         while (!ReplayPtr->Stop &&
+                Head - ReplayPtr->Tail.load(std::memory_order_acquire) >= NbSlots)
+            MthrWait(ReplayPtr->BufferFreeEvent,
+                     M_EVENT_WAIT+M_EVENT_TIMEOUT(REPLAY_WAIT_TIMEOUT), M_NULL);
+         if (ReplayPtr->Stop)
+            break;
+         }
+
+      /* Copy the frame in the next buffer, or pass the source frame itself */
+      /* when no buffer list is given.                                      */
+      MIL_INT Slot = Head % NbSlots;
+      if (ReplayPtr->BufferList)
+         {
+         MbufCopy(ReplayPtr->FrameList[FrameIndex], ReplayPtr->BufferList[Slot]);
+         ReplayPtr->SlotBuffer[Slot] = ReplayPtr->BufferList[Slot];
+         }
+      else
+         ReplayPtr->SlotBuffer[Slot] = ReplayPtr->FrameList[FrameIndex];
+      MappTimer(M_DEFAULT, M_TIMER_READ, &Now);
+      ReplayPtr->SlotTimeStamp[Slot] = Now - ReplayPtr->StartTime;
+
+      ReplayPtr->Head.store(Head + 1, std::memory_order_release);
+      MthrControl(ReplayPtr->FrameReadyEvent, M_EVENT_SET, M_SIGNALED);
+
+      FrameCount++;
+      FrameIndex = (FrameIndex + 1) % ReplayPtr->NbFrames;
+      }
+
+   ReplayPtr->ProducerDone = true;
+   MthrControl(ReplayPtr->FrameReadyEvent, M_EVENT_SET, M_SIGNALED);
+   MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+   return 0;
+   }
+
+/* Hook thread: calls the callback function with each queued frame. */
+inline MIL_UINT32 MFTYPE ReplayHookThread(void* ReplayDataPtr)
+   {
+   ReplayStruct*   ReplayPtr = (ReplayStruct*)ReplayDataPtr;
+   ReplayHookInfo& Info = ReplayCurrentHookInfo();
+   MIL_INT         NbSlots = ReplayPtr->BufferList ? ReplayPtr->NbBuffers : REPLAY_BUFFER_NB_MAX;
+
+   while (true)
+      {
+      MIL_INT Tail = ReplayPtr->Tail.load(std::memory_order_relaxed);
+
+      /* Process the frames left in the queue after the producer ends. */
+      if (Tail == ReplayPtr->Head.load(std::memory_order_acquire))
+         {
+         if (ReplayPtr->ProducerDone && Tail == ReplayPtr->Head.load(std::memory_order_acquire))
+            break;
+         MthrWait(ReplayPtr->FrameReadyEvent, M_EVENT_WAIT+M_EVENT_TIMEOUT(REPLAY_WAIT_TIMEOUT), M_NULL);
+         continue;
+         }
+
+      Info.Active      = true;
+      Info.BufferId    = ReplayPtr->SlotBuffer[Tail % NbSlots];
+      Info.BufferIndex = Tail % NbSlots;
+      Info.TimeStamp   = ReplayPtr->SlotTimeStamp[Tail % NbSlots];
+      ReplayPtr->HookFunctionPtr(M_MODIFIED_BUFFER, M_NULL, ReplayPtr->HookDataPtr);
+      Info.Active      = false;
+
+      ReplayPtr->ProcessedCount++;
+      ReplayPtr->Tail.store(Tail + 1, std::memory_order_release);
+      MthrControl(ReplayPtr->BufferFreeEvent, M_EVENT_SET, M_SIGNALED);
+      }
+
+   MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+   MappTimer(M_DEFAULT, M_TIMER_READ, &ReplayPtr->EndTime);
+   return 0;
+   }
+
+/* Wait for the end of the replay threads and free them. */
+inline void ReplayEnd(ReplayStruct* ReplayPtr)
+   {
+   if (!ReplayPtr->Running)
+      return;
+   MthrWait(ReplayPtr->ProducerThread, M_THREAD_END_WAIT, M_NULL);
+   MthrWait(ReplayPtr->HookThread, M_THREAD_END_WAIT, M_NULL);
+   MthrFree(ReplayPtr->ProducerThread);
+   MthrFree(ReplayPtr->HookThread);
+   ReplayPtr->Running = false;
+   }
+
+/* Restore an image file, or a container file or its image component. */
+inline MIL_ID ReplayRestoreFrame(MIL_ID MilSystem, const MIL_STRING& FileName, bool KeepContainer)
+   {
+   MIL_ID RestoredId = M_NULL, ComponentId, FrameId = M_NULL;
+
+   MbufRestore(FileName, MilSystem, &RestoredId);
+   if (!RestoredId || KeepContainer || MbufInquire(RestoredId, M_OBJECT_TYPE, M_NULL) != M_CONTAINER)
+      return RestoredId;
+
+   /* Copy the intensity component, or the range component of a 3d container. */
+   ComponentId = MbufInquireContainer(RestoredId, M_COMPONENT_INTENSITY, M_COMPONENT_ID, M_NULL);
+   if (!ComponentId)
+      ComponentId = MbufInquireContainer(RestoredId, M_COMPONENT_RANGE, M_COMPONENT_ID, M_NULL);
+   if (ComponentId)
+      {
+      MbufAllocColor(MilSystem,
+                     MbufInquire(ComponentId, M_SIZE_BAND, M_NULL),
+                     MbufInquire(ComponentId, M_SIZE_X, M_NULL),
+                     MbufInquire(ComponentId, M_SIZE_Y, M_NULL),
+                     MbufInquire(ComponentId, M_TYPE, M_NULL),
+                     M_IMAGE+M_PROC, &FrameId);
+      MbufCopy(ComponentId, FrameId);
+      }
+   MbufFree(RestoredId);
+   return FrameId;
+   }
+
+/* Allocate a replay source; returns false if no frame can be loaded. */
+inline bool ReplayAlloc(MIL_ID MilSystem, MIL_CONST_TEXT_PTR Source,
+                        const ReplaySettings* SettingsPtr, ReplayDigitizer* DigitizerPtr)
+   {
+   ReplayStruct* ReplayPtr = new ReplayStruct;
+   MIL_STRING    SourceName = Source;
+   MIL_INT       NbFiles = 0;
+
+   ReplayPtr->MilSystem  = MilSystem;
+   ReplayPtr->Settings   = *SettingsPtr;
+   ReplayPtr->NbFrames   = 0;
+   ReplayPtr->RandomSeed = 1;
+   ReplayPtr->Running    = false;
+   ReplayPtr->Head       = 0;
+   ReplayPtr->Tail       = 0;
+
+   if (SourceName.size() > 4 &&
+       (SourceName.compare(SourceName.size() - 4, 4, MIL_TEXT(".avi")) == 0 ||
+        SourceName.compare(SourceName.size() - 4, 4, MIL_TEXT(".AVI")) == 0))
+      {
+      /* Load all the frames of the AVI file. */
+      MIL_INT SizeX, SizeY, SizeBand;
+      MbufDiskInquire(Source, M_NUMBER_OF_IMAGES, &ReplayPtr->NbFrames);
+      MbufDiskInquire(Source, M_SIZE_X, &SizeX);
+      MbufDiskInquire(Source, M_SIZE_Y, &SizeY);
+      MbufDiskInquire(Source, M_SIZE_BAND, &SizeBand);
+      if (ReplayPtr->NbFrames > REPLAY_FRAME_NB_MAX)
+         ReplayPtr->NbFrames = REPLAY_FRAME_NB_MAX;
+
+      for (MIL_INT i = 0; i < ReplayPtr->NbFrames; i++)
+         MbufAllocColor(MilSystem, SizeBand, SizeX, SizeY, 8+M_UNSIGNED,
+                        M_IMAGE+M_PROC, &ReplayPtr->FrameList[i]);
+      MbufImportSequence(Source, M_DEFAULT, M_NULL, M_NULL, M_NULL, M_NULL, M_NULL, M_OPEN);
+      MbufImportSequence(Source, M_DEFAULT, M_LOAD, M_NULL, ReplayPtr->FrameList,
+                         0, ReplayPtr->NbFrames, M_READ);
+      MbufImportSequence(Source, M_DEFAULT, M_NULL, M_NULL, M_NULL, M_NULL, M_NULL, M_CLOSE);
+      }
+   else
+      {
+      /* Restore the .mim files of the folder, or its .mbufc files if it has none. */
+      MIL_STRING FileToSearch = SourceName + MIL_TEXT("*.mim");
+      MappFileOperation(M_DEFAULT, FileToSearch, M_NULL, M_NULL, M_FILE_NAME_FIND_COUNT, M_DEFAULT, &NbFiles);
+      if (NbFiles == 0)
+         {
+         FileToSearch = SourceName + MIL_TEXT("*.mbufc");
+         MappFileOperation(M_DEFAULT, FileToSearch, M_NULL, M_NULL, M_FILE_NAME_FIND_COUNT, M_DEFAULT, &NbFiles);
+         }
+      for (MIL_INT i = 0; i < NbFiles && ReplayPtr->NbFrames < REPLAY_FRAME_NB_MAX; i++)
+         {
+         MIL_STRING FileName;
+         MappFileOperation(M_DEFAULT, FileToSearch, M_NULL, M_NULL, M_FILE_NAME_FIND, i, FileName);
+         ReplayPtr->FrameList[ReplayPtr->NbFrames] = ReplayRestoreFrame(MilSystem, SourceName + FileName,
+                                                                        SettingsPtr->KeepContainers);
+         if (ReplayPtr->FrameList[ReplayPtr->NbFrames])
+            ReplayPtr->NbFrames++;
+         }
+      }
+
+   DigitizerPtr->MilDigitizer = M_NULL;
+   DigitizerPtr->ReplayPtr    = M_NULL;
+   if (ReplayPtr->NbFrames == 0)
+      {
+      MosPrintf(MIL_TEXT("Unable to replay %s.\n"), Source);
+      delete ReplayPtr;
+      return false;
+      }
+
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL,
+             &ReplayPtr->FrameReadyEvent);
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL,
+             &ReplayPtr->BufferFreeEvent);
+
+   DigitizerPtr->ReplayPtr = ReplayPtr;
+   return true;
+   }
+
+/* Free a replay source. */
+inline void ReplayFree(ReplayDigitizer* DigitizerPtr)
+   {
+   ReplayStruct* ReplayPtr = DigitizerPtr->ReplayPtr;
+
+   if (!ReplayPtr)
+      return;
+
+   ReplayPtr->Stop = true;
+   ReplayEnd(ReplayPtr);
+   for (MIL_INT i = 0; i < ReplayPtr->NbFrames; i++)
+      MbufFree(ReplayPtr->FrameList[i]);
+   MthrFree(ReplayPtr->BufferFreeEvent);
+   MthrFree(ReplayPtr->FrameReadyEvent);
+   delete ReplayPtr;
+   DigitizerPtr->ReplayPtr = M_NULL;
+   }
+
+/* MdigProcess() equivalent. Supports M_START, M_STOP and M_SEQUENCE. The replay    */
+/* does not decode M_COUNT(): with M_SEQUENCE, it plays FrameCount frames, or until */
+/* stopped if FrameCount is 0. Pass the same count as in M_COUNT(), if any.         */
+/* Without a buffer list, the callback function gets the source frames.             */
+inline void ReplayDigProcess(ReplayDigitizer* DigitizerPtr, MIL_ID* BufferList, MIL_INT NbBuffers,
+                             MIL_INT Operation, MIL_INT OperationFlag,
+                             MIL_DIG_HOOK_FUNCTION_PTR HookFunctionPtr, void* HookDataPtr,
+                             MIL_INT FrameCount = 0)
+   {
+   ReplayStruct* ReplayPtr = DigitizerPtr->ReplayPtr;
+
+   if (!ReplayPtr)
+      {
+      MdigProcess(DigitizerPtr->MilDigitizer, BufferList, NbBuffers, Operation, OperationFlag,
+                  HookFunctionPtr, HookDataPtr);
+      return;
+      }
+
+   if (Operation == M_STOP || Operation == M_STOP+M_WAIT)
+      {
+      ReplayPtr->Stop = true;
+      ReplayEnd(ReplayPtr);
+      return;
+      }
+
+   /* Start a new replay. */
+   ReplayPtr->Stop = true;
+   ReplayEnd(ReplayPtr);
+   ReplayPtr->BufferList      = BufferList;
+   ReplayPtr->NbBuffers       = (NbBuffers < REPLAY_BUFFER_NB_MAX) ? NbBuffers : REPLAY_BUFFER_NB_MAX;
+   ReplayPtr->HookFunctionPtr = HookFunctionPtr;
+   ReplayPtr->HookDataPtr     = HookDataPtr;
+   ReplayPtr->FrameCountMax   = (Operation == M_START) ? 0 : FrameCount;
+   ReplayPtr->Head            = 0;
+   ReplayPtr->Tail            = 0;
+   ReplayPtr->Stop            = false;
+   ReplayPtr->ProducerDone    = false;
+   ReplayPtr->ProcessedCount  = 0;
+   ReplayPtr->MissedCount     = 0;
+   MappTimer(M_DEFAULT, M_TIMER_READ, &ReplayPtr->StartTime);
+   ReplayPtr->EndTime         = ReplayPtr->StartTime;
+
+   MthrAlloc(ReplayPtr->MilSystem, M_THREAD, M_DEFAULT, &ReplayHookThread, ReplayPtr,
+             &ReplayPtr->HookThread);
+   MthrAlloc(ReplayPtr->MilSystem, M_THREAD, M_DEFAULT, &ReplayProducerThread, ReplayPtr,
+             &ReplayPtr->ProducerThread);
+   ReplayPtr->Running = true;
+
+   if (Operation != M_START && OperationFlag == M_SYNCHRONOUS)
+      ReplayEnd(ReplayPtr);
+   }
+
+/* Returns the value of a replay inquiry. */
+inline MIL_DOUBLE ReplayInquireValue(ReplayStruct* ReplayPtr, MIL_INT InquireType)
+   {
+   MIL_DOUBLE EndTime = ReplayPtr->EndTime;
+
+   if (InquireType == M_SIZE_X || InquireType == M_SIZE_Y ||
+       InquireType == M_SIZE_BAND || InquireType == M_TYPE)
+      return (MIL_DOUBLE)MbufInquire(ReplayPtr->FrameList[0], InquireType, M_NULL);
+   if (InquireType == M_PROCESS_FRAME_COUNT)
+      return (MIL_DOUBLE)ReplayPtr->ProcessedCount;
+   if (InquireType == M_PROCESS_FRAME_MISSED)
+      return (MIL_DOUBLE)ReplayPtr->MissedCount;
+   if (InquireType == M_PROCESS_FRAME_RATE)
+      {
+      if (ReplayPtr->Running)
+         MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+      return (EndTime > ReplayPtr->StartTime) ?
+             ReplayPtr->ProcessedCount / (EndTime - ReplayPtr->StartTime) : 0.0;
+      }
+   return 0.0;
+   }
+
+/* MdigInquire() equivalent. */
+template <class T>
+inline MIL_INT ReplayDigInquire(ReplayDigitizer* DigitizerPtr, MIL_INT InquireType, T* UserVarPtr)
+   {
+   ReplayStruct* ReplayPtr = DigitizerPtr->ReplayPtr;
+   MIL_DOUBLE    Value;
+
+   if (!ReplayPtr)
+      return MdigInquire(DigitizerPtr->MilDigitizer, InquireType, UserVarPtr);
+
+   Value = ReplayInquireValue(ReplayPtr, InquireType);
+   if (UserVarPtr)
+      *UserVarPtr = (T)Value;
+   return (MIL_INT)Value;
+   }
+
+inline MIL_INT ReplayDigInquire(ReplayDigitizer* DigitizerPtr, MIL_INT InquireType, MIL_INT NullPtr)
+   {
+   ReplayStruct* ReplayPtr = DigitizerPtr->ReplayPtr;
+
+   if (!ReplayPtr)
+      return MdigInquire(DigitizerPtr->MilDigitizer, InquireType, M_NULL);
+   return (MIL_INT)ReplayInquireValue(ReplayPtr, InquireType);
+   }
+
+/* MdigGetHookInfo() equivalent. Supports M_MODIFIED_BUFFER+M_BUFFER_ID, */
+/* M_MODIFIED_BUFFER+M_BUFFER_INDEX and M_TIME_STAMP.                     */
+template <class T>
+inline MIL_INT ReplayDigGetHookInfo(MIL_ID HookId, MIL_INT InfoType, T* UserVarPtr)
+   {
+   const ReplayHookInfo& Info = ReplayCurrentHookInfo();
+
+   if (!Info.Active)
+      return MdigGetHookInfo(HookId, InfoType, UserVarPtr);
+
+   if (InfoType == M_MODIFIED_BUFFER+M_BUFFER_ID)
+      *UserVarPtr = (T)Info.BufferId;
+   else if (InfoType == M_MODIFIED_BUFFER+M_BUFFER_INDEX)
+      *UserVarPtr = (T)Info.BufferIndex;
+   else if (InfoType == M_TIME_STAMP)
+      *UserVarPtr = (T)Info.TimeStamp;
+   else
+      *UserVarPtr = (T)0;
+   return M_NULL;
+   }
+
+/* MdigGrab(), MdigGrabContinuous() and MdigHalt() equivalents; the replay shows */
+/* its first frame.                                                               */
+inline void ReplayDigGrab(ReplayDigitizer* DigitizerPtr, MIL_ID DestImageId)
+   {
+   if (DigitizerPtr->ReplayPtr)
+      MbufCopy(DigitizerPtr->ReplayPtr->FrameList[0], DestImageId);
+   else
+      MdigGrab(DigitizerPtr->MilDigitizer, DestImageId);
+   }
+
+inline void ReplayDigGrabContinuous(ReplayDigitizer* DigitizerPtr, MIL_ID DestImageId)
+   {
+   if (DigitizerPtr->ReplayPtr)
+      MbufCopy(DigitizerPtr->ReplayPtr->FrameList[0], DestImageId);
+   else
+      MdigGrabContinuous(DigitizerPtr->MilDigitizer, DestImageId);
+   }
+
+inline void ReplayDigHalt(ReplayDigitizer* DigitizerPtr)
+   {
+   if (!DigitizerPtr->ReplayPtr)
+      MdigHalt(DigitizerPtr->MilDigitizer);
+   }
+
+#endif
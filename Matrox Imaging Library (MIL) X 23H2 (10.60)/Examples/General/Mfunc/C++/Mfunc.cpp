@@ -10,32 +10,68 @@
  *            to MIL and calls the Slave function. The Slave function retrieves all the 
  *            parameters, gets the pointers to the MIL image buffers, uses them to access 
  *            the data directly and adds a constant.
+ *
+ *            The Slave function uses saturated arithmetic kernels vectorized with 
+ *            SSE2, AVX2, AVX-512 or NEON, selected at run time from the CPU. The 
+ *            buffer access, the type dispatch and the split of the rows between a 
+ *            pool of threads are done by the PixelKernel template layer. The 
+ *            example then compares their throughput with the scalar reference and 
+ *            with MimArith.
  *             
- *            Note: The images must be 8-bit unsigned and have a valid Host pointer.
+ *            Note: The images must be 8 or 16-bit, signed or unsigned, and have a 
+ *                  valid Host pointer.
  *
  * Copyright © Matrox Electronic Systems Ltd., 1992-2023.
  * All Rights Reserved
  */
 #include <mil.h>
+#include <string.h>
+#include "../../MfuncUtil/C++/PixelArith.h"
+#include "../../MfuncUtil/C++/PixelKernel.h"
 
 /* MIL function specifications. */
-#define FUNCTION_NB_PARAM                 4
+#define FUNCTION_NB_PARAM                 7
 #define FUNCTION_OPCODE_ADD_CONSTANT      1 
 #define FUNCTION_PARAMETER_ERROR_CODE     1
-#define FUNCTION_SUPPORTED_IMAGE_TYPE     (8+M_UNSIGNED)
+#define FUNCTION_SUPPORTED_IMAGE_TYPES    (PixelKernel::TYPE_8U  | PixelKernel::TYPE_8S | \
+                                           PixelKernel::TYPE_16U | PixelKernel::TYPE_16S)
 
 /* Target image file name. */
 #define IMAGE_FILE M_IMAGE_PATH MIL_TEXT("BoltsNutsWashers.mim")
 
+/* Throughput comparison specifications. */
+#define BENCHMARK_IMAGE_SIZE_X            1920
+#define BENCHMARK_IMAGE_SIZE_Y            1080
+#define BENCHMARK_NB_ITERATIONS           50
+
 /* Master and Slave MIL functions declarations. */
 MIL_INT AddConstant(MIL_ID SrcImageId, MIL_ID DstImageId, MIL_INT ConstantToAdd);
-void MFTYPE SlaveAddConstant(MIL_ID Func);
+MIL_INT ArithConstant(MIL_ID SrcImageId, MIL_ID DstImageId, MIL_INT Constant,
+                      MIL_INT Operation, MIL_INT InstructionSet, bool UseThreadPool);
+void MFTYPE SlaveArithConstant(MIL_ID Func);
+
+/* Pool of threads of the Slave function, allocated by the main. */
+static PixelKernel::CRowThreadPool* RowThreadPool = M_NULL;
+
+/* Throughput comparison of the custom function and MimArith. */
+void BenchmarkArithConstant(MIL_ID MilSystem);
 
 
-/* Master MIL Function definition. */
-/* ------------------------------- */
+/* Master MIL Function definitions. */
+/* -------------------------------- */
 
+/* Adds a constant with the best kernel for the CPU. */
 MIL_INT AddConstant(MIL_ID SrcImageId, MIL_ID DstImageId, MIL_INT ConstantToAdd)
+{
+   return ArithConstant(SrcImageId, DstImageId, ConstantToAdd, 
+                        PixelArith::enAdd, PixelArith::GetBestInstructionSet(), true);
+}
+
+/* Adds or subtracts a constant with the given kernel implementation, in the 
+   pool of threads or in the calling thread.
+*/
+MIL_INT ArithConstant(MIL_ID SrcImageId, MIL_ID DstImageId, MIL_INT Constant,
+                      MIL_INT Operation, MIL_INT InstructionSet, bool UseThreadPool)
 {
    MIL_ID   Func;
    MIL_INT  SlaveReturnValue = 0;
@@ -43,9 +79,9 @@ MIL_INT AddConstant(MIL_ID SrcImageId, MIL_ID DstImageId, MIL_INT ConstantToAdd)
    /* Allocate a MIL function context that will be used to call a target 
       Slave function locally on the Host to do the processing.
    */
-   MfuncAlloc(MIL_TEXT("AddConstant"), 
+   MfuncAlloc(MIL_TEXT("ArithConstant"), 
               FUNCTION_NB_PARAM,
-              SlaveAddConstant, M_NULL, M_NULL, 
+              SlaveArithConstant, M_NULL, M_NULL, 
               M_USER_MODULE_1+FUNCTION_OPCODE_ADD_CONSTANT, 
               M_LOCAL+M_SYNCHRONOUS_FUNCTION, 
               &Func
@@ -54,8 +90,11 @@ MIL_INT AddConstant(MIL_ID SrcImageId, MIL_ID DstImageId, MIL_INT ConstantToAdd)
    /* Register the parameters. */
    MfuncParamMilId( Func, 1, SrcImageId, M_IMAGE, M_IN);
    MfuncParamMilId( Func, 2, DstImageId, M_IMAGE, M_OUT);
-   MfuncParamMilInt(Func, 3, ConstantToAdd);
-   MfuncParamDataPointer(Func, 4, &SlaveReturnValue, sizeof(MIL_INT), M_OUT);
+   MfuncParamMilInt(Func, 3, Constant);
+   MfuncParamMilInt(Func, 4, Operation);
+   MfuncParamMilInt(Func, 5, InstructionSet);
+   MfuncParamMilInt(Func, 6, UseThreadPool ? M_YES : M_NO);
+   MfuncParamDataPointer(Func, 7, &SlaveReturnValue, sizeof(MIL_INT), M_OUT);
 
    /* Call the target Slave function. */
    MfuncCall(Func);
@@ -71,92 +110,235 @@ MIL_INT AddConstant(MIL_ID SrcImageId, MIL_ID DstImageId, MIL_INT ConstantToAdd)
 /* MIL Slave function definition. */
 /* ------------------------------ */
 
-void MFTYPE SlaveAddConstant(MIL_ID Func)
+/* Row functor of the Slave function. It is called by the PixelKernel layer for 
+   each row of each band, with the data pointers of the buffers.
+*/
+struct ArithConstantRowFunctor
+   {
+   PixelArith::KernelStruct Kernel;
+
+   template <class T>
+   void operator()(const PixelKernel::BandRow<const T>& Src, const PixelKernel::BandRow<T>& Dst,
+                   MIL_INT NumPixels) const
+      {
+      if ((Src.Stride == 1) && (Dst.Stride == 1))
+         PixelArith::ProcessRow(Kernel, Src.Ptr, Dst.Ptr, NumPixels);
+      else
+         {
+         /* The bands of packed buffers are interleaved; process them pixel by pixel. */
+         for (MIL_INT x = 0; x < NumPixels; x++)
+            PixelArith::ProcessRow(Kernel, &Src[x], &Dst[x], 1);
+         }
+      }
+   };
+
+void MFTYPE SlaveArithConstant(MIL_ID Func)
 {
   MIL_ID    SrcImageId, DstImageId;
-  MIL_INT   ConstantToAdd, TempValue;
-  unsigned  char *SrcImageDataPtr, *DstImageDataPtr;
-  MIL_INT   SrcImageSizeX, SrcImageSizeY, SrcImageType, SrcImagePitchByte;
-  MIL_INT   DstImageSizeX, DstImageSizeY, DstImageType, DstImagePitchByte;
-  MIL_INT   x, y;
+  MIL_INT   Constant, Operation, InstructionSet, UseThreadPool;
   MIL_INT  *SlaveReturnValuePtr;
+  ArithConstantRowFunctor RowFunctor;
+  PixelKernel::StatusEnum Status = PixelKernel::enUnsupportedType;
 
   /* Read the parameters. */
   MfuncParamValue(Func, 1, &SrcImageId);
   MfuncParamValue(Func, 2, &DstImageId);
-  MfuncParamValue(Func, 3, &ConstantToAdd); 
-  MfuncParamValue(Func, 4, &SlaveReturnValuePtr); 
-
-  /* Lock buffers for direct access. */
-  MbufControl(SrcImageId, M_LOCK, M_DEFAULT);
-  MbufControl(DstImageId, M_LOCK, M_DEFAULT);
-
-  /* Read image information. */
-  MbufInquire(SrcImageId, M_HOST_ADDRESS, &SrcImageDataPtr);
-  MbufInquire(SrcImageId, M_SIZE_X,       &SrcImageSizeX);
-  MbufInquire(SrcImageId, M_SIZE_Y,       &SrcImageSizeY);
-  MbufInquire(SrcImageId, M_TYPE,         &SrcImageType);
-  MbufInquire(SrcImageId, M_PITCH_BYTE,   &SrcImagePitchByte);
-  MbufInquire(DstImageId, M_HOST_ADDRESS, &DstImageDataPtr);
-  MbufInquire(DstImageId, M_SIZE_X,       &DstImageSizeX);
-  MbufInquire(DstImageId, M_SIZE_Y,       &DstImageSizeY);
-  MbufInquire(DstImageId, M_TYPE,         &DstImageType);
-  MbufInquire(DstImageId, M_PITCH_BYTE,   &DstImagePitchByte);
-
-  /* Reduce the destination area to process if necessary. */
-  if (SrcImageSizeX < DstImageSizeX)   DstImageSizeX = SrcImageSizeX;
-  if (SrcImageSizeY < DstImageSizeY)   DstImageSizeY = SrcImageSizeY;
-
-  /* If images have the proper type and a valid host pointer,
-     execute the operation using custom C code.
-   */
-  if ((SrcImageType == DstImageType) && (SrcImageType == FUNCTION_SUPPORTED_IMAGE_TYPE) &&
-      (SrcImageDataPtr != M_NULL) && (DstImageDataPtr != M_NULL)
-     )
+  MfuncParamValue(Func, 3, &Constant); 
+  MfuncParamValue(Func, 4, &Operation); 
+  MfuncParamValue(Func, 5, &InstructionSet); 
+  MfuncParamValue(Func, 6, &UseThreadPool); 
+  MfuncParamValue(Func, 7, &SlaveReturnValuePtr); 
+
+  /* Check that the CPU supports the requested instruction set. */
+  if (!PixelArith::IsInstructionSetAvailable((PixelArith::InstructionSetEnum)InstructionSet))
+     {
+     MfuncErrorReport(Func,M_FUNC_ERROR+FUNCTION_PARAMETER_ERROR_CODE,
+                      MIL_TEXT("Invalid parameter."),
+                      MIL_TEXT("Instruction set not supported by the CPU."),
+                      M_NULL,
+                      M_NULL
+                     );
+     *SlaveReturnValuePtr = M_FUNC_ERROR+FUNCTION_PARAMETER_ERROR_CODE;
+     return;
+     }
+
+  /* Prepare the kernel of the image type. */
+  if (PixelArith::GetKernel((PixelArith::InstructionSetEnum)InstructionSet, 
+                            (PixelArith::OperationEnum)Operation, 
+                            MbufInquire(SrcImageId, M_TYPE, M_NULL), Constant, &RowFunctor.Kernel))
+     {
+     /* Lock the buffers, call the kernel on each row and unlock the buffers. The rows 
+        are split between the threads of the pool. The area is the smallest of the 
+        two buffers, which can be children or the same buffer.
+     */
+     Status = PixelKernel::Transform(SrcImageId, DstImageId, RowFunctor, FUNCTION_SUPPORTED_IMAGE_TYPES,
+                                     (UseThreadPool == M_YES) ? RowThreadPool : M_NULL);
+     }
+
+  if (Status == PixelKernel::enOk)
      {
-     /* Add the constant to the image. */
-     for (y= 0; y < DstImageSizeY; y++)
-        {
-        for (x= 0; x < DstImageSizeX; x++) 
-           {
-           /* Calculate the value to write. */
-           TempValue = (MIL_INT)SrcImageDataPtr[x] + (MIL_INT)ConstantToAdd;
-
-           /* Write the value if no overflow, else saturate. */
-           if (TempValue <= 0xff)
-              DstImageDataPtr[x] = (unsigned char)TempValue;
-           else 
-              DstImageDataPtr[x] = 0xff;
-           }
-
-         /* Move pointer to the next line taking into account the image's pitch. */
-         SrcImageDataPtr += SrcImagePitchByte;
-         DstImageDataPtr += DstImagePitchByte;
-        }
-     
      /* Return a null error code to the Master function. */
      *SlaveReturnValuePtr = M_NULL;
      }
   else 
      {
      /* Buffer cannot be processed. Report an error. */ 
-     MfuncErrorReport(Func,M_FUNC_ERROR+FUNCTION_PARAMETER_ERROR_CODE,
-                      MIL_TEXT("Invalid parameter."),
-                      MIL_TEXT("Image type not supported or invalid target system."),
-                      MIL_TEXT("Image must be 8-bit and have a valid host address."),
-                      M_NULL
-                     );
+     PixelKernel::ReportError(Func, FUNCTION_PARAMETER_ERROR_CODE, Status);
 
      /* Return an error code to the Master function. */
      *SlaveReturnValuePtr = M_FUNC_ERROR+FUNCTION_PARAMETER_ERROR_CODE;
      }
+}
+
+
+/* Throughput comparison of the custom function and MimArith. */
+/* ----------------------------------------------------------- */
+
+/* Times an implementation and returns the time per image in ms. Implementation is
+   an instruction set of the custom function, or -1 for MimArith.
+*/
+static MIL_DOUBLE TimeArithConstant(MIL_ID SrcImage, MIL_ID DstImage, MIL_INT Constant,
+                                    MIL_INT Operation, MIL_INT Implementation, bool UseThreadPool)
+{
+   MIL_DOUBLE Time = 0.0;
+   MIL_INT    i;
 
-  /* Unlock buffers. */
-  MbufControl(SrcImageId, M_UNLOCK, M_DEFAULT);
-  MbufControl(DstImageId, M_UNLOCK, M_DEFAULT);
+   /* The first call is not timed. */
+   for (i = 0; i <= BENCHMARK_NB_ITERATIONS; i++)
+      {
+      if (i == 1)
+         MappTimer(M_DEFAULT, M_TIMER_RESET+M_SYNCHRONOUS, M_NULL);
 
-  /* Signal to MIL that the destination buffer was modified. */
-  MbufControl(DstImageId, M_MODIFIED, M_DEFAULT); 
+      if (Implementation < 0)
+         MimArith(SrcImage, (MIL_DOUBLE)Constant, DstImage, 
+                  ((Operation == PixelArith::enAdd) ? M_ADD_CONST : M_SUB_CONST)+M_SATURATION);
+      else
+         ArithConstant(SrcImage, DstImage, Constant, Operation, Implementation, UseThreadPool);
+      }
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &Time);
+
+   return Time*1000.0/BENCHMARK_NB_ITERATIONS;
+}
+
+void BenchmarkArithConstant(MIL_ID MilSystem)
+{
+   static const MIL_INT            ImageTypes[] = { 8+M_UNSIGNED, 8+M_SIGNED, 16+M_UNSIGNED, 16+M_SIGNED };
+   static const MIL_CONST_TEXT_PTR TypeNames[]  = { MIL_TEXT("8u"), MIL_TEXT("8s"), MIL_TEXT("16u"), MIL_TEXT("16s") };
+   static const MIL_INT            Constants[]  = { 0x40, 0x40, 0x1000, 0x1000 };
+   const MIL_INT NbTypes = sizeof(ImageTypes)/sizeof(ImageTypes[0]);
+
+   MIL_ID      MilSrcImage, MilRefImage, MilDstImage,   /* Image buffer identifiers. */
+               MilSrcChild, MilRefChild, MilDstChild;   /* Unaligned child buffers.  */
+   MIL_INT     ChildSizeX, ChildSizeY, BufferSize;
+   MIL_INT     t, Operation, Implementation, i;
+   MIL_UINT8  *RefData, *DstData;
+   MIL_UINT32  Seed = 1;
+   MIL_DOUBLE  ReferenceTime, Time;
+   MIL_TEXT_CHAR ThreadPoolName[32];
+
+   /* The children start on an odd pixel and have an odd width, so that the rows 
+      are not aligned and end with a partial vector.
+   */
+   ChildSizeX = BENCHMARK_IMAGE_SIZE_X-3;
+   ChildSizeY = BENCHMARK_IMAGE_SIZE_Y-2;
+   BufferSize = ChildSizeX*ChildSizeY*2;
+   RefData = new MIL_UINT8[BufferSize];
+   DstData = new MIL_UINT8[BufferSize];
+
+   MosPrintf(MIL_TEXT("Saturated arithmetic on a %d x %d child buffer, %d iterations.\n"),
+             (int)ChildSizeX, (int)ChildSizeY, (int)BENCHMARK_NB_ITERATIONS);
+   MosPrintf(MIL_TEXT("Best kernel for this CPU: %s.\n"),
+             PixelArith::GetInstructionSetName(PixelArith::GetBestInstructionSet()));
+   MosPrintf(MIL_TEXT("Threads of the pool: %d.\n\n"), (int)PixelKernel::GetNumThreads(RowThreadPool));
+   MosSprintf(ThreadPoolName, 32, MIL_TEXT("%s x%d"),
+              PixelArith::GetInstructionSetName(PixelArith::GetBestInstructionSet()),
+              (int)PixelKernel::GetNumThreads(RowThreadPool));
+   MosPrintf(MIL_TEXT("Type  Op   Implementation  ms/image  MPixel/s  Speedup  Result\n"));
+   MosPrintf(MIL_TEXT("----  ---  --------------  --------  --------  -------  ---------\n"));
+
+   for (t = 0; t < NbTypes; t++)
+      {
+      MbufAlloc2d(MilSystem, BENCHMARK_IMAGE_SIZE_X, BENCHMARK_IMAGE_SIZE_Y, ImageTypes[t],
+                  M_IMAGE+M_PROC+M_HOST_MEMORY, &MilSrcImage);
+      MbufAlloc2d(MilSystem, BENCHMARK_IMAGE_SIZE_X, BENCHMARK_IMAGE_SIZE_Y, ImageTypes[t],
+                  M_IMAGE+M_PROC+M_HOST_MEMORY, &MilRefImage);
+      MbufAlloc2d(MilSystem, BENCHMARK_IMAGE_SIZE_X, BENCHMARK_IMAGE_SIZE_Y, ImageTypes[t],
+                  M_IMAGE+M_PROC+M_HOST_MEMORY, &MilDstImage);
+      MbufChild2d(MilSrcImage, 1, 1, ChildSizeX, ChildSizeY, &MilSrcChild);
+      MbufChild2d(MilRefImage, 1, 1, ChildSizeX, ChildSizeY, &MilRefChild);
+      MbufChild2d(MilDstImage, 1, 1, ChildSizeX, ChildSizeY, &MilDstChild);
+
+      /* Fill the source with pseudo-random values, so that some of the results 
+         saturate.
+      */
+      for (i = 0; i < BufferSize; i++)
+         {
+         Seed = Seed*1103515245 + 12345;
+         RefData[i] = (MIL_UINT8)(Seed >> 16);
+         }
+      MbufPut(MilSrcChild, RefData);
+
+      for (Operation = PixelArith::enAdd; Operation <= PixelArith::enSub; Operation++)
+         {
+         /* The scalar kernel is the reference of the results and of the speedups. */
+         ReferenceTime = TimeArithConstant(MilSrcChild, MilRefChild, Constants[t], Operation, 
+                                           PixelArith::enScalar, false);
+         MbufGet(MilRefChild, RefData);
+
+         /* The last implementation is the best kernel with the rows split between the 
+            threads of the pool. The others run in the calling thread.
+         */
+         for (Implementation = -1; Implementation <= PixelArith::enNumInstructionSets; Implementation++)
+            {
+            MIL_CONST_TEXT_PTR Name = MIL_TEXT("MimArith");
+            MIL_CONST_TEXT_PTR Result = MIL_TEXT("reference");
+            MIL_INT            InstructionSet = Implementation;
+            bool               UseThreadPool = false;
+
+            if (Implementation == PixelArith::enNumInstructionSets)
+               {
+               InstructionSet = PixelArith::GetBestInstructionSet();
+               UseThreadPool = true;
+               Name = ThreadPoolName;
+               }
+            else if (Implementation >= 0)
+               {
+               if (!PixelArith::IsInstructionSetAvailable((PixelArith::InstructionSetEnum)Implementation))
+                  continue;
+               Name = PixelArith::GetInstructionSetName((PixelArith::InstructionSetEnum)Implementation);
+               }
+
+            if (Implementation == PixelArith::enScalar)
+               Time = ReferenceTime;
+            else
+               {
+               /* Check that the results are those of the reference. */
+               MbufClear(MilDstImage, 0);
+               Time = TimeArithConstant(MilSrcChild, MilDstChild, Constants[t], Operation, InstructionSet,
+                                        UseThreadPool);
+               MbufGet(MilDstChild, DstData);
+               Result = (memcmp(RefData, DstData, ChildSizeX*ChildSizeY*
+                                MbufInquire(MilDstChild, M_SIZE_BIT, M_NULL)/8) == 0) ?
+                        MIL_TEXT("identical") : MIL_TEXT("DIFFERENT");
+               }
+
+            MosPrintf(MIL_TEXT("%-4s  %-3s  %-14s  %8.3f  %8.1f  %6.1fx  %s\n"),
+                      TypeNames[t], (Operation == PixelArith::enAdd) ? MIL_TEXT("Add") : MIL_TEXT("Sub"),
+                      Name, Time, (ChildSizeX*ChildSizeY)/(Time*1000.0), ReferenceTime/Time, Result);
+            }
+         }
+
+      MbufFree(MilDstChild);
+      MbufFree(MilRefChild);
+      MbufFree(MilSrcChild);
+      MbufFree(MilDstImage);
+      MbufFree(MilRefImage);
+      MbufFree(MilSrcImage);
+      }
+   MosPrintf(MIL_TEXT("\n"));
+
+   delete [] RefData;
+   delete [] DstData;
 }
 
 
@@ -174,6 +356,10 @@ int MosMain(void)
    /* Allocate default application, system, display and image. */
    MappAllocDefault(M_DEFAULT, &MilApplication, &MilSystem, &MilDisplay, M_NULL, M_NULL);
 
+   /* Allocate the pool of threads of the Slave function, one per core. */
+   RowThreadPool = new PixelKernel::CRowThreadPool(MilSystem, 
+                      MappInquireMp(M_DEFAULT, M_CORE_NUM_PROCESS, M_DEFAULT, M_DEFAULT, M_NULL));
+
    /* Load source image into a Host memory image buffer. */
    MbufAlloc2d(MilSystem, 
                MbufDiskInquire(IMAGE_FILE, M_SIZE_X, M_NULL), 
@@ -206,6 +392,11 @@ int MosMain(void)
          MosPrintf(MIL_TEXT("The white level of the image was augmented.\n"));
       else
          MosPrintf(MIL_TEXT("An error was returned by the Slave function.\n"));
+
+      /* Compare the throughput of the kernels and of MimArith. */
+      MosPrintf(MIL_TEXT("Press a key to compare the throughput of the implementations.\n\n"));
+      MosGetch();
+      BenchmarkArithConstant(MilSystem);
       }
    else
       {
@@ -219,6 +410,8 @@ int MosMain(void)
 
    /* Free all allocations. */
    MbufFree(MilImage);
+   delete RowThreadPool;
+   RowThreadPool = M_NULL;
    MappFreeDefault(MilApplication, MilSystem, MilDisplay, M_NULL, M_NULL);
 
    return 0;
@@ -0,0 +1,487 @@
+﻿/************************************************************************************/
+/*
+* File name: PixelArith.cpp
+*
+* Synopsis:  This file contains the scalar and vectorized saturated arithmetic
+*            kernels and their run-time dispatch.
+*
+* Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+* All Rights Reserved
+*/
+#include <mil.h>
+#include "PixelArith.h"
+
+/* Instruction sets that can be compiled in. */
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXEL_ARITH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__) || defined(__ARM_NEON)
+#define PIXEL_ARITH_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* With GCC and Clang, the functions using instructions beyond the compiler's
+   target must be marked with the instruction set. MSVC needs no option.
+*/
+#if defined(PIXEL_ARITH_X86) && !defined(_MSC_VER)
+#define PIXEL_ARITH_TARGET_SSE2   __attribute__((target("sse2")))
+#define PIXEL_ARITH_TARGET_AVX2   __attribute__((target("avx2")))
+#define PIXEL_ARITH_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define PIXEL_ARITH_TARGET_SSE2
+#define PIXEL_ARITH_TARGET_AVX2
+#define PIXEL_ARITH_TARGET_AVX512
+#endif
+
+/* Supported pixel types. */
+enum PixelTypeEnum
+   {
+   enUnsigned8,
+   enSigned8,
+   enUnsigned16,
+   enSigned16,
+   enNumPixelTypes,
+   enInvalidPixelType = enNumPixelTypes
+   };
+
+/*****************************************************************************/
+/* GetPixelType. Returns the kernel pixel type of a MIL buffer type.         */
+/*****************************************************************************/
+static PixelTypeEnum GetPixelType(MIL_INT BufferType)
+   {
+   switch (BufferType)
+      {
+      case 8+M_UNSIGNED:   return enUnsigned8;
+      case 8+M_SIGNED:     return enSigned8;
+      case 16+M_UNSIGNED:  return enUnsigned16;
+      case 16+M_SIGNED:    return enSigned16;
+      default:             return enInvalidPixelType;
+      }
+   }
+
+/*****************************************************************************/
+/* GetPixelRange. Returns the minimum and maximum values of a pixel type.    */
+/*****************************************************************************/
+static void GetPixelRange(PixelTypeEnum PixelType, MIL_INT* MinValue, MIL_INT* MaxValue)
+   {
+   switch (PixelType)
+      {
+      case enUnsigned8:  *MinValue = 0;       *MaxValue = 0xFF;   break;
+      case enSigned8:    *MinValue = -0x80;   *MaxValue = 0x7F;   break;
+      case enUnsigned16: *MinValue = 0;       *MaxValue = 0xFFFF; break;
+      case enSigned16:
+      default:           *MinValue = -0x8000; *MaxValue = 0x7FFF; break;
+      }
+   }
+
+/*****************************************************************************/
+/* Clamp. Saturates a value to a range.                                      */
+/*****************************************************************************/
+static inline MIL_INT Clamp(MIL_INT Value, MIL_INT MinValue, MIL_INT MaxValue)
+   {
+   return (Value < MinValue) ? MinValue : ((Value > MaxValue) ? MaxValue : Value);
+   }
+
+/* Scalar reference kernels. */
+/* ------------------------- */
+
+template <class PixelType, MIL_INT MinValue, MIL_INT MaxValue>
+static void ScalarAddRow(const void* SrcPtr, void* DstPtr, MIL_INT NumPixels, MIL_INT Constant)
+   {
+   const PixelType* pSrc = (const PixelType*)SrcPtr;
+   PixelType*       pDst = (PixelType*)DstPtr;
+
+   for (MIL_INT x = 0; x < NumPixels; x++)
+      pDst[x] = (PixelType)Clamp((MIL_INT)pSrc[x] + Constant, MinValue, MaxValue);
+   }
+
+template <class PixelType, MIL_INT MinValue, MIL_INT MaxValue>
+static void ScalarSubRow(const void* SrcPtr, void* DstPtr, MIL_INT NumPixels, MIL_INT Constant)
+   {
+   const PixelType* pSrc = (const PixelType*)SrcPtr;
+   PixelType*       pDst = (PixelType*)DstPtr;
+
+   for (MIL_INT x = 0; x < NumPixels; x++)
+      pDst[x] = (PixelType)Clamp((MIL_INT)pSrc[x] - Constant, MinValue, MaxValue);
+   }
+
+#define SCALAR_U8   MIL_UINT8,  0,       0xFF
+#define SCALAR_S8   MIL_INT8,   -0x80,   0x7F
+#define SCALAR_U16  MIL_UINT16, 0,       0xFFFF
+#define SCALAR_S16  MIL_INT16,  -0x8000, 0x7FFF
+
+/* Vectorized kernels. */
+/* ------------------- */
+/*
+ * Each kernel processes the first pixels one by one up to the alignment of the
+ * destination, then whole vectors with unaligned loads, and the last pixels with
+ * the scalar kernel. This supports any pitch and any child buffer offset.
+ */
+#define VECTOR_ROW_KERNEL(Name, Target, VectorType, VectorBytes, PixelType, Load, Store,       \
+                          Set1, SetType, Operation, ScalarRow)                                 \
+static Target void Name(const void* SrcPtr, void* DstPtr, MIL_INT NumPixels, MIL_INT Constant) \
+   {                                                                                           \
+   const PixelType* pSrc = (const PixelType*)SrcPtr;                                           \
+   PixelType*       pDst = (PixelType*)DstPtr;                                                 \
+   const MIL_INT    PixelsPerVector = (VectorBytes)/(MIL_INT)sizeof(PixelType);                \
+   MIL_INT          Head = (MIL_INT)((((VectorBytes) - ((MIL_UINT)pDst & ((VectorBytes)-1))) & \
+                                      ((VectorBytes)-1))/sizeof(PixelType));                   \
+   MIL_INT          x;                                                                         \
+                                                                                               \
+   if (Head > NumPixels)                                                                       \
+      Head = NumPixels;                                                                        \
+   ScalarRow(pSrc, pDst, Head, Constant);                                                      \
+                                                                                               \
+   const VectorType VectorConstant = Set1((SetType)Constant);                                  \
+   for (x = Head; x + 2*PixelsPerVector <= NumPixels; x += 2*PixelsPerVector)                  \
+      {                                                                                        \
+      VectorType Value0 = Load((pSrc + x));                                                    \
+      VectorType Value1 = Load((pSrc + x + PixelsPerVector));                                  \
+      Store((pDst + x), Operation(Value0, VectorConstant));                                    \
+      Store((pDst + x + PixelsPerVector), Operation(Value1, VectorConstant));                  \
+      }                                                                                        \
+   for (; x + PixelsPerVector <= NumPixels; x += PixelsPerVector)                              \
+      Store((pDst + x), Operation(Load((pSrc + x)), VectorConstant));                          \
+                                                                                               \
+   ScalarRow(pSrc + x, pDst + x, NumPixels - x, Constant);                                     \
+   }
+
+#if defined(PIXEL_ARITH_X86)
+
+#define LOAD_128(Ptr)         _mm_loadu_si128((const __m128i*)(Ptr))
+#define STORE_128(Ptr, V)     _mm_storeu_si128((__m128i*)(Ptr), (V))
+#define LOAD_256(Ptr)         _mm256_loadu_si256((const __m256i*)(Ptr))
+#define STORE_256(Ptr, V)     _mm256_storeu_si256((__m256i*)(Ptr), (V))
+#define LOAD_512(Ptr)         _mm512_loadu_si512((const void*)(Ptr))
+#define STORE_512(Ptr, V)     _mm512_storeu_si512((void*)(Ptr), (V))
+
+/* SSE2. */
+#define SSE2_KERNEL(Name, PixelType, Set1, SetType, Operation, ScalarRow)                      \
+   VECTOR_ROW_KERNEL(Name, PIXEL_ARITH_TARGET_SSE2, __m128i, 16, PixelType, LOAD_128, STORE_128, \
+                     Set1, SetType, Operation, ScalarRow)
+SSE2_KERNEL(SSE2AddU8Row,  MIL_UINT8,  _mm_set1_epi8,  char,  _mm_adds_epu8,  (ScalarAddRow<SCALAR_U8>))
+SSE2_KERNEL(SSE2AddS8Row,  MIL_INT8,   _mm_set1_epi8,  char,  _mm_adds_epi8,  (ScalarAddRow<SCALAR_S8>))
+SSE2_KERNEL(SSE2AddU16Row, MIL_UINT16, _mm_set1_epi16, short, _mm_adds_epu16, (ScalarAddRow<SCALAR_U16>))
+SSE2_KERNEL(SSE2AddS16Row, MIL_INT16,  _mm_set1_epi16, short, _mm_adds_epi16, (ScalarAddRow<SCALAR_S16>))
+SSE2_KERNEL(SSE2SubU8Row,  MIL_UINT8,  _mm_set1_epi8,  char,  _mm_subs_epu8,  (ScalarSubRow<SCALAR_U8>))
+SSE2_KERNEL(SSE2SubS8Row,  MIL_INT8,   _mm_set1_epi8,  char,  _mm_subs_epi8,  (ScalarSubRow<SCALAR_S8>))
+SSE2_KERNEL(SSE2SubU16Row, MIL_UINT16, _mm_set1_epi16, short, _mm_subs_epu16, (ScalarSubRow<SCALAR_U16>))
+SSE2_KERNEL(SSE2SubS16Row, MIL_INT16,  _mm_set1_epi16, short, _mm_subs_epi16, (ScalarSubRow<SCALAR_S16>))
+
+/* AVX2. */
+#define AVX2_KERNEL(Name, PixelType, Set1, SetType, Operation, ScalarRow)                      \
+   VECTOR_ROW_KERNEL(Name, PIXEL_ARITH_TARGET_AVX2, __m256i, 32, PixelType, LOAD_256, STORE_256, \
+                     Set1, SetType, Operation, ScalarRow)
+AVX2_KERNEL(AVX2AddU8Row,  MIL_UINT8,  _mm256_set1_epi8,  char,  _mm256_adds_epu8,  (ScalarAddRow<SCALAR_U8>))
+AVX2_KERNEL(AVX2AddS8Row,  MIL_INT8,   _mm256_set1_epi8,  char,  _mm256_adds_epi8,  (ScalarAddRow<SCALAR_S8>))
+AVX2_KERNEL(AVX2AddU16Row, MIL_UINT16, _mm256_set1_epi16, short, _mm256_adds_epu16, (ScalarAddRow<SCALAR_U16>))
+AVX2_KERNEL(AVX2AddS16Row, MIL_INT16,  _mm256_set1_epi16, short, _mm256_adds_epi16, (ScalarAddRow<SCALAR_S16>))
+AVX2_KERNEL(AVX2SubU8Row,  MIL_UINT8,  _mm256_set1_epi8,  char,  _mm256_subs_epu8,  (ScalarSubRow<SCALAR_U8>))
+AVX2_KERNEL(AVX2SubS8Row,  MIL_INT8,   _mm256_set1_epi8,  char,  _mm256_subs_epi8,  (ScalarSubRow<SCALAR_S8>))
+AVX2_KERNEL(AVX2SubU16Row, MIL_UINT16, _mm256_set1_epi16, short, _mm256_subs_epu16, (ScalarSubRow<SCALAR_U16>))
+AVX2_KERNEL(AVX2SubS16Row, MIL_INT16,  _mm256_set1_epi16, short, _mm256_subs_epi16, (ScalarSubRow<SCALAR_S16>))
+
+/* AVX-512 (BW). */
+#define AVX512_KERNEL(Name, PixelType, Set1, SetType, Operation, ScalarRow)                    \
+   VECTOR_ROW_KERNEL(Name, PIXEL_ARITH_TARGET_AVX512, __m512i, 64, PixelType, LOAD_512, STORE_512, \
+                     Set1, SetType, Operation, ScalarRow)
+AVX512_KERNEL(AVX512AddU8Row,  MIL_UINT8,  _mm512_set1_epi8,  char,  _mm512_adds_epu8,  (ScalarAddRow<SCALAR_U8>))
+AVX512_KERNEL(AVX512AddS8Row,  MIL_INT8,   _mm512_set1_epi8,  char,  _mm512_adds_epi8,  (ScalarAddRow<SCALAR_S8>))
+AVX512_KERNEL(AVX512AddU16Row, MIL_UINT16, _mm512_set1_epi16, short, _mm512_adds_epu16, (ScalarAddRow<SCALAR_U16>))
+AVX512_KERNEL(AVX512AddS16Row, MIL_INT16,  _mm512_set1_epi16, short, _mm512_adds_epi16, (ScalarAddRow<SCALAR_S16>))
+AVX512_KERNEL(AVX512SubU8Row,  MIL_UINT8,  _mm512_set1_epi8,  char,  _mm512_subs_epu8,  (ScalarSubRow<SCALAR_U8>))
+AVX512_KERNEL(AVX512SubS8Row,  MIL_INT8,   _mm512_set1_epi8,  char,  _mm512_subs_epi8,  (ScalarSubRow<SCALAR_S8>))
+AVX512_KERNEL(AVX512SubU16Row, MIL_UINT16, _mm512_set1_epi16, short, _mm512_subs_epu16, (ScalarSubRow<SCALAR_U16>))
+AVX512_KERNEL(AVX512SubS16Row, MIL_INT16,  _mm512_set1_epi16, short, _mm512_subs_epi16, (ScalarSubRow<SCALAR_S16>))
+
+#endif
+
+#if defined(PIXEL_ARITH_NEON)
+
+/* NEON. */
+#define NEON_KERNEL(Name, VectorType, PixelType, Load, Store, Set1, SetType, Operation, ScalarRow) \
+   VECTOR_ROW_KERNEL(Name, , VectorType, 16, PixelType, Load, Store, Set1, SetType, Operation, ScalarRow)
+NEON_KERNEL(NEONAddU8Row,  uint8x16_t, MIL_UINT8,  vld1q_u8,  vst1q_u8,  vdupq_n_u8,  uint8_t,  vqaddq_u8,  (ScalarAddRow<SCALAR_U8>))
+NEON_KERNEL(NEONAddS8Row,  int8x16_t,  MIL_INT8,   vld1q_s8,  vst1q_s8,  vdupq_n_s8,  int8_t,   vqaddq_s8,  (ScalarAddRow<SCALAR_S8>))
+NEON_KERNEL(NEONAddU16Row, uint16x8_t, MIL_UINT16, vld1q_u16, vst1q_u16, vdupq_n_u16, uint16_t, vqaddq_u16, (ScalarAddRow<SCALAR_U16>))
+NEON_KERNEL(NEONAddS16Row, int16x8_t,  MIL_INT16,  vld1q_s16, vst1q_s16, vdupq_n_s16, int16_t,  vqaddq_s16, (ScalarAddRow<SCALAR_S16>))
+NEON_KERNEL(NEONSubU8Row,  uint8x16_t, MIL_UINT8,  vld1q_u8,  vst1q_u8,  vdupq_n_u8,  uint8_t,  vqsubq_u8,  (ScalarSubRow<SCALAR_U8>))
+NEON_KERNEL(NEONSubS8Row,  int8x16_t,  MIL_INT8,   vld1q_s8,  vst1q_s8,  vdupq_n_s8,  int8_t,   vqsubq_s8,  (ScalarSubRow<SCALAR_S8>))
+NEON_KERNEL(NEONSubU16Row, uint16x8_t, MIL_UINT16, vld1q_u16, vst1q_u16, vdupq_n_u16, uint16_t, vqsubq_u16, (ScalarSubRow<SCALAR_U16>))
+NEON_KERNEL(NEONSubS16Row, int16x8_t,  MIL_INT16,  vld1q_s16, vst1q_s16, vdupq_n_s16, int16_t,  vqsubq_s16, (ScalarSubRow<SCALAR_S16>))
+
+#endif
+
+/* Kernel table, indexed by instruction set, operation and pixel type. */
+/* -------------------------------------------------------------------- */
+
+static const PixelArith::RowFunctionPtr ROW_FUNCTIONS[PixelArith::enNumInstructionSets]
+                                                     [PixelArith::enNumOperations]
+                                                     [enNumPixelTypes] =
+   {
+   /* Scalar. */
+   {
+      { ScalarAddRow<SCALAR_U8>, ScalarAddRow<SCALAR_S8>, ScalarAddRow<SCALAR_U16>, ScalarAddRow<SCALAR_S16> },
+      { ScalarSubRow<SCALAR_U8>, ScalarSubRow<SCALAR_S8>, ScalarSubRow<SCALAR_U16>, ScalarSubRow<SCALAR_S16> }
+   },
+#if defined(PIXEL_ARITH_X86)
+   /* SSE2. */
+   {
+      { SSE2AddU8Row, SSE2AddS8Row, SSE2AddU16Row, SSE2AddS16Row },
+      { SSE2SubU8Row, SSE2SubS8Row, SSE2SubU16Row, SSE2SubS16Row }
+   },
+   /* AVX2. */
+   {
+      { AVX2AddU8Row, AVX2AddS8Row, AVX2AddU16Row, AVX2AddS16Row },
+      { AVX2SubU8Row, AVX2SubS8Row, AVX2SubU16Row, AVX2SubS16Row }
+   },
+   /* AVX-512. */
+   {
+      { AVX512AddU8Row, AVX512AddS8Row, AVX512AddU16Row, AVX512AddS16Row },
+      { AVX512SubU8Row, AVX512SubS8Row, AVX512SubU16Row, AVX512SubS16Row }
+   },
+#else
+   { { M_NULL, M_NULL, M_NULL, M_NULL }, { M_NULL, M_NULL, M_NULL, M_NULL } },
+   { { M_NULL, M_NULL, M_NULL, M_NULL }, { M_NULL, M_NULL, M_NULL, M_NULL } },
+   { { M_NULL, M_NULL, M_NULL, M_NULL }, { M_NULL, M_NULL, M_NULL, M_NULL } },
+#endif
+#if defined(PIXEL_ARITH_NEON)
+   /* NEON. */
+   {
+      { NEONAddU8Row, NEONAddS8Row, NEONAddU16Row, NEONAddS16Row },
+      { NEONSubU8Row, NEONSubS8Row, NEONSubU16Row, NEONSubS16Row }
+   }
+#else
+   { { M_NULL, M_NULL, M_NULL, M_NULL }, { M_NULL, M_NULL, M_NULL, M_NULL } }
+#endif
+   };
+
+/* Run-time detection of the instruction sets. */
+/* ------------------------------------------- */
+
+#if defined(PIXEL_ARITH_X86)
+/*****************************************************************************/
+/* CpuId. Reads the CPUID registers of a leaf.                               */
+/*****************************************************************************/
+static void CpuId(int Leaf, int SubLeaf, unsigned int Registers[4])
+   {
+#if defined(_MSC_VER)
+   int Values[4];
+   __cpuidex(Values, Leaf, SubLeaf);
+   for (int i = 0; i < 4; i++)
+      Registers[i] = (unsigned int)Values[i];
+#else
+   Registers[0] = Registers[1] = Registers[2] = Registers[3] = 0;
+   if ((unsigned int)Leaf <= __get_cpuid_max(0, M_NULL))
+      __cpuid_count(Leaf, SubLeaf, Registers[0], Registers[1], Registers[2], Registers[3]);
+#endif
+   }
+
+/*****************************************************************************/
+/* GetEnabledRegisterStates. Reads the register states enabled by the OS    */
+/*                           (XCR0).                                         */
+/*****************************************************************************/
+static MIL_UINT64 GetEnabledRegisterStates()
+   {
+#if defined(_MSC_VER)
+   return (MIL_UINT64)_xgetbv(0);
+#else
+   unsigned int Low, High;
+   __asm__ __volatile__("xgetbv" : "=a"(Low), "=d"(High) : "c"(0));
+   return ((MIL_UINT64)High << 32) | Low;
+#endif
+   }
+#endif
+
+/*****************************************************************************/
+/* DetectInstructionSets. Returns the instruction sets supported by the CPU  */
+/*                        and the OS, as a bit field.                        */
+/*****************************************************************************/
+static MIL_UINT DetectInstructionSets()
+   {
+   MIL_UINT Supported = (MIL_UINT)1 << PixelArith::enScalar;
+
+#if defined(PIXEL_ARITH_X86)
+   unsigned int Leaf1[4], Leaf7[4];
+   CpuId(1, 0, Leaf1);
+   CpuId(7, 0, Leaf7);
+
+   if (Leaf1[3] & (1u << 26))
+      Supported |= (MIL_UINT)1 << PixelArith::enSSE2;
+
+   /* The OS must save the AVX (and AVX-512) registers. */
+   bool OsSavesAvx = false, OsSavesAvx512 = false;
+   if (Leaf1[2] & (1u << 27))
+      {
+      MIL_UINT64 RegisterStates = GetEnabledRegisterStates();
+      OsSavesAvx    = (RegisterStates & 0x06) == 0x06;
+      OsSavesAvx512 = OsSavesAvx && ((RegisterStates & 0xE0) == 0xE0);
+      }
+
+   if (OsSavesAvx && (Leaf1[2] & (1u << 28)) && (Leaf7[1] & (1u << 5)))
+      Supported |= (MIL_UINT)1 << PixelArith::enAVX2;
+
+   if (OsSavesAvx512 && (Leaf7[1] & (1u << 16)) && (Leaf7[1] & (1u << 30)))
+      Supported |= (MIL_UINT)1 << PixelArith::enAVX512;
+#endif
+
+#if defined(PIXEL_ARITH_NEON)
+   /* NEON is part of the ARMv8 architecture. */
+   Supported |= (MIL_UINT)1 << PixelArith::enNEON;
+#endif
+
+   return Supported;
+   }
+
+/*****************************************************************************/
+/* IsSupportedType. Returns true if the kernels support the buffer type.     */
+/*****************************************************************************/
+bool PixelArith::IsSupportedType(MIL_INT BufferType)
+   {
+   return GetPixelType(BufferType) != enInvalidPixelType;
+   }
+
+/*****************************************************************************/
+/* IsInstructionSetAvailable. Returns true if the instruction set can be     */
+/*                            used on this CPU.                              */
+/*****************************************************************************/
+bool PixelArith::IsInstructionSetAvailable(InstructionSetEnum InstructionSet)
+   {
+   static const MIL_UINT SupportedInstructionSets = DetectInstructionSets();
+
+   if ((InstructionSet < enScalar) || (InstructionSet >= enNumInstructionSets))
+      return false;
+
+   return ((SupportedInstructionSets >> InstructionSet) & 1) &&
+          (ROW_FUNCTIONS[InstructionSet][enAdd][enUnsigned8] != M_NULL);
+   }
+
+/*****************************************************************************/
+/* GetBestInstructionSet. Returns the widest instruction set available.     */
+/*****************************************************************************/
+PixelArith::InstructionSetEnum PixelArith::GetBestInstructionSet()
+   {
+   static const InstructionSetEnum PreferenceOrder[] = { enAVX512, enAVX2, enNEON, enSSE2 };
+
+   for (MIL_INT i = 0; i < (MIL_INT)(sizeof(PreferenceOrder)/sizeof(PreferenceOrder[0])); i++)
+      {
+      if (IsInstructionSetAvailable(PreferenceOrder[i]))
+         return PreferenceOrder[i];
+      }
+
+   return enScalar;
+   }
+
+/*****************************************************************************/
+/* GetInstructionSetName. Returns the name of the instruction set.           */
+/*****************************************************************************/
+MIL_CONST_TEXT_PTR PixelArith::GetInstructionSetName(InstructionSetEnum InstructionSet)
+   {
+   switch (InstructionSet)
+      {
+      case enScalar: return MIL_TEXT("Scalar");
+      case enSSE2:   return MIL_TEXT("SSE2");
+      case enAVX2:   return MIL_TEXT("AVX2");
+      case enAVX512: return MIL_TEXT("AVX-512");
+      case enNEON:   return MIL_TEXT("NEON");
+      default:       return MIL_TEXT("Unknown");
+      }
+   }
+
+/*****************************************************************************/
+/* GetRowFunction. Returns the row kernel of the operation and buffer type.  */
+/*****************************************************************************/
+PixelArith::RowFunctionPtr PixelArith::GetRowFunction(InstructionSetEnum InstructionSet,
+                                                      OperationEnum Operation, MIL_INT BufferType)
+   {
+   PixelTypeEnum PixelType = GetPixelType(BufferType);
+
+   if ((PixelType == enInvalidPixelType) || (Operation < enAdd) || (Operation >= enNumOperations) ||
+       !IsInstructionSetAvailable(InstructionSet))
+      return M_NULL;
+
+   return ROW_FUNCTIONS[InstructionSet][Operation][PixelType];
+   }
+
+/*****************************************************************************/
+/* GetKernel. Prepares the row kernel and the steps of the constant.         */
+/*****************************************************************************/
+bool PixelArith::GetKernel(InstructionSetEnum InstructionSet, OperationEnum Operation, MIL_INT BufferType,
+                           MIL_INT Constant, KernelStruct* Kernel)
+   {
+   PixelTypeEnum PixelType = GetPixelType(BufferType);
+   MIL_INT       MinValue, MaxValue;
+
+   if ((PixelType == enInvalidPixelType) || (Operation < enAdd) || (Operation >= enNumOperations) ||
+       !IsInstructionSetAvailable(InstructionSet))
+      return false;
+   GetPixelRange(PixelType, &MinValue, &MaxValue);
+
+   /* Beyond the pixel range, all the results are saturated. */
+   Constant = Clamp(Constant, MinValue - MaxValue, MaxValue - MinValue);
+
+   if (MinValue == 0)
+      {
+      /* Unsigned: a negative constant is the opposite operation. */
+      if (Constant < 0)
+         {
+         Operation = (Operation == enAdd) ? enSub : enAdd;
+         Constant  = -Constant;
+         }
+      }
+   else if (Operation == enSub)
+      {
+      /* Signed: subtracting is adding the opposite. */
+      Operation = enAdd;
+      Constant  = -Constant;
+      }
+
+   Kernel->RowFunction = ROW_FUNCTIONS[InstructionSet][Operation][PixelType];
+
+   /* The constant of a kernel must fit in the pixel type. Otherwise, it is applied in
+      steps of the same sign, which give the same saturated result.
+   */
+   Kernel->NumSteps = 0;
+   do
+      {
+      MIL_INT Step = Clamp(Constant, MinValue, MaxValue);
+      Kernel->Steps[Kernel->NumSteps++] = Step;
+      Constant -= Step;
+      } while (Constant != 0);
+
+   return true;
+   }
+
+/*****************************************************************************/
+/* ProcessRow. Applies the kernel on a row. The steps after the first one    */
+/*             are done in place in the destination.                         */
+/*****************************************************************************/
+void PixelArith::ProcessRow(const KernelStruct& Kernel, const void* SrcPtr, void* DstPtr, MIL_INT NumPixels)
+   {
+   Kernel.RowFunction(SrcPtr, DstPtr, NumPixels, Kernel.Steps[0]);
+   for (MIL_INT i = 1; i < Kernel.NumSteps; i++)
+      Kernel.RowFunction(DstPtr, DstPtr, NumPixels, Kernel.Steps[i]);
+   }
+
+/*****************************************************************************/
+/* Process. Applies the saturated operation on an area.                      */
+/*****************************************************************************/
+bool PixelArith::Process(InstructionSetEnum InstructionSet, OperationEnum Operation, MIL_INT BufferType,
+                         const void* SrcPtr, MIL_INT SrcPitchByte, void* DstPtr, MIL_INT DstPitchByte,
+                         MIL_INT SizeX, MIL_INT SizeY, MIL_INT Constant)
+   {
+   KernelStruct Kernel;
+
+   if (!GetKernel(InstructionSet, Operation, BufferType, Constant, &Kernel))
+      return false;
+
+   for (MIL_INT y = 0; y < SizeY; y++)
+      ProcessRow(Kernel, (const MIL_UINT8*)SrcPtr + y*SrcPitchByte, (MIL_UINT8*)DstPtr + y*DstPitchByte, SizeX);
+
+   return true;
+   }
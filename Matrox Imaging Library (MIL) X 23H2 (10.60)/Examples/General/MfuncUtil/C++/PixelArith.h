@@ -0,0 +1,86 @@
+﻿/************************************************************************************/
+/*
+* File name: PixelArith.h
+*
+* Synopsis:  This file contains saturated arithmetic kernels between an image and
+*            a constant, used by the custom MIL functions that access the buffer's
+*            data pointer directly. The kernels are vectorized with SSE2, AVX2,
+*            AVX-512 and NEON and the best one is selected at run time from the
+*            instruction sets supported by the CPU.
+*
+* Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+* All Rights Reserved
+*/
+
+#ifndef PIXEL_ARITH
+#define PIXEL_ARITH
+
+namespace PixelArith
+   {
+   /* Saturated operations between the pixels and the constant. */
+   enum OperationEnum
+      {
+      enAdd,
+      enSub,
+      enNumOperations
+      };
+
+   /* Implementations of the kernels. enScalar is the reference implementation. */
+   enum InstructionSetEnum
+      {
+      enScalar,
+      enSSE2,
+      enAVX2,
+      enAVX512,
+      enNEON,
+      enNumInstructionSets
+      };
+
+   /* Processes NumPixels pixels of a row. The constant fits in the pixel type. */
+   typedef void (*RowFunctionPtr)(const void* SrcPtr, void* DstPtr, MIL_INT NumPixels, MIL_INT Constant);
+
+   /* Kernel of an operation with a constant, applied in at most 3 steps. */
+   static const MIL_INT MAX_KERNEL_STEPS = 3;
+   struct KernelStruct
+      {
+      RowFunctionPtr RowFunction;
+      MIL_INT        Steps[MAX_KERNEL_STEPS];
+      MIL_INT        NumSteps;
+      };
+
+   /* Returns true for the supported buffer types: 8 and 16-bit, signed or unsigned. */
+   bool IsSupportedType(MIL_INT BufferType);
+
+   /* Returns true if the instruction set is compiled in and supported by the CPU. */
+   bool IsInstructionSetAvailable(InstructionSetEnum InstructionSet);
+   InstructionSetEnum GetBestInstructionSet();
+   MIL_CONST_TEXT_PTR GetInstructionSetName(InstructionSetEnum InstructionSet);
+
+   /* Returns the row kernel, or M_NULL if it is not available. */
+   RowFunctionPtr GetRowFunction(InstructionSetEnum InstructionSet, OperationEnum Operation,
+                                 MIL_INT BufferType);
+
+   /* Prepares the kernel of the operation with any constant; the result is the one of
+      the operation computed without overflow and saturated to the pixel type. Returns
+      false if the type or the instruction set is not supported.
+   */
+   bool GetKernel(InstructionSetEnum InstructionSet, OperationEnum Operation, MIL_INT BufferType,
+                  MIL_INT Constant, KernelStruct* Kernel);
+
+   /* Applies the kernel on a row. The pointers need no alignment and the source can be
+      the destination.
+   */
+   void ProcessRow(const KernelStruct& Kernel, const void* SrcPtr, void* DstPtr, MIL_INT NumPixels);
+
+   /* Applies the saturated operation on a SizeX x SizeY area. The pointers and pitches
+      can be those of child buffers and need no alignment, and the source can be the
+      destination. Any constant is supported; the result is the one of the operation
+      computed without overflow and saturated to the pixel type. Returns false if the
+      type or the instruction set is not supported.
+   */
+   bool Process(InstructionSetEnum InstructionSet, OperationEnum Operation, MIL_INT BufferType,
+                const void* SrcPtr, MIL_INT SrcPitchByte, void* DstPtr, MIL_INT DstPitchByte,
+                MIL_INT SizeX, MIL_INT SizeY, MIL_INT Constant);
+   }
+
+#endif
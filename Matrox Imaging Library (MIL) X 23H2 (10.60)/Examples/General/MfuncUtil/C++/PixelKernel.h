@@ -0,0 +1,532 @@
+﻿/************************************************************************************/
+/*
+* File name: PixelKernel.h
+*
+* Synopsis:  This file contains a header-only template layer that turns a row or
+*            pixel functor into the body of a custom MIL function that accesses
+*            the buffer's data pointer directly. It locks the buffers, inquires
+*            their data, clamps the area to process, dispatches on the buffer
+*            type and splits the rows between the threads of a pool.
+*
+*            A row functor of a transform has a templated call operator:
+*
+*               template <class T>
+*               void operator()(const BandRow<const T>& Src, const BandRow<T>& Dst,
+*                               MIL_INT NumPixels) const;
+*
+*            A pixel functor has T operator()(T Value) const. A row functor of a
+*            scan receives the source row, the number of pixels and the index of
+*            the thread, to accumulate a result per thread.
+*
+* Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+* All Rights Reserved
+*/
+
+#ifndef PIXEL_KERNEL
+#define PIXEL_KERNEL
+
+namespace PixelKernel
+   {
+   /* Pixel types, as bits of the mask of the types supported by a functor. */
+   static const MIL_INT TYPE_8U  = 0x01;
+   static const MIL_INT TYPE_8S  = 0x02;
+   static const MIL_INT TYPE_16U = 0x04;
+   static const MIL_INT TYPE_16S = 0x08;
+   static const MIL_INT TYPE_32U = 0x10;
+   static const MIL_INT TYPE_32S = 0x20;
+   static const MIL_INT TYPE_32F = 0x40;
+   static const MIL_INT TYPE_ALL = 0x7F;
+
+   /* Result of a transform or a scan. */
+   enum StatusEnum
+      {
+      enOk,
+      enNoHostAddress,
+      enUnsupportedLayout,
+      enUnsupportedType,
+      enTypeMismatch
+      };
+
+   /* Minimum number of rows given to each thread of the pool. */
+   static const MIL_INT MIN_ROWS_PER_THREAD = 16;
+
+   /*****************************************************************************/
+   /* BandRow. Row of one band of an image. Pixel x is at Ptr[x*Stride]; the    */
+   /*          stride is 1 except for packed color buffers.                     */
+   /*****************************************************************************/
+   template <class PixelType>
+   struct BandRow
+      {
+      PixelType* Ptr;
+      MIL_INT    Stride;
+      MIL_INT    Band;
+
+      PixelType& operator[](MIL_INT x) const { return Ptr[x*Stride]; }
+      };
+
+   /*****************************************************************************/
+   /* GetTypeMask. Returns the bit of a MIL buffer type, or 0 if it is not      */
+   /*              supported.                                                    */
+   /*****************************************************************************/
+   inline MIL_INT GetTypeMask(MIL_INT BufferType)
+      {
+      switch (BufferType)
+         {
+         case 8+M_UNSIGNED:   return TYPE_8U;
+         case 8+M_SIGNED:     return TYPE_8S;
+         case 16+M_UNSIGNED:  return TYPE_16U;
+         case 16+M_SIGNED:    return TYPE_16S;
+         case 32+M_UNSIGNED:  return TYPE_32U;
+         case 32+M_SIGNED:    return TYPE_32S;
+         case 32+M_FLOAT:     return TYPE_32F;
+         default:             return 0;
+         }
+      }
+
+   /*****************************************************************************/
+   /* CImageAccess. Direct access to the data of an image buffer. The buffer is */
+   /*               locked for the lifetime of the object.                      */
+   /*****************************************************************************/
+   class CImageAccess
+      {
+      public:
+         CImageAccess(MIL_ID ImageId, bool Modified)
+            : m_ImageId(ImageId), m_Modified(Modified), m_Status(enOk), m_PixelStride(1)
+            {
+            MIL_INT PitchPixel;
+
+            MbufControl(m_ImageId, M_LOCK, M_DEFAULT);
+
+            MbufInquire(m_ImageId, M_SIZE_X,     &m_SizeX);
+            MbufInquire(m_ImageId, M_SIZE_Y,     &m_SizeY);
+            MbufInquire(m_ImageId, M_SIZE_BAND,  &m_SizeBand);
+            MbufInquire(m_ImageId, M_TYPE,       &m_Type);
+            MbufInquire(m_ImageId, M_PITCH_BYTE, &m_PitchByte);
+            MbufInquire(m_ImageId, M_PITCH,      &PitchPixel);
+            MbufInquire(m_ImageId, M_HOST_ADDRESS, &m_BandAddress[0]);
+            m_BandAddress[1] = m_BandAddress[2] = M_NULL;
+
+            if ((m_SizeBand == 3) && (m_BandAddress[0] != M_NULL))
+               {
+               MIL_INT BytesPerValue = (MbufInquire(m_ImageId, M_SIZE_BIT, M_NULL) + 7)/8;
+
+               if (MbufInquire(m_ImageId, M_EXTENDED_ATTRIBUTE, M_NULL) & M_PACKED)
+                  {
+                  /* Packed buffers have 3 or 4 values per pixel, in the order of their format. */
+                  MIL_UINT8* PixelAddress = m_BandAddress[0];
+                  MIL_INT64  Format = 0;
+                  MbufInquire(m_ImageId, M_EXTENDED_FORMAT, &Format);
+                  m_PixelStride = (m_PitchByte/PitchPixel)/BytesPerValue;
+                  if ((Format == M_PACKED+M_BGR24) || (Format == M_PACKED+M_BGR32))
+                     {
+                     m_BandAddress[0] = PixelAddress + 2*BytesPerValue;
+                     m_BandAddress[1] = PixelAddress + 1*BytesPerValue;
+                     m_BandAddress[2] = PixelAddress;
+                     }
+                  else if ((Format == M_PACKED+M_RGB24) || (Format == M_PACKED+M_RGB48))
+                     {
+                     m_BandAddress[0] = PixelAddress;
+                     m_BandAddress[1] = PixelAddress + 1*BytesPerValue;
+                     m_BandAddress[2] = PixelAddress + 2*BytesPerValue;
+                     }
+                  else
+                     {
+                     m_BandAddress[0] = M_NULL;
+                     m_Status = enUnsupportedLayout;
+                     }
+                  }
+               else
+                  {
+                  /* Planar buffers have one plane per band. */
+                  static const MIL_INT Bands[3] = { M_RED, M_GREEN, M_BLUE };
+                  for (MIL_INT b = 0; b < 3; b++)
+                     {
+                     MIL_ID BandChild;
+                     MbufChildColor(m_ImageId, Bands[b], &BandChild);
+                     MbufInquire(BandChild, M_HOST_ADDRESS, &m_BandAddress[b]);
+                     MbufFree(BandChild);
+                     }
+                  }
+               }
+            }
+
+         ~CImageAccess()
+            {
+            MbufControl(m_ImageId, M_UNLOCK, M_DEFAULT);
+            if (m_Modified)
+               MbufControl(m_ImageId, M_MODIFIED, M_DEFAULT);
+            }
+
+         StatusEnum GetStatus() const
+            {
+            if (m_Status != enOk)
+               return m_Status;
+            for (MIL_INT b = 0; b < m_SizeBand; b++)
+               {
+               if ((b >= 3) || (m_BandAddress[b] == M_NULL))
+                  return enNoHostAddress;
+               }
+            return enOk;
+            }
+
+         MIL_INT GetSizeX() const    { return m_SizeX; }
+         MIL_INT GetSizeY() const    { return m_SizeY; }
+         MIL_INT GetSizeBand() const { return m_SizeBand; }
+         MIL_INT GetType() const     { return m_Type; }
+
+         template <class PixelType>
+         BandRow<PixelType> GetRow(MIL_INT Band, MIL_INT y) const
+            {
+            BandRow<PixelType> Row;
+            Row.Ptr    = (PixelType*)(m_BandAddress[Band] + y*m_PitchByte);
+            Row.Stride = m_PixelStride;
+            Row.Band   = Band;
+            return Row;
+            }
+
+      private:
+         /* Disallow copy. */
+         CImageAccess(const CImageAccess&);
+         CImageAccess& operator=(const CImageAccess&);
+
+         MIL_ID     m_ImageId;
+         bool       m_Modified;
+         StatusEnum m_Status;
+         MIL_UINT8* m_BandAddress[3];
+         MIL_INT    m_SizeX;
+         MIL_INT    m_SizeY;
+         MIL_INT    m_SizeBand;
+         MIL_INT    m_Type;
+         MIL_INT    m_PitchByte;
+         MIL_INT    m_PixelStride;
+      };
+
+   /*****************************************************************************/
+   /* CRowThreadPool. Pool of MIL threads that process the rows of an image.    */
+   /*                 The calling thread processes the first rows itself.       */
+   /*****************************************************************************/
+   class CRowThreadPool
+      {
+      public:
+         typedef void (*JobFunctionPtr)(void* JobData, MIL_INT StartRow, MIL_INT EndRow, MIL_INT ThreadIndex);
+
+         /* NumThreads includes the calling thread. */
+         CRowThreadPool(MIL_ID MilSystem, MIL_INT NumThreads)
+            : m_NumThreads((NumThreads > 1) ? NumThreads : 1), m_JobFunction(M_NULL), m_JobData(M_NULL),
+              m_NumRows(0), m_NumActiveThreads(1)
+            {
+            MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilMutex);
+
+            m_Workers = new WorkerStruct[m_NumThreads];
+            for (MIL_INT i = 1; i < m_NumThreads; i++)
+               {
+               WorkerStruct& Worker = m_Workers[i];
+               Worker.Pool  = this;
+               Worker.Index = i;
+               MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &Worker.MilEvents[enRunEvent]);
+               MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &Worker.MilEvents[enKillEvent]);
+               MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &Worker.MilDoneEvent);
+               MthrAlloc(MilSystem, M_THREAD, M_DEFAULT, &WorkerFunction, (void*)&Worker, &Worker.MilThread);
+               }
+            }
+
+         ~CRowThreadPool()
+            {
+            for (MIL_INT i = 1; i < m_NumThreads; i++)
+               {
+               WorkerStruct& Worker = m_Workers[i];
+               MthrControl(Worker.MilEvents[enKillEvent], M_EVENT_SET, M_SIGNALED);
+               MthrWait(Worker.MilThread, M_THREAD_END_WAIT, M_NULL);
+               MthrFree(Worker.MilThread);
+               MthrFree(Worker.MilEvents[enRunEvent]);
+               MthrFree(Worker.MilEvents[enKillEvent]);
+               MthrFree(Worker.MilDoneEvent);
+               }
+            delete [] m_Workers;
+            MthrFree(m_MilMutex);
+            }
+
+         MIL_INT GetNumThreads() const { return m_NumThreads; }
+
+         /* Calls the job on all the rows, split in bands of rows between the threads,
+            and returns when all the rows are processed.
+         */
+         void Execute(JobFunctionPtr JobFunction, void* JobData, MIL_INT NumRows)
+            {
+            MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+
+            m_JobFunction = JobFunction;
+            m_JobData     = JobData;
+            m_NumRows     = NumRows;
+
+            /* Small images are not worth waking up the threads. */
+            m_NumActiveThreads = NumRows/MIN_ROWS_PER_THREAD;
+            if (m_NumActiveThreads > m_NumThreads) m_NumActiveThreads = m_NumThreads;
+            if (m_NumActiveThreads < 1)            m_NumActiveThreads = 1;
+
+            for (MIL_INT i = 1; i < m_NumActiveThreads; i++)
+               MthrControl(m_Workers[i].MilEvents[enRunEvent], M_EVENT_SET, M_SIGNALED);
+
+            RunJob(0);
+
+            for (MIL_INT i = 1; i < m_NumActiveThreads; i++)
+               MthrWait(m_Workers[i].MilDoneEvent, M_EVENT_WAIT, M_NULL);
+
+            MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+            }
+
+      private:
+         /* Disallow copy. */
+         CRowThreadPool(const CRowThreadPool&);
+         CRowThreadPool& operator=(const CRowThreadPool&);
+
+         enum { enRunEvent, enKillEvent, enNumEvents };
+
+         struct WorkerStruct
+            {
+            CRowThreadPool* Pool;
+            MIL_INT         Index;
+            MIL_ID          MilThread;
+            MIL_ID          MilEvents[enNumEvents];
+            MIL_ID          MilDoneEvent;
+            };
+
+         void RunJob(MIL_INT ThreadIndex)
+            {
+            MIL_INT StartRow = (m_NumRows*ThreadIndex)/m_NumActiveThreads;
+            MIL_INT EndRow   = (m_NumRows*(ThreadIndex+1))/m_NumActiveThreads;
+            m_JobFunction(m_JobData, StartRow, EndRow, ThreadIndex);
+            }
+
+         static MIL_UINT32 MFTYPE WorkerFunction(void* UserDataPtr)
+            {
+            WorkerStruct& Worker = *(WorkerStruct*)UserDataPtr;
+
+            while (MthrWaitMultiple(Worker.MilEvents, enNumEvents, M_EVENT_WAIT, M_NULL) == enRunEvent)
+               {
+               Worker.Pool->RunJob(Worker.Index);
+               MthrControl(Worker.MilDoneEvent, M_EVENT_SET, M_SIGNALED);
+               }
+            return 0;
+            }
+
+         MIL_INT         m_NumThreads;
+         WorkerStruct*   m_Workers;
+         MIL_ID          m_MilMutex;
+
+         /* Current job. */
+         JobFunctionPtr  m_JobFunction;
+         void*           m_JobData;
+         MIL_INT         m_NumRows;
+         MIL_INT         m_NumActiveThreads;
+      };
+
+   /*****************************************************************************/
+   /* GetNumThreads. Returns the number of threads that can call a functor,     */
+   /*                to size the results accumulated per thread.                */
+   /*****************************************************************************/
+   inline MIL_INT GetNumThreads(const CRowThreadPool* Pool)
+      {
+      return Pool ? Pool->GetNumThreads() : 1;
+      }
+
+   /* Jobs of the transforms and scans, for each pixel type. */
+   /* ------------------------------------------------------ */
+
+   template <class RowFunctor>
+   struct JobStruct
+      {
+      const CImageAccess* Src;
+      const CImageAccess* Dst;
+      RowFunctor*         Functor;
+      MIL_INT             SizeX;
+      MIL_INT             SizeBand;
+      };
+
+   struct TransformJob
+      {
+      template <class PixelType, class RowFunctor>
+      static void ProcessRows(void* JobData, MIL_INT StartRow, MIL_INT EndRow, MIL_INT /*ThreadIndex*/)
+         {
+         JobStruct<RowFunctor>& Job = *(JobStruct<RowFunctor>*)JobData;
+
+         for (MIL_INT y = StartRow; y < EndRow; y++)
+            {
+            for (MIL_INT b = 0; b < Job.SizeBand; b++)
+               (*Job.Functor)(Job.Src->template GetRow<const PixelType>(b, y),
+                              Job.Dst->template GetRow<PixelType>(b, y), Job.SizeX);
+            }
+         }
+      };
+
+   struct ScanJob
+      {
+      template <class PixelType, class RowFunctor>
+      static void ProcessRows(void* JobData, MIL_INT StartRow, MIL_INT EndRow, MIL_INT ThreadIndex)
+         {
+         JobStruct<RowFunctor>& Job = *(JobStruct<RowFunctor>*)JobData;
+
+         for (MIL_INT y = StartRow; y < EndRow; y++)
+            {
+            for (MIL_INT b = 0; b < Job.SizeBand; b++)
+               (*Job.Functor)(Job.Src->template GetRow<const PixelType>(b, y), Job.SizeX, ThreadIndex);
+            }
+         }
+      };
+
+   /*****************************************************************************/
+   /* RunJob. Runs the job of the pixel type on the rows, in the pool if any.   */
+   /*****************************************************************************/
+   template <class JobKind, class RowFunctor>
+   void RunJob(JobStruct<RowFunctor>& Job, MIL_INT Type, MIL_INT NumRows, CRowThreadPool* Pool)
+      {
+      CRowThreadPool::JobFunctionPtr JobFunction = M_NULL;
+
+      switch (GetTypeMask(Type))
+         {
+#define PIXEL_KERNEL_JOB(Mask, PixelType)                                                          \
+         case Mask:                                                                                \
+            JobFunction = JobKind::template ProcessRows<PixelType, RowFunctor>;                    \
+            break;
+         PIXEL_KERNEL_JOB(TYPE_8U,  MIL_UINT8)
+         PIXEL_KERNEL_JOB(TYPE_8S,  MIL_INT8)
+         PIXEL_KERNEL_JOB(TYPE_16U, MIL_UINT16)
+         PIXEL_KERNEL_JOB(TYPE_16S, MIL_INT16)
+         PIXEL_KERNEL_JOB(TYPE_32U, MIL_UINT32)
+         PIXEL_KERNEL_JOB(TYPE_32S, MIL_INT32)
+         PIXEL_KERNEL_JOB(TYPE_32F, MIL_FLOAT)
+#undef PIXEL_KERNEL_JOB
+         default:
+            return;
+         }
+
+      if (Pool)
+         Pool->Execute(JobFunction, &Job, NumRows);
+      else
+         JobFunction(&Job, 0, NumRows, 0);
+      }
+
+   /*****************************************************************************/
+   /* Transform. Calls the row functor on each row of each band of the source   */
+   /*            and destination. The area is the smallest of the two buffers.  */
+   /*            The buffers must have the same type and number of bands, and   */
+   /*            can be the same buffer or children.                            */
+   /*****************************************************************************/
+   template <class RowFunctor>
+   StatusEnum Transform(MIL_ID SrcImageId, MIL_ID DstImageId, RowFunctor& Functor,
+                        MIL_INT SupportedTypes, CRowThreadPool* Pool = M_NULL)
+      {
+      CImageAccess Src(SrcImageId, false);
+      CImageAccess Dst(DstImageId, true);
+
+      if (Src.GetStatus() != enOk)
+         return Src.GetStatus();
+      if (Dst.GetStatus() != enOk)
+         return Dst.GetStatus();
+      if ((Src.GetType() != Dst.GetType()) || (Src.GetSizeBand() != Dst.GetSizeBand()))
+         return enTypeMismatch;
+      if (!(GetTypeMask(Src.GetType()) & SupportedTypes))
+         return enUnsupportedType;
+
+      JobStruct<RowFunctor> Job;
+      Job.Src      = &Src;
+      Job.Dst      = &Dst;
+      Job.Functor  = &Functor;
+      Job.SizeX    = (Src.GetSizeX() < Dst.GetSizeX()) ? Src.GetSizeX() : Dst.GetSizeX();
+      Job.SizeBand = Src.GetSizeBand();
+
+      RunJob<TransformJob>(Job, Src.GetType(),
+                           (Src.GetSizeY() < Dst.GetSizeY()) ? Src.GetSizeY() : Dst.GetSizeY(), Pool);
+      return enOk;
+      }
+
+   /*****************************************************************************/
+   /* Scan. Calls the row functor on each row of each band of the source, with  */
+   /*       the index of the calling thread.                                    */
+   /*****************************************************************************/
+   template <class RowFunctor>
+   StatusEnum Scan(MIL_ID SrcImageId, RowFunctor& Functor, MIL_INT SupportedTypes,
+                   CRowThreadPool* Pool = M_NULL)
+      {
+      CImageAccess Src(SrcImageId, false);
+
+      if (Src.GetStatus() != enOk)
+         return Src.GetStatus();
+      if (!(GetTypeMask(Src.GetType()) & SupportedTypes))
+         return enUnsupportedType;
+
+      JobStruct<RowFunctor> Job;
+      Job.Src      = &Src;
+      Job.Dst      = M_NULL;
+      Job.Functor  = &Functor;
+      Job.SizeX    = Src.GetSizeX();
+      Job.SizeBand = Src.GetSizeBand();
+
+      RunJob<ScanJob>(Job, Src.GetType(), Src.GetSizeY(), Pool);
+      return enOk;
+      }
+
+   /*****************************************************************************/
+   /* CPixelRowFunctor. Row functor that applies a pixel functor.               */
+   /*****************************************************************************/
+   template <class PixelFunctor>
+   class CPixelRowFunctor
+      {
+      public:
+         explicit CPixelRowFunctor(const PixelFunctor& Functor) : m_Functor(Functor) {}
+
+         template <class T>
+         void operator()(const BandRow<const T>& Src, const BandRow<T>& Dst, MIL_INT NumPixels) const
+            {
+            if ((Src.Stride == 1) && (Dst.Stride == 1))
+               {
+               /* Contiguous rows, which the compiler can vectorize. */
+               const T* pSrc = Src.Ptr;
+               T*       pDst = Dst.Ptr;
+               for (MIL_INT x = 0; x < NumPixels; x++)
+                  pDst[x] = m_Functor(pSrc[x]);
+               }
+            else
+               {
+               for (MIL_INT x = 0; x < NumPixels; x++)
+                  Dst[x] = m_Functor(Src[x]);
+               }
+            }
+
+      private:
+         const PixelFunctor& m_Functor;
+      };
+
+   /*****************************************************************************/
+   /* TransformPixels. Transform with a pixel functor.                          */
+   /*****************************************************************************/
+   template <class PixelFunctor>
+   StatusEnum TransformPixels(MIL_ID SrcImageId, MIL_ID DstImageId, const PixelFunctor& Functor,
+                              MIL_INT SupportedTypes, CRowThreadPool* Pool = M_NULL)
+      {
+      CPixelRowFunctor<PixelFunctor> RowFunctor(Functor);
+      return Transform(SrcImageId, DstImageId, RowFunctor, SupportedTypes, Pool);
+      }
+
+   /*****************************************************************************/
+   /* ReportError. Reports the MIL error of a status of a transform or a scan.  */
+   /*****************************************************************************/
+   inline void ReportError(MIL_ID Func, MIL_INT ErrorCode, StatusEnum Status)
+      {
+      MIL_CONST_TEXT_PTR Message;
+
+      switch (Status)
+         {
+         case enOk:                return;
+         case enNoHostAddress:     Message = MIL_TEXT("One of the buffers has a NULL host address."); break;
+         case enUnsupportedLayout: Message = MIL_TEXT("Packed color format not supported."); break;
+         case enTypeMismatch:      Message = MIL_TEXT("The buffers must have the same type and number of bands."); break;
+         case enUnsupportedType:
+         default:                  Message = MIL_TEXT("Image type not supported."); break;
+         }
+
+      MfuncErrorReport(Func, M_FUNC_ERROR+ErrorCode, MIL_TEXT("Invalid parameter."), Message, M_NULL, M_NULL);
+      }
+   }
+
+#endif
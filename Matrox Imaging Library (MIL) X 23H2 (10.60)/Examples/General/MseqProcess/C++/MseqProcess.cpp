@@ -11,6 +11,21 @@
  *            frame is also made in that hook function to allow fully parallel
  *            execution of the capture and the encoding.
  *
+ *            Several compression contexts can encode in parallel (see
+ *            NB_ENCODE_STREAMS); consecutive groups of pictures are sent to the
+ *            streams in turn. With a single stream, the hook function feeds the
+ *            grabbed buffer directly. With several streams, the hook function
+ *            only copies each frame into a staging buffer of its stream, and a
+ *            feeder thread per stream drains its queue with one MseqFeed() per
+ *            frame each time it wakes up, so the hook never blocks on an
+ *            encoder. The encoding latency and the queue depth of each stream
+ *            are reported at the end.
+ *
+ *            Each stream writes its own file, holding every NB_ENCODE_STREAMS-th
+ *            group of pictures. The files are not merged: the replay plays them
+ *            one after the other, so the frames of different streams are not
+ *            shown in their capture order.
+ *
  *      Note: The average encoding time must be shorter than the grab time or
  *            some frames will be missed. Missed frames are very frequent when
  *            the encoding is done by software. Also, if the captured images
@@ -24,6 +39,7 @@
  * All Rights Reserved
  */
 #include <mil.h>
+#include <atomic>
 
 /* Number of images in the buffering grab queue.
    Generally, increasing this number gives better real-time grab.
@@ -38,6 +54,26 @@
 /* Remote target sequence file name and location if Distributed MIL is used. */
 #define REMOTE_SEQUENCE_FILE MIL_TEXT("remote:///") SEQUENCE_FILE
 
+/* Number of compression contexts encoding in parallel. With more than one
+   stream, each stream writes its own file and receives every
+   NB_ENCODE_STREAMS-th group of pictures. With several cameras, use one
+   stream per camera instead.
+   */
+#define NB_ENCODE_STREAMS     1
+#define STREAM_SEQUENCE_FILE  M_TEMP_DIR MIL_TEXT("SeqProcess_%d.mp4")
+#define FILE_NAME_LENGTH_MAX  512
+
+/* Interval between I-Frames, also used as the segment size sent to a stream. */
+#define GROUP_OF_PICTURE_SIZE 30
+
+/* Number of staging buffers per stream when there are several streams (power
+   of 2), number of hand-off times kept to measure the encoding latency (more
+   than the frames in flight) and feeder thread polling period, in ms.
+   */
+#define STREAM_QUEUE_SIZE     8
+#define STREAM_HISTORY_SIZE   256
+#define FEEDER_WAIT_TIMEOUT   100
+
 enum ProcessingHookOperation
    {
    DISPLAY,
@@ -47,12 +83,52 @@ enum ProcessingHookOperation
 /* User's processing function prototype. */
 MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr);
 
+/* Single-producer/single-consumer ring of buffer identifiers. */
+typedef struct
+   {
+   MIL_ID                BufferId[STREAM_QUEUE_SIZE];
+   std::atomic<MIL_UINT> Head;   /* Next position written by the producer. */
+   std::atomic<MIL_UINT> Tail;   /* Next position read by the consumer.    */
+   } BufferRing;
+
+void BufferRingInit(BufferRing* RingPtr);
+bool BufferRingPush(BufferRing* RingPtr, MIL_ID BufferId);
+bool BufferRingPop(BufferRing* RingPtr, MIL_ID* BufferIdPtr);
+
+/* Encoding stream: a compression context, its staging buffers and its feeder thread. */
+typedef struct
+   {
+   MIL_INT              StreamIndex;
+   MIL_ID               MilSeqContext;
+   MIL_ID               FeederThread;
+   MIL_ID               FramesReadyEvent;
+   BufferRing           PendingFrames;    /* Frames waiting to be fed.    */
+   BufferRing           FreeBuffers;      /* Staging buffers not in use.  */
+   MIL_ID               StagingBufferList[STREAM_QUEUE_SIZE];
+   MIL_DOUBLE           HandOffTime[STREAM_HISTORY_SIZE];
+   std::atomic<MIL_INT> HandedOffCount;   /* Frames queued by the hook.   */
+   std::atomic<MIL_INT> FedCount;         /* Frames passed to MseqFeed(). */
+   std::atomic<MIL_INT> EncodedCount;     /* Frames done by the encoder.  */
+   MIL_INT              DroppedCount;
+   MIL_INT              FeedBatchCount;
+   MIL_INT              QueueDepthMax;
+   MIL_DOUBLE           LatencySum;
+   MIL_DOUBLE           LatencyMax;
+   std::atomic<bool>    Exit;
+   MIL_TEXT_CHAR        FileName[FILE_NAME_LENGTH_MAX];
+   } EncodeStreamStruct;
+
+void SetCompressionSettings(MIL_ID MilCompressContext, MIL_DOUBLE EncodingDesiredFrameRate);
+void StartStreamFeeder(MIL_ID MilSystem, MIL_ID MilDigitizer, EncodeStreamStruct* StreamPtr);
+void StopStreamFeeder(EncodeStreamStruct* StreamPtr);
+MIL_UINT32 MFTYPE FeederThreadFunction(void* StreamPtr);
+
 /* User's processing function hook data structure. */
 typedef struct
    {
    MIL_ID  MilDigitizer;
    MIL_ID  MilImageDisp;
-   MIL_ID  MilSeqContext;
+   EncodeStreamStruct* StreamList;
    MIL_INT ProcessedImageCount;
    ProcessingHookOperation ProcessingOperation;
    } ProcessingHookDataStruct;
@@ -67,13 +143,6 @@ MIL_INT MFTYPE FrameDecodingEndFunction(MIL_INT HookType, MIL_ID HookId, void* H
 MIL_INT CheckMseqProcessError(MIL_ID MilApplication, MIL_ID MilCompressContext);
 MIL_INT PrintMilErrorMessage(MIL_ID MilApplication);
 
-/* Optional encoding end function hook data structure. */
-typedef struct
-   {
-   MIL_INT EncodedImageCount;
-   MIL_ID DecompressContextID;
-   } EncodingFrameEndHookDataStruct;
-
 /* Optional decoding end function hook data structure. */
 typedef struct
    {
@@ -92,7 +161,6 @@ int MosMain(void)
    MIL_ID MilDisplay;
    MIL_ID MilImageDisp;
    MIL_ID MilGrabBufferList[BUFFERING_SIZE_MAX] = { 0 };
-   MIL_ID MilCompressContext;
    MIL_ID MilDecompressContext;
    MIL_INT LicenseModules = 0;
    MIL_INT MilSystemLocation;
@@ -103,9 +171,10 @@ int MosMain(void)
    MIL_DOUBLE ProcessFrameRate = 0.0;
    MIL_STRING SeqProcessFilePath;
    ProcessingHookDataStruct ProcessingUserHookData;
-   EncodingFrameEndHookDataStruct EncodingFrameEndUserHookData;
+   EncodeStreamStruct StreamList[NB_ENCODE_STREAMS];
    DecodingFrameEndHookDataStruct DecodingFrameEndUserHookData;
    MIL_INT SeqSystemType = M_NULL;
+   MIL_INT StreamIdx, NbStreamsStarted = 0;
 
    /* Allocate defaults. */
    MappAllocDefault(M_DEFAULT, &MilApplication, &MilSystem, &MilDisplay,
@@ -162,7 +231,7 @@ int MosMain(void)
 
    /* Initialize the User's processing function data structure only for Display. */
    ProcessingUserHookData.MilDigitizer = MilDigitizer;
-   ProcessingUserHookData.MilSeqContext = M_NULL;
+   ProcessingUserHookData.StreamList = M_NULL;
    ProcessingUserHookData.MilImageDisp = MilImageDisp;
    ProcessingUserHookData.ProcessedImageCount = 0;
    ProcessingUserHookData.ProcessingOperation = DISPLAY;
@@ -183,61 +252,74 @@ int MosMain(void)
    MdigInquire(MilDigitizer, M_PROCESS_FRAME_RATE, &EncodingDesiredFrameRate);
    MosPrintf(MIL_TEXT("Grabbing frames at %.2f frames/sec.\n"), EncodingDesiredFrameRate);
 
-   /* Creates a context for the H.264 compression engine. Compression will be done
-      using hardware or software depending on the system hardware configuration.
-      */
-   MseqAlloc(MilSystem, M_DEFAULT, M_SEQ_COMPRESS, M_DEFAULT,
-             M_DEFAULT, &MilCompressContext);
-
-   /* Specify the destination of the compressed file and the target container type.
-      The last argument specifies to generate an MP4 file.
-      */
-   MseqDefine(MilCompressContext, M_SEQ_OUTPUT(0) + M_SEQ_DEST(0), M_FILE,
-              (MilSystemLocation != M_REMOTE ? SEQUENCE_FILE : REMOTE_SEQUENCE_FILE),
-              M_FILE_FORMAT_MP4);
-
-   /* Set the compression context's settings. */
-   /* Sets the compression context's settings to compress frames at any resolution under
-      1920 x 1080. Any resolution higher than that will generate a warning that can be disabled
-     using MseqControl with M_SETTING_AUTO_ADJUSTMENT. See documentation for more details.
-      */
-   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_BIT_RATE_MODE, M_VARIABLE);   // M_VARIABLE or M_CONSTANT
-   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_BIT_RATE_MAX, 25000);         // 25 Mbps bit rate
-   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_BIT_RATE, 10000);             // 10 Mbps bit rate
-   
-   if (EncodingDesiredFrameRate != 0)
-      MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_FRAME_RATE, EncodingDesiredFrameRate);
-   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_FRAME_RATE_MODE, M_VARIABLE); // Attempts to update the file header with the encoding frame rate
-                                                                                     // if lower than the specified frame rate.
-   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_PROFILE, M_PROFILE_HIGH);     // M_PROFILE_BASELINE, M_PROFILE_MAIN, M_PROFILE_HIGH
-   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_LEVEL, M_LEVEL_4_2);          // M_LEVEL_1, M_LEVEL_1B, M_LEVEL_1_1, M_LEVEL_1_2, M_LEVEL_1_3,
-                                                                                     // M_LEVEL_2, M_LEVEL_2_1, M_LEVEL_2_2,
-                                                                                     // M_LEVEL_3, M_LEVEL_3_1, M_LEVEL_3_2,
-                                                                                     // M_LEVEL_4, M_LEVEL_4_1, M_LEVEL_4_2,
-                                                                                     // M_LEVEL_5, M_LEVEL_5_1
-   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_GROUP_OF_PICTURE_SIZE, 30);   // Interval between I-Frame
-
-   /* Initialize the optional encoding end function data structure. */
-   EncodingFrameEndUserHookData.EncodedImageCount = 0;
-
-   /* Register the encoding end function to the sequence context. */
-   MseqHookFunction(MilCompressContext, M_FRAME_END, FrameEncodingEndFunction,
-                    &EncodingFrameEndUserHookData);
-
-   /* Provide a sample image to initialize the encoding engine accordingly. */
-   MseqControl(MilCompressContext, M_CONTEXT, M_BUFFER_SAMPLE, MilGrabBufferList[0]);
-
    /* Disable error prints because MseqProcess() might not support the current input source. */
    MappControl(M_ERROR, M_PRINT_DISABLE);
 
-   /* Start the encoding process, waits for buffer to be fed for encoding. */
-   MseqProcess(MilCompressContext, M_START, M_ASYNCHRONOUS);
+   for (StreamIdx = 0; StreamIdx < NB_ENCODE_STREAMS; StreamIdx++, NbStreamsStarted++)
+      {
+      EncodeStreamStruct* StreamPtr = &StreamList[StreamIdx];
+      StreamPtr->StreamIndex = StreamIdx;
+
+      /* Creates a context for the H.264 compression engine. Compression will be done
+         using hardware or software depending on the system hardware configuration.
+         */
+      MseqAlloc(MilSystem, M_DEFAULT, M_SEQ_COMPRESS, M_DEFAULT,
+                M_DEFAULT, &StreamPtr->MilSeqContext);
+
+      /* Specify the destination of the compressed file and the target container type.
+         The last argument specifies to generate an MP4 file. Each stream writes its own file.
+         */
+      if (NB_ENCODE_STREAMS == 1)
+         MosSprintf(StreamPtr->FileName, FILE_NAME_LENGTH_MAX, MIL_TEXT("%s"),
+                    (MilSystemLocation != M_REMOTE ? SEQUENCE_FILE : REMOTE_SEQUENCE_FILE));
+      else
+         MosSprintf(StreamPtr->FileName, FILE_NAME_LENGTH_MAX,
+                    (MilSystemLocation != M_REMOTE ? STREAM_SEQUENCE_FILE :
+                                                     MIL_TEXT("remote:///") STREAM_SEQUENCE_FILE),
+                    (int)StreamIdx);
+      MseqDefine(StreamPtr->MilSeqContext, M_SEQ_OUTPUT(0) + M_SEQ_DEST(0), M_FILE,
+                 StreamPtr->FileName, M_FILE_FORMAT_MP4);
+
+      /* Set the compression context's settings. */
+      SetCompressionSettings(StreamPtr->MilSeqContext, EncodingDesiredFrameRate);
+
+      /* Initialize the stream statistics. */
+      StreamPtr->HandedOffCount = 0;
+      StreamPtr->FedCount       = 0;
+      StreamPtr->EncodedCount   = 0;
+      StreamPtr->DroppedCount   = 0;
+      StreamPtr->FeedBatchCount = 0;
+      StreamPtr->QueueDepthMax  = 0;
+      StreamPtr->LatencySum     = 0.0;
+      StreamPtr->LatencyMax     = 0.0;
+
+      /* Register the encoding end function to the sequence context. */
+      MseqHookFunction(StreamPtr->MilSeqContext, M_FRAME_END, FrameEncodingEndFunction,
+                       StreamPtr);
+
+      /* Provide a sample image to initialize the encoding engine accordingly. */
+      MseqControl(StreamPtr->MilSeqContext, M_CONTEXT, M_BUFFER_SAMPLE, MilGrabBufferList[0]);
+
+      /* Start the encoding process, waits for buffer to be fed for encoding. */
+      MseqProcess(StreamPtr->MilSeqContext, M_START, M_ASYNCHRONOUS);
+
+      /* Checks if an error has been logged by MseqProcess(). If so, stop the example. */
+      if (CheckMseqProcessError(MilApplication, StreamPtr->MilSeqContext))
+         {
+         MseqProcess(StreamPtr->MilSeqContext, M_STOP, M_NULL);
+         MseqFree(StreamPtr->MilSeqContext);
+         break;
+         }
+      }
 
-   /* Checks if an error has been logged by MseqProcess(). If so, stop the example. */
-   if (CheckMseqProcessError(MilApplication, MilCompressContext))
+   if (NbStreamsStarted < NB_ENCODE_STREAMS)
       {
       /* An error happened during MseqProcess() and we need to free the allocated resources. */
-      MseqProcess(MilCompressContext, M_STOP, M_NULL);
+      for (StreamIdx = 0; StreamIdx < NbStreamsStarted; StreamIdx++)
+         {
+         MseqProcess(StreamList[StreamIdx].MilSeqContext, M_STOP, M_NULL);
+         MseqFree(StreamList[StreamIdx].MilSeqContext);
+         }
 
       MIL_INT SourceSizeX, SourceSizeY;
       MIL_DOUBLE SourceFPS;
@@ -247,7 +329,8 @@ int MosMain(void)
       MdigInquire(MilDigitizer, M_PROCESS_FRAME_RATE, &SourceFPS);
 
       MosPrintf(MIL_TEXT("Unable to perform H.264 encoding with the current input source of\n"));
-      MosPrintf(MIL_TEXT("%d X %d @ %.2f fps.\n"), (int)SourceSizeX, (int)SourceSizeY, SourceFPS);
+      MosPrintf(MIL_TEXT("%d X %d @ %.2f fps on %d parallel streams.\n"),
+                (int)SourceSizeX, (int)SourceSizeY, SourceFPS, NB_ENCODE_STREAMS);
       MosPrintf(MIL_TEXT("\nExample parameters are optimized for sources of\n"));
       MosPrintf(MIL_TEXT("1920 x 1080 @ 60 fps.\n"));
       MosPrintf(MIL_TEXT("\nYou can try changing encoding parameters to better match your source.\n\n"));
@@ -261,7 +344,6 @@ int MosMain(void)
          MilGrabBufferList[MilGrabBufferListSize] = M_NULL;
          }
 
-      MseqFree(MilCompressContext);
       MappFreeDefault(MilApplication, MilSystem, MilDisplay, MilDigitizer, MilImageDisp);
       return 0;
       }
@@ -271,16 +353,24 @@ int MosMain(void)
 
    /* Display the type of compression used. */
    MosPrintf(MIL_TEXT("Live image capture and compression to file using "));
-   MseqInquire(MilCompressContext, M_CONTEXT, M_CODEC_TYPE, &SeqSystemType);
+   MseqInquire(StreamList[0].MilSeqContext, M_CONTEXT, M_CODEC_TYPE, &SeqSystemType);
    if (SeqSystemType & M_HARDWARE)
-      MosPrintf(MIL_TEXT("Hardware acceleration.\n"));
+      MosPrintf(MIL_TEXT("Hardware acceleration"));
    else // M_SOFTWARE + M_QSV
-      MosPrintf(MIL_TEXT("Software implementation.\n"));
+      MosPrintf(MIL_TEXT("Software implementation"));
+   MosPrintf(MIL_TEXT(" on %d parallel stream(s).\n"), NB_ENCODE_STREAMS);
+
+   /* Start the feeder thread of each stream. A single stream is fed by the hook function. */
+   if (NB_ENCODE_STREAMS > 1)
+      {
+      for (StreamIdx = 0; StreamIdx < NB_ENCODE_STREAMS; StreamIdx++)
+         StartStreamFeeder(MilSystem, MilDigitizer, &StreamList[StreamIdx]);
+      }
 
-   /* Set the sequence context id in the user hook data structure to start
+   /* Set the encoding streams in the user hook data structure to start
       feeding buffers for encoding in ProcessingFunction.
       */
-   ProcessingUserHookData.MilSeqContext = MilCompressContext;
+   ProcessingUserHookData.StreamList = StreamList;
    ProcessingUserHookData.ProcessedImageCount = 0;
    ProcessingUserHookData.ProcessingOperation = ENCODE;
 
@@ -297,15 +387,38 @@ int MosMain(void)
    MdigProcess(MilDigitizer, MilGrabBufferList, MilGrabBufferListSize,
                M_STOP + M_WAIT, M_DEFAULT, ProcessingFunction, &ProcessingUserHookData);
 
-   /* Stop the encoding process */
-   MseqProcess(MilCompressContext, M_STOP, M_WAIT);
+   /* Feed the frames still queued, then stop the encoding process of each stream. */
+   for (StreamIdx = 0; StreamIdx < NB_ENCODE_STREAMS; StreamIdx++)
+      {
+      if (NB_ENCODE_STREAMS > 1)
+         StopStreamFeeder(&StreamList[StreamIdx]);
+      MseqProcess(StreamList[StreamIdx].MilSeqContext, M_STOP, M_WAIT);
+      }
 
    /* Print statistics. */
    MdigInquire(MilDigitizer, M_PROCESS_FRAME_COUNT, &ProcessFrameCount);
    MdigInquire(MilDigitizer, M_PROCESS_FRAME_RATE, &ProcessFrameRate);
    MosPrintf(MIL_TEXT("%d frames encoded at %.2f frames/sec (%.1f ms/frame).\n\n"),
              (int)ProcessFrameCount, ProcessFrameRate, 1000.0 / ProcessFrameRate);
-   MseqInquire(MilCompressContext, M_SEQ_OUTPUT(0) + M_SEQ_DEST(0), M_STREAM_FILE_NAME, SeqProcessFilePath);
+   for (StreamIdx = 0; StreamIdx < NB_ENCODE_STREAMS; StreamIdx++)
+      {
+      EncodeStreamStruct* StreamPtr = &StreamList[StreamIdx];
+      MIL_INT EncodedCount = StreamPtr->EncodedCount;
+      MIL_INT FedCount     = StreamPtr->FedCount;
+
+      MosPrintf(MIL_TEXT("Stream #%d: %d frames encoded, %d dropped (no free staging buffer).\n"),
+                (int)StreamIdx, (int)EncodedCount, (int)StreamPtr->DroppedCount);
+      MosPrintf(MIL_TEXT("   Encoding latency:    %.1f ms mean, %.1f ms max.\n"),
+                EncodedCount ? 1000.0 * StreamPtr->LatencySum / EncodedCount : 0.0,
+                1000.0 * StreamPtr->LatencyMax);
+      MosPrintf(MIL_TEXT("   Encoder queue depth: %d frames max"), (int)StreamPtr->QueueDepthMax);
+      if (NB_ENCODE_STREAMS > 1)
+         MosPrintf(MIL_TEXT(", %.1f frames fed per feeder wake-up"),
+                   StreamPtr->FeedBatchCount ? (MIL_DOUBLE)FedCount / StreamPtr->FeedBatchCount : 0.0);
+      MosPrintf(MIL_TEXT(".\n"));
+      }
+   MosPrintf(MIL_TEXT("\n"));
+   MseqInquire(StreamList[0].MilSeqContext, M_SEQ_OUTPUT(0) + M_SEQ_DEST(0), M_STREAM_FILE_NAME, SeqProcessFilePath);
 
    /* Free the grab buffers and sequence context. */
    while (MilGrabBufferListSize > 0)
@@ -314,63 +427,71 @@ int MosMain(void)
       MilGrabBufferList[MilGrabBufferListSize] = M_NULL;
       }
 
-   MseqFree(MilCompressContext);
+   for (StreamIdx = 0; StreamIdx < NB_ENCODE_STREAMS; StreamIdx++)
+      MseqFree(StreamList[StreamIdx].MilSeqContext);
 
    if(ProcessFrameCount > 1)
       {
       MosPrintf(MIL_TEXT("The video sequence file was written to:\n%s.\n\n"), SeqProcessFilePath.c_str());
+      if (NB_ENCODE_STREAMS > 1)
+         MosPrintf(MIL_TEXT("The other streams were written to the same folder.\n"));
       MosPrintf(MIL_TEXT("It can be played back using any compatible video player.\n"));
 
       /* Wait for a key to start the replay. */
       MosPrintf(MIL_TEXT("Press <Enter> to replay encoded sequence.\n"));
       MosGetch();
 
+      /* Replay the file of each stream in turn. */
+      for (StreamIdx = 0; StreamIdx < NB_ENCODE_STREAMS; StreamIdx++)
+         {
+         MseqAlloc(MilSystem, M_DEFAULT, M_SEQ_DECOMPRESS, M_DEFAULT,
+                   M_DEFAULT, &MilDecompressContext);
 
-      MseqAlloc(MilSystem, M_DEFAULT, M_SEQ_DECOMPRESS, M_DEFAULT,
-                M_DEFAULT, &MilDecompressContext);
-
-      MappControl(M_ERROR, M_PRINT_DISABLE);
-
-      /* Specify the destination of the compressed file and the target container type.
-         The last argument specifies to generate an MP4 file.
-         */
-      MseqDefine(MilDecompressContext, M_SEQ_INPUT(0), M_FILE,
-         (MilSystemLocation != M_REMOTE ? SEQUENCE_FILE : REMOTE_SEQUENCE_FILE),
-                 M_FILE_FORMAT_MP4);
+         MappControl(M_ERROR, M_PRINT_DISABLE);
 
-      if(PrintMilErrorMessage(MilApplication))
-         {
-         MosPrintf(MIL_TEXT("\nPress <Enter> to end.\n"));
-         MosGetch();
-         MseqFree(MilDecompressContext);
-         MappFreeDefault(MilApplication, MilSystem, MilDisplay, MilDigitizer, MilImageDisp);
-         return 0;
-         }
-      MappControl(M_ERROR, M_PRINT_ENABLE);
+         /* Specify the destination of the compressed file and the target container type.
+            The last argument specifies to generate an MP4 file.
+            */
+         MseqDefine(MilDecompressContext, M_SEQ_INPUT(0), M_FILE,
+                    StreamList[StreamIdx].FileName, M_FILE_FORMAT_MP4);
 
-      MIL_DOUBLE outputFrameRate = 0.0;
-      MseqInquire(MilDecompressContext, M_SEQ_INPUT(0), M_STREAM_FRAME_RATE, &outputFrameRate);
-      MosPrintf(MIL_TEXT("\nReplaying file at %.2f frames/second.\n"), outputFrameRate);
+         if(PrintMilErrorMessage(MilApplication))
+            {
+            MosPrintf(MIL_TEXT("\nPress <Enter> to end.\n"));
+            MosGetch();
+            MseqFree(MilDecompressContext);
+            MappFreeDefault(MilApplication, MilSystem, MilDisplay, MilDigitizer, MilImageDisp);
+            return 0;
+            }
+         MappControl(M_ERROR, M_PRINT_ENABLE);
 
-      /* Initialize the optional decoding end function data structure. */
-      DecodingFrameEndUserHookData.DecodedImageCount = 0;
-      DecodingFrameEndUserHookData.MilImageDisp = MilImageDisp;
+         MIL_DOUBLE outputFrameRate = 0.0;
+         MseqInquire(MilDecompressContext, M_SEQ_INPUT(0), M_STREAM_FRAME_RATE, &outputFrameRate);
+         if (NB_ENCODE_STREAMS > 1)
+            MosPrintf(MIL_TEXT("\nReplaying stream #%d of %d at %.2f frames/second.\n"),
+                      (int)StreamIdx, NB_ENCODE_STREAMS, outputFrameRate);
+         else
+            MosPrintf(MIL_TEXT("\nReplaying file at %.2f frames/second.\n"), outputFrameRate);
 
-      /* Register the decoding end function to the sequence context. */
-      MseqHookFunction(MilDecompressContext, M_FRAME_END, FrameDecodingEndFunction,
-                       &DecodingFrameEndUserHookData);
+         /* Initialize the optional decoding end function data structure. */
+         DecodingFrameEndUserHookData.DecodedImageCount = 0;
+         DecodingFrameEndUserHookData.MilImageDisp = MilImageDisp;
 
-      /* Start the decoding process, waits for buffer to be fed for encoding. */
-      MseqProcess(MilDecompressContext, M_START, M_ASYNCHRONOUS);
+         /* Register the decoding end function to the sequence context. */
+         MseqHookFunction(MilDecompressContext, M_FRAME_END, FrameDecodingEndFunction,
+                          &DecodingFrameEndUserHookData);
 
-      /* Print a message and wait for a key press after a minimum number of frames. */
-      MosPrintf(MIL_TEXT("Press <Enter> to stop.\n\n"));
-      MosGetch();
+         /* Start the decoding process, waits for buffer to be fed for encoding. */
+         MseqProcess(MilDecompressContext, M_START, M_ASYNCHRONOUS);
 
-      /* Stop the play back. */
-      MseqProcess(MilDecompressContext, M_STOP, M_NULL);
-      MseqFree(MilDecompressContext);
+         /* Print a message and wait for a key press after a minimum number of frames. */
+         MosPrintf(MIL_TEXT("Press <Enter> to stop.\n\n"));
+         MosGetch();
 
+         /* Stop the play back. */
+         MseqProcess(MilDecompressContext, M_STOP, M_NULL);
+         MseqFree(MilDecompressContext);
+         }
       }
    else
       {
@@ -419,8 +540,42 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID HookId, void* HookDat
          MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), (int)UserHookDataPtr->ProcessedImageCount);
          MgraText(M_DEFAULT, ModifiedBufferId, STRING_POS_X, STRING_POS_Y, Text);
 
-         /* Enqueue the grabbed buffer for parallel encoding. */
-         MseqFeed(UserHookDataPtr->MilSeqContext, ModifiedBufferId, M_DEFAULT);
+         /* Hand the grabbed buffer off to the stream of its group of pictures. A single */
+         /* stream is fed directly. Otherwise, the frame is copied in a staging buffer   */
+         /* and the feeder thread of the stream enqueues it for parallel encoding.       */
+         {
+         EncodeStreamStruct* StreamPtr = &UserHookDataPtr->StreamList[
+            ((UserHookDataPtr->ProcessedImageCount - 1) / GROUP_OF_PICTURE_SIZE) % NB_ENCODE_STREAMS];
+         MIL_ID StagingBufferId;
+
+         if (NB_ENCODE_STREAMS == 1)
+            {
+            MIL_INT HandOffIndex = StreamPtr->HandedOffCount;
+            MappTimer(M_DEFAULT, M_TIMER_READ,
+                      &StreamPtr->HandOffTime[HandOffIndex % STREAM_HISTORY_SIZE]);
+            StreamPtr->HandedOffCount = HandOffIndex + 1;
+            MseqFeed(StreamPtr->MilSeqContext, ModifiedBufferId, M_DEFAULT);
+
+            MIL_INT QueueDepth = ++StreamPtr->FedCount - StreamPtr->EncodedCount;
+            if (QueueDepth > StreamPtr->QueueDepthMax)
+               StreamPtr->QueueDepthMax = QueueDepth;
+            }
+         else if (BufferRingPop(&StreamPtr->FreeBuffers, &StagingBufferId))
+            {
+            MIL_INT HandOffIndex = StreamPtr->HandedOffCount;
+            MbufCopy(ModifiedBufferId, StagingBufferId);
+            MappTimer(M_DEFAULT, M_TIMER_READ,
+                      &StreamPtr->HandOffTime[HandOffIndex % STREAM_HISTORY_SIZE]);
+            StreamPtr->HandedOffCount = HandOffIndex + 1;
+            BufferRingPush(&StreamPtr->PendingFrames, StagingBufferId);
+            MthrControl(StreamPtr->FramesReadyEvent, M_EVENT_SET, M_SIGNALED);
+            }
+         else
+            {
+            /* The stream is falling behind; drop the frame rather than block. */
+            StreamPtr->DroppedCount++;
+            }
+         }
 
          /* Update the display with the last captured image. */
          MbufCopy(ModifiedBufferId, UserHookDataPtr->MilImageDisp);
@@ -429,11 +584,137 @@ MIL_INT MFTYPE ProcessingFunction(MIL_INT HookType, MIL_ID HookId, void* HookDat
    return 0;
    }
 
+/* Set the compression context's settings. */
+/* ---------------------------------------- */
+void SetCompressionSettings(MIL_ID MilCompressContext, MIL_DOUBLE EncodingDesiredFrameRate)
+   {
+   /* Sets the compression context's settings to compress frames at any resolution under
+      1920 x 1080. Any resolution higher than that will generate a warning that can be disabled
+     using MseqControl with M_SETTING_AUTO_ADJUSTMENT. See documentation for more details.
+      */
+   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_BIT_RATE_MODE, M_VARIABLE);   // M_VARIABLE or M_CONSTANT
+   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_BIT_RATE_MAX, 25000);         // 25 Mbps bit rate
+   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_BIT_RATE, 10000);             // 10 Mbps bit rate
+   
+   if (EncodingDesiredFrameRate != 0)
+      MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_FRAME_RATE, EncodingDesiredFrameRate);
+   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_FRAME_RATE_MODE, M_VARIABLE); // Attempts to update the file header with the encoding frame rate
+                                                                                     // if lower than the specified frame rate.
+   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_PROFILE, M_PROFILE_HIGH);     // M_PROFILE_BASELINE, M_PROFILE_MAIN, M_PROFILE_HIGH
+   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_LEVEL, M_LEVEL_4_2);          // M_LEVEL_1, M_LEVEL_1B, M_LEVEL_1_1, M_LEVEL_1_2, M_LEVEL_1_3,
+                                                                                     // M_LEVEL_2, M_LEVEL_2_1, M_LEVEL_2_2,
+                                                                                     // M_LEVEL_3, M_LEVEL_3_1, M_LEVEL_3_2,
+                                                                                     // M_LEVEL_4, M_LEVEL_4_1, M_LEVEL_4_2,
+                                                                                     // M_LEVEL_5, M_LEVEL_5_1
+   MseqControl(MilCompressContext, M_CONTEXT, M_STREAM_GROUP_OF_PICTURE_SIZE, GROUP_OF_PICTURE_SIZE);
+   }
+
+/* Allocate the staging buffers of a stream and start its feeder thread. */
+/* --------------------------------------------------------------------- */
+void StartStreamFeeder(MIL_ID MilSystem, MIL_ID MilDigitizer, EncodeStreamStruct* StreamPtr)
+   {
+   BufferRingInit(&StreamPtr->PendingFrames);
+   BufferRingInit(&StreamPtr->FreeBuffers);
+   StreamPtr->Exit = false;
+
+   for (MIL_INT BufIdx = 0; BufIdx < STREAM_QUEUE_SIZE; BufIdx++)
+      {
+      MbufAllocColor(MilSystem, MdigInquire(MilDigitizer, M_SIZE_BAND, M_NULL),
+                     MdigInquire(MilDigitizer, M_SIZE_X, M_NULL),
+                     MdigInquire(MilDigitizer, M_SIZE_Y, M_NULL),
+                     8 + M_UNSIGNED, M_IMAGE + M_PROC,
+                     &StreamPtr->StagingBufferList[BufIdx]);
+      BufferRingPush(&StreamPtr->FreeBuffers, StreamPtr->StagingBufferList[BufIdx]);
+      }
+
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED + M_AUTO_RESET, M_NULL, M_NULL,
+             &StreamPtr->FramesReadyEvent);
+   MthrAlloc(MilSystem, M_THREAD, M_DEFAULT, &FeederThreadFunction, StreamPtr,
+             &StreamPtr->FeederThread);
+   }
+
+/* Stop the feeder thread once the queued frames are fed, and free the stream objects. */
+/* ----------------------------------------------------------------------------------- */
+void StopStreamFeeder(EncodeStreamStruct* StreamPtr)
+   {
+   StreamPtr->Exit = true;
+   MthrControl(StreamPtr->FramesReadyEvent, M_EVENT_SET, M_SIGNALED);
+   MthrWait(StreamPtr->FeederThread, M_THREAD_END_WAIT, M_NULL);
+   MthrFree(StreamPtr->FeederThread);
+   MthrFree(StreamPtr->FramesReadyEvent);
+
+   for (MIL_INT BufIdx = 0; BufIdx < STREAM_QUEUE_SIZE; BufIdx++)
+      MbufFree(StreamPtr->StagingBufferList[BufIdx]);
+   }
+
+/* Feeder thread: drains the queued frames of a stream at each wake-up, one MseqFeed() per frame. */
+/* ---------------------------------------------------------------------------------------------- */
+MIL_UINT32 MFTYPE FeederThreadFunction(void* StreamPtr)
+   {
+   EncodeStreamStruct* Stream = (EncodeStreamStruct*)StreamPtr;
+   MIL_ID StagingBufferId;
+   bool LastPass = false;
+
+   while (!LastPass)
+      {
+      MIL_INT BatchSize = 0;
+      LastPass = Stream->Exit;
+
+      while (BufferRingPop(&Stream->PendingFrames, &StagingBufferId))
+         {
+         /* MseqFeed() copies the buffer in the encoder queue; it only blocks this */
+         /* thread, never the grab, when the encoder queue is full.                */
+         MseqFeed(Stream->MilSeqContext, StagingBufferId, M_DEFAULT);
+         BufferRingPush(&Stream->FreeBuffers, StagingBufferId);
+         BatchSize++;
+
+         MIL_INT QueueDepth = ++Stream->FedCount - Stream->EncodedCount;
+         if (QueueDepth > Stream->QueueDepthMax)
+            Stream->QueueDepthMax = QueueDepth;
+         }
+      if (BatchSize)
+         Stream->FeedBatchCount++;
+
+      if (!LastPass)
+         MthrWait(Stream->FramesReadyEvent, M_EVENT_WAIT + M_EVENT_TIMEOUT(FEEDER_WAIT_TIMEOUT), M_NULL);
+      }
+
+   return 0;
+   }
+
+/* Lock-free single-producer/single-consumer buffer ring. */
+/* ------------------------------------------------------ */
+void BufferRingInit(BufferRing* RingPtr)
+   {
+   RingPtr->Head = 0;
+   RingPtr->Tail = 0;
+   }
+
+bool BufferRingPush(BufferRing* RingPtr, MIL_ID BufferId)
+   {
+   MIL_UINT Head = RingPtr->Head.load(std::memory_order_relaxed);
+   if (Head - RingPtr->Tail.load(std::memory_order_acquire) == STREAM_QUEUE_SIZE)
+      return false;
+   RingPtr->BufferId[Head % STREAM_QUEUE_SIZE] = BufferId;
+   RingPtr->Head.store(Head + 1, std::memory_order_release);
+   return true;
+   }
+
+bool BufferRingPop(BufferRing* RingPtr, MIL_ID* BufferIdPtr)
+   {
+   MIL_UINT Tail = RingPtr->Tail.load(std::memory_order_relaxed);
+   if (Tail == RingPtr->Head.load(std::memory_order_acquire))
+      return false;
+   *BufferIdPtr = RingPtr->BufferId[Tail % STREAM_QUEUE_SIZE];
+   RingPtr->Tail.store(Tail + 1, std::memory_order_release);
+   return true;
+   }
+
 /* Optional encoding end function called every time a buffer is finished being compressed. */
 /* ----------------------------------------------------------------------------------------*/
 MIL_INT MFTYPE FrameEncodingEndFunction(MIL_INT HookType, MIL_ID HookId, void* HookDataPtr)
    {
-   EncodingFrameEndHookDataStruct * UserHookDataPtr = (EncodingFrameEndHookDataStruct *)HookDataPtr;
+   EncodeStreamStruct * StreamPtr = (EncodeStreamStruct *)HookDataPtr;
 
    /* Frame end hook post processing. */
    if (HookType == M_FRAME_END)
@@ -441,9 +722,19 @@ MIL_INT MFTYPE FrameEncodingEndFunction(MIL_INT HookType, MIL_ID HookId, void* H
       MIL_ID CompressedBufferId;
       void* CompressedDataPtr = M_NULL;
       MIL_INT CompressedDataSize = 0;
+      MIL_INT EncodedIndex = StreamPtr->EncodedCount;
+      MIL_DOUBLE EndTime, Latency;
+
+      /* Measure the latency since the grab hook handed the frame off. The */
+      /* frames of a stream are encoded in the order they are fed.         */
+      MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+      Latency = EndTime - StreamPtr->HandOffTime[EncodedIndex % STREAM_HISTORY_SIZE];
+      StreamPtr->LatencySum += Latency;
+      if (Latency > StreamPtr->LatencyMax)
+         StreamPtr->LatencyMax = Latency;
 
       /* Increment a encoded frame counter */
-      UserHookDataPtr->EncodedImageCount++;
+      StreamPtr->EncodedCount = EncodedIndex + 1;
 
       /* Retrieve the MIL_ID of the encoded buffer. */
       MseqGetHookInfo(HookId, M_MODIFIED_BUFFER + M_BUFFER_ID, &CompressedBufferId);
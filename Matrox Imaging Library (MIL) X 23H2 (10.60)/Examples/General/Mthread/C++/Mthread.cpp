@@ -19,6 +19,15 @@
  *        top-left and bottom-left threads, except that the bottom-right thread
  *        performs an edge detection operation, rather than a rotation.
  *
+ *     Task graph usage:
+ *      - The same processing is then declared as a graph of tasks, each with
+ *        the buffers it reads and writes; a fifth task updates the display.
+ *        The dependencies are derived from the buffers, so adding a task does
+ *        not require any event to be wired by hand.
+ *      - A pool of worker threads runs the graph; independent branches run
+ *        concurrently and idle workers steal ready tasks from busy ones.
+ *      - The time of each graph run is compared with its critical path.
+ *
  *      Note : - Under MIL-Lite, the threads will do graphic annotations instead.
  *             - Comment out the MdispSelect() if you wish to avoid benchmarking
  *               the display update overhead on CPU usage and processing rate.
@@ -28,6 +37,7 @@
  */
  
 #include <mil.h>
+#include <atomic>
 
 /* Local defines. */
 #define IMAGE_FILE         M_IMAGE_PATH MIL_TEXT("Bird.mim")
@@ -41,10 +51,21 @@
 #define DRAW_CENTER_POSX   196
 #define DRAW_CENTER_POSY   180
 
+/* Task graph defines. */
+#define TASK_NB_MAX          16
+#define TASK_BUFFER_NB_MAX   4
+#define TASK_WORKER_NB_MAX   8
+#define TASK_WAIT_TIMEOUT    100
+#define TASK_INVALID         -1
+
 /* Function prototypes. */
 MIL_UINT32 MFTYPE TopThread(void *TPar);
 MIL_UINT32 MFTYPE BotLeftThread(void *TPar);
 MIL_UINT32 MFTYPE BotRightThread(void *TPar);
+void TopProcessing(void *TPar);
+void BotLeftProcessing(void *TPar);
+void BotRightProcessing(void *TPar);
+void DisplayProcessing(void *DPar);
 
 /* Thread parameters structure. */
 typedef struct ThreadParam
@@ -61,11 +82,78 @@ typedef struct ThreadParam
    MIL_ID DoneEvent;
    MIL_INT NumberOfIteration;
    MIL_INT Radius;
+   MIL_DOUBLE Angle;
    MIL_INT Exit;
    MIL_INT LicenseModules;
    struct ThreadParam *SlaveThreadParam;
    } THREAD_PARAM;
 
+/* Display task parameters structure. */
+typedef struct
+   {
+   MIL_ID DispImage;
+   THREAD_PARAM *Quadrant[4];
+   MIL_INT NumberOfIteration;
+   } DISPLAY_PARAM;
+
+/* Task graph structures. */
+typedef void (*TASK_FUNCTION_PTR)(void *TaskData);
+
+typedef struct
+   {
+   const MIL_TEXT_CHAR *Name;
+   TASK_FUNCTION_PTR Function;
+   void *TaskData;
+   MIL_ID InBuffer[TASK_BUFFER_NB_MAX];     /* Buffers read by the task.    */
+   MIL_INT NbInBuffers;
+   MIL_ID OutBuffer[TASK_BUFFER_NB_MAX];    /* Buffers written by the task. */
+   MIL_INT NbOutBuffers;
+   MIL_INT Successor[TASK_NB_MAX];          /* Tasks that depend on this one. */
+   MIL_INT NbSuccessors;
+   MIL_INT NbPredecessors;
+   std::atomic<MIL_INT> PendingPredecessors;
+   MIL_DOUBLE Duration;                     /* Duration of the last run.    */
+   MIL_DOUBLE TotalDuration;
+   } TASK;
+
+typedef struct
+   {
+   MIL_ID Id;
+   MIL_ID Mutex;                 /* Protects the task deque.                 */
+   MIL_INT Deque[TASK_NB_MAX];   /* Owner works at the bottom, thieves at the top. */
+   MIL_INT Top;
+   MIL_INT Bottom;
+   MIL_INT NbTasksRun;
+   MIL_INT NbTasksStolen;
+   struct TaskGraph *Graph;
+   } TASK_WORKER;
+
+typedef struct TaskGraph
+   {
+   MIL_ID System;
+   TASK Task[TASK_NB_MAX];
+   MIL_INT NbTasks;
+   TASK_WORKER Worker[TASK_WORKER_NB_MAX];
+   MIL_INT NbWorkers;
+   MIL_ID WorkEvent;             /* Signaled when tasks become ready.        */
+   MIL_ID DoneEvent;             /* Signaled when a run of the graph ends.   */
+   std::atomic<MIL_INT> NbReady;
+   std::atomic<MIL_INT> NbRemaining;
+   std::atomic<bool> Exit;
+   MIL_INT NbRuns;
+   MIL_DOUBLE TotalTime;
+   MIL_DOUBLE TotalCriticalPath;
+   } TASK_GRAPH;
+
+void TaskGraphAlloc(MIL_ID System, MIL_INT NbWorkers, TASK_GRAPH *Graph);
+MIL_INT TaskGraphAddTask(TASK_GRAPH *Graph, const MIL_TEXT_CHAR *Name,
+                         TASK_FUNCTION_PTR Function, void *TaskData,
+                         const MIL_ID *InBuffers, MIL_INT NbInBuffers,
+                         const MIL_ID *OutBuffers, MIL_INT NbOutBuffers);
+void TaskGraphRun(TASK_GRAPH *Graph);
+void TaskGraphFree(TASK_GRAPH *Graph);
+MIL_UINT32 MFTYPE TaskWorkerThread(void *WorkerPtr);
+
 
 /* Main function: */
 /* -------------- */
@@ -82,6 +170,10 @@ int MosMain(void)
                 TParBotRight;    /* Parameters passed to bottom-right thread.  */
    MIL_DOUBLE Time, FramesPerSecond; /* Timer variables.                       */
    MIL_INT LicenseModules;       /* List of available MIL modules.             */
+   static TASK_GRAPH Graph;      /* Task graph running the same processing.    */
+   bool GraphValid;              /* All the tasks fit in the task graph.       */
+   DISPLAY_PARAM DPar;           /* Parameters passed to the display task.     */
+   MIL_INT NbCores, NbWorkers, i;
 
    /* Allocate defaults. */
    MappAllocDefault(M_DEFAULT, &MilApplication, &MilSystem, &MilDisplay, M_NULL, M_NULL);
@@ -122,6 +214,7 @@ int MosMain(void)
    TParTopLeft.ReadyEvent           = TParBotLeft.DoneEvent;
    TParTopLeft.NumberOfIteration    = 0;
    TParTopLeft.Radius               = 0;
+   TParTopLeft.Angle                = 0;
    TParTopLeft.Exit                 = 0;
    TParTopLeft.LicenseModules       = LicenseModules;
    TParTopLeft.SlaveThreadParam     = &TParBotLeft;
@@ -135,6 +228,7 @@ int MosMain(void)
    TParBotLeft.ReadyEvent           = TParTopLeft.DoneEvent;
    TParBotLeft.NumberOfIteration    = 0;
    TParBotLeft.Radius               = 0;
+   TParBotLeft.Angle                = 0;
    TParBotLeft.Exit                 = 0;
    TParBotLeft.LicenseModules       = LicenseModules;
    TParBotLeft.SlaveThreadParam     = 0;
@@ -148,6 +242,7 @@ int MosMain(void)
    TParTopRight.ReadyEvent          = TParBotRight.DoneEvent;
    TParTopRight.NumberOfIteration   = 0;
    TParTopRight.Radius              = 0;
+   TParTopRight.Angle               = 0;
    TParTopRight.Exit                = 0;
    TParTopRight.LicenseModules      = LicenseModules;
    TParTopRight.SlaveThreadParam    = &TParBotRight;
@@ -161,6 +256,7 @@ int MosMain(void)
    TParBotRight.ReadyEvent          = TParTopRight.DoneEvent;
    TParBotRight.NumberOfIteration   = 0;
    TParBotRight.Radius              = 0;
+   TParBotRight.Angle               = 0;
    TParBotRight.Exit                = 0;
    TParBotRight.LicenseModules      = LicenseModules;
    TParBotRight.SlaveThreadParam    = 0;
@@ -218,7 +314,7 @@ int MosMain(void)
                                  (int)TParBotRight.NumberOfIteration);
    MosPrintf(MIL_TEXT("Processing speed for the 4 threads: ")
                              MIL_TEXT("%.0f Images/Sec.\n\n"), FramesPerSecond);
-   MosPrintf(MIL_TEXT("Press <Enter> to end.\n\n"));
+   MosPrintf(MIL_TEXT("Press <Enter> to continue.\n\n"));
    MosGetch();
 
    /* Free threads. */
@@ -227,6 +323,105 @@ int MosMain(void)
    MthrFree(TParTopRight.Id);
    MthrFree(TParBotRight.Id);
 
+   /* Run the same processing as a task graph. The display is now updated by */
+   /* a fifth task, once the 4 quadrants of a run are done.                   */
+   TParTopLeft.NumberOfIteration  = 0;
+   TParBotLeft.NumberOfIteration  = 0;
+   TParTopRight.NumberOfIteration = 0;
+   TParBotRight.NumberOfIteration = 0;
+   DPar.DispImage         = TParTopLeft.DispImage;
+   DPar.Quadrant[0]       = &TParTopLeft;
+   DPar.Quadrant[1]       = &TParBotLeft;
+   DPar.Quadrant[2]       = &TParTopRight;
+   DPar.Quadrant[3]       = &TParBotRight;
+   DPar.NumberOfIteration = 0;
+   for (i = 0; i < 4; i++)
+      DPar.Quadrant[i]->DispImage = M_NULL;
+
+   /* Use one worker per core. */
+   MthrInquireMp(M_DEFAULT, M_CORE_NUM_EFFECTIVE, M_DEFAULT, M_DEFAULT, &NbCores);
+   NbWorkers = (NbCores < 2) ? 2 : ((NbCores > TASK_WORKER_NB_MAX) ? TASK_WORKER_NB_MAX : NbCores);
+   TaskGraphAlloc(MilSystem, NbWorkers, &Graph);
+
+   /* Declare the tasks with the buffers they read and write. */
+      {
+      MIL_ID TopLeftIO[]  = { TParTopLeft.SrcImage };
+      MIL_ID BotLeftOut[] = { TParBotLeft.DstImage };
+      MIL_ID TopRightIO[] = { TParTopRight.SrcImage };
+      MIL_ID BotRightOut[]= { TParBotRight.DstImage };
+      MIL_ID DisplayIn[]  = { TParTopLeft.DstImage, TParBotLeft.DstImage,
+                              TParTopRight.DstImage, TParBotRight.DstImage };
+      MIL_ID DisplayOut[] = { DPar.DispImage };
+
+      GraphValid =
+         (TaskGraphAddTask(&Graph, MIL_TEXT("Top-left"), TopProcessing, &TParTopLeft,
+                           TopLeftIO, 1, TopLeftIO, 1) != TASK_INVALID) &&
+         (TaskGraphAddTask(&Graph, MIL_TEXT("Bottom-left"), BotLeftProcessing, &TParBotLeft,
+                           TopLeftIO, 1, BotLeftOut, 1) != TASK_INVALID) &&
+         (TaskGraphAddTask(&Graph, MIL_TEXT("Top-right"), TopProcessing, &TParTopRight,
+                           TopRightIO, 1, TopRightIO, 1) != TASK_INVALID) &&
+         (TaskGraphAddTask(&Graph, MIL_TEXT("Bottom-right"), BotRightProcessing, &TParBotRight,
+                           TopRightIO, 1, BotRightOut, 1) != TASK_INVALID) &&
+         (TaskGraphAddTask(&Graph, MIL_TEXT("Display"), DisplayProcessing, &DPar,
+                           DisplayIn, 4, DisplayOut, 1) != TASK_INVALID);
+      }
+
+   MosPrintf(MIL_TEXT("\nTASK GRAPH:\n"));
+   MosPrintf(MIL_TEXT("-----------\n\n"));
+   MappTimer(M_DEFAULT, M_TIMER_RESET+M_SYNCHRONOUS, M_NULL);
+   if (GraphValid)
+      {
+      MosPrintf(MIL_TEXT("%d tasks running on %d worker threads...\n"),
+                (int)Graph.NbTasks, (int)Graph.NbWorkers);
+      MosPrintf(MIL_TEXT("Press <Enter> to stop.\n\n"));
+
+      /* Run the graph until a key is pressed. */
+      while (!MosKbhit())
+         TaskGraphRun(&Graph);
+      MosGetch();
+      }
+   else
+      {
+      MosPrintf(MIL_TEXT("The task graph exceeds TASK_NB_MAX tasks or TASK_BUFFER_NB_MAX\n")
+                MIL_TEXT("buffers per task; it was not run.\n\n"));
+      }
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &Time);
+
+   /* Print statistics. The averages are not available if the graph did not run. */
+   for (i = 0; i < Graph.NbTasks; i++)
+      {
+      if (Graph.NbRuns > 0)
+         MosPrintf(MIL_TEXT("%-13s task: %6.3f ms per run.\n"), Graph.Task[i].Name,
+                   1000.0 * Graph.Task[i].TotalDuration / Graph.NbRuns);
+      else
+         MosPrintf(MIL_TEXT("%-13s task:    n/a ms per run.\n"), Graph.Task[i].Name);
+      }
+   MosPrintf(MIL_TEXT("\n"));
+   for (i = 0; i < Graph.NbWorkers; i++)
+      MosPrintf(MIL_TEXT("Worker %d: %5d tasks run, %5d stolen.\n"), (int)i,
+                (int)Graph.Worker[i].NbTasksRun, (int)Graph.Worker[i].NbTasksStolen);
+   MosPrintf(MIL_TEXT("\nGraph runs done:     %4d.\n"), (int)Graph.NbRuns);
+   if (Graph.NbRuns > 0)
+      {
+      MosPrintf(MIL_TEXT("Time per run:        %6.3f ms.\n"),
+                1000.0 * Graph.TotalTime / Graph.NbRuns);
+      MosPrintf(MIL_TEXT("Critical path:       %6.3f ms.\n\n"),
+                1000.0 * Graph.TotalCriticalPath / Graph.NbRuns);
+      MosPrintf(MIL_TEXT("Processing speed for the 4 quadrants: ")
+                                MIL_TEXT("%.0f Images/Sec.\n\n"), 4 * Graph.NbRuns / Time);
+      }
+   else
+      {
+      MosPrintf(MIL_TEXT("Time per run:           n/a ms.\n"));
+      MosPrintf(MIL_TEXT("Critical path:          n/a ms.\n\n"));
+      MosPrintf(MIL_TEXT("Processing speed for the 4 quadrants: n/a Images/Sec.\n\n"));
+      }
+   MosPrintf(MIL_TEXT("Press <Enter> to end.\n\n"));
+   MosGetch();
+
+   /* Free the task graph. */
+   TaskGraphFree(&Graph);
+
    /* Free events. */
    MthrFree(TParTopLeft.DoneEvent);
    MthrFree(TParBotLeft.DoneEvent);
@@ -253,53 +448,13 @@ int MosMain(void)
 MIL_UINT32 MFTYPE TopThread(void *ThreadParameters)
 {
    THREAD_PARAM  *TPar = (THREAD_PARAM *)ThreadParameters;
-   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX];
 
    while (!TPar->Exit)
       {
       /* Wait for bottom ready event before proceeding. */
       MthrWait(TPar->ReadyEvent, M_EVENT_WAIT, M_NULL);
 
-      /* For better visual effect, reset SrcImage to the original image regularly. */
-      if ((TPar->NumberOfIteration % 192) == 0)
-         MbufCopy(TPar->OrgImage, TPar->SrcImage);
-
-   #if (!M_MIL_LITE)
-      if (TPar->LicenseModules & M_LICENSE_IM)
-         {
-         /* Add a constant to the image. */
-         MimArith(TPar->SrcImage, 1L, TPar->DstImage, M_ADD_CONST+M_SATURATION);
-         }
-      else
-   #endif
-         {
-         /* Under MIL-Lite draw a variable size rectangle in the image. */
-         TPar->Radius = TPar->SlaveThreadParam->Radius = 
-                      (TPar->NumberOfIteration % DRAW_RADIUS_NUMBER) * DRAW_RADIUS_STEP;
-         MgraColor(M_DEFAULT, 0xff);
-         MgraRectFill(M_DEFAULT, TPar->DstImage, 
-                     DRAW_CENTER_POSX - TPar->Radius, DRAW_CENTER_POSY - TPar->Radius, 
-                     DRAW_CENTER_POSX + TPar->Radius, DRAW_CENTER_POSY + TPar->Radius);
-        }
-
-      /* Increment iteration count and draw text. */
-      TPar->NumberOfIteration++;
-      MgraColor(M_DEFAULT, 0xFF);
-      MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), (int)TPar->NumberOfIteration);
-      MgraText(M_DEFAULT, TPar->DstImage, STRING_POS_X, STRING_POS_Y, Text);
-
-      /* Update the display. */
-      if (TPar->DispImage)
-         {
-         MbufCopyColor2d(TPar->DstImage,
-                         TPar->DispImage,
-                         M_ALL_BANDS, 0, 0,
-                         M_ALL_BANDS,
-                         TPar->DispOffsetX,
-                         TPar->DispOffsetY,
-                         IMAGE_WIDTH,
-                         IMAGE_HEIGHT);
-         }
+      TopProcessing(TPar);
 
       /* Signal to the bottom thread that the first part of the processing is completed. */
       MthrControl(TPar->DoneEvent, M_EVENT_SET, M_SIGNALED);
@@ -316,64 +471,68 @@ MIL_UINT32 MFTYPE TopThread(void *ThreadParameters)
    return(1L);
 }
 
+/* Top-left and top-right processing (Add an offset): */
+/* -------------------------------------------------- */
+void TopProcessing(void *ThreadParameters)
+{
+   THREAD_PARAM  *TPar = (THREAD_PARAM *)ThreadParameters;
+   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX];
+
+   /* For better visual effect, reset SrcImage to the original image regularly. */
+   if ((TPar->NumberOfIteration % 192) == 0)
+      MbufCopy(TPar->OrgImage, TPar->SrcImage);
+
+#if (!M_MIL_LITE)
+   if (TPar->LicenseModules & M_LICENSE_IM)
+      {
+      /* Add a constant to the image. */
+      MimArith(TPar->SrcImage, 1L, TPar->DstImage, M_ADD_CONST+M_SATURATION);
+      }
+   else
+#endif
+      {
+      /* Under MIL-Lite draw a variable size rectangle in the image. */
+      TPar->Radius = TPar->SlaveThreadParam->Radius = 
+                   (TPar->NumberOfIteration % DRAW_RADIUS_NUMBER) * DRAW_RADIUS_STEP;
+      MgraColor(M_DEFAULT, 0xff);
+      MgraRectFill(M_DEFAULT, TPar->DstImage, 
+                  DRAW_CENTER_POSX - TPar->Radius, DRAW_CENTER_POSY - TPar->Radius, 
+                  DRAW_CENTER_POSX + TPar->Radius, DRAW_CENTER_POSY + TPar->Radius);
+     }
+
+   /* Increment iteration count and draw text. */
+   TPar->NumberOfIteration++;
+   MgraColor(M_DEFAULT, 0xFF);
+   MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), (int)TPar->NumberOfIteration);
+   MgraText(M_DEFAULT, TPar->DstImage, STRING_POS_X, STRING_POS_Y, Text);
+
+   /* Update the display. */
+   if (TPar->DispImage)
+      {
+      MbufCopyColor2d(TPar->DstImage,
+                      TPar->DispImage,
+                      M_ALL_BANDS, 0, 0,
+                      M_ALL_BANDS,
+                      TPar->DispOffsetX,
+                      TPar->DispOffsetY,
+                      IMAGE_WIDTH,
+                      IMAGE_HEIGHT);
+      }
+}
+
 
 /* Bottom-left thread function (Rotate): */
 /* ------------------------------------- */
 MIL_UINT32 MFTYPE BotLeftThread(void *ThreadParameters)
 {
    THREAD_PARAM  *TPar = (THREAD_PARAM *)ThreadParameters;
-   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX];
-   MIL_DOUBLE Angle = 0, AngleIncrement = 0.5;
 
    while (!TPar->Exit)
       {
       /* Wait for the event in top-left function to be ready before proceeding. */
       MthrWait(TPar->ReadyEvent, M_EVENT_WAIT, M_NULL);
 
-   #if (!M_MIL_LITE)
-      if (TPar->LicenseModules & M_LICENSE_IM)
-         {
-         /* Rotate the image. */
-         MimRotate(TPar->SrcImage, TPar->DstImage, Angle,
-                   M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT,
-                   M_NEAREST_NEIGHBOR+M_OVERSCAN_CLEAR);
-
-         Angle += AngleIncrement;
-
-         if (Angle >= 360)
-            {
-            Angle -= 360;
-            }
-         }
-      else
-   #endif
-         {
-         /* Under MIL-Lite copy the top-left image and draw */
-         /* a variable size filled circle in the image. */
-         MbufCopy(TPar->SrcImage,TPar->DstImage);
-         MgraColor(M_DEFAULT, 0x80);
-         MgraArcFill(M_DEFAULT, TPar->DstImage, DRAW_CENTER_POSX, DRAW_CENTER_POSY,
-                                                TPar->Radius, TPar->Radius, 0, 360);
-         }
-
-      /* Increment iteration count and draw text. */
-      TPar->NumberOfIteration++;
-      MgraColor(M_DEFAULT, 0xFF);
-      MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), (int)TPar->NumberOfIteration);
-      MgraText(M_DEFAULT, TPar->DstImage, STRING_POS_X, STRING_POS_Y, Text);
-
-      /* Update the display. */
-      if (TPar->DispImage)
-         {
-         MbufCopyColor2d(TPar->DstImage,
-                         TPar->DispImage,
-                         M_ALL_BANDS, 0, 0,
-                         M_ALL_BANDS,
-                         TPar->DispOffsetX,
-                         TPar->DispOffsetY,
-                         IMAGE_WIDTH,
-                         IMAGE_HEIGHT);
-         }
+      BotLeftProcessing(TPar);
 
       /* Signal to the top-left thread that the last part of the processing is completed. */
       MthrControl(TPar->DoneEvent, M_EVENT_SET, M_SIGNALED);
@@ -384,59 +543,379 @@ MIL_UINT32 MFTYPE BotLeftThread(void *ThreadParameters)
    return(1L);
 }
 
+/* Bottom-left processing (Rotate): */
+/* -------------------------------- */
+void BotLeftProcessing(void *ThreadParameters)
+{
+   THREAD_PARAM  *TPar = (THREAD_PARAM *)ThreadParameters;
+   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX];
+   MIL_DOUBLE AngleIncrement = 0.5;
+
+#if (!M_MIL_LITE)
+   if (TPar->LicenseModules & M_LICENSE_IM)
+      {
+      /* Rotate the image. */
+      MimRotate(TPar->SrcImage, TPar->DstImage, TPar->Angle,
+                M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT,
+                M_NEAREST_NEIGHBOR+M_OVERSCAN_CLEAR);
+
+      TPar->Angle += AngleIncrement;
+
+      if (TPar->Angle >= 360)
+         {
+         TPar->Angle -= 360;
+         }
+      }
+   else
+#endif
+      {
+      /* Under MIL-Lite copy the top-left image and draw */
+      /* a variable size filled circle in the image. */
+      MbufCopy(TPar->SrcImage,TPar->DstImage);
+      MgraColor(M_DEFAULT, 0x80);
+      MgraArcFill(M_DEFAULT, TPar->DstImage, DRAW_CENTER_POSX, DRAW_CENTER_POSY,
+                                             TPar->Radius, TPar->Radius, 0, 360);
+      }
+
+   /* Increment iteration count and draw text. */
+   TPar->NumberOfIteration++;
+   MgraColor(M_DEFAULT, 0xFF);
+   MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), (int)TPar->NumberOfIteration);
+   MgraText(M_DEFAULT, TPar->DstImage, STRING_POS_X, STRING_POS_Y, Text);
+
+   /* Update the display. */
+   if (TPar->DispImage)
+      {
+      MbufCopyColor2d(TPar->DstImage,
+                      TPar->DispImage,
+                      M_ALL_BANDS, 0, 0,
+                      M_ALL_BANDS,
+                      TPar->DispOffsetX,
+                      TPar->DispOffsetY,
+                      IMAGE_WIDTH,
+                      IMAGE_HEIGHT);
+      }
+}
+
 /* Bottom-right thread function (Edge Detect): */
 /* ------------------------------------------- */
 MIL_UINT32 MFTYPE BotRightThread(void *ThreadParameters)
 {
    THREAD_PARAM  *TPar = (THREAD_PARAM *)ThreadParameters;
-   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX];
 
    while (!TPar->Exit)
       {
       /* Wait for the event in top-right function to be ready before proceeding. */
       MthrWait(TPar->ReadyEvent, M_EVENT_WAIT, M_NULL);
 
-   #if (!M_MIL_LITE)
-      if (TPar->LicenseModules & M_LICENSE_IM)
+      BotRightProcessing(TPar);
+
+      /* Signal to the top-right thread that the last part of the processing is completed. */
+      MthrControl(TPar->DoneEvent, M_EVENT_SET, M_SIGNALED);
+      }
+      
+   /* Before exiting the thread, make sure that all the commands are executed. */
+   MthrWait(TPar->System, M_THREAD_WAIT, M_NULL);
+   return(1L);
+}
+
+/* Bottom-right processing (Edge Detect): */
+/* -------------------------------------- */
+void BotRightProcessing(void *ThreadParameters)
+{
+   THREAD_PARAM  *TPar = (THREAD_PARAM *)ThreadParameters;
+   MIL_TEXT_CHAR Text[STRING_LENGTH_MAX];
+
+#if (!M_MIL_LITE)
+   if (TPar->LicenseModules & M_LICENSE_IM)
+      {
+      /* Perform an edge detection operation on the image. */
+      MimConvolve(TPar->SrcImage, TPar->DstImage, M_EDGE_DETECT_SOBEL_FAST);
+      }
+   else
+#endif
+      {
+      /* Under MIL-Lite copy the top-right image and draw */
+      /* a variable size filled circle in the image. */
+      MbufCopy(TPar->SrcImage,TPar->DstImage);
+      MgraColor(M_DEFAULT, 0x40);
+      MgraArcFill(M_DEFAULT, TPar->DstImage, DRAW_CENTER_POSX, DRAW_CENTER_POSY,
+                  TPar->Radius/2, TPar->Radius/2, 0, 360);
+      }
+
+   /* Increment iteration count and draw text. */
+   TPar->NumberOfIteration++;
+   MgraColor(M_DEFAULT, 0xFF);
+   MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), (int)TPar->NumberOfIteration);
+   MgraText(M_DEFAULT, TPar->DstImage, STRING_POS_X, STRING_POS_Y, Text);
+
+   /* Update the display. */
+   if (TPar->DispImage)
+      {
+      MbufCopyColor2d(TPar->DstImage,
+                      TPar->DispImage,
+                      M_ALL_BANDS, 0, 0,
+                      M_ALL_BANDS,
+                      TPar->DispOffsetX,
+                      TPar->DispOffsetY,
+                      IMAGE_WIDTH,
+                      IMAGE_HEIGHT);
+      }
+}
+
+/* Display task function (Copy the 4 quadrants to the display): */
+/* ------------------------------------------------------------ */
+void DisplayProcessing(void *DisplayParameters)
+{
+   DISPLAY_PARAM *DPar = (DISPLAY_PARAM *)DisplayParameters;
+   MIL_INT i;
+
+   for (i = 0; i < 4; i++)
+      {
+      MbufCopyColor2d(DPar->Quadrant[i]->DstImage,
+                      DPar->DispImage,
+                      M_ALL_BANDS, 0, 0,
+                      M_ALL_BANDS,
+                      DPar->Quadrant[i]->DispOffsetX,
+                      DPar->Quadrant[i]->DispOffsetY,
+                      IMAGE_WIDTH,
+                      IMAGE_HEIGHT);
+      }
+   DPar->NumberOfIteration++;
+}
+
+
+/* Task graph scheduler: */
+/* --------------------- */
+
+/* Allocate the graph and start its worker threads. */
+void TaskGraphAlloc(MIL_ID System, MIL_INT NbWorkers, TASK_GRAPH *Graph)
+{
+   MIL_INT i;
+
+   Graph->System            = System;
+   Graph->NbTasks           = 0;
+   Graph->NbWorkers         = NbWorkers;
+   Graph->NbReady           = 0;
+   Graph->NbRemaining       = 0;
+   Graph->Exit              = false;
+   Graph->NbRuns            = 0;
+   Graph->TotalTime         = 0;
+   Graph->TotalCriticalPath = 0;
+   MthrAlloc(System, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &Graph->WorkEvent);
+   MthrAlloc(System, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &Graph->DoneEvent);
+
+   for (i = 0; i < NbWorkers; i++)
+      {
+      TASK_WORKER *Worker = &Graph->Worker[i];
+      Worker->Top           = 0;
+      Worker->Bottom        = 0;
+      Worker->NbTasksRun    = 0;
+      Worker->NbTasksStolen = 0;
+      Worker->Graph         = Graph;
+      MthrAlloc(System, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &Worker->Mutex);
+      MthrAlloc(System, M_THREAD, M_DEFAULT, &TaskWorkerThread, Worker, &Worker->Id);
+      }
+}
+
+/* Returns true if the 2 lists share a buffer. */
+static bool BuffersOverlap(const MIL_ID *List1, MIL_INT Nb1, const MIL_ID *List2, MIL_INT Nb2)
+{
+   for (MIL_INT i = 0; i < Nb1; i++)
+      for (MIL_INT j = 0; j < Nb2; j++)
+         if (List1[i] == List2[j])
+            return true;
+   return false;
+}
+
+/* Add a task. It depends on every previously added task that writes a buffer */
+/* it reads, or that reads or writes a buffer it writes. Returns the index of  */
+/* the task, or TASK_INVALID if the graph is full or the task has too many     */
+/* buffers.                                                                    */
+MIL_INT TaskGraphAddTask(TASK_GRAPH *Graph, const MIL_TEXT_CHAR *Name,
+                         TASK_FUNCTION_PTR Function, void *TaskData,
+                         const MIL_ID *InBuffers, MIL_INT NbInBuffers,
+                         const MIL_ID *OutBuffers, MIL_INT NbOutBuffers)
+{
+   MIL_INT i;
+
+   if (Graph->NbTasks >= TASK_NB_MAX ||
+       NbInBuffers < 0 || NbInBuffers > TASK_BUFFER_NB_MAX ||
+       NbOutBuffers < 0 || NbOutBuffers > TASK_BUFFER_NB_MAX)
+      return TASK_INVALID;
+
+   MIL_INT TaskIndex = Graph->NbTasks++;
+   TASK *Task = &Graph->Task[TaskIndex];
+
+   Task->Name           = Name;
+   Task->Function       = Function;
+   Task->TaskData       = TaskData;
+   Task->NbInBuffers    = NbInBuffers;
+   Task->NbOutBuffers   = NbOutBuffers;
+   Task->NbSuccessors   = 0;
+   Task->NbPredecessors = 0;
+   Task->Duration       = 0;
+   Task->TotalDuration  = 0;
+   for (i = 0; i < NbInBuffers; i++)
+      Task->InBuffer[i] = InBuffers[i];
+   for (i = 0; i < NbOutBuffers; i++)
+      Task->OutBuffer[i] = OutBuffers[i];
+
+   for (i = 0; i < TaskIndex; i++)
+      {
+      TASK *Previous = &Graph->Task[i];
+      if (BuffersOverlap(Previous->OutBuffer, Previous->NbOutBuffers, InBuffers, NbInBuffers) ||
+          BuffersOverlap(Previous->OutBuffer, Previous->NbOutBuffers, OutBuffers, NbOutBuffers) ||
+          BuffersOverlap(Previous->InBuffer, Previous->NbInBuffers, OutBuffers, NbOutBuffers))
          {
-         /* Perform an edge detection operation on the image. */
-         MimConvolve(TPar->SrcImage, TPar->DstImage, M_EDGE_DETECT_SOBEL_FAST);
+         Previous->Successor[Previous->NbSuccessors++] = TaskIndex;
+         Task->NbPredecessors++;
          }
+      }
+   return TaskIndex;
+}
+
+/* Queue a ready task at the bottom of a worker's deque. */
+static void TaskWorkerPush(TASK_WORKER *Worker, MIL_INT TaskIndex)
+{
+   MthrControl(Worker->Mutex, M_LOCK, M_DEFAULT);
+   Worker->Deque[Worker->Bottom++ % TASK_NB_MAX] = TaskIndex;
+   MthrControl(Worker->Mutex, M_UNLOCK, M_DEFAULT);
+
+   Worker->Graph->NbReady++;
+   MthrControl(Worker->Graph->WorkEvent, M_EVENT_SET, M_SIGNALED);
+}
+
+/* Take a task from the bottom of the worker's own deque, or from the top */
+/* of another worker's deque when stealing. Returns -1 if it is empty.    */
+static MIL_INT TaskWorkerPop(TASK_WORKER *Worker, bool Steal)
+{
+   MIL_INT TaskIndex = -1;
+
+   MthrControl(Worker->Mutex, M_LOCK, M_DEFAULT);
+   if (Worker->Bottom != Worker->Top)
+      {
+      if (Steal)
+         TaskIndex = Worker->Deque[Worker->Top++ % TASK_NB_MAX];
       else
-   #endif
+         TaskIndex = Worker->Deque[--Worker->Bottom % TASK_NB_MAX];
+      }
+   MthrControl(Worker->Mutex, M_UNLOCK, M_DEFAULT);
+   return TaskIndex;
+}
+
+/* Worker thread: runs ready tasks and queues the tasks they unblock. */
+MIL_UINT32 MFTYPE TaskWorkerThread(void *WorkerPtr)
+{
+   TASK_WORKER *Worker = (TASK_WORKER *)WorkerPtr;
+   TASK_GRAPH  *Graph  = Worker->Graph;
+   MIL_INT      WorkerIndex = Worker - Graph->Worker;
+   MIL_INT      TaskIndex, i;
+   MIL_DOUBLE   StartTime, EndTime;
+
+   while (!Graph->Exit)
+      {
+      /* Look in the own deque first, then try to steal from the others. */
+      TaskIndex = TaskWorkerPop(Worker, false);
+      for (i = 1; TaskIndex < 0 && i < Graph->NbWorkers; i++)
          {
-         /* Under MIL-Lite copy the top-right image and draw */
-         /* a variable size filled circle in the image. */
-         MbufCopy(TPar->SrcImage,TPar->DstImage);
-         MgraColor(M_DEFAULT, 0x40);
-         MgraArcFill(M_DEFAULT, TPar->DstImage, DRAW_CENTER_POSX, DRAW_CENTER_POSY,
-                     TPar->Radius/2, TPar->Radius/2, 0, 360);
+         TaskIndex = TaskWorkerPop(&Graph->Worker[(WorkerIndex + i) % Graph->NbWorkers], true);
+         if (TaskIndex >= 0)
+            Worker->NbTasksStolen++;
+         }
+      if (TaskIndex < 0)
+         {
+         MthrWait(Graph->WorkEvent, M_EVENT_WAIT+M_EVENT_TIMEOUT(TASK_WAIT_TIMEOUT), M_NULL);
+         continue;
          }
 
-      /* Increment iteration count and draw text. */
-      TPar->NumberOfIteration++;
-      MgraColor(M_DEFAULT, 0xFF);
-      MosSprintf(Text, STRING_LENGTH_MAX, MIL_TEXT("%d"), (int)TPar->NumberOfIteration);
-      MgraText(M_DEFAULT, TPar->DstImage, STRING_POS_X, STRING_POS_Y, Text);
-
-      /* Update the display. */
-      if (TPar->DispImage)
+      /* Wake another worker if more tasks are ready. */
+      if (--Graph->NbReady > 0)
+         MthrControl(Graph->WorkEvent, M_EVENT_SET, M_SIGNALED);
+
+      /* Run the task and wait until its MIL commands are executed. */
+      TASK *Task = &Graph->Task[TaskIndex];
+      MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+      Task->Function(Task->TaskData);
+      MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+      MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+      Task->Duration = EndTime - StartTime;
+      Task->TotalDuration += Task->Duration;
+      Worker->NbTasksRun++;
+
+      /* Queue the successors that have no pending predecessors left. */
+      for (i = 0; i < Task->NbSuccessors; i++)
          {
-         MbufCopyColor2d(TPar->DstImage,
-                         TPar->DispImage,
-                         M_ALL_BANDS, 0, 0,
-                         M_ALL_BANDS,
-                         TPar->DispOffsetX,
-                         TPar->DispOffsetY,
-                         IMAGE_WIDTH,
-                         IMAGE_HEIGHT);
+         if (--Graph->Task[Task->Successor[i]].PendingPredecessors == 0)
+            TaskWorkerPush(Worker, Task->Successor[i]);
          }
 
-      /* Signal to the top-right thread that the last part of the processing is completed. */
-      MthrControl(TPar->DoneEvent, M_EVENT_SET, M_SIGNALED);
+      if (--Graph->NbRemaining == 0)
+         MthrControl(Graph->DoneEvent, M_EVENT_SET, M_SIGNALED);
       }
-      
-   /* Before exiting the thread, make sure that all the commands are executed. */
-   MthrWait(TPar->System, M_THREAD_WAIT, M_NULL);
+
    return(1L);
 }
+
+/* Run all the tasks of the graph once and wait for the end. */
+void TaskGraphRun(TASK_GRAPH *Graph)
+{
+   MIL_DOUBLE StartTime, EndTime, PathStart[TASK_NB_MAX], CriticalPath = 0;
+   MIL_INT i, j, NextWorker = 0;
+
+   MappTimer(M_DEFAULT, M_TIMER_READ, &StartTime);
+   Graph->NbRemaining = Graph->NbTasks;
+   for (i = 0; i < Graph->NbTasks; i++)
+      Graph->Task[i].PendingPredecessors = Graph->Task[i].NbPredecessors;
+
+   /* Spread the tasks without predecessors over the workers. */
+   for (i = 0; i < Graph->NbTasks; i++)
+      {
+      if (Graph->Task[i].NbPredecessors == 0)
+         TaskWorkerPush(&Graph->Worker[NextWorker++ % Graph->NbWorkers], i);
+      }
+
+   MthrWait(Graph->DoneEvent, M_EVENT_WAIT, M_NULL);
+   MappTimer(M_DEFAULT, M_TIMER_READ, &EndTime);
+
+   /* The critical path is the longest chain of dependent tasks. Tasks only */
+   /* depend on tasks added before them, so one pass in order is enough.    */
+   for (i = 0; i < Graph->NbTasks; i++)
+      PathStart[i] = 0;
+   for (i = 0; i < Graph->NbTasks; i++)
+      {
+      TASK *Task = &Graph->Task[i];
+      MIL_DOUBLE PathEnd = PathStart[i] + Task->Duration;
+      for (j = 0; j < Task->NbSuccessors; j++)
+         {
+         if (PathEnd > PathStart[Task->Successor[j]])
+            PathStart[Task->Successor[j]] = PathEnd;
+         }
+      if (PathEnd > CriticalPath)
+         CriticalPath = PathEnd;
+      }
+
+   Graph->NbRuns++;
+   Graph->TotalTime         += EndTime - StartTime;
+   Graph->TotalCriticalPath += CriticalPath;
+}
+
+/* Stop the worker threads and free the graph. */
+void TaskGraphFree(TASK_GRAPH *Graph)
+{
+   MIL_INT i;
+
+   Graph->Exit = true;
+   for (i = 0; i < Graph->NbWorkers; i++)
+      {
+      MthrControl(Graph->WorkEvent, M_EVENT_SET, M_SIGNALED);
+      MthrWait(Graph->Worker[i].Id, M_THREAD_END_WAIT, M_NULL);
+      }
+   for (i = 0; i < Graph->NbWorkers; i++)
+      {
+      MthrFree(Graph->Worker[i].Id);
+      MthrFree(Graph->Worker[i].Mutex);
+      }
+   MthrFree(Graph->WorkEvent);
+   MthrFree(Graph->DoneEvent);
+}
@@ -9,13 +9,27 @@
 
 #include "common.h"
 
+//Number of frames that can be queued for each dispatch thread in frame queue mode
+static const MIL_INT FRAME_QUEUE_DEPTH_PER_THREAD = 2;
+
 //*******************************************************************************
 // Constructor.  Allocates and initializes the dispatcher
 //*******************************************************************************
-CDispatcher::CDispatcher(MIL_ID MilSystem, PROC_FUNCTION_PTR ProcessingFunctionPtr, void* DataPtr)
+CDispatcher::CDispatcher(MIL_ID MilSystem, PROC_FUNCTION_PTR ProcessingFunctionPtr, void* DataPtr, 
+                         MIL_INT NumDispatchThreads)
 : m_MilSystem(MilSystem), m_ProcessingFunctionPtr(ProcessingFunctionPtr), m_DataPtr(DataPtr), 
-  m_ThreadStarted(false), m_DispatchRunning(false), m_FrameRate(0.0)
+  m_ThreadStarted(false), m_DispatchRunning(false), m_FrameRate(0.0),
+  m_NumDispatchThreads(NumDispatchThreads), m_FrameQueue(M_NULL), m_NumFramesProcessed(0),
+  m_TotalFramesProcessed(0)
    {   
+   //Initialize the dispatch threads information of the frame queue mode
+   m_DispatchThreads = new DispatchThreadStruct[m_NumDispatchThreads];
+   for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+      {
+      m_DispatchThreads[i].Dispatcher = this;
+      m_DispatchThreads[i].Index = i;
+      m_DispatchThreads[i].MilThread = M_NULL;
+      }
    }
 
 //*******************************************************************************
@@ -24,6 +38,7 @@ CDispatcher::CDispatcher(MIL_ID MilSystem, PROC_FUNCTION_PTR ProcessingFunctionP
 CDispatcher::~CDispatcher()
    {
    StopThread();
+   delete [] m_DispatchThreads;
    }
 
 //*******************************************************************************
@@ -40,6 +55,21 @@ void CDispatcher::StartThread()
 
       //Allocate a thread, it is initially paused.
       MthrAlloc (m_MilSystem, M_THREAD, M_DEFAULT, &DispatchFunction, (void*)this, &m_MilDispatchThread);
+
+      //In frame queue mode, allocate the queue and the pool of dispatch threads.
+      if (m_NumDispatchThreads > 1)
+         {
+         m_FrameQueue = new CFrameQueue(m_MilSystem, m_NumDispatchThreads*FRAME_QUEUE_DEPTH_PER_THREAD);
+
+         for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+            {
+            DispatchThreadStruct& DispatchThread = m_DispatchThreads[i];
+            MthrAlloc (m_MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &DispatchThread.MilEvents[enRun]);
+            MthrAlloc (m_MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &DispatchThread.MilEvents[enKill]);
+            MthrAlloc (m_MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &DispatchThread.MilStoppedEvent);
+            MthrAlloc (m_MilSystem, M_THREAD, M_DEFAULT, &DispatchThreadFunction, (void*)&DispatchThread, &DispatchThread.MilThread);
+            }
+         }
       m_ThreadStarted = true;
       }
    }
@@ -55,6 +85,24 @@ void CDispatcher::StopThread()
       Pause();
       MthrControl(m_MilEvents[enKill], M_EVENT_SET, M_SIGNALED);
 
+      //Stop the dispatch threads of the frame queue mode
+      if (m_NumDispatchThreads > 1)
+         {
+         for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+            {
+            DispatchThreadStruct& DispatchThread = m_DispatchThreads[i];
+            MthrControl(DispatchThread.MilEvents[enKill], M_EVENT_SET, M_SIGNALED);
+            MthrWait(DispatchThread.MilThread, M_THREAD_END_WAIT, M_NULL);
+            MthrFree(DispatchThread.MilEvents[enRun]);
+            MthrFree(DispatchThread.MilEvents[enKill]);
+            MthrFree(DispatchThread.MilStoppedEvent);
+            MthrFree(DispatchThread.MilThread);
+            DispatchThread.MilThread = M_NULL;
+            }
+         delete m_FrameQueue;
+         m_FrameQueue = M_NULL;
+         }
+
       //Free related objects
       MthrWait(m_MilDispatchThread, M_THREAD_END_WAIT, M_NULL);
       MthrFree(m_MilEvents[enRun]);
@@ -97,13 +145,15 @@ void CDispatcher::Pause()
 
 //*******************************************************************************
 // RunDispatcher.  Function called in DispatchFunction to copy the buffer and
-// manage the call to the user function.
+// manage the call to the user function. In frame queue mode, it queues the
+// frames for the dispatch threads instead.
 //*******************************************************************************
 void CDispatcher::RunDispatcher()
    {
    const MIL_INT UpdateInterval = 2;
    MIL_DOUBLE EndTime;
    MIL_INT NumFrames=0;
+   MIL_INT FrameNumber=0;
    MIL_DOUBLE TotalTime;
    MIL_DOUBLE PreviousUpdateTime = 0.0;
    m_FrameRate = 0;
@@ -113,28 +163,56 @@ void CDispatcher::RunDispatcher()
       {
       MappTimer(M_TIMER_READ, &PreviousUpdateTime);
 
+      //Signal the dispatch threads of the frame queue mode to start pulling frames
+      if (m_NumDispatchThreads > 1)
+         {
+         m_NumFramesProcessed = 0;
+         for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+            MthrControl(m_DispatchThreads[i].MilEvents[enRun], M_EVENT_SET, M_SIGNALED);
+         }
+
       //Call and benchmark the processing function while the stop signal has not been received
       while (m_DispatchRunning)
          {
-         //Call the processing function
-         m_ProcessingFunctionPtr(m_DataPtr);
+         if (m_NumDispatchThreads > 1)
+            {
+            //Queue the next frame. This waits while all the dispatch threads are busy.
+            m_FrameQueue->Push(FrameNumber++, m_DispatchRunning);
+            }
+         else
+            {
+            //Call the processing function
+            m_ProcessingFunctionPtr(m_DataPtr, 0);
          
-         MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+            MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+            NumFrames++;
+            m_TotalFramesProcessed++;
+            }
          
          //Time the processing and calculate the FPS
-         NumFrames++;
          MappTimer(M_TIMER_READ, &EndTime);
 
          if ((EndTime-PreviousUpdateTime)>UpdateInterval)
             {
             TotalTime = EndTime-PreviousUpdateTime;
 
+            if (m_NumDispatchThreads > 1)
+               NumFrames = m_NumFramesProcessed.exchange(0);
+
             m_FrameRate = NumFrames / TotalTime;
             NumFrames = 0;
             PreviousUpdateTime=EndTime;
             }
          }
 
+      //Wait for the dispatch threads to finish their frame and empty the queue
+      if (m_NumDispatchThreads > 1)
+         {
+         for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+            MthrWait(m_DispatchThreads[i].MilStoppedEvent, M_EVENT_WAIT, M_NULL);
+         m_FrameQueue->Clear();
+         }
+
       //Signal that the dispatcher has stopped
       MthrControl(m_MilDispatchStoppedEvent, M_EVENT_SET, M_SIGNALED);
       }   
@@ -152,3 +230,45 @@ MIL_UINT32 MFTYPE CDispatcher::DispatchFunction(void *UserDataPtr)
 
    return 0;
    }
+
+//*******************************************************************************
+// RunDispatchThread.  Function called in DispatchThreadFunction to pull the
+// frames from the queue and call the user function in frame queue mode.
+//*******************************************************************************
+void CDispatcher::RunDispatchThread(MIL_INT DispatchThreadIndex)
+   {
+   DispatchThreadStruct& DispatchThread = m_DispatchThreads[DispatchThreadIndex];
+   MIL_INT FrameNumber;
+
+   //Wait for an event
+   while ( MthrWaitMultiple(DispatchThread.MilEvents, NUM_EVENTS, M_EVENT_WAIT, M_NULL) != (MIL_INT)enKill )
+      {
+      //Process the queued frames while the stop signal has not been received
+      while (m_FrameQueue->Pull(FrameNumber, m_DispatchRunning))
+         {
+         //Call the processing function with the buffers of this dispatch thread
+         m_ProcessingFunctionPtr(m_DataPtr, DispatchThreadIndex);
+
+         MthrWait(M_DEFAULT, M_THREAD_WAIT, M_NULL);
+         m_NumFramesProcessed++;
+         m_TotalFramesProcessed++;
+         }
+
+      //Signal that the dispatch thread has stopped
+      MthrControl(DispatchThread.MilStoppedEvent, M_EVENT_SET, M_SIGNALED);
+      }
+   }
+
+//*******************************************************************************
+// DispatchThreadFunction.  Call back function for the dispatch threads of the
+// frame queue mode.
+//*******************************************************************************
+MIL_UINT32 MFTYPE CDispatcher::DispatchThreadFunction(void *UserDataPtr)
+   {
+   DispatchThreadStruct* DispatchThread = (DispatchThreadStruct*)UserDataPtr;
+
+   //Run the dispatch thread
+   DispatchThread->Dispatcher->RunDispatchThread(DispatchThread->Index);
+
+   return 0;
+   }
@@ -10,16 +10,33 @@
 #ifndef DISPATCHER_H
 #define DISPATCHER_H
 
-typedef long (*PROC_FUNCTION_PTR)(void* UserData);
+typedef long (*PROC_FUNCTION_PTR)(void* UserData, MIL_INT DispatchThreadIndex);
+
+class CDispatcher;
+
+//structure for the dispatch threads of the frame queue mode
+struct DispatchThreadStruct
+   {
+   CDispatcher*   Dispatcher;
+   MIL_INT        Index;
+   MIL_ID         MilThread;
+   MIL_ID         MilEvents[NUM_EVENTS];
+   MIL_ID         MilStoppedEvent;
+   };
 
 //*****************************************************************************
 // Class used to define the dispatcher of the MP processing example.
 // It manages the processing thread and its associated events.
+//
+// With more than one dispatch thread, the dispatcher runs in frame queue mode:
+// its thread pushes frames in a queue from which a pool of dispatch threads
+// pull and process them. This combines user-level threading with MIL's MP.
 //*****************************************************************************
 class CDispatcher
    {
    public:
-      CDispatcher(MIL_ID MilSystem, PROC_FUNCTION_PTR ProcessingFunctionPtr, void* DataPtr);
+      CDispatcher(MIL_ID MilSystem, PROC_FUNCTION_PTR ProcessingFunctionPtr, void* DataPtr, 
+                  MIL_INT NumDispatchThreads);
       ~CDispatcher();
 
       //Dispatcher thread control operations
@@ -28,13 +45,17 @@ class CDispatcher
       void Run();
       void Pause();
 
-      MIL_ID GetThreadId() { return m_MilDispatchThread;}
+      //Returns the thread in which the processing is done. In frame queue mode,
+      //there is one such thread per dispatch thread index.
+      inline MIL_ID GetThreadId(MIL_INT DispatchThreadIndex = 0) const;
+      inline MIL_INT GetNumDispatchThreads() const;
 
       //Dispatcher inquire information functions
       inline bool ThreadStarted() const;
       inline bool IsRunning() const;
 
       inline MIL_DOUBLE GetFrameRate() const;
+      inline MIL_INT GetTotalFramesProcessed() const;
 
    private:
       //Disallow copy
@@ -49,6 +70,15 @@ class CDispatcher
       volatile bool       m_DispatchRunning;
       MIL_ID              m_MilDispatchStoppedEvent;
 
+      //Frame queue mode objects
+      MIL_INT               m_NumDispatchThreads;
+      DispatchThreadStruct* m_DispatchThreads;
+      CFrameQueue*          m_FrameQueue;
+      std::atomic<MIL_INT>  m_NumFramesProcessed;
+
+      //Number of frames processed since the thread started, in both modes
+      std::atomic<MIL_INT>  m_TotalFramesProcessed;
+
       //Variable that holds a pointer to the processing function to call in the dispatcher thread
       PROC_FUNCTION_PTR m_ProcessingFunctionPtr;
       void*             m_DataPtr;
@@ -56,6 +86,8 @@ class CDispatcher
       //Functions called from the dispatcher thread
       static MIL_UINT32 MFTYPE DispatchFunction(void *UserDataPtr);
       void RunDispatcher();
+      static MIL_UINT32 MFTYPE DispatchThreadFunction(void *UserDataPtr);
+      void RunDispatchThread(MIL_INT DispatchThreadIndex);
    };
 
 //*******************************************************************************
@@ -74,6 +106,23 @@ inline bool CDispatcher::IsRunning() const
    return (m_ThreadStarted&&m_DispatchRunning); 
    }
 
+//*******************************************************************************
+// GetThreadId.  Returns the MIL thread that calls the processing function.
+//*******************************************************************************
+inline MIL_ID CDispatcher::GetThreadId(MIL_INT DispatchThreadIndex) const
+   {
+   return (m_NumDispatchThreads > 1)?m_DispatchThreads[DispatchThreadIndex].MilThread:m_MilDispatchThread;
+   }
+
+//*******************************************************************************
+// GetNumDispatchThreads.  Returns the number of threads that call the
+// processing function.
+//*******************************************************************************
+inline MIL_INT CDispatcher::GetNumDispatchThreads() const
+   {
+   return m_NumDispatchThreads;
+   }
+
 //*******************************************************************************
 // GetFrameRate.  Returns the frame rate of the dispatcher
 //*******************************************************************************
@@ -82,4 +131,13 @@ inline MIL_DOUBLE CDispatcher::GetFrameRate() const
    return m_FrameRate;
    }
 
+//*******************************************************************************
+// GetTotalFramesProcessed.  Returns the number of frames processed since the
+// thread started.
+//*******************************************************************************
+inline MIL_INT CDispatcher::GetTotalFramesProcessed() const
+   {
+   return m_TotalFramesProcessed;
+   }
+
 #endif
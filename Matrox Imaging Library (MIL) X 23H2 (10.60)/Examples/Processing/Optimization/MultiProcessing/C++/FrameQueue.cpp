@@ -0,0 +1,106 @@
+﻿//***************************************************************************************/
+//
+// File name: FrameQueue.cpp
+//
+// Synopsis:  Implements the CFrameQueue class.
+//
+// Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+// All Rights Reserved
+
+#include "common.h"
+
+//Maximum time to wait before checking again whether the dispatching is still running
+static const MIL_INT QUEUE_WAIT_TIMEOUT = 50;
+
+//*******************************************************************************
+// Constructor.  Allocates the queue and its synchronization objects.
+//*******************************************************************************
+CFrameQueue::CFrameQueue(MIL_ID MilSystem, MIL_INT Capacity)
+: m_Capacity(Capacity), m_Head(0), m_Count(0)
+   {
+   m_Frames = new MIL_INT[m_Capacity];
+
+   MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilMutex);
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &m_MilNotEmptyEvent);
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED+M_AUTO_RESET, M_NULL, M_NULL, &m_MilNotFullEvent);
+   }
+
+//*******************************************************************************
+// Destructor.  Frees the queue.
+//*******************************************************************************
+CFrameQueue::~CFrameQueue()
+   {
+   MthrFree(m_MilNotFullEvent);
+   MthrFree(m_MilNotEmptyEvent);
+   MthrFree(m_MilMutex);
+
+   delete [] m_Frames;
+   }
+
+//*******************************************************************************
+// Push.  Adds a frame at the end of the queue.
+//*******************************************************************************
+bool CFrameQueue::Push(MIL_INT FrameNumber, const volatile bool& Running)
+   {
+   while (Running)
+      {
+      MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+      if (m_Count < m_Capacity)
+         {
+         m_Frames[(m_Head+m_Count)%m_Capacity] = FrameNumber;
+         m_Count++;
+
+         //Wake up a waiting thread. Since the events are auto-reset, a thread
+         //that is woken up wakes the next one if there is still room (or frames).
+         MthrControl(m_MilNotEmptyEvent, M_EVENT_SET, M_SIGNALED);
+         if (m_Count < m_Capacity)
+            MthrControl(m_MilNotFullEvent, M_EVENT_SET, M_SIGNALED);
+         MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+         return true;
+         }
+      MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+
+      //The queue is full, wait for a thread to pull a frame
+      MthrWait(m_MilNotFullEvent, M_EVENT_WAIT+M_EVENT_TIMEOUT(QUEUE_WAIT_TIMEOUT), M_NULL);
+      }
+   return false;
+   }
+
+//*******************************************************************************
+// Pull.  Removes the frame at the front of the queue.
+//*******************************************************************************
+bool CFrameQueue::Pull(MIL_INT& FrameNumber, const volatile bool& Running)
+   {
+   while (Running)
+      {
+      MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+      if (m_Count > 0)
+         {
+         FrameNumber = m_Frames[m_Head];
+         m_Head = (m_Head+1)%m_Capacity;
+         m_Count--;
+
+         MthrControl(m_MilNotFullEvent, M_EVENT_SET, M_SIGNALED);
+         if (m_Count > 0)
+            MthrControl(m_MilNotEmptyEvent, M_EVENT_SET, M_SIGNALED);
+         MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+         return true;
+         }
+      MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+
+      //The queue is empty, wait for a frame to be pushed
+      MthrWait(m_MilNotEmptyEvent, M_EVENT_WAIT+M_EVENT_TIMEOUT(QUEUE_WAIT_TIMEOUT), M_NULL);
+      }
+   return false;
+   }
+
+//*******************************************************************************
+// Clear.  Removes all the frames from the queue.
+//*******************************************************************************
+void CFrameQueue::Clear()
+   {
+   MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+   m_Head = 0;
+   m_Count = 0;
+   MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+   }
@@ -0,0 +1,45 @@
+﻿//***************************************************************************************
+//
+// File name: FrameQueue.h
+//
+// Synopsis:  Class that defines the queue of frames shared by the dispatch
+//            threads of a processing object.
+//
+// Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+// All Rights Reserved
+
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+//*****************************************************************************
+// Class used to define a bounded queue of frame numbers. Many threads can
+// push and pull frames concurrently.
+//*****************************************************************************
+class CFrameQueue
+   {
+   public:
+      CFrameQueue(MIL_ID MilSystem, MIL_INT Capacity);
+      ~CFrameQueue();
+
+      //Queue operations. They wait while the queue is full (or empty) and
+      //return false if Running becomes false before the operation is done.
+      bool Push(MIL_INT FrameNumber, const volatile bool& Running);
+      bool Pull(MIL_INT& FrameNumber, const volatile bool& Running);
+      void Clear();
+
+   private:
+      //Disallow copy
+      CFrameQueue(const CFrameQueue&);
+      CFrameQueue& operator=(const CFrameQueue&);
+
+      MIL_ID   m_MilMutex;
+      MIL_ID   m_MilNotEmptyEvent;
+      MIL_ID   m_MilNotFullEvent;
+
+      MIL_INT* m_Frames;
+      MIL_INT  m_Capacity;
+      MIL_INT  m_Head;
+      MIL_INT  m_Count;
+   };
+
+#endif
@@ -0,0 +1,432 @@
+﻿//***************************************************************************************/
+//
+// File name: MPAutoTuner.cpp
+//
+// Synopsis:  Implements the CMPAutoTuner class.
+//
+// Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+// All Rights Reserved
+
+#include "common.h"
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#if M_MIL_USE_WINDOWS
+#include <windows.h>
+#endif
+
+//File in which the tuned configurations are kept
+#define PROFILE_FILE M_TEMP_DIR MIL_TEXT("MultiProcessingProfiles.txt")
+
+//Separator between the key and the values of a profile
+static const MIL_TEXT_CHAR PROFILE_SEPARATOR = MIL_TEXT(';');
+
+//Time to let a configuration settle before measuring its frame rate. It is
+//longer than the update interval of the dispatcher frame rate.
+static const MIL_INT TUNE_SETTLE_TIME = 2500;
+
+//Number of frame rate readings averaged for a configuration and time between
+//them. Each reading covers a new update interval of the dispatcher.
+static const MIL_INT NUM_TUNE_SAMPLES = 3;
+static const MIL_INT TUNE_SAMPLE_INTERVAL = 2100;
+
+//Minimum relative gain for a configuration to replace the best one, so that
+//measurement noise does not select a different configuration.
+static const MIL_DOUBLE TUNE_MIN_GAIN = 0.02;
+
+//MP priorities tried by the tuner
+static const MIL_INT TUNE_PRIORITIES[] = { M_NORMAL, M_ABOVE_NORMAL, M_HIGHEST };
+static const MIL_INT NUM_TUNE_PRIORITIES = sizeof(TUNE_PRIORITIES)/sizeof(TUNE_PRIORITIES[0]);
+
+//*****************************************************************************
+// Constructor. Identifies the CPU and gets the cores available to the process.
+//*****************************************************************************
+CMPAutoTuner::CMPAutoTuner()
+: m_ProfileFileName(PROFILE_FILE)
+   {
+   m_CpuModel = InquireCpuModel();
+
+   MIL_INT CoreAffinityMaskArraySize;
+   MappInquireMp(M_DEFAULT, M_CORE_AFFINITY_MASK_ARRAY_SIZE, M_DEFAULT, M_DEFAULT, &CoreAffinityMaskArraySize);
+   m_CoreAffinityMaskProcess = new MIL_UINT64[CoreAffinityMaskArraySize];
+   MappInquireMp(M_DEFAULT, M_CORE_AFFINITY_MASK_PROCESS, M_DEFAULT, M_DEFAULT, m_CoreAffinityMaskProcess);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CMPAutoTuner::~CMPAutoTuner()
+   {
+   delete [] m_CoreAffinityMaskProcess;
+   }
+
+//*****************************************************************************
+// Tune. Searches the MP controls one at a time (MP, core maximum, core
+// sharing, priority, core affinity and memory bank), keeping the value that
+// gives the highest frame rate before moving to the next control.
+//*****************************************************************************
+MIL_DOUBLE CMPAutoTuner::Tune(CMPProcessing* Processing, MIL_INT NumCores)
+   {
+   bool WasRunning = Processing->IsRunning();
+   NumCores = (NumCores>1)?NumCores:1;
+
+   MosPrintf(MIL_TEXT("Tuning %s processing on %s, %d core(s) per dispatch thread...\n"),
+             Processing->GetProcessingName(), m_CpuModel.c_str(), (int)NumCores);
+
+   //Start from the current configuration of the processing
+   MPConfigStruct Best;
+   Best.MPEnable = Processing->MPEnabled();
+   Best.CoreMax = Processing->GetCoreMax();
+   Best.CoreSharing = Processing->CoreSharingEnabled();
+   Best.MPPriority = Processing->GetMPPriority();
+   Best.CoreAffinityMask = Processing->GetCoreAffinity();
+   Best.MemoryBankIndex = 0;
+   bool AutoMemoryBank = Processing->AutoMemoryBankEnabled();
+   if (AutoMemoryBank)
+      Best.MemoryBankIndex = -1;
+   for (MIL_INT i=0; !AutoMemoryBank && Processing->UseMemoryBank() && (i<Processing->GetNumMemoryBank()); i++)
+      {
+      bool ValidBank = false;
+      if (Processing->GetMemoryBank(i, ValidBank) == Processing->GetCurrentMemoryBank())
+         Best.MemoryBankIndex = i+1;
+      }
+   Evaluate(Processing, Best);
+
+   MPConfigStruct Candidate;
+   if (NumCores >= MIN_MP_CORES)
+      {
+      //MP
+      Candidate = Best;
+      Candidate.MPEnable = !Best.MPEnable;
+      Candidate.CoreMax = NumCores;
+      TryConfig(Processing, Candidate, Best);
+      }
+
+   if (Best.MPEnable)
+      {
+      //Maximum number of cores, by powers of two up to the available cores
+      for (MIL_INT CoreMax=MIN_MP_CORES; ; CoreMax*=2)
+         {
+         Candidate = Best;
+         Candidate.CoreMax = (CoreMax<NumCores)?CoreMax:NumCores;
+         if (Candidate.CoreMax != Best.CoreMax)
+            TryConfig(Processing, Candidate, Best);
+         if (CoreMax >= NumCores)
+            break;
+         }
+
+      //Core sharing
+      Candidate = Best;
+      Candidate.CoreSharing = !Best.CoreSharing;
+      TryConfig(Processing, Candidate, Best);
+
+      //MP priority
+      for (MIL_INT i=0; i<NUM_TUNE_PRIORITIES; i++)
+         {
+         Candidate = Best;
+         Candidate.MPPriority = TUNE_PRIORITIES[i];
+         if (Candidate.MPPriority != Best.MPPriority)
+            TryConfig(Processing, Candidate, Best);
+         }
+
+      //Core affinity on the first cores of the process
+      Candidate = Best;
+      Candidate.CoreAffinityMask = (Best.CoreAffinityMask==0)?GetCoreAffinityMask(Best.CoreMax):0;
+      TryConfig(Processing, Candidate, Best);
+      }
+
+   //Memory bank of the processing buffers. Trying a bank turns off the automatic
+   //selection, which is restored if no bank is better.
+   for (MIL_INT i=0; i<=Processing->GetNumMemoryBank(); i++)
+      {
+      Candidate = Best;
+      Candidate.MemoryBankIndex = i;
+      if (Candidate.MemoryBankIndex != Best.MemoryBankIndex)
+         TryConfig(Processing, Candidate, Best);
+      }
+   if (AutoMemoryBank && (Best.MemoryBankIndex < 0))
+      Processing->SetAutoMemoryBank(true);
+
+   //Apply and save the best configuration
+   ApplyConfig(Processing, Best);
+   if (!WasRunning)
+      Processing->Pause();
+   SaveProfile(GetProfileKey(Processing), Best);
+
+   MosPrintf(MIL_TEXT("Best configuration: "));
+   PrintConfig(Best);
+   MosPrintf(MIL_TEXT("\n"));
+
+   return Best.FrameRate;
+   }
+
+//*****************************************************************************
+// ApplyProfile. Applies the saved configuration of the processing object.
+// The maximum number of cores is limited to the given number of cores.
+//*****************************************************************************
+bool CMPAutoTuner::ApplyProfile(CMPProcessing* Processing, MIL_INT NumCores) const
+   {
+   MPConfigStruct Config;
+   if (!LoadProfile(GetProfileKey(Processing), Config))
+      return false;
+
+   if (Config.CoreMax > NumCores)
+      Config.CoreMax = (NumCores>1)?NumCores:1;
+   if (Config.MemoryBankIndex > Processing->GetNumMemoryBank())
+      Config.MemoryBankIndex = -1;
+
+   ApplyConfig(Processing, Config);
+   return true;
+   }
+
+//*****************************************************************************
+// Evaluate. Runs the processing with the given configuration and measures
+// its frame rate.
+//*****************************************************************************
+MIL_DOUBLE CMPAutoTuner::Evaluate(CMPProcessing* Processing, MPConfigStruct& Config) const
+   {
+   //Restart the processing so that the frame rate only covers this configuration
+   Processing->Pause();
+   ApplyConfig(Processing, Config);
+   Processing->Run();
+   MosSleep(TUNE_SETTLE_TIME);
+
+   MIL_DOUBLE FrameRate = 0.0;
+   for (MIL_INT i=0; i<NUM_TUNE_SAMPLES; i++)
+      {
+      FrameRate += Processing->GetFrameRate();
+      if (i < NUM_TUNE_SAMPLES-1)
+         MosSleep(TUNE_SAMPLE_INTERVAL);
+      }
+   Config.FrameRate = FrameRate/NUM_TUNE_SAMPLES;
+
+   MosPrintf(MIL_TEXT("   "));
+   PrintConfig(Config);
+   MosPrintf(MIL_TEXT("\n"));
+
+   return Config.FrameRate;
+   }
+
+//*****************************************************************************
+// TryConfig. Evaluates the candidate configuration and keeps it if it is
+// better than the best one.
+//*****************************************************************************
+bool CMPAutoTuner::TryConfig(CMPProcessing* Processing, MPConfigStruct& Candidate, MPConfigStruct& Best) const
+   {
+   if (Evaluate(Processing, Candidate) > Best.FrameRate*(1.0+TUNE_MIN_GAIN))
+      {
+      Best = Candidate;
+      return true;
+      }
+   return false;
+   }
+
+//*****************************************************************************
+// ApplyConfig. Sets the MP controls of the processing object. The memory bank
+// is left as is, possibly selected automatically, unless the configuration
+// picked one.
+//*****************************************************************************
+void CMPAutoTuner::ApplyConfig(CMPProcessing* Processing, const MPConfigStruct& Config) const
+   {
+   Processing->SetMP(Config.MPEnable);
+   Processing->SetCoreMax(Config.CoreMax);
+   Processing->SetCoreSharing(Config.CoreSharing);
+   Processing->SetMPPriority(Config.MPPriority);
+   Processing->SetCoreAffinity(Config.CoreAffinityMask);
+
+   if (Config.MemoryBankIndex >= 0)
+      {
+      bool ValidBank = false;
+      MIL_INT64 MemoryBank = Processing->GetMemoryBank(Config.MemoryBankIndex-1, ValidBank);
+      Processing->SetCurrentMemoryBank(MemoryBank, ValidBank);
+      }
+   }
+
+//*****************************************************************************
+// PrintConfig. Prints a configuration and its frame rate.
+//*****************************************************************************
+void CMPAutoTuner::PrintConfig(const MPConfigStruct& Config) const
+   {
+   if (Config.MPEnable)
+      {
+      MosPrintf(MIL_TEXT("MP on, %d cores, sharing %s, priority %d, affinity 0x%llx, "),
+                (int)Config.CoreMax, Config.CoreSharing?MIL_TEXT("on"):MIL_TEXT("off"),
+                (int)Config.MPPriority, (unsigned long long)Config.CoreAffinityMask);
+      }
+   else
+      {
+      MosPrintf(MIL_TEXT("MP off, "));
+      }
+
+   if (Config.MemoryBankIndex > 0)
+      MosPrintf(MIL_TEXT("memory bank %d: "), (int)(Config.MemoryBankIndex-1));
+   else if (Config.MemoryBankIndex < 0)
+      MosPrintf(MIL_TEXT("automatic memory bank: "));
+   else
+      MosPrintf(MIL_TEXT("no memory bank: "));
+
+   MosPrintf(MIL_TEXT("%.1f fps"), Config.FrameRate);
+   }
+
+//*****************************************************************************
+// GetProfileKey. Returns the key of the profile of the processing object:
+// the CPU model, the processing, its image size and its dispatch threads.
+//*****************************************************************************
+MIL_STRING CMPAutoTuner::GetProfileKey(const CMPProcessing* Processing) const
+   {
+   MIL_TEXT_CHAR Key[STRING_SIZE*2];
+   MosSprintf(Key, STRING_SIZE*2, MIL_TEXT("%s|%s|%dx%dx%d|%d"), m_CpuModel.c_str(),
+              Processing->GetProcessingName(), (int)Processing->GetBufferSizeX(),
+              (int)Processing->GetBufferSizeY(), (int)Processing->GetBufferSizeBand(),
+              (int)Processing->GetNumDispatchThreads());
+   return MIL_STRING(Key);
+   }
+
+//*****************************************************************************
+// LoadProfile. Reads the configuration saved with the given key.
+//*****************************************************************************
+bool CMPAutoTuner::LoadProfile(const MIL_STRING& Key, MPConfigStruct& Config) const
+   {
+   std::basic_ifstream<MIL_TEXT_CHAR> ProfileFile(m_ProfileFileName.c_str());
+   MIL_STRING Line;
+
+   while (std::getline(ProfileFile, Line))
+      {
+      if ((Line.size() <= Key.size()) || (Line.compare(0, Key.size(), Key) != 0) ||
+          (Line[Key.size()] != PROFILE_SEPARATOR))
+         continue;
+
+      std::basic_istringstream<MIL_TEXT_CHAR> Values(Line.substr(Key.size()+1));
+      MIL_TEXT_CHAR Separator;
+      long long MPEnable, CoreMax, CoreSharing, MPPriority, MemoryBankIndex;
+      unsigned long long CoreAffinityMask;
+      double FrameRate;
+
+      if (Values >> MPEnable >> Separator >> CoreMax >> Separator >> CoreSharing >> Separator
+                 >> MPPriority >> Separator >> CoreAffinityMask >> Separator
+                 >> MemoryBankIndex >> Separator >> FrameRate)
+         {
+         Config.MPEnable = (MPEnable!=0);
+         Config.CoreMax = (MIL_INT)CoreMax;
+         Config.CoreSharing = (CoreSharing!=0);
+         Config.MPPriority = (MIL_INT)MPPriority;
+         Config.CoreAffinityMask = (MIL_UINT64)CoreAffinityMask;
+         Config.MemoryBankIndex = (MIL_INT)MemoryBankIndex;
+         Config.FrameRate = FrameRate;
+         return true;
+         }
+      }
+   return false;
+   }
+
+//*****************************************************************************
+// SaveProfile. Saves the configuration with the given key, replacing the
+// previous configuration with the same key and keeping the other ones.
+//*****************************************************************************
+void CMPAutoTuner::SaveProfile(const MIL_STRING& Key, const MPConfigStruct& Config) const
+   {
+   std::vector<MIL_STRING> OtherProfiles;
+   MIL_STRING Line;
+
+      {
+      std::basic_ifstream<MIL_TEXT_CHAR> ProfileFile(m_ProfileFileName.c_str());
+      while (std::getline(ProfileFile, Line))
+         {
+         bool SameKey = (Line.size() > Key.size()) && (Line.compare(0, Key.size(), Key) == 0) &&
+                        (Line[Key.size()] == PROFILE_SEPARATOR);
+         if (!Line.empty() && !SameKey)
+            OtherProfiles.push_back(Line);
+         }
+      }
+
+   MIL_FILE ProfileFile = MosFopen(m_ProfileFileName.c_str(), MIL_TEXT("w"));
+   if (!ProfileFile)
+      {
+      MosPrintf(MIL_TEXT("Unable to save the profile in %s.\n"), m_ProfileFileName.c_str());
+      return;
+      }
+
+   for (size_t i=0; i<OtherProfiles.size(); i++)
+      MosFprintf(ProfileFile, MIL_TEXT("%s\n"), OtherProfiles[i].c_str());
+
+   MosFprintf(ProfileFile, MIL_TEXT("%s%c%d%c%d%c%d%c%d%c%llu%c%d%c%.1f\n"), Key.c_str(),
+              PROFILE_SEPARATOR, (int)Config.MPEnable,
+              PROFILE_SEPARATOR, (int)Config.CoreMax,
+              PROFILE_SEPARATOR, (int)Config.CoreSharing,
+              PROFILE_SEPARATOR, (int)Config.MPPriority,
+              PROFILE_SEPARATOR, (unsigned long long)Config.CoreAffinityMask,
+              PROFILE_SEPARATOR, (int)Config.MemoryBankIndex,
+              PROFILE_SEPARATOR, Config.FrameRate);
+   MosFclose(ProfileFile);
+
+   MosPrintf(MIL_TEXT("Profile saved in %s.\n"), m_ProfileFileName.c_str());
+   }
+
+//*****************************************************************************
+// GetCoreAffinityMask. Returns the mask of the first cores of the process.
+//*****************************************************************************
+MIL_UINT64 CMPAutoTuner::GetCoreAffinityMask(MIL_INT NumCores) const
+   {
+   MIL_UINT64 AffinityMask = 0;
+   MIL_INT NumCoresInMask = 0;
+
+   for (MIL_INT i=0; (i<MAX_MP_CORES) && (NumCoresInMask<NumCores); i++)
+      {
+      if (m_CoreAffinityMaskProcess[0]&((MIL_UINT64)1<<i))
+         {
+         AffinityMask |= ((MIL_UINT64)1<<i);
+         NumCoresInMask++;
+         }
+      }
+
+   return AffinityMask;
+   }
+
+//*****************************************************************************
+// InquireCpuModel. Returns the name of the CPU model followed by the number
+// of cores available to the process.
+//*****************************************************************************
+MIL_STRING CMPAutoTuner::InquireCpuModel()
+   {
+   MIL_STRING CpuModel;
+
+#if M_MIL_USE_WINDOWS
+   MIL_TEXT_CHAR ProcessorName[STRING_SIZE] = MIL_TEXT("");
+   DWORD ProcessorNameSize = sizeof(ProcessorName);
+   if (RegGetValue(HKEY_LOCAL_MACHINE, MIL_TEXT("HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0"),
+                   MIL_TEXT("ProcessorNameString"), RRF_RT_REG_SZ, NULL, ProcessorName,
+                   &ProcessorNameSize) == ERROR_SUCCESS)
+      CpuModel = ProcessorName;
+#else
+   std::basic_ifstream<MIL_TEXT_CHAR> CpuInfoFile("/proc/cpuinfo");
+   MIL_STRING Line;
+   while (std::getline(CpuInfoFile, Line))
+      {
+      if (Line.compare(0, 10, MIL_TEXT("model name")) == 0)
+         {
+         size_t Colon = Line.find(MIL_TEXT(':'));
+         if (Colon != MIL_STRING::npos)
+            CpuModel = Line.substr(Colon+1);
+         break;
+         }
+      }
+#endif
+
+   //Remove the surrounding spaces and the characters used by the profile file
+   size_t First = CpuModel.find_first_not_of(MIL_TEXT(" \t"));
+   size_t Last = CpuModel.find_last_not_of(MIL_TEXT(" \t\r"));
+   CpuModel = (First!=MIL_STRING::npos)?CpuModel.substr(First, Last-First+1):MIL_STRING(MIL_TEXT("Unknown CPU"));
+   for (size_t i=0; i<CpuModel.size(); i++)
+      {
+      if ((CpuModel[i] == PROFILE_SEPARATOR) || (CpuModel[i] == MIL_TEXT('|')))
+         CpuModel[i] = MIL_TEXT(' ');
+      }
+
+   MIL_INT NumCores;
+   MIL_TEXT_CHAR NumCoresText[STRING_SIZE];
+   MappInquireMp(M_DEFAULT, M_CORE_NUM_PROCESS, M_DEFAULT, M_DEFAULT, &NumCores);
+   MosSprintf(NumCoresText, STRING_SIZE, MIL_TEXT(" (%d cores)"), (int)NumCores);
+
+   return CpuModel + NumCoresText;
+   }
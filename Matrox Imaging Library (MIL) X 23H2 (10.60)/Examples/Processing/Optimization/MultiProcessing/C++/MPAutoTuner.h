@@ -0,0 +1,79 @@
+﻿//***************************************************************************************
+//
+// File name: MPAutoTuner.h
+//
+// Synopsis:  Class that searches the MP configuration giving the highest frame
+//            rate for a processing object and keeps it in a profile file.
+//
+// Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+// All Rights Reserved
+
+#ifndef MPAUTOTUNER_H
+#define MPAUTOTUNER_H
+
+//Structure for an MP configuration of a processing object
+struct MPConfigStruct
+   {
+   bool       MPEnable;
+   MIL_INT    CoreMax;
+   bool       CoreSharing;
+   MIL_INT    MPPriority;
+   MIL_UINT64 CoreAffinityMask;
+   MIL_INT    MemoryBankIndex;   //-1 to keep the memory bank selection, 0 for no memory bank, i for the bank i-1.
+   MIL_DOUBLE FrameRate;
+   };
+
+//*****************************************************************************
+// Class used to tune the MP controls of a processing object without the menu.
+// Each configuration is applied on the running processing and is evaluated
+// with its frame rate. The best configuration is saved in a profile file,
+// keyed by the CPU model, the processing and its image size, so that it can be
+// reapplied the next time the example starts.
+//*****************************************************************************
+class CMPAutoTuner
+   {
+   public:
+      CMPAutoTuner();
+      ~CMPAutoTuner();
+
+      //Searches the best configuration of a running processing object using at
+      //most NumCores cores per dispatch thread, then applies and saves it.
+      MIL_DOUBLE Tune(CMPProcessing* Processing, MIL_INT NumCores);
+
+      //Applies the saved configuration of the processing object, if any.
+      bool ApplyProfile(CMPProcessing* Processing, MIL_INT NumCores) const;
+
+      inline MIL_CONST_TEXT_PTR GetCpuModel() const;
+
+   private:
+      //Disallow copy
+      CMPAutoTuner(const CMPAutoTuner&);
+      CMPAutoTuner& operator=(const CMPAutoTuner&);
+
+      MIL_DOUBLE Evaluate(CMPProcessing* Processing, MPConfigStruct& Config) const;
+      bool TryConfig(CMPProcessing* Processing, MPConfigStruct& Candidate, MPConfigStruct& Best) const;
+      void ApplyConfig(CMPProcessing* Processing, const MPConfigStruct& Config) const;
+      void PrintConfig(const MPConfigStruct& Config) const;
+
+      MIL_STRING GetProfileKey(const CMPProcessing* Processing) const;
+      bool LoadProfile(const MIL_STRING& Key, MPConfigStruct& Config) const;
+      void SaveProfile(const MIL_STRING& Key, const MPConfigStruct& Config) const;
+
+      MIL_UINT64 GetCoreAffinityMask(MIL_INT NumCores) const;
+
+      static MIL_STRING InquireCpuModel();
+
+      MIL_STRING  m_CpuModel;
+      MIL_STRING  m_ProfileFileName;
+      MIL_UINT64* m_CoreAffinityMaskProcess;
+   };
+
+//*****************************************************************************
+// GetCpuModel. Returns the CPU model used to key the profiles.
+//*****************************************************************************
+inline MIL_CONST_TEXT_PTR CMPAutoTuner::GetCpuModel() const
+   {
+   return m_CpuModel.c_str();
+   }
+
+#endif
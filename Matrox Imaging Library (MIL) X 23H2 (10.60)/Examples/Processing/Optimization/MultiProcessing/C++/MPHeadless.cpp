@@ -0,0 +1,500 @@
+﻿//***************************************************************************************
+//
+// File name: MPHeadless.cpp
+//
+// Synopsis:  Implements the CMPHeadless class, which runs the processing
+//            without the menu for benchmarking.
+//
+// Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+// All Rights Reserved
+
+#include "common.h"
+#include <sstream>
+
+//Default duration of a run, in seconds
+static const MIL_INT DEFAULT_DURATION = 30;
+
+//Interval between two frame rate samples, in msec
+static const MIL_INT SAMPLE_INTERVAL = 1000;
+
+//Values of the memory bank argument that are not a bank index
+static const MIL_INT MEMORY_BANK_NONE = -1;
+static const MIL_INT MEMORY_BANK_AUTO = -2;
+
+//Names of the MP thread priorities
+struct PriorityNameStruct
+   {
+   MIL_CONST_TEXT_PTR Name;
+   MIL_INT            Priority;
+   };
+
+static const PriorityNameStruct PRIORITY_NAMES[] =
+   {
+   { MIL_TEXT("idle"),          M_IDLE          },
+   { MIL_TEXT("lowest"),        M_LOWEST        },
+   { MIL_TEXT("below_normal"),  M_BELOW_NORMAL  },
+   { MIL_TEXT("normal"),        M_NORMAL        },
+   { MIL_TEXT("above_normal"),  M_ABOVE_NORMAL  },
+   { MIL_TEXT("highest"),       M_HIGHEST       },
+   { MIL_TEXT("time_critical"), M_TIME_CRITICAL }
+   };
+static const MIL_INT NUM_PRIORITY_NAMES = sizeof(PRIORITY_NAMES)/sizeof(PRIORITY_NAMES[0]);
+
+//*****************************************************************************
+// Constructor. Sets the default controls, which are those of the menu.
+//*****************************************************************************
+CMPHeadless::CMPHeadless(MIL_INT NumCoresAvailable)
+:  m_Processing        (M_NULL),
+   m_AutoTuner         (M_NULL),
+   m_NumCoresAvailable (NumCoresAvailable),
+   m_NumThreads        (1),
+   m_NumDispatchThreads(1),
+   m_ProcessingType    (enMixedProcessing),
+   m_Duration          (DEFAULT_DURATION),
+   m_MPEnable          (true),
+   m_CoreMax           (0),
+   m_CoreSharing       (false),
+   m_MPPriority        (M_NORMAL),
+   m_CoreAffinityMask  (0),
+   m_MemoryBank        (MEMORY_BANK_AUTO),
+   m_UseProfile        (false),
+   m_Tune              (false)
+   {
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CMPHeadless::~CMPHeadless()
+   {
+   FreeProcessing();
+   }
+
+//*****************************************************************************
+// PrintUsage. Prints the command line arguments of the headless mode.
+//*****************************************************************************
+void CMPHeadless::PrintUsage()
+   {
+   MosPrintf(MIL_TEXT("Usage: MultiProcessing [options]\n")
+             MIL_TEXT("Runs the processing without display and prints the frame rates in CSV.\n\n")
+             MIL_TEXT("   --threads N         Number of processing objects (default 1).\n")
+             MIL_TEXT("   --dispatch N        Dispatch threads per processing object (default 1).\n")
+             MIL_TEXT("   --type T            rotate, warp or mixed (default mixed).\n")
+             MIL_TEXT("   --mp on|off         Multi-processing (default on).\n")
+             MIL_TEXT("   --coremax N         Maximum number of cores (default: cores/threads).\n")
+             MIL_TEXT("   --sharing on|off    Core sharing (default off).\n")
+             MIL_TEXT("   --priority P        idle, lowest, below_normal, normal, above_normal,\n")
+             MIL_TEXT("                       highest or time_critical (default normal).\n")
+             MIL_TEXT("   --affinity MASK     Core affinity mask, 0 for all cores (default 0).\n")
+             MIL_TEXT("   --bank none|auto|N  Memory bank of the buffers (default auto).\n")
+             MIL_TEXT("   --profile           Apply the saved tuned profiles after the controls.\n")
+             MIL_TEXT("   --tune              Tune each processing object and save its profile\n")
+             MIL_TEXT("                       before the run; the run then uses the tuned controls.\n")
+             MIL_TEXT("   --duration S        Duration of the run in seconds (default %d).\n\n"),
+             (int)DEFAULT_DURATION);
+   }
+
+//*****************************************************************************
+// ParseArguments. Reads the controls from the command line. Returns false and
+// prints the usage if an argument is invalid.
+//*****************************************************************************
+bool CMPHeadless::ParseArguments(int argc, MIL_TEXT_CHAR* argv[])
+   {
+   bool Valid = true;
+   MIL_INT64 Value = 0;
+
+   for (int i=1; (i<argc) && Valid; i++)
+      {
+      MIL_STRING Argument = argv[i];
+
+      //Arguments without value
+      if (Argument == MIL_TEXT("--help"))
+         {
+         Valid = false;
+         break;
+         }
+      if (Argument == MIL_TEXT("--profile"))
+         {
+         m_UseProfile = true;
+         continue;
+         }
+      if (Argument == MIL_TEXT("--tune"))
+         {
+         m_Tune = true;
+         continue;
+         }
+
+      //Arguments with a value
+      if (i+1 >= argc)
+         {
+         Valid = false;
+         break;
+         }
+      MIL_STRING Text = argv[++i];
+
+      if (Argument == MIL_TEXT("--threads"))
+         {
+         Valid = ParseInteger(Text, Value) && (Value >= 1) && (Value <= m_NumCoresAvailable);
+         m_NumThreads = (MIL_INT)Value;
+         }
+      else if (Argument == MIL_TEXT("--dispatch"))
+         {
+         Valid = ParseInteger(Text, Value) && (Value >= 1) && (Value <= MAX_DISPATCH_THREADS);
+         m_NumDispatchThreads = (MIL_INT)Value;
+         }
+      else if (Argument == MIL_TEXT("--type"))
+         {
+         if (Text == MIL_TEXT("rotate"))
+            m_ProcessingType = enRotateProcessing;
+         else if (Text == MIL_TEXT("warp"))
+            m_ProcessingType = enWarpProcessing;
+         else if (Text == MIL_TEXT("mixed"))
+            m_ProcessingType = enMixedProcessing;
+         else
+            Valid = false;
+         }
+      else if (Argument == MIL_TEXT("--mp"))
+         {
+         Valid = ParseOnOff(Text, m_MPEnable);
+         }
+      else if (Argument == MIL_TEXT("--coremax"))
+         {
+         Valid = ParseInteger(Text, Value) && (Value >= 1) && (Value <= MAX_MP_CORES);
+         m_CoreMax = (MIL_INT)Value;
+         }
+      else if (Argument == MIL_TEXT("--sharing"))
+         {
+         Valid = ParseOnOff(Text, m_CoreSharing);
+         }
+      else if (Argument == MIL_TEXT("--priority"))
+         {
+         Valid = ParsePriority(Text, m_MPPriority);
+         }
+      else if (Argument == MIL_TEXT("--affinity"))
+         {
+         Valid = ParseUnsigned(Text, m_CoreAffinityMask);
+         }
+      else if (Argument == MIL_TEXT("--bank"))
+         {
+         if (Text == MIL_TEXT("none"))
+            m_MemoryBank = MEMORY_BANK_NONE;
+         else if (Text == MIL_TEXT("auto"))
+            m_MemoryBank = MEMORY_BANK_AUTO;
+         else
+            {
+            Valid = ParseInteger(Text, Value) && (Value >= 0);
+            m_MemoryBank = (MIL_INT)Value;
+            }
+         }
+      else if (Argument == MIL_TEXT("--duration"))
+         {
+         Valid = ParseInteger(Text, Value) && (Value >= 1);
+         m_Duration = (MIL_INT)Value;
+         }
+      else
+         {
+         Valid = false;
+         }
+
+      if (!Valid)
+         MosPrintf(MIL_TEXT("Invalid value for %s: %s\n\n"), Argument.c_str(), Text.c_str());
+      }
+
+   if (!Valid)
+      PrintUsage();
+
+   return Valid;
+   }
+
+//*****************************************************************************
+// Run. Runs the processing objects for the duration and prints their frame
+// rates in CSV. Each row holds the total frame rate and the frame rate of
+// each processing object over the sample interval; the last row holds the
+// frame rates over the whole run. The frame rates are computed from the
+// number of frames processed, since the frame rate of the dispatchers is
+// only updated every few seconds. With --tune, each processing object is
+// first tuned while the others are running, and the tuner output precedes
+// the CSV header.
+//*****************************************************************************
+void CMPHeadless::Run()
+   {
+   AllocateProcessing();
+   PrintConfiguration();
+
+   //Start all the processing objects, then configure them while they run
+   for (MIL_INT i=0; i<m_NumThreads; i++)
+      {
+      m_Processing[i]->StartThread();
+      ConfigureProcessing(m_Processing[i]);
+      m_Processing[i]->Run();
+      }
+
+   //Tune the MP controls of each processing object and save their profiles
+   if (m_Tune)
+      {
+      for (MIL_INT i=0; i<m_NumThreads; i++)
+         m_AutoTuner->Tune(m_Processing[i], GetNumCoresPerThread());
+      }
+
+   //Header of the CSV
+   MosPrintf(MIL_TEXT("Time,TotalFPS"));
+   for (MIL_INT i=0; i<m_NumThreads; i++)
+      MosPrintf(MIL_TEXT(",Thread%dFPS"), (int)i);
+   MosPrintf(MIL_TEXT("\n"));
+
+   //Sample the number of frames processed
+   MIL_INT NumSamples = (m_Duration*1000)/SAMPLE_INTERVAL;
+   MIL_INT* StartFrames = new MIL_INT[m_NumThreads];
+   MIL_INT* PreviousFrames = new MIL_INT[m_NumThreads];
+   MIL_INT* CurrentFrames = new MIL_INT[m_NumThreads];
+   MIL_DOUBLE StartTime, PreviousTime, CurrentTime;
+
+   MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &StartTime);
+   for (MIL_INT i=0; i<m_NumThreads; i++)
+      StartFrames[i] = PreviousFrames[i] = m_Processing[i]->GetTotalFramesProcessed();
+   PreviousTime = StartTime;
+
+   for (MIL_INT Sample=0; Sample<NumSamples; Sample++)
+      {
+      MosSleep(SAMPLE_INTERVAL);
+      MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &CurrentTime);
+
+      MIL_INT TotalFrames = 0;
+      for (MIL_INT i=0; i<m_NumThreads; i++)
+         {
+         CurrentFrames[i] = m_Processing[i]->GetTotalFramesProcessed();
+         TotalFrames += CurrentFrames[i]-PreviousFrames[i];
+         }
+
+      MosPrintf(MIL_TEXT("%.1f,%.1f"), CurrentTime-StartTime, TotalFrames/(CurrentTime-PreviousTime));
+      for (MIL_INT i=0; i<m_NumThreads; i++)
+         {
+         MosPrintf(MIL_TEXT(",%.1f"), (CurrentFrames[i]-PreviousFrames[i])/(CurrentTime-PreviousTime));
+         PreviousFrames[i] = CurrentFrames[i];
+         }
+      MosPrintf(MIL_TEXT("\n"));
+      PreviousTime = CurrentTime;
+      }
+
+   //Frame rates over the whole run
+   MIL_DOUBLE RunTime = PreviousTime-StartTime;
+   MIL_INT TotalRunFrames = 0;
+   for (MIL_INT i=0; i<m_NumThreads; i++)
+      TotalRunFrames += PreviousFrames[i]-StartFrames[i];
+   MosPrintf(MIL_TEXT("Mean,%.1f"), (RunTime>0)?TotalRunFrames/RunTime:0.0);
+   for (MIL_INT i=0; i<m_NumThreads; i++)
+      MosPrintf(MIL_TEXT(",%.1f"), (RunTime>0)?(PreviousFrames[i]-StartFrames[i])/RunTime:0.0);
+   MosPrintf(MIL_TEXT("\n"));
+
+   delete [] CurrentFrames;
+   delete [] PreviousFrames;
+   delete [] StartFrames;
+
+   //Stop the processing
+   for (MIL_INT i=0; i<m_NumThreads; i++)
+      m_Processing[i]->StopThread();
+
+   FreeProcessing();
+   }
+
+//*****************************************************************************
+// AllocateProcessing. Allocates the processing objects without display.
+//*****************************************************************************
+void CMPHeadless::AllocateProcessing()
+   {
+   MIL_TEXT_CHAR Title[STRING_SIZE];
+
+   m_Processing = new CMPProcessing* [m_NumThreads];
+   for (MIL_INT i=0; i<m_NumThreads; i++)
+      {
+      MosSprintf(Title, STRING_SIZE, MIL_TEXT("Thread %d"), i);
+
+      //The mixed type alternates the processing as the menu does
+      bool Rotate = (m_ProcessingType == enRotateProcessing) ||
+                    ((m_ProcessingType == enMixedProcessing) && (i%2 == 0));
+      if (Rotate)
+         m_Processing[i] = new CMPRotateProcessing(Title, i, m_NumDispatchThreads, false);
+      else
+         m_Processing[i] = new CMPWarpProcessing(Title, i, m_NumDispatchThreads, false);
+      }
+
+   if (m_UseProfile || m_Tune)
+      m_AutoTuner = new CMPAutoTuner();
+   }
+
+//*****************************************************************************
+// FreeProcessing. Frees the processing objects.
+//*****************************************************************************
+void CMPHeadless::FreeProcessing()
+   {
+   if (m_Processing)
+      {
+      for (MIL_INT i=0; i<m_NumThreads; i++)
+         delete m_Processing[i];
+      delete [] m_Processing;
+      m_Processing = M_NULL;
+      }
+
+   delete m_AutoTuner;
+   m_AutoTuner = M_NULL;
+   }
+
+//*****************************************************************************
+// ConfigureProcessing. Applies the controls of the command line to the given
+// processing object. By default, the cores are divided between the processing
+// objects and their dispatch threads, as in the menu.
+//*****************************************************************************
+void CMPHeadless::ConfigureProcessing(CMPProcessing* Processing)
+   {
+   MIL_INT NumCoresPerThread = GetNumCoresPerThread();
+
+   Processing->RunDisplay(false);
+   Processing->SetMP(m_MPEnable);
+   Processing->SetCoreMax((m_CoreMax>0)?m_CoreMax:NumCoresPerThread);
+   Processing->SetCoreSharing(m_CoreSharing);
+   Processing->SetMPPriority(m_MPPriority);
+   Processing->SetCoreAffinity(m_CoreAffinityMask);
+
+   if (m_MemoryBank == MEMORY_BANK_AUTO)
+      {
+      Processing->SetCurrentMemoryBank(0, false);
+      if (Processing->GetNumMemoryBank() > 1)
+         Processing->SetAutoMemoryBank(true);
+      }
+   else
+      {
+      bool ValidBank = false;
+      MIL_INT64 MemoryBank = 0;
+      if (m_MemoryBank != MEMORY_BANK_NONE)
+         MemoryBank = Processing->GetMemoryBank(m_MemoryBank, ValidBank);
+      if ((m_MemoryBank != MEMORY_BANK_NONE) && !ValidBank)
+         MosPrintf(MIL_TEXT("# warning=memory bank %d is not available\n"), (int)m_MemoryBank);
+      Processing->SetCurrentMemoryBank(MemoryBank, ValidBank);
+      }
+
+   if (m_UseProfile && !m_AutoTuner->ApplyProfile(Processing, NumCoresPerThread))
+      MosPrintf(MIL_TEXT("# warning=no saved profile for %s\n"), Processing->GetProcessingName());
+   }
+
+//*****************************************************************************
+// GetNumCoresPerThread. Returns the cores of each dispatch thread when the
+// cores are divided between the processing objects and their dispatch threads.
+//*****************************************************************************
+MIL_INT CMPHeadless::GetNumCoresPerThread() const
+   {
+   MIL_INT NumCoresPerThread = m_NumCoresAvailable/(m_NumThreads*m_NumDispatchThreads);
+   return (NumCoresPerThread>1)?NumCoresPerThread:1;
+   }
+
+//*****************************************************************************
+// PrintConfiguration. Prints the controls of the run as comment lines of the
+// CSV, so that the results can be matched with their configuration.
+//*****************************************************************************
+void CMPHeadless::PrintConfiguration() const
+   {
+   static MIL_CONST_TEXT_PTR TYPE_NAMES[] = { MIL_TEXT("rotate"), MIL_TEXT("warp"), MIL_TEXT("mixed") };
+
+   MosPrintf(MIL_TEXT("# cores=%d\n"), (int)m_NumCoresAvailable);
+   MosPrintf(MIL_TEXT("# threads=%d\n"), (int)m_NumThreads);
+   MosPrintf(MIL_TEXT("# dispatch=%d\n"), (int)m_NumDispatchThreads);
+   MosPrintf(MIL_TEXT("# type=%s\n"), TYPE_NAMES[m_ProcessingType]);
+   MosPrintf(MIL_TEXT("# mp=%s\n"), m_MPEnable?MIL_TEXT("on"):MIL_TEXT("off"));
+   if (m_CoreMax > 0)
+      MosPrintf(MIL_TEXT("# coremax=%d\n"), (int)m_CoreMax);
+   else
+      MosPrintf(MIL_TEXT("# coremax=default\n"));
+   MosPrintf(MIL_TEXT("# sharing=%s\n"), m_CoreSharing?MIL_TEXT("on"):MIL_TEXT("off"));
+   MosPrintf(MIL_TEXT("# priority=%s\n"), GetPriorityName(m_MPPriority));
+   MosPrintf(MIL_TEXT("# affinity=0x%llx\n"), (unsigned long long)m_CoreAffinityMask);
+   if (m_MemoryBank == MEMORY_BANK_AUTO)
+      MosPrintf(MIL_TEXT("# bank=auto\n"));
+   else if (m_MemoryBank == MEMORY_BANK_NONE)
+      MosPrintf(MIL_TEXT("# bank=none\n"));
+   else
+      MosPrintf(MIL_TEXT("# bank=%d\n"), (int)m_MemoryBank);
+   MosPrintf(MIL_TEXT("# profile=%s\n"), m_UseProfile?MIL_TEXT("on"):MIL_TEXT("off"));
+   MosPrintf(MIL_TEXT("# tune=%s\n"), m_Tune?MIL_TEXT("on"):MIL_TEXT("off"));
+   MosPrintf(MIL_TEXT("# duration=%d\n"), (int)m_Duration);
+   }
+
+//*****************************************************************************
+// ParseInteger. Reads a decimal, or hexadecimal with the 0x prefix, integer.
+//*****************************************************************************
+bool CMPHeadless::ParseInteger(const MIL_STRING& Text, MIL_INT64& Value)
+   {
+   std::basic_istringstream<MIL_TEXT_CHAR> Stream(Text);
+   long long Integer = 0;
+
+   //Without a base, the base is deduced from the prefix
+   Stream.unsetf(std::ios::basefield);
+   Stream >> Integer;
+   Value = (MIL_INT64)Integer;
+
+   return !Stream.fail() && Stream.eof();
+   }
+
+//*****************************************************************************
+// ParseUnsigned. Reads a decimal, or hexadecimal with the 0x prefix, unsigned
+// integer that can use all 64 bits, such as a core affinity mask.
+//*****************************************************************************
+bool CMPHeadless::ParseUnsigned(const MIL_STRING& Text, MIL_UINT64& Value)
+   {
+   std::basic_istringstream<MIL_TEXT_CHAR> Stream(Text);
+   unsigned long long Integer = 0;
+
+   //A negative value would be wrapped around by the extraction
+   if (Text.empty() || Text[0] == MIL_TEXT('-'))
+      return false;
+
+   Stream.unsetf(std::ios::basefield);
+   Stream >> Integer;
+   Value = (MIL_UINT64)Integer;
+
+   return !Stream.fail() && Stream.eof();
+   }
+
+//*****************************************************************************
+// ParseOnOff. Reads an on/off value.
+//*****************************************************************************
+bool CMPHeadless::ParseOnOff(const MIL_STRING& Text, bool& Value)
+   {
+   if (Text == MIL_TEXT("on"))
+      Value = true;
+   else if (Text == MIL_TEXT("off"))
+      Value = false;
+   else
+      return false;
+
+   return true;
+   }
+
+//*****************************************************************************
+// ParsePriority. Reads the name of an MP thread priority.
+//*****************************************************************************
+bool CMPHeadless::ParsePriority(const MIL_STRING& Text, MIL_INT& Value)
+   {
+   for (MIL_INT i=0; i<NUM_PRIORITY_NAMES; i++)
+      {
+      if (Text == PRIORITY_NAMES[i].Name)
+         {
+         Value = PRIORITY_NAMES[i].Priority;
+         return true;
+         }
+      }
+
+   return false;
+   }
+
+//*****************************************************************************
+// GetPriorityName. Returns the name of an MP thread priority.
+//*****************************************************************************
+MIL_CONST_TEXT_PTR CMPHeadless::GetPriorityName(MIL_INT Priority)
+   {
+   for (MIL_INT i=0; i<NUM_PRIORITY_NAMES; i++)
+      {
+      if (PRIORITY_NAMES[i].Priority == Priority)
+         return PRIORITY_NAMES[i].Name;
+      }
+
+   return MIL_TEXT("unknown");
+   }
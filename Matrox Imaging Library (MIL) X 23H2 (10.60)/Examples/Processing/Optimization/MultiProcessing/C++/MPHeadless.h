@@ -0,0 +1,69 @@
+﻿//***************************************************************************************
+//
+// File name: MPHeadless.h
+//
+// Synopsis:  Class that runs the processing without the menu, with the MP
+//            controls given on the command line.
+//
+// Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+// All Rights Reserved
+
+#ifndef MPHEADLESS_H
+#define MPHEADLESS_H
+
+//*****************************************************************************
+// Class used to run the example without display and without user input, for
+// example for benchmarks on servers. The processing objects are configured
+// from the command line arguments, run for a fixed duration and their frame
+// rates are printed in CSV.
+//*****************************************************************************
+class CMPHeadless
+   {
+   public:
+      CMPHeadless(MIL_INT NumCoresAvailable);
+      ~CMPHeadless();
+
+      bool ParseArguments(int argc, MIL_TEXT_CHAR* argv[]);
+      void Run();
+
+      static void PrintUsage();
+
+   private:
+      //Disallow copy
+      CMPHeadless(const CMPHeadless&);
+      CMPHeadless& operator=(const CMPHeadless&);
+
+      enum ProcessingType { enRotateProcessing, enWarpProcessing, enMixedProcessing };
+
+      void AllocateProcessing();
+      void FreeProcessing();
+      void ConfigureProcessing(CMPProcessing* Processing);
+      MIL_INT GetNumCoresPerThread() const;
+      void PrintConfiguration() const;
+
+      static bool ParseInteger(const MIL_STRING& Text, MIL_INT64& Value);
+      static bool ParseUnsigned(const MIL_STRING& Text, MIL_UINT64& Value);
+      static bool ParseOnOff(const MIL_STRING& Text, bool& Value);
+      static bool ParsePriority(const MIL_STRING& Text, MIL_INT& Value);
+      static MIL_CONST_TEXT_PTR GetPriorityName(MIL_INT Priority);
+
+      CMPProcessing**   m_Processing;
+      CMPAutoTuner*     m_AutoTuner;
+
+      MIL_INT           m_NumCoresAvailable;
+      MIL_INT           m_NumThreads;
+      MIL_INT           m_NumDispatchThreads;
+      ProcessingType    m_ProcessingType;
+      MIL_INT           m_Duration;
+
+      bool              m_MPEnable;
+      MIL_INT           m_CoreMax;
+      bool              m_CoreSharing;
+      MIL_INT           m_MPPriority;
+      MIL_UINT64        m_CoreAffinityMask;
+      MIL_INT           m_MemoryBank;
+      bool              m_UseProfile;
+      bool              m_Tune;
+   };
+
+#endif
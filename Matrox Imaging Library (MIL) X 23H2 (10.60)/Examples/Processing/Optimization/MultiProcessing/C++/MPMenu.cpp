@@ -52,10 +52,13 @@ static const MIL_INT CORE_AFFINITY_GAP = BUTTON_GAP*5;
 
 
 //*****************************************************************************
-// Constructor. Allocates and intializes the menu.
+// Constructor. Allocates and intializes the menu.  If requested, the MP
+// configuration of the running processing objects is tuned before the menu is
+// created.
 //*****************************************************************************
-CMPMenu::CMPMenu(MIL_INT ProcessingArraySize, CMPProcessing** Processing)
-: m_ProcessingArraySize(ProcessingArraySize)
+CMPMenu::CMPMenu(MIL_INT ProcessingArraySize, CMPProcessing** Processing,
+                 CMPAutoTuner* AutoTuner, bool TuneMP)
+: m_ProcessingArraySize(ProcessingArraySize), m_AutoTuner(AutoTuner)
    {
    //Allocate memory to contain the processing objects
    m_Processing = new CMPProcessing*[m_ProcessingArraySize]; 
@@ -144,6 +147,17 @@ CMPMenu::CMPMenu(MIL_INT ProcessingArraySize, CMPProcessing** Processing)
          //Run the processing
          m_Processing[m_CurrentProcessingNum]->Run();
          }
+
+      //Tune the MP configuration of the running processing objects. Each one is
+      //tuned while the others are running, as they are when the menu is used.
+      if (TuneMP && m_AutoTuner)
+         {
+         for (MIL_INT i=0; i<m_CurrentProcessingNum; i++)
+            {
+            MIL_INT NumCoresPerThread = NumCoresAssigned/m_Processing[i]->GetNumDispatchThreads();
+            m_AutoTuner->Tune(m_Processing[i], NumCoresPerThread);
+            }
+         }
       }
 
    //Create the menu
@@ -837,6 +851,7 @@ void CMPMenu::ApplyToAllThreadsButtonClick()
    //Apply current processing configuration to all threads
    MIL_INT ThreadIndex;  
    bool UseMemoryBank = m_Processing[m_CurrentProcessing]->UseMemoryBank();
+   bool AutoMemoryBank = m_Processing[m_CurrentProcessing]->AutoMemoryBankEnabled();
    MIL_INT64 MemoryBank = m_Processing[m_CurrentProcessing]->GetCurrentMemoryBank();
    for (MIL_INT i=1; i<m_CurrentProcessingNum; i++)
       {
@@ -854,6 +869,8 @@ void CMPMenu::ApplyToAllThreadsButtonClick()
       m_Processing[ThreadIndex]->SetCoreAffinity(m_Processing[m_CurrentProcessing]->GetCoreAffinity());
 
       m_Processing[ThreadIndex]->SetCurrentMemoryBank(MemoryBank, UseMemoryBank);
+      if (AutoMemoryBank)
+         m_Processing[ThreadIndex]->SetAutoMemoryBank(true);
       }
 
    //For visual effect, push the button twice.
@@ -977,7 +994,17 @@ void CMPMenu::AllThreadsDisplayButtonClick()
 void CMPMenu::MemoryBankButtonClick(bool Next)
    {      
    //Set the current memory bank to use.  Initially, no memory bank is specified.
-   if ( (!m_Processing[m_CurrentProcessing]->UseMemoryBank() && Next) && (m_NumMemoryBank>0) )
+   //Before no memory bank, the memory bank can follow the core affinity.
+   if (m_Processing[m_CurrentProcessing]->AutoMemoryBankEnabled())
+      {
+      if (Next)
+         m_Processing[m_CurrentProcessing]->SetCurrentMemoryBank(0, false);
+      }
+   else if ( (!m_Processing[m_CurrentProcessing]->UseMemoryBank() && !Next) && (m_NumMemoryBank>0) )
+      {
+      m_Processing[m_CurrentProcessing]->SetAutoMemoryBank(true);
+      }
+   else if ( (!m_Processing[m_CurrentProcessing]->UseMemoryBank() && Next) && (m_NumMemoryBank>0) )
       {
       m_Processing[m_CurrentProcessing]->SetCurrentMemoryBank(M_MEMORY_BANK_0, true);
       }
@@ -1053,6 +1080,10 @@ void CMPMenu::CoreAffinityButtonClick(MIL_INT CoreIndex)
       m_Processing[m_CurrentProcessing]->SetCoreAffinity(CurrentCoreAffinity|CoreAffinityMask);
       }
 
+   //The automatic memory bank follows the core affinity
+   if (m_Processing[m_CurrentProcessing]->AutoMemoryBankEnabled())
+      m_Buttons[enMemoryBank].Push(GetButtonText(m_CurrentProcessing, enMemoryBank, ButtonText));
+
    m_Buttons[CoreIndex+FIRST_CORE].Push(GetButtonText(m_CurrentProcessing, (MPButtons)(CoreIndex+FIRST_CORE), 
       ButtonText));   
    }
@@ -1316,6 +1347,14 @@ MIL_TEXT_CHAR* CMPMenu::GetButtonText(MIL_INT ProcessingIndex, MPButtons ButtonT
             {
             MosSprintf(ButtonText, STRING_SIZE, MIL_TEXT("%s"), MIL_TEXT("No Affinity"));
             }
+
+         if (m_Processing[m_CurrentProcessing]->AutoMemoryBankEnabled())
+            {
+            MIL_TEXT_CHAR BankText[STRING_SIZE];
+            MosSprintf(BankText, STRING_SIZE, MIL_TEXT("%s"), ButtonText);
+            MosSprintf(ButtonText, STRING_SIZE, MIL_TEXT("Auto: %s"), 
+               m_Processing[m_CurrentProcessing]->UseMemoryBank()?BankText:MIL_TEXT("None"));
+            }
          break;
       case enMP:  
          if (m_Processing[ProcessingIndex]->MPEnabled())
@@ -1383,13 +1422,23 @@ MIL_TEXT_CHAR* CMPMenu::GetButtonText(MIL_INT ProcessingIndex, MPButtons ButtonT
 //*****************************************************************************
 void CMPMenu::InitProcessingMP(MIL_INT NumCores, CMPProcessing* Processing)
    {
-   //Set the initial MP state of the given processing object
+   //Set the initial MP state of the given processing object. The cores are
+   //shared between the dispatch threads of the processing object.
+   MIL_INT NumCoresPerThread = NumCores/Processing->GetNumDispatchThreads();
    Processing->SetMP(true);
-   Processing->SetCoreMax(NumCores);
+   Processing->SetCoreMax((NumCoresPerThread>1)?NumCoresPerThread:1);
    Processing->SetCoreSharing(false);
    Processing->SetMPPriority(M_NORMAL);
    Processing->SetCoreAffinity(0x00000000);
    Processing->SetCurrentMemoryBank(0, false);
+
+   //Place the buffers on the memory bank of the cores of the affinity
+   if (m_NumMemoryBank > 1)
+      Processing->SetAutoMemoryBank(true);
+
+   //Reapply the tuned configuration of this processing if it was saved
+   if (m_AutoTuner)
+      m_AutoTuner->ApplyProfile(Processing, (NumCoresPerThread>1)?NumCoresPerThread:1);
    }
 
 
@@ -18,7 +18,8 @@
 class CMPMenu
    {
    public:
-      CMPMenu(MIL_INT ProcessingArraySize, CMPProcessing** Processing);
+      CMPMenu(MIL_INT ProcessingArraySize, CMPProcessing** Processing,
+              CMPAutoTuner* AutoTuner, bool TuneMP);
       ~CMPMenu();
 
       void Run();
@@ -48,6 +49,7 @@ class CMPMenu
 
       MIL_INT           m_ProcessingArraySize;
       CMPProcessing**   m_Processing;
+      CMPAutoTuner*     m_AutoTuner;
 
       MIL_INT           m_CurrentProcessing;
       MIL_INT           m_CurrentProcessingNum;
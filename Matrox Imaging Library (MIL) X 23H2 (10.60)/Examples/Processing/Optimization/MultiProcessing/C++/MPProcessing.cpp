@@ -12,6 +12,19 @@
 static const MIL_INT DISPLAY_OFFSET_X = 40;
 static const MIL_INT MAX_DISPLAY_OFFSET_X = 600;
 
+//All possible memory banks
+static const MIL_INT   NUM_MAX_MEMORY_BANK = 7;
+static const MIL_INT64 ALL_MEMORY_BANKS[NUM_MAX_MEMORY_BANK] =
+   {
+   M_MEMORY_BANK_0, M_MEMORY_BANK_1, M_MEMORY_BANK_2, M_MEMORY_BANK_3,
+   M_MEMORY_BANK_4, M_MEMORY_BANK_5, M_MEMORY_BANK_6
+   };
+
+//Buffers used to measure the memory bank bandwidth
+static const MIL_INT BANDWIDTH_BUFFER_SIZE_X = 4096;
+static const MIL_INT BANDWIDTH_BUFFER_SIZE_Y = 4096;
+static const MIL_INT BANDWIDTH_NUM_COPIES    = 20;
+
 
 //*****************************************************************************
 // Constructor. Allocates and initializes the processing objects.
@@ -21,12 +34,16 @@ CMPProcessing::CMPProcessing(MIL_CONST_TEXT_PTR Title,
                              MIL_INT DisplayBufferSizeY,
                              MIL_INT DisplayBufferType, 
                              MIL_INT DisplayBufferSizeBand,
-                             MIL_INT ProcessingIndex)
+                             MIL_INT ProcessingIndex,
+                             MIL_INT NumDispatchThreads,
+                             bool UseDisplay)
 : m_DisplayBufferSizeX(DisplayBufferSizeX),
   m_DisplayBufferSizeY(DisplayBufferSizeY), 
   m_DisplayBufferType(DisplayBufferType),
   m_DisplayBufferSizeBand(DisplayBufferSizeBand), 
-  m_ProcessingIndex(ProcessingIndex)
+  m_ProcessingIndex(ProcessingIndex),
+  m_NumDispatchThreads(NumDispatchThreads),
+  m_UseDisplay(UseDisplay)
    {
    //Allocate processing objects
    Alloc(Title);
@@ -89,8 +106,9 @@ void CMPProcessing::SetMP(bool Enable)
    {
    //Set whether or not MP is enabled 
    m_MPEnable = Enable;
-   MthrControlMp(m_Dispatcher->GetThreadId(), M_MP_USE, M_DEFAULT, 
-      (m_MPEnable)?M_ENABLE:M_DISABLE, M_NULL);
+   for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+      MthrControlMp(m_Dispatcher->GetThreadId(i), M_MP_USE, M_DEFAULT, 
+         (m_MPEnable)?M_ENABLE:M_DISABLE, M_NULL);
    }
 
 //*****************************************************************************
@@ -110,8 +128,9 @@ void CMPProcessing::SetCoreMax(MIL_INT Max)
    {
    //Set the maximum cores to use for this processing thread
    m_CoreMax=Max;
-   MthrControlMp(m_Dispatcher->GetThreadId(), M_CORE_MAX, M_DEFAULT, 
-      m_CoreMax, M_NULL);
+   for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+      MthrControlMp(m_Dispatcher->GetThreadId(i), M_CORE_MAX, M_DEFAULT, 
+         m_CoreMax, M_NULL);
    }
 
 //*****************************************************************************
@@ -121,8 +140,9 @@ void CMPProcessing::SetCoreSharing(bool Enable)
    {
    //Set whether core sharing is enabled or not
    m_CoreSharing=Enable;
-   MthrControlMp(m_Dispatcher->GetThreadId(), M_CORE_SHARING, M_DEFAULT, 
-      (m_CoreSharing)?M_ENABLE:M_DISABLE, M_NULL);
+   for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+      MthrControlMp(m_Dispatcher->GetThreadId(i), M_CORE_SHARING, M_DEFAULT, 
+         (m_CoreSharing)?M_ENABLE:M_DISABLE, M_NULL);
    }
 
 //*****************************************************************************
@@ -132,8 +152,9 @@ void CMPProcessing::SetMPPriority(MIL_INT Priority)
    {
    //Set the thread priority
    m_MPPriority = Priority;
-   MthrControlMp(m_Dispatcher->GetThreadId(), M_MP_PRIORITY, M_DEFAULT, 
-      m_MPPriority, M_NULL);
+   for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+      MthrControlMp(m_Dispatcher->GetThreadId(i), M_MP_PRIORITY, M_DEFAULT, 
+         m_MPPriority, M_NULL);
    }
 
 //*****************************************************************************
@@ -144,8 +165,13 @@ void CMPProcessing::SetCoreAffinity(MIL_UINT64 AffinityMask)
    //Set the core affinity of this thread
    m_CoreAffinityMask[0]=AffinityMask;
    
-   MthrControlMp(m_Dispatcher->GetThreadId(), M_CORE_AFFINITY_MASK, M_DEFAULT, 
-      M_USER_DEFINED, m_CoreAffinityMask);
+   for (MIL_INT i=0; i<m_NumDispatchThreads; i++)
+      MthrControlMp(m_Dispatcher->GetThreadId(i), M_CORE_AFFINITY_MASK, M_DEFAULT, 
+         M_USER_DEFINED, m_CoreAffinityMask);
+
+   //Move the buffers to the memory bank of the new cores
+   if (m_AutoMemoryBank)
+      UpdateAutoMemoryBank();
    }
 
 //*****************************************************************************
@@ -156,6 +182,18 @@ void CMPProcessing::SetCurrentMemoryBank(MIL_INT64 MemoryBank, bool UseBank)
    //Set the memory bank to use for buffers used in this thread
    m_CurrentMemoryBank = MemoryBank; 
    m_UseMemoryBank = UseBank;
+   m_AutoMemoryBank = false;
+   }
+
+//*****************************************************************************
+// SetAutoMemoryBank. Sets whether the memory bank is selected automatically 
+// from the core affinity.
+//*****************************************************************************
+void CMPProcessing::SetAutoMemoryBank(bool Enable)
+   {
+   m_AutoMemoryBank = Enable;
+   if (m_AutoMemoryBank)
+      UpdateAutoMemoryBank();
    }
 
 //*****************************************************************************
@@ -193,18 +231,25 @@ void CMPProcessing::Alloc(MIL_CONST_TEXT_PTR Title)
    {
    // Allocate MIL objects. 
    MsysAlloc(M_DEFAULT, M_SYSTEM_HOST, M_DEFAULT, M_DEFAULT, &m_MilSystem);
-   MdispAlloc(m_MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_WINDOWED, &m_MilDisplay);
+
+   //Change the display window title
+   MosSprintf(m_DisplayTitle, STRING_SIZE, MIL_TEXT("%s"), Title);
+
+   //Allocate the display, unless the processing runs without display
+   m_MilDisplay = M_NULL;
+   if (m_UseDisplay)
+      {
+      MdispAlloc(m_MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_WINDOWED, &m_MilDisplay);
 
 #if M_MIL_USE_WINDOWS
-   MdispControl(m_MilDisplay, M_WINDOW_SYSBUTTON, M_DISABLE);
+      MdispControl(m_MilDisplay, M_WINDOW_SYSBUTTON, M_DISABLE);
 #endif
 
-   //Change the display window title
-   MosSprintf(m_DisplayTitle, STRING_SIZE, MIL_TEXT("%s"), Title);
-   MdispControl(m_MilDisplay, M_TITLE, m_DisplayTitle);
+      MdispControl(m_MilDisplay, M_TITLE, m_DisplayTitle);
+      }
 
    //Allocate the dispatcher
-   m_Dispatcher = new CDispatcher(m_MilSystem, (PROC_FUNCTION_PTR)&ProcessingFunction, (void*)this);
+   m_Dispatcher = new CDispatcher(m_MilSystem, (PROC_FUNCTION_PTR)&ProcessingFunction, (void*)this, m_NumDispatchThreads);
 
    m_DisplayRunning = false;
    m_DisplaySelected = false;
@@ -228,6 +273,7 @@ void CMPProcessing::Alloc(MIL_CONST_TEXT_PTR Title)
    //Initialize memory bank affinity information
    m_CurrentMemoryBank = 0;  
    m_UseMemoryBank = false;
+   m_AutoMemoryBank = false;
 
    //Create array of available memory banks
    MIL_INT MemoryBankAffinityArraySize = 0;
@@ -242,14 +288,6 @@ void CMPProcessing::Alloc(MIL_CONST_TEXT_PTR Title)
 
    MappInquireMp(M_DEFAULT, M_MEMORY_BANK_AFFINITY_MASK, M_LOCAL, M_DEFAULT, MemoryBankAffinityMask);   
 
-   //All possible memory banks
-   static const MIL_INT   NUM_MAX_MEMORY_BANK = 7;
-   static const MIL_INT64 ALL_MEMORY_BANKS[NUM_MAX_MEMORY_BANK] =
-      {
-      M_MEMORY_BANK_0, M_MEMORY_BANK_1, M_MEMORY_BANK_2, M_MEMORY_BANK_3,
-      M_MEMORY_BANK_4, M_MEMORY_BANK_5, M_MEMORY_BANK_6
-      };
-
    //Initialize the number of memory banks (maximum is 7 for this example)
    m_NumMemoryBank = 0;
    m_AvailableMemoryBanks = M_NULL;
@@ -273,7 +311,7 @@ void CMPProcessing::Alloc(MIL_CONST_TEXT_PTR Title)
 
    //Allocate and clear the display buffer
    MbufAllocColor(m_MilSystem, m_DisplayBufferSizeBand, m_DisplayBufferSizeX, m_DisplayBufferSizeY, 
-      m_DisplayBufferType, M_IMAGE+M_PROC+M_DISP, &m_MilDisplayBuffer);  
+      m_DisplayBufferType, M_IMAGE+M_PROC+(m_UseDisplay?M_DISP:0), &m_MilDisplayBuffer);  
 
    MbufClear(m_MilDisplayBuffer, 0.0);
    }
@@ -292,7 +330,8 @@ void CMPProcessing::Free()
    
    //Free MIL objects
    MbufFree(m_MilDisplayBuffer);
-   MdispFree(m_MilDisplay);
+   if (m_MilDisplay)
+      MdispFree(m_MilDisplay);
    MsysFree(m_MilSystem);
    
    delete [] m_AvailableMemoryBanks;
@@ -307,7 +346,8 @@ void CMPProcessing::UpdateDisplayTitle()
    MIL_TEXT_CHAR TitleText[STRING_SIZE] = MIL_TEXT("");
    MosSprintf(TitleText, STRING_SIZE, MIL_TEXT("%s   %.1f frames per second"), m_DisplayTitle, 
       m_Dispatcher->GetFrameRate());
-   MdispControl(m_MilDisplay, M_TITLE, TitleText);
+   if (m_MilDisplay)
+      MdispControl(m_MilDisplay, M_TITLE, TitleText);
    }
 
 //*****************************************************************************
@@ -316,7 +356,7 @@ void CMPProcessing::UpdateDisplayTitle()
 void CMPProcessing::DisplaySelect()
    {
    //Select the buffer on the display
-   if (!m_DisplaySelected)
+   if (!m_DisplaySelected && m_MilDisplay)
       {
       //Set an x offset so we can see a part of all displays
       MdispControl(m_MilDisplay, M_WINDOW_INITIAL_POSITION_X, 
@@ -361,6 +401,179 @@ MIL_INT64 CMPProcessing::GetMemoryBank(MIL_INT Index, bool& ValidBank) const
    return ReturnValue;
    }
 
+//*****************************************************************************
+// GetCoreMemoryBank. Returns the memory bank define of the memory bank local
+// to the given core (its NUMA node). It returns 0 if the memory bank is not
+// valid.
+//*****************************************************************************
+MIL_INT64 CMPProcessing::GetCoreMemoryBank(MIL_INT CoreIndex, bool& ValidBank) const
+   {
+   MIL_INT BankNumber = MappInquireMp(M_DEFAULT, M_CORE_MEMORY_BANK, M_DEFAULT, CoreIndex, M_NULL);
+   MIL_INT64 MemoryBank = 0;
+   ValidBank = false;
+
+   if ( (BankNumber>=0) && (BankNumber<NUM_MAX_MEMORY_BANK) )
+      {
+      MIL_INT BankIndex = GetMemoryBankIndex(ALL_MEMORY_BANKS[BankNumber]);
+      if ( (BankIndex>=0) && (BankIndex<m_NumMemoryBank) )
+         {
+         MemoryBank = ALL_MEMORY_BANKS[BankNumber];
+         ValidBank = true;
+         }
+      }
+
+   return MemoryBank;
+   }
+
+//*****************************************************************************
+// UpdateAutoMemoryBank. Selects the memory bank local to most of the cores of
+// the core affinity. Without core affinity, no memory bank is used.
+//*****************************************************************************
+void CMPProcessing::UpdateAutoMemoryBank()
+   {
+   MIL_INT NumCoresInBank[NUM_MAX_MEMORY_BANK] = {0};
+   MIL_INT64 BestMemoryBank = 0;
+   MIL_INT BestNumCores = 0;
+
+   //Count the cores of the affinity in each memory bank
+   for (MIL_INT i=0; i<MAX_MP_CORES; i++)
+      {
+      bool ValidBank = false;
+      if (m_CoreAffinityMask[0]&((MIL_UINT64)1<<i))
+         {
+         MIL_INT64 MemoryBank = GetCoreMemoryBank(i, ValidBank);
+         MIL_INT BankIndex = GetMemoryBankIndex(MemoryBank);
+         if (ValidBank && (++NumCoresInBank[BankIndex] > BestNumCores))
+            {
+            BestNumCores = NumCoresInBank[BankIndex];
+            BestMemoryBank = MemoryBank;
+            }
+         }
+      }
+
+   //The processing picks the processing objects of the selected bank on the next frame
+   m_CurrentMemoryBank = BestMemoryBank;
+   m_UseMemoryBank = (BestNumCores>0);
+   }
+
+//*****************************************************************************
+// ReportMemoryBankBandwidth. Measures the copy bandwidth of buffers in each
+// memory bank when the MP threads run on the cores of each memory bank, and
+// prints the local and remote bandwidth.
+//*****************************************************************************
+void CMPProcessing::ReportMemoryBankBandwidth()
+   {
+   if (m_NumMemoryBank < 2)
+      return;
+
+   //Allocate a source and a destination buffer in each memory bank
+   MIL_ID* MilSourceBuffers = new MIL_ID[m_NumMemoryBank];
+   MIL_ID* MilDestBuffers = new MIL_ID[m_NumMemoryBank];
+   for (MIL_INT i=0; i<m_NumMemoryBank; i++)
+      {
+      MbufAlloc2d(m_MilSystem, BANDWIDTH_BUFFER_SIZE_X, BANDWIDTH_BUFFER_SIZE_Y, 8+M_UNSIGNED,
+         M_IMAGE+M_PROC+M_HOST_MEMORY+m_AvailableMemoryBanks[i], &MilSourceBuffers[i]);
+      MbufAlloc2d(m_MilSystem, BANDWIDTH_BUFFER_SIZE_X, BANDWIDTH_BUFFER_SIZE_Y, 8+M_UNSIGNED,
+         M_IMAGE+M_PROC+M_HOST_MEMORY+m_AvailableMemoryBanks[i], &MilDestBuffers[i]);
+      MbufClear(MilSourceBuffers[i], 0.0);
+      MbufClear(MilDestBuffers[i], 0.0);
+      }
+
+   //Get the cores that are available for the process
+   MIL_INT CoreAffinityMaskArraySize = 0;
+   MappInquireMp(M_DEFAULT, M_CORE_AFFINITY_MASK_ARRAY_SIZE, M_DEFAULT, M_DEFAULT, &CoreAffinityMaskArraySize);
+   MIL_UINT64* CoreAffinityMaskProcess = new MIL_UINT64[CoreAffinityMaskArraySize];
+   MIL_UINT64* CoreAffinityMask = new MIL_UINT64[CoreAffinityMaskArraySize];
+   MappInquireMp(M_DEFAULT, M_CORE_AFFINITY_MASK_PROCESS, M_DEFAULT, M_DEFAULT, CoreAffinityMaskProcess);
+
+   MosPrintf(MIL_TEXT("Memory bank bandwidth (MB/s, read and write):\n"));
+   MosPrintf(MIL_TEXT("   Cores of bank   Buffers in bank   Bandwidth\n"));
+
+   const MIL_DOUBLE BytesCopied = 2.0*BANDWIDTH_BUFFER_SIZE_X*BANDWIDTH_BUFFER_SIZE_Y*BANDWIDTH_NUM_COPIES;
+   MIL_DOUBLE LocalBandwidth = 0.0, RemoteBandwidth = 0.0;
+   MIL_INT NumLocal = 0, NumRemote = 0;
+   for (MIL_INT CoreBank=0; CoreBank<m_NumMemoryBank; CoreBank++)
+      {
+      //Run the MP threads on the cores of the memory bank only
+      for (MIL_INT i=0; i<CoreAffinityMaskArraySize; i++)
+         CoreAffinityMask[i] = 0;
+      for (MIL_INT i=0; i<MAX_MP_CORES; i++)
+         {
+         bool ValidBank = false;
+         if ( (CoreAffinityMaskProcess[0]&((MIL_UINT64)1<<i)) &&
+              (GetCoreMemoryBank(i, ValidBank)==m_AvailableMemoryBanks[CoreBank]) && ValidBank )
+            CoreAffinityMask[0] |= ((MIL_UINT64)1<<i);
+         }
+      if (CoreAffinityMask[0] == 0)
+         continue;
+      MappControlMp(M_DEFAULT, M_CORE_AFFINITY_MASK, M_DEFAULT, M_USER_DEFINED, CoreAffinityMask);
+
+      for (MIL_INT BufferBank=0; BufferBank<m_NumMemoryBank; BufferBank++)
+         {
+         MIL_DOUBLE StartTime, EndTime;
+
+         //Copy once to warm up the buffers, then time the copies
+         MbufCopy(MilSourceBuffers[BufferBank], MilDestBuffers[BufferBank]);
+         MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &StartTime);
+         for (MIL_INT i=0; i<BANDWIDTH_NUM_COPIES; i++)
+            MbufCopy(MilSourceBuffers[BufferBank], MilDestBuffers[BufferBank]);
+         MappTimer(M_DEFAULT, M_TIMER_READ+M_SYNCHRONOUS, &EndTime);
+
+         MIL_DOUBLE Bandwidth = (EndTime>StartTime)?BytesCopied/(EndTime-StartTime)/1.0e6:0.0;
+         MosPrintf(MIL_TEXT("   %13d   %15d   %9.0f %s\n"), (int)CoreBank, (int)BufferBank, Bandwidth,
+                   (CoreBank==BufferBank)?MIL_TEXT("local"):MIL_TEXT("remote"));
+
+         if (CoreBank == BufferBank)
+            {
+            LocalBandwidth += Bandwidth;
+            NumLocal++;
+            }
+         else
+            {
+            RemoteBandwidth += Bandwidth;
+            NumRemote++;
+            }
+         }
+      }
+
+   //Restore the default core affinity
+   MappControlMp(M_DEFAULT, M_CORE_AFFINITY_MASK, M_DEFAULT, M_DEFAULT, M_NULL);
+
+   if ((NumLocal > 0) && (NumRemote > 0))
+      {
+      LocalBandwidth /= NumLocal;
+      RemoteBandwidth /= NumRemote;
+      MosPrintf(MIL_TEXT("Average local bandwidth: %.0f MB/s, remote bandwidth: %.0f MB/s (%.0f%% lower).\n\n"),
+                LocalBandwidth, RemoteBandwidth, 100.0*(1.0-RemoteBandwidth/LocalBandwidth));
+      }
+   else
+      {
+      MosPrintf(MIL_TEXT("The cores of the memory banks could not be identified.\n\n"));
+      }
+
+   delete [] CoreAffinityMask;
+   delete [] CoreAffinityMaskProcess;
+   for (MIL_INT i=0; i<m_NumMemoryBank; i++)
+      {
+      MbufFree(MilDestBuffers[i]);
+      MbufFree(MilSourceBuffers[i]);
+      }
+   delete [] MilDestBuffers;
+   delete [] MilSourceBuffers;
+   }
+
+//*****************************************************************************
+// GetProcessingElementMemoryBank. Returns the memory bank on which the buffers
+// of a processing object must be allocated. The processing objects of each
+// dispatch thread are grouped together, starting with the one without a
+// memory bank.
+//*****************************************************************************
+MIL_INT64 CMPProcessing::GetProcessingElementMemoryBank(MIL_INT ProcessingObjectIndex) const
+   {
+   bool ValidBank = false;
+   return GetMemoryBank((ProcessingObjectIndex%(m_NumMemoryBank+1))-1, ValidBank);
+   }
+
 //*****************************************************************************
 // UpdateDisplay. Copies the given image to the display if it is not disabled 
 // and updates the information in the display title.
@@ -398,7 +611,7 @@ MIL_INT CMPProcessing::GetMemoryBankIndex(MIL_INT64 MemoryBank) const
 //*****************************************************************************
 // ProcessingFunction. Function that calls the processing to do.
 //*****************************************************************************
-long CMPProcessing::ProcessingFunction(void* DataPtr)
+long CMPProcessing::ProcessingFunction(void* DataPtr, MIL_INT DispatchThreadIndex)
    {
    CMPProcessing* Processing = (CMPProcessing*)DataPtr;
 
@@ -408,6 +621,9 @@ long CMPProcessing::ProcessingFunction(void* DataPtr)
    if (Processing->UseMemoryBank())
       ProcessingObjectIndex = Processing->GetMemoryBankIndex(Processing->GetCurrentMemoryBank())+1;
 
+   //Use the processing objects of the dispatch thread that calls the processing.
+   ProcessingObjectIndex += DispatchThreadIndex*(Processing->GetNumMemoryBank()+1);
+
    //Run the processing
    Processing->Process(ProcessingObjectIndex);
    return 0;
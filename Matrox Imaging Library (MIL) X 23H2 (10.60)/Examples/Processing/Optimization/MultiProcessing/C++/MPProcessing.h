@@ -22,7 +22,9 @@ class CMPProcessing
                     MIL_INT DisplayBufferSizeY,
                     MIL_INT DisplayBufferType, 
                     MIL_INT DisplayBufferSizeBand,
-                    MIL_INT ProcessingIndex);
+                    MIL_INT ProcessingIndex,
+                    MIL_INT NumDispatchThreads,
+                    bool UseDisplay);
 
       virtual ~CMPProcessing();
 
@@ -44,6 +46,7 @@ class CMPProcessing
       void SetMPPriority(MIL_INT Priority);
       void SetCoreAffinity(MIL_UINT64 AffinityMask);
       void SetCurrentMemoryBank(MIL_INT64 MemoryBank, bool UseBank);
+      void SetAutoMemoryBank(bool Enable);
 
       //Thread inquire functions
       inline bool ThreadStarted() const;
@@ -60,22 +63,36 @@ class CMPProcessing
       inline MIL_INT GetMPPriority() const;
 
       inline bool UseMemoryBank() const;
+      inline bool AutoMemoryBankEnabled() const;
       inline MIL_INT64 GetCurrentMemoryBank() const;
       inline MIL_UINT64 GetCoreAffinity() const;
       inline MIL_DOUBLE GetFrameRate() const;
+      inline MIL_INT GetTotalFramesProcessed() const;
       MIL_INT64 GetMemoryBank(bool Next, bool& ValidBank) const;
 
-   protected:
+      inline MIL_INT GetNumMemoryBank() const;
+      MIL_INT64 GetMemoryBank(MIL_INT Index, bool& ValidBank) const;
+      MIL_INT64 GetCoreMemoryBank(MIL_INT CoreIndex, bool& ValidBank) const;
+      void ReportMemoryBankBandwidth();
+
+      //Dispatch inquire functions
+      inline MIL_INT GetNumDispatchThreads() const;
+
+      //Buffer inquire functions
       inline MIL_INT GetBufferSizeX() const;
       inline MIL_INT GetBufferSizeY() const;
       inline MIL_INT GetBufferType() const;
       inline MIL_INT GetBufferSizeBand() const;
 
+      //Virtual function that must be defined in derived classes to name the processing.
+      virtual MIL_CONST_TEXT_PTR GetProcessingName() const = 0;
+
+   protected:
       inline MIL_ID  GetSystemID() const;
 
-      inline MIL_INT GetNumMemoryBank() const;
+      inline MIL_INT GetNumProcessingElements() const;
 
-      MIL_INT64 GetMemoryBank(MIL_INT Index, bool& ValidBank) const;
+      MIL_INT64 GetProcessingElementMemoryBank(MIL_INT ProcessingObjectIndex) const;
       void UpdateDisplay(MIL_ID ImageToDisplay);
 
       //Virtual function that must be defined in derived classes to define processing.
@@ -90,6 +107,7 @@ class CMPProcessing
       void Free();
 
       MIL_INT GetMemoryBankIndex(MIL_INT64 MemoryBank) const;
+      void UpdateAutoMemoryBank();
       void UpdateDisplayTitle();
 
       MIL_ID   m_MilSystem;
@@ -98,6 +116,8 @@ class CMPProcessing
       MIL_ID   m_MilDisplayBuffer;
 
       MIL_INT  m_ProcessingIndex;
+      MIL_INT  m_NumDispatchThreads;
+      bool     m_UseDisplay;
 
       CDispatcher* m_Dispatcher;
 
@@ -114,6 +134,7 @@ class CMPProcessing
       MIL_INT     m_NumMemoryBank;
       MIL_INT64*  m_AvailableMemoryBanks;  
       bool        m_UseMemoryBank;
+      bool        m_AutoMemoryBank;
      
       MIL_TEXT_CHAR m_DisplayTitle[STRING_SIZE];
 
@@ -122,7 +143,7 @@ class CMPProcessing
       MIL_INT     m_DisplayBufferType;
       MIL_INT     m_DisplayBufferSizeBand;
 
-      static long ProcessingFunction(void* DataPtr);
+      static long ProcessingFunction(void* DataPtr, MIL_INT DispatchThreadIndex);
    };
 
 //*****************************************************************************
@@ -214,6 +235,23 @@ inline MIL_DOUBLE CMPProcessing::GetFrameRate() const
    return m_Dispatcher->GetFrameRate(); 
    }
 
+//*****************************************************************************
+// GetTotalFramesProcessed. Returns the number of frames processed since the
+// processing thread started.
+//*****************************************************************************
+inline MIL_INT CMPProcessing::GetTotalFramesProcessed() const 
+   { 
+   return m_Dispatcher->GetTotalFramesProcessed(); 
+   }
+
+//*****************************************************************************
+// GetNumDispatchThreads. Returns the number of threads that run the processing.
+//*****************************************************************************
+inline MIL_INT CMPProcessing::GetNumDispatchThreads() const 
+   { 
+   return m_NumDispatchThreads; 
+   }
+
 //*****************************************************************************
 // GetBufferSizeX. Get the size X of the display buffer.
 //*****************************************************************************
@@ -262,6 +300,14 @@ inline bool CMPProcessing::UseMemoryBank() const
    return m_UseMemoryBank;
    }
 
+//*****************************************************************************
+// AutoMemoryBankEnabled. Get whether the memory bank follows the core affinity.
+//*****************************************************************************
+inline bool CMPProcessing::AutoMemoryBankEnabled() const
+   {
+   return m_AutoMemoryBank;
+   }
+
 //*****************************************************************************
 // GetNumMemoryBank. Get the number of memory banks.
 //*****************************************************************************
@@ -270,4 +316,14 @@ inline MIL_INT CMPProcessing::GetNumMemoryBank() const
    return m_NumMemoryBank;
    }
 
+//*****************************************************************************
+// GetNumProcessingElements. Get the number of processing objects the derived
+// classes must allocate: one per memory bank (plus one for no memory bank)
+// for each dispatch thread.
+//*****************************************************************************
+inline MIL_INT CMPProcessing::GetNumProcessingElements() const
+   {
+   return (m_NumMemoryBank+1)*m_NumDispatchThreads;
+   }
+
 #endif 
@@ -15,22 +15,24 @@ static const MIL_DOUBLE           ROTATION_INCREMENT      = 8.0;
 //*****************************************************************************
 // Constructor. 
 //*****************************************************************************
-CMPRotateProcessing::CMPRotateProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT ProcessingIndex)
+CMPRotateProcessing::CMPRotateProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT ProcessingIndex, MIL_INT NumDispatchThreads,
+                                         bool UseDisplay)
 : CMPProcessing(Title,
                 MbufDiskInquire(ROTATE_PROCESSING_IMAGE, M_SIZE_X,    M_NULL), 
                 MbufDiskInquire(ROTATE_PROCESSING_IMAGE, M_SIZE_Y,    M_NULL),
                 MbufDiskInquire(ROTATE_PROCESSING_IMAGE, M_TYPE,      M_NULL), 
                 MbufDiskInquire(ROTATE_PROCESSING_IMAGE, M_SIZE_BAND, M_NULL),
-                ProcessingIndex)
+                ProcessingIndex,
+                NumDispatchThreads,
+                UseDisplay)
    {
    //Allocate the structure which will contain all processing object information.
-   m_ProcessingElements = new RotateProcessingStruct[GetNumMemoryBank()+1];
+   m_ProcessingElements = new RotateProcessingStruct[GetNumProcessingElements()];
 
-   bool ValidBank=false;
    MIL_INT64 MemoryBank = 0;
-   for (MIL_INT i=0; i<=GetNumMemoryBank(); i++)
+   for (MIL_INT i=0; i<GetNumProcessingElements(); i++)
       {
-      MemoryBank = GetMemoryBank(i-1, ValidBank);
+      MemoryBank = GetProcessingElementMemoryBank(i);
       //Allocate required buffers for processing
       MbufAllocColor(GetSystemID(), GetBufferSizeBand(), GetBufferSizeX(), GetBufferSizeY(), GetBufferType(), 
          M_IMAGE+M_PROC+M_HOST_MEMORY+MemoryBank, &m_ProcessingElements[i].MilSourceBuffer);
@@ -74,7 +76,7 @@ CMPRotateProcessing::~CMPRotateProcessing()
    StopThread();
 
    //Free the processing objects
-   for (MIL_INT i=0; i<=GetNumMemoryBank(); i++)
+   for (MIL_INT i=0; i<GetNumProcessingElements(); i++)
       {   
       // Free MIL objects.  
       MbufFree(m_ProcessingElements[i].MilSourceBuffer);
@@ -88,6 +90,14 @@ CMPRotateProcessing::~CMPRotateProcessing()
    delete [] m_ProcessingElements;
    }
 
+//*****************************************************************************
+// GetProcessingName. Returns the name of the processing.
+//*****************************************************************************
+MIL_CONST_TEXT_PTR CMPRotateProcessing::GetProcessingName() const
+   {
+   return MIL_TEXT("Rotate");
+   }
+
 //*****************************************************************************
 // Process. Do the processing.
 //*****************************************************************************
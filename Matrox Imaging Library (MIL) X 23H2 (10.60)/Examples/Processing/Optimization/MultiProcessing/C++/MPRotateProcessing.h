@@ -33,9 +33,12 @@ struct RotateProcessingStruct
 class CMPRotateProcessing : public CMPProcessing
    {
    public:
-      CMPRotateProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT ProcessingIndex);
+      CMPRotateProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT ProcessingIndex, MIL_INT NumDispatchThreads,
+                          bool UseDisplay);
       virtual ~CMPRotateProcessing();
 
+      virtual MIL_CONST_TEXT_PTR GetProcessingName() const;
+
    protected:
       virtual void Process(MIL_INT ProcessingObjectIndex);
 
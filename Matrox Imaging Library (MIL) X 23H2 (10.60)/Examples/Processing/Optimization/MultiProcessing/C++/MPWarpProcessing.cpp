@@ -8,21 +8,39 @@
 // All Rights Reserved
 
 #include "common.h"
+#include <cstring>
 
 static MIL_CONST_TEXT_PTR const   WARP_PROCESSING_IMAGE = EXAMPLE_IMAGE_PATH MIL_TEXT("LargeWafer.mim");
 static const MIL_INT WARP_INCREMENT = 40;  
 static const MIL_INT MAX_INCREMENT = 20;
 
+//Set this define to 0 to warp with the polynomial coefficients generated for
+//each frame instead of the cached warp maps.
+#define USE_WARP_MAP_CACHE 1
+
+//The cache holds the maps of a whole animation cycle (4 directions), within a
+//memory budget. Its maps are allocated when they are first used.
+static const MIL_INT WARP_MAP_CACHE_SIZE = 4*MAX_INCREMENT;
+static const MIL_INT WARP_MAP_CACHE_MAX_BYTES = 512*1024*1024;
+
+//The warp processing objects warp the same image with the same animation, so
+//they share one cache, allocated on the default host system.
+static CWarpMapCache* SharedWarpMapCache = M_NULL;
+static MIL_INT        SharedWarpMapCacheUsers = 0;
+
 //*****************************************************************************
 // Constructor. 
 //*****************************************************************************
-CMPWarpProcessing::CMPWarpProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT ProcessingIndex)
+CMPWarpProcessing::CMPWarpProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT ProcessingIndex, MIL_INT NumDispatchThreads,
+                                     bool UseDisplay)
 : CMPProcessing(Title,
                 MbufDiskInquire(WARP_PROCESSING_IMAGE, M_SIZE_X,    M_NULL),
                 MbufDiskInquire(WARP_PROCESSING_IMAGE, M_SIZE_Y,    M_NULL),
                 MbufDiskInquire(WARP_PROCESSING_IMAGE, M_TYPE,      M_NULL),
                 MbufDiskInquire(WARP_PROCESSING_IMAGE, M_SIZE_BAND, M_NULL),
-                ProcessingIndex)
+                ProcessingIndex,
+                NumDispatchThreads,
+                UseDisplay)
    {
    m_IncrementCount = 0;
 
@@ -54,14 +72,31 @@ CMPWarpProcessing::CMPWarpProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT Processin
    m_FourCorners[10] = (MIL_FLOAT)GetBufferSizeX()-1; 
    m_FourCorners[11] = (MIL_FLOAT)GetBufferSizeY()-1;
 
+   MthrAlloc(GetSystemID(), M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilWarpMutex);
+
+   //Use the shared warp map cache, allocated by the first warp processing object
+   m_WarpMapCache = M_NULL;
+#if USE_WARP_MAP_CACHE
+   if (!SharedWarpMapCache)
+      {
+      MIL_INT WarpMapSize = GetBufferSizeX()*GetBufferSizeY()*2*sizeof(MIL_INT16);
+      MIL_INT WarpMapCacheSize = WARP_MAP_CACHE_MAX_BYTES/WarpMapSize;
+      WarpMapCacheSize = (WarpMapCacheSize<WARP_MAP_CACHE_SIZE)?WarpMapCacheSize:WARP_MAP_CACHE_SIZE;
+      WarpMapCacheSize = (WarpMapCacheSize>1)?WarpMapCacheSize:1;
+      SharedWarpMapCache = new CWarpMapCache(M_DEFAULT_HOST, GetBufferSizeX(), GetBufferSizeY(),
+                                             WarpMapCacheSize, WARP_MAP_CACHE_SIZE);
+      }
+   SharedWarpMapCacheUsers++;
+   m_WarpMapCache = SharedWarpMapCache;
+#endif
+
    //Allocate the structure which will contain all processing object information.
-   m_ProcessingElements = new WarpProcessingStruct[GetNumMemoryBank()+1];
+   m_ProcessingElements = new WarpProcessingStruct[GetNumProcessingElements()];
 
-   bool ValidBank = false;
    MIL_INT64 MemoryBank = 0;
-   for (MIL_INT i=0; i<=GetNumMemoryBank(); i++)
+   for (MIL_INT i=0; i<GetNumProcessingElements(); i++)
       {
-      MemoryBank = GetMemoryBank(i-1, ValidBank);
+      MemoryBank = GetProcessingElementMemoryBank(i);
 
       //Allocate required buffers for processing
       MbufAllocColor(GetSystemID(), GetBufferSizeBand(), GetBufferSizeX(), GetBufferSizeY(), GetBufferType(), 
@@ -98,7 +133,7 @@ CMPWarpProcessing::CMPWarpProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT Processin
       MbufLoad(WARP_PROCESSING_IMAGE, m_ProcessingElements[i].MilSourceBuffer);
 
       //Generate the coefficients buffer for warping
-      GenerateCoefficientsBuffer(i);
+      GenerateCoefficientsBuffer(i, m_FourCorners);
      }
    }
 
@@ -110,7 +145,7 @@ CMPWarpProcessing::~CMPWarpProcessing()
    //Stop the thread
    StopThread();
 
-   for (MIL_INT i=0; i<=GetNumMemoryBank(); i++)
+   for (MIL_INT i=0; i<GetNumProcessingElements(); i++)
       {
       // Free MIL objects.  
       MbufFree(m_ProcessingElements[i].MilSourceBuffer);
@@ -124,6 +159,23 @@ CMPWarpProcessing::~CMPWarpProcessing()
 
    //Free processing information structure
    delete [] m_ProcessingElements;
+
+   //Free the shared warp map cache with the last warp processing object
+   if (m_WarpMapCache && (--SharedWarpMapCacheUsers == 0))
+      {
+      SharedWarpMapCache->PrintStatistics(GetProcessingName());
+      delete SharedWarpMapCache;
+      SharedWarpMapCache = M_NULL;
+      }
+   MthrFree(m_MilWarpMutex);
+   }
+
+//*****************************************************************************
+// GetProcessingName. Returns the name of the processing.
+//*****************************************************************************
+MIL_CONST_TEXT_PTR CMPWarpProcessing::GetProcessingName() const
+   {
+   return MIL_TEXT("Warp");
    }
 
 //*****************************************************************************
@@ -143,19 +195,53 @@ void CMPWarpProcessing::Process(MIL_INT ProcessingObjectIndex)
       m_ProcessingElements[ProcessingObjectIndex].MilDest3Buffer, M_SUB);
 
    //Warp the image
-   MimWarp( m_ProcessingElements[ProcessingObjectIndex].MilDest3Buffer, m_ProcessingElements[ProcessingObjectIndex].MilDest2Buffer, 
-            m_ProcessingElements[ProcessingObjectIndex].MilCoefficientsBuffer, 
-            M_NULL, M_WARP_POLYNOMIAL, 
-            M_BILINEAR+M_OVERSCAN_CLEAR);
+   if (m_WarpMapCache)
+      {
+      //Take the current warp parameters and move to the next ones
+      MIL_FLOAT FourCorners[NUM_FOUR_CORNER_VALUES];
+      MthrControl(m_MilWarpMutex, M_LOCK, M_DEFAULT);
+      memcpy(FourCorners, m_FourCorners, sizeof(FourCorners));
+      UpdateWarpCoefficients(ProcessingObjectIndex);
+      MthrControl(m_MilWarpMutex, M_UNLOCK, M_DEFAULT);
+
+      //Get their map, which is generated outside the locks if it is not cached
+      WarpMapStruct* WarpMap = m_WarpMapCache->Acquire(FourCorners);
+      if (WarpMap)
+         {
+         MimWarp( m_ProcessingElements[ProcessingObjectIndex].MilDest3Buffer, m_ProcessingElements[ProcessingObjectIndex].MilDest2Buffer, 
+                  WarpMap->MilLutX, WarpMap->MilLutY, m_WarpMapCache->GetWarpControlFlag(), 
+                  M_BILINEAR+M_OVERSCAN_CLEAR);
+
+         m_WarpMapCache->Release(WarpMap);
+         }
+      else
+         {
+         //All the maps are in use, warp with the polynomial coefficients
+         GenerateCoefficientsBuffer(ProcessingObjectIndex, FourCorners);
+         MimWarp( m_ProcessingElements[ProcessingObjectIndex].MilDest3Buffer, m_ProcessingElements[ProcessingObjectIndex].MilDest2Buffer, 
+                  m_ProcessingElements[ProcessingObjectIndex].MilCoefficientsBuffer, 
+                  M_NULL, M_WARP_POLYNOMIAL, 
+                  M_BILINEAR+M_OVERSCAN_CLEAR);
+         }
+      }
+   else
+      {
+      MimWarp( m_ProcessingElements[ProcessingObjectIndex].MilDest3Buffer, m_ProcessingElements[ProcessingObjectIndex].MilDest2Buffer, 
+               m_ProcessingElements[ProcessingObjectIndex].MilCoefficientsBuffer, 
+               M_NULL, M_WARP_POLYNOMIAL, 
+               M_BILINEAR+M_OVERSCAN_CLEAR);
+
+      //Update the warp coefficients
+      MthrControl(m_MilWarpMutex, M_LOCK, M_DEFAULT);
+      UpdateWarpCoefficients(ProcessingObjectIndex);
+      MthrControl(m_MilWarpMutex, M_UNLOCK, M_DEFAULT);
+      }
 
    //Make the image brighter to make the result more visible
    const MIL_INT PixelAdjustmentFactor = 3;
    MimArith(m_ProcessingElements[ProcessingObjectIndex].MilDest2Buffer, PixelAdjustmentFactor, 
       m_ProcessingElements[ProcessingObjectIndex].MilDest3Buffer, M_MULT_CONST);
 
-   //Update the warp coefficients
-   UpdateWarpCoefficients(ProcessingObjectIndex);
-
    //Copy the result to the display if it is not disabled and Update the information in the display title
    UpdateDisplay(m_ProcessingElements[ProcessingObjectIndex].MilDest3Buffer);
    }
@@ -258,16 +344,19 @@ void CMPWarpProcessing::UpdateWarpCoefficients(MIL_INT ProcessingObjectIndex)
          break;
       }
 
-   //Generate the coefficients buffer for warping
-   GenerateCoefficientsBuffer(ProcessingObjectIndex);
+   //Generate the coefficients buffer for warping. The cached maps are
+   //generated when they are needed.
+   if (!m_WarpMapCache)
+      GenerateCoefficientsBuffer(ProcessingObjectIndex, m_FourCorners);
    }
 
 //*****************************************************************************
-// GenerateCoefficientsBuffer. Generates the coefficients buffer for warping.
+// GenerateCoefficientsBuffer. Generates the coefficients buffer for warping
+// with the given four corner parameters.
 //*****************************************************************************
-void CMPWarpProcessing::GenerateCoefficientsBuffer(MIL_INT ProcessingObjectIndex)
+void CMPWarpProcessing::GenerateCoefficientsBuffer(MIL_INT ProcessingObjectIndex, const MIL_FLOAT* FourCorners)
    {
-   MbufPut(m_ProcessingElements[ProcessingObjectIndex].MilFourCornerBuffer, m_FourCorners);
+   MbufPut(m_ProcessingElements[ProcessingObjectIndex].MilFourCornerBuffer, (void*)FourCorners);
 
    MgenWarpParameter(m_ProcessingElements[ProcessingObjectIndex].MilFourCornerBuffer,
       m_ProcessingElements[ProcessingObjectIndex].MilCoefficientsBuffer, M_NULL, 
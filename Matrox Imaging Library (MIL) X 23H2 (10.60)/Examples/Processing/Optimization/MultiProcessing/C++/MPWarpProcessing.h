@@ -39,9 +39,12 @@ struct WarpProcessingStruct
 class CMPWarpProcessing: public CMPProcessing
    {
    public:
-      CMPWarpProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT ProcessingIndex);
+      CMPWarpProcessing(MIL_CONST_TEXT_PTR Title, MIL_INT ProcessingIndex, MIL_INT NumDispatchThreads,
+                        bool UseDisplay);
       virtual ~CMPWarpProcessing();
 
+      virtual MIL_CONST_TEXT_PTR GetProcessingName() const;
+
    protected:
       virtual void Process(MIL_INT ProcessingObjectIndex);
 
@@ -51,13 +54,19 @@ class CMPWarpProcessing: public CMPProcessing
       CMPWarpProcessing& operator=(const CMPProcessing&);
 
       void UpdateWarpCoefficients(MIL_INT ProcessingObjectIndex);
-      void GenerateCoefficientsBuffer(MIL_INT ProcessingObjectIndex);
+      void GenerateCoefficientsBuffer(MIL_INT ProcessingObjectIndex, const MIL_FLOAT* FourCorners);
 
       WarpProcessingStruct* m_ProcessingElements;
 
       MIL_INT        m_IncrementCount;
       WarpDirection  m_Direction;
-      MIL_FLOAT      m_FourCorners[12];
+      MIL_FLOAT      m_FourCorners[NUM_FOUR_CORNER_VALUES];
+
+      //Protects the warp animation state, which is shared by the dispatch threads
+      MIL_ID         m_MilWarpMutex;
+
+      //Dense warp maps of the animation, shared by the processing objects
+      CWarpMapCache* m_WarpMapCache;
    };
 
 #endif
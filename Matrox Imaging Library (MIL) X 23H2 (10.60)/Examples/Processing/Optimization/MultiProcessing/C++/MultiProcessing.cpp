@@ -22,6 +22,15 @@ void PrintHeader()
              MIL_TEXT("The menu allows you to interactively modify the number of user processing \n")
              MIL_TEXT("threads and the multi-processing controls for each one. This allows for\n")
              MIL_TEXT("the comparison of various multi-processing modes.\n")
+             MIL_TEXT("Each processing object can also be run by a pool of dispatch threads\n")
+             MIL_TEXT("pulling frames from a shared queue, to compare user-level threading\n")
+             MIL_TEXT("combined with multi-processing against multi-processing alone.\n")
+             MIL_TEXT("The multi-processing controls can also be tuned automatically; the\n")
+             MIL_TEXT("best configuration is saved in a profile and reapplied at startup.\n")
+             MIL_TEXT("On NUMA systems, the buffers of each processing object are placed on\n")
+             MIL_TEXT("the memory bank of the cores of its affinity.\n")
+             MIL_TEXT("When started with arguments (see --help), the example runs without\n")
+             MIL_TEXT("display and prints the frame rates in CSV, for benchmarking.\n")
              MIL_TEXT("\n\n")
   
              MIL_TEXT("[MODULES USED]\n")
@@ -32,10 +41,13 @@ void PrintHeader()
 //*****************************************************************************
 // Main.
 //*****************************************************************************
-int MosMain(void)
+int MosMain(int argc, MIL_TEXT_CHAR* argv[])
    {
    MIL_INT NumCoresAvailable;
+   MIL_INT NumDispatchThreads = 1;
+   bool TuneMP = false;
    CMPMenu* Menu;
+   CMPAutoTuner* AutoTuner;
    CMPProcessing** Processing; 
    MIL_TEXT_CHAR Title[STRING_SIZE];
    MIL_ID MilApplication;
@@ -48,10 +60,45 @@ int MosMain(void)
    if (MappInquireMp(M_DEFAULT, M_MP_FORCED_DISABLE, M_DEFAULT, M_DEFAULT, M_NULL)==M_YES) 
       NumCoresAvailable=1;
 
+   //With arguments, run without the menu and without user input
+   if (argc > 1)
+      {
+      int Status = 1;
+      CMPHeadless* Headless = new CMPHeadless(NumCoresAvailable);
+      if (Headless->ParseArguments(argc, argv))
+         {
+         Headless->Run();
+         Status = 0;
+         }
+      delete Headless;
+      MappFree(MilApplication);
+      return Status;
+      }
+
    MosPrintf(MIL_TEXT("Multiprocessing:\n"));
    MosPrintf(MIL_TEXT("---------------------------------------\n\n"));
    
    PrintHeader();    
+
+   //Select the number of dispatch threads of each processing object
+   MosPrintf(MIL_TEXT("Enter the number of dispatch threads per processing object (1-%d).\n"),
+             (int)MAX_DISPATCH_THREADS);
+   MosPrintf(MIL_TEXT("With more than one, the threads pull frames from a shared queue and\n")
+             MIL_TEXT("the cores are divided between them. Press <Enter> for 1.\n\n"));
+   MIL_INT Selection = MosGetch();
+   if ((Selection > MIL_TEXT('1')) && (Selection <= MIL_TEXT('0')+MAX_DISPATCH_THREADS))
+      NumDispatchThreads = Selection-MIL_TEXT('0');
+   MosPrintf(MIL_TEXT("Using %d dispatch thread(s) per processing object.\n\n"), (int)NumDispatchThreads);
+
+   //Select whether to tune the MP configuration or to reapply the saved profiles
+   AutoTuner = new CMPAutoTuner();
+   MosPrintf(MIL_TEXT("CPU: %s\n"), AutoTuner->GetCpuModel());
+   MosPrintf(MIL_TEXT("Press <t> to tune the MP configuration of the processing objects\n")
+             MIL_TEXT("before showing the menu (this can take a few minutes). Press any\n")
+             MIL_TEXT("other key to reapply the saved profiles, if any.\n\n"));
+   Selection = MosGetch();
+   TuneMP = (Selection == MIL_TEXT('t')) || (Selection == MIL_TEXT('T'));
+
    MosPrintf(MIL_TEXT("Loading menu...\n\n"));
 
    //Allocate the processing objects.  There are as many as there are available cores.
@@ -64,17 +111,21 @@ int MosMain(void)
       switch (i%NumberOfProcessingTypes)
          {
          case 0:
-            Processing[i] = new CMPRotateProcessing(Title, i);
+            Processing[i] = new CMPRotateProcessing(Title, i, NumDispatchThreads, true);
             break;
          case 1:
          default:
-            Processing[i] = new CMPWarpProcessing(Title, i);
+            Processing[i] = new CMPWarpProcessing(Title, i, NumDispatchThreads, true);
             break;
          }
       }
 
+   //On NUMA systems, show the cost of accessing the buffers of another memory bank
+   if (Processing[0]->GetNumMemoryBank() > 1)
+      Processing[0]->ReportMemoryBankBandwidth();
+
    //Allocate and run the menu
-   Menu = new CMPMenu(NumCoresAvailable, Processing);
+   Menu = new CMPMenu(NumCoresAvailable, Processing, AutoTuner, TuneMP);
    Menu->Run();
 
    //Wait for user input to end the example
@@ -90,6 +141,7 @@ int MosMain(void)
       delete Processing[i];
       }
    delete [] Processing;
+   delete AutoTuner;
    MappFree(MilApplication);
    return 0;
    }
@@ -0,0 +1,401 @@
+﻿//***************************************************************************************/
+//
+// File name: WarpMapCache.cpp
+//
+// Synopsis:  Implements the CWarpMapCache class.
+//
+// Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+// All Rights Reserved
+
+#include "common.h"
+#include <cstring>
+
+//Size of the tiles that are compared and generated independently
+static const MIL_INT WARP_MAP_TILE_SIZE = 64;
+
+//Maximum number of fraction bits of the fixed point maps
+static const MIL_INT WARP_MAP_MAX_FRACTION_BITS = 6;
+
+//Maximum value of a 16-bit signed map
+static const MIL_INT WARP_MAP_MAX_VALUE = 32767;
+
+//Margin, in pixels, of the coordinates of a tile that is outside the image
+static const MIL_DOUBLE WARP_MAP_OUTSIDE_MARGIN = 0.01;
+
+//*****************************************************************************
+// Constructor. Prepares the maps of the cache, which are allocated when they
+// are first used. The fixed point precision is the highest that can hold the
+// coordinates of the image in 16 bits.
+//*****************************************************************************
+CWarpMapCache::CWarpMapCache(MIL_ID MilSystem, MIL_INT SizeX, MIL_INT SizeY, MIL_INT Capacity, MIL_INT WorkingSetSize)
+: m_MilSystem(MilSystem), m_SizeX(SizeX), m_SizeY(SizeY), m_Capacity(Capacity), m_UseCounter(0),
+  m_ReplaceMostRecent(Capacity < WorkingSetSize),
+  m_NumHits(0), m_NumMisses(0), m_NumFull(0), m_NumTilesGenerated(0), m_NumTilesReused(0)
+   {
+   MIL_INT MaxCoordinate = ((m_SizeX>m_SizeY)?m_SizeX:m_SizeY)+1;
+   m_FractionBits = 0;
+   while ((m_FractionBits < WARP_MAP_MAX_FRACTION_BITS) && ((MaxCoordinate<<(m_FractionBits+1)) <= WARP_MAP_MAX_VALUE))
+      m_FractionBits++;
+   m_FixedPointScale = (MIL_DOUBLE)((MIL_INT)1<<m_FractionBits);
+
+   MthrAlloc(m_MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilMutex);
+   MbufAlloc1d(m_MilSystem, NUM_FOUR_CORNER_VALUES, 32+M_FLOAT, M_ARRAY, &m_MilFourCornerBuffer);
+   MbufAlloc2d(m_MilSystem, 3, 3, 32+M_FLOAT, M_ARRAY, &m_MilCoefficientsBuffer);
+
+   m_Maps = new WarpMapStruct[m_Capacity];
+   for (MIL_INT i=0; i<m_Capacity; i++)
+      {
+      WarpMapStruct& WarpMap = m_Maps[i];
+      WarpMap.MilLutX = M_NULL;
+      WarpMap.MilLutY = M_NULL;
+      WarpMap.MilReadyEvent = M_NULL;
+      WarpMap.UseCount = 0;
+      WarpMap.LastUse = 0;
+      WarpMap.Valid = false;
+      WarpMap.Ready = false;
+      }
+   }
+
+//*****************************************************************************
+// Destructor. Frees the maps of the cache.
+//*****************************************************************************
+CWarpMapCache::~CWarpMapCache()
+   {
+   for (MIL_INT i=0; i<m_Capacity; i++)
+      {
+      if (m_Maps[i].MilLutX)
+         {
+         MthrFree(m_Maps[i].MilReadyEvent);
+         MbufFree(m_Maps[i].MilLutY);
+         MbufFree(m_Maps[i].MilLutX);
+         }
+      }
+   delete [] m_Maps;
+
+   MbufFree(m_MilCoefficientsBuffer);
+   MbufFree(m_MilFourCornerBuffer);
+   MthrFree(m_MilMutex);
+   }
+
+//*****************************************************************************
+// Acquire. Returns the map of the four corner parameters from the cache. If it
+// is not cached, a free map is reserved under the lock and generated outside
+// of it. The threads that need the same map meanwhile wait until it is ready.
+//*****************************************************************************
+WarpMapStruct* CWarpMapCache::Acquire(const MIL_FLOAT* FourCorners)
+   {
+   WarpMapStruct* BaseMap = M_NULL;
+   WarpMapStruct  PreviousMap;
+   bool           Generate = false;
+   bool           Ready = true;
+
+   MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+
+   WarpMapStruct* WarpMap = FindMap(FourCorners);
+   if (WarpMap)
+      {
+      m_NumHits++;
+      Ready = WarpMap->Ready;
+      }
+   else
+      {
+      m_NumMisses++;
+      WarpMap = FindFreeMap();
+      if (WarpMap)
+         {
+         //Keep the nearest map while its tiles are copied. If it is the map
+         //itself, its previous coefficients are kept to compare the tiles.
+         BaseMap = FindNearestMap(FourCorners);
+         if (BaseMap == WarpMap)
+            {
+            PreviousMap = *WarpMap;
+            BaseMap = &PreviousMap;
+            }
+         else if (BaseMap)
+            BaseMap->UseCount++;
+
+         ReserveMap(WarpMap, FourCorners);
+         Generate = true;
+         }
+      else
+         m_NumFull++;
+      }
+
+   if (WarpMap)
+      {
+      WarpMap->UseCount++;
+      WarpMap->LastUse = ++m_UseCounter;
+      }
+
+   MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+
+   if (Generate)
+      {
+      MIL_INT NumTilesGenerated = 0, NumTilesReused = 0;
+      GenerateMap(WarpMap, BaseMap, NumTilesGenerated, NumTilesReused);
+
+      MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+      WarpMap->Ready = true;
+      if (BaseMap && (BaseMap != &PreviousMap))
+         BaseMap->UseCount--;
+      m_NumTilesGenerated += NumTilesGenerated;
+      m_NumTilesReused += NumTilesReused;
+      MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+
+      MthrControl(WarpMap->MilReadyEvent, M_EVENT_SET, M_SIGNALED);
+      }
+   else if (!Ready)
+      {
+      //The map is generated by another thread, and cannot be replaced while it is used
+      MthrWait(WarpMap->MilReadyEvent, M_EVENT_WAIT, M_NULL);
+      }
+
+   return WarpMap;
+   }
+
+//*****************************************************************************
+// Release. Indicates that the map is no longer used.
+//*****************************************************************************
+void CWarpMapCache::Release(WarpMapStruct* WarpMap)
+   {
+   MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+   WarpMap->UseCount--;
+   MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+   }
+
+//*****************************************************************************
+// PrintStatistics. Prints the use of the cache.
+//*****************************************************************************
+void CWarpMapCache::PrintStatistics(MIL_CONST_TEXT_PTR Title) const
+   {
+   MIL_INT NumTiles = m_NumTilesGenerated+m_NumTilesReused;
+   MIL_INT NumAcquires = m_NumHits+m_NumMisses;
+   MosPrintf(MIL_TEXT("%s warp map cache: %d maps, %d hits, %d misses (%.1f%% hit rate), %d without a free map, ")
+             MIL_TEXT("%.1f%% of the tiles reused%s.\n"), Title, (int)m_Capacity,
+             (int)m_NumHits, (int)m_NumMisses, (NumAcquires>0)?(100.0*m_NumHits/NumAcquires):0.0, (int)m_NumFull,
+             (NumTiles>0)?(100.0*m_NumTilesReused/NumTiles):0.0,
+             m_ReplaceMostRecent?MIL_TEXT(", most recently used map replaced"):MIL_TEXT(""));
+   }
+
+//*****************************************************************************
+// FindMap. Returns the cached map of the four corner parameters, if any. The
+// map can still be being generated.
+//*****************************************************************************
+WarpMapStruct* CWarpMapCache::FindMap(const MIL_FLOAT* FourCorners)
+   {
+   for (MIL_INT i=0; i<m_Capacity; i++)
+      {
+      if (m_Maps[i].Valid && (memcmp(m_Maps[i].FourCorners, FourCorners, sizeof(m_Maps[i].FourCorners))==0))
+         return &m_Maps[i];
+      }
+   return M_NULL;
+   }
+
+//*****************************************************************************
+// FindNearestMap. Returns the generated map whose four corners are the
+// closest to the given ones.
+//*****************************************************************************
+WarpMapStruct* CWarpMapCache::FindNearestMap(const MIL_FLOAT* FourCorners)
+   {
+   WarpMapStruct* NearestMap = M_NULL;
+   MIL_DOUBLE NearestDistance = 0.0;
+
+   for (MIL_INT i=0; i<m_Capacity; i++)
+      {
+      if (!m_Maps[i].Valid || !m_Maps[i].Ready)
+         continue;
+
+      MIL_DOUBLE Distance = 0.0;
+      for (MIL_INT j=0; j<NUM_FOUR_CORNER_VALUES; j++)
+         {
+         MIL_DOUBLE Difference = fabs((MIL_DOUBLE)(m_Maps[i].FourCorners[j]-FourCorners[j]));
+         Distance = (Difference>Distance)?Difference:Distance;
+         }
+
+      if (!NearestMap || (Distance < NearestDistance))
+         {
+         NearestMap = &m_Maps[i];
+         NearestDistance = Distance;
+         }
+      }
+   return NearestMap;
+   }
+
+//*****************************************************************************
+// FindFreeMap. Returns a map that was never used. Otherwise, returns the least
+// recently used map that is not in use or, when the working set does not fit
+// in the cache, the most recently used one.
+//*****************************************************************************
+WarpMapStruct* CWarpMapCache::FindFreeMap()
+   {
+   WarpMapStruct* FreeMap = M_NULL;
+
+   for (MIL_INT i=0; i<m_Capacity; i++)
+      {
+      WarpMapStruct* WarpMap = &m_Maps[i];
+      if (WarpMap->UseCount != 0)
+         continue;
+      if (!WarpMap->Valid)
+         return WarpMap;
+      if (!FreeMap ||
+          (!m_ReplaceMostRecent && (WarpMap->LastUse < FreeMap->LastUse)) ||
+          (m_ReplaceMostRecent && (WarpMap->LastUse > FreeMap->LastUse)))
+         FreeMap = WarpMap;
+      }
+   return FreeMap;
+   }
+
+//*****************************************************************************
+// ReserveMap. Allocates the map if it was never used and sets its four corner
+// parameters and coefficients. The map is generated afterwards.
+//*****************************************************************************
+void CWarpMapCache::ReserveMap(WarpMapStruct* WarpMap, const MIL_FLOAT* FourCorners)
+   {
+   //The maps are written directly in host memory
+   if (!WarpMap->MilLutX)
+      {
+      MbufAlloc2d(m_MilSystem, m_SizeX, m_SizeY, 16+M_SIGNED, M_LUT+M_HOST_MEMORY, &WarpMap->MilLutX);
+      MbufAlloc2d(m_MilSystem, m_SizeX, m_SizeY, 16+M_SIGNED, M_LUT+M_HOST_MEMORY, &WarpMap->MilLutY);
+      MbufInquire(WarpMap->MilLutX, M_HOST_ADDRESS, &WarpMap->LutXPtr);
+      MbufInquire(WarpMap->MilLutY, M_HOST_ADDRESS, &WarpMap->LutYPtr);
+      MbufInquire(WarpMap->MilLutX, M_PITCH, &WarpMap->Pitch);
+      MthrAlloc(m_MilSystem, M_EVENT, M_NOT_SIGNALED+M_MANUAL_RESET, M_NULL, M_NULL, &WarpMap->MilReadyEvent);
+      }
+
+   //Get the coefficients of the transformation from the destination to the source
+   MbufPut(m_MilFourCornerBuffer, (void*)FourCorners);
+   MgenWarpParameter(m_MilFourCornerBuffer, m_MilCoefficientsBuffer, M_NULL,
+      M_WARP_4_CORNER_REVERSE, M_DEFAULT, M_NULL, M_NULL);
+
+   memcpy(WarpMap->FourCorners, FourCorners, sizeof(WarpMap->FourCorners));
+   MbufGet(m_MilCoefficientsBuffer, WarpMap->Coefficients);
+   WarpMap->Valid = true;
+   WarpMap->Ready = false;
+   MthrControl(WarpMap->MilReadyEvent, M_EVENT_SET, M_NOT_SIGNALED);
+   }
+
+//*****************************************************************************
+// GenerateMap. Generates the map of its four corner parameters. The tiles
+// that are the same in the base map are copied instead of being computed, or
+// kept as is when the base map is the previous content of the map itself.
+//*****************************************************************************
+void CWarpMapCache::GenerateMap(WarpMapStruct* WarpMap, const WarpMapStruct* BaseMap,
+                                MIL_INT& NumTilesGenerated, MIL_INT& NumTilesReused)
+   {
+   for (MIL_INT StartY=0; StartY<m_SizeY; StartY+=WARP_MAP_TILE_SIZE)
+      {
+      MIL_INT EndY = (StartY+WARP_MAP_TILE_SIZE<m_SizeY)?StartY+WARP_MAP_TILE_SIZE:m_SizeY;
+      for (MIL_INT StartX=0; StartX<m_SizeX; StartX+=WARP_MAP_TILE_SIZE)
+         {
+         MIL_INT EndX = (StartX+WARP_MAP_TILE_SIZE<m_SizeX)?StartX+WARP_MAP_TILE_SIZE:m_SizeX;
+         if (BaseMap && !TileChanged(WarpMap, BaseMap, StartX, StartY, EndX, EndY))
+            {
+            if (BaseMap->LutXPtr != WarpMap->LutXPtr)
+               CopyTile(WarpMap, BaseMap, StartX, StartY, EndX, EndY);
+            NumTilesReused++;
+            }
+         else
+            {
+            GenerateTile(WarpMap, StartX, StartY, EndX, EndY);
+            NumTilesGenerated++;
+            }
+         }
+      }
+   }
+
+//*****************************************************************************
+// GenerateTile. Computes the source coordinates of each pixel of the tile in
+// fixed point. Coordinates outside the image are set to -1 so that the pixels
+// are cleared by MimWarp.
+//*****************************************************************************
+void CWarpMapCache::GenerateTile(WarpMapStruct* WarpMap, MIL_INT StartX, MIL_INT StartY, MIL_INT EndX, MIL_INT EndY)
+   {
+   const MIL_FLOAT* C = WarpMap->Coefficients;
+   const MIL_INT16 OutsideValue = (MIL_INT16)(-m_FixedPointScale);
+
+   for (MIL_INT y=StartY; y<EndY; y++)
+      {
+      MIL_INT16* LutXRow = WarpMap->LutXPtr+y*WarpMap->Pitch;
+      MIL_INT16* LutYRow = WarpMap->LutYPtr+y*WarpMap->Pitch;
+      for (MIL_INT x=StartX; x<EndX; x++)
+         {
+         MIL_DOUBLE W = C[6]*x + C[7]*y + C[8];
+         MIL_DOUBLE SourceX = (C[0]*x + C[1]*y + C[2])/W;
+         MIL_DOUBLE SourceY = (C[3]*x + C[4]*y + C[5])/W;
+
+         if ((SourceX < -1.0) || (SourceX > m_SizeX) || (SourceY < -1.0) || (SourceY > m_SizeY))
+            {
+            LutXRow[x] = OutsideValue;
+            LutYRow[x] = OutsideValue;
+            }
+         else
+            {
+            LutXRow[x] = (MIL_INT16)floor(SourceX*m_FixedPointScale+0.5);
+            LutYRow[x] = (MIL_INT16)floor(SourceY*m_FixedPointScale+0.5);
+            }
+         }
+      }
+   }
+
+//*****************************************************************************
+// CopyTile. Copies a tile of the base map.
+//*****************************************************************************
+void CWarpMapCache::CopyTile(WarpMapStruct* WarpMap, const WarpMapStruct* BaseMap,
+                             MIL_INT StartX, MIL_INT StartY, MIL_INT EndX, MIL_INT EndY)
+   {
+   size_t RowSize = (EndX-StartX)*sizeof(MIL_INT16);
+   for (MIL_INT y=StartY; y<EndY; y++)
+      {
+      memcpy(WarpMap->LutXPtr+y*WarpMap->Pitch+StartX, BaseMap->LutXPtr+y*BaseMap->Pitch+StartX, RowSize);
+      memcpy(WarpMap->LutYPtr+y*WarpMap->Pitch+StartX, BaseMap->LutYPtr+y*BaseMap->Pitch+StartX, RowSize);
+      }
+   }
+
+//*****************************************************************************
+// TileChanged. Returns whether the values of the tile can differ between the
+// two maps. A tile is only reused when its values are known to be exactly the
+// same: the maps have the same coefficients, or the tile is outside the image
+// in both maps, so that all its values are the outside value.
+//*****************************************************************************
+bool CWarpMapCache::TileChanged(const WarpMapStruct* WarpMap, const WarpMapStruct* BaseMap,
+                                MIL_INT StartX, MIL_INT StartY, MIL_INT EndX, MIL_INT EndY) const
+   {
+   if (memcmp(WarpMap->Coefficients, BaseMap->Coefficients, sizeof(WarpMap->Coefficients)) == 0)
+      return false;
+
+   return !TileOutside(WarpMap->Coefficients, StartX, StartY, EndX, EndY) ||
+          !TileOutside(BaseMap->Coefficients, StartX, StartY, EndX, EndY);
+   }
+
+//*****************************************************************************
+// TileOutside. Returns whether all the pixels of the tile are mapped outside
+// the image. The transformation maps the tile to the quadrilateral of its
+// corners when the denominator keeps the same sign over the tile, so the tile
+// is outside if its four corners are beyond the same edge of the image.
+//*****************************************************************************
+bool CWarpMapCache::TileOutside(const MIL_FLOAT* C, MIL_INT StartX, MIL_INT StartY, MIL_INT EndX, MIL_INT EndY) const
+   {
+   const MIL_DOUBLE CornersX[4] = { (MIL_DOUBLE)StartX, (MIL_DOUBLE)(EndX-1), (MIL_DOUBLE)StartX, (MIL_DOUBLE)(EndX-1) };
+   const MIL_DOUBLE CornersY[4] = { (MIL_DOUBLE)StartY, (MIL_DOUBLE)StartY, (MIL_DOUBLE)(EndY-1), (MIL_DOUBLE)(EndY-1) };
+   const MIL_DOUBLE Margin = WARP_MAP_OUTSIDE_MARGIN;
+   bool Left = true, Right = true, Top = true, Bottom = true;
+   MIL_INT NumPositive = 0;
+
+   for (MIL_INT i=0; i<4; i++)
+      {
+      MIL_DOUBLE x = CornersX[i], y = CornersY[i];
+      MIL_DOUBLE W = C[6]*x + C[7]*y + C[8];
+      if (W == 0.0)
+         return false;
+      NumPositive += (W > 0.0)?1:0;
+
+      MIL_DOUBLE SourceX = (C[0]*x + C[1]*y + C[2])/W;
+      MIL_DOUBLE SourceY = (C[3]*x + C[4]*y + C[5])/W;
+      Left   = Left   && (SourceX < -1.0-Margin);
+      Right  = Right  && (SourceX > m_SizeX+Margin);
+      Top    = Top    && (SourceY < -1.0-Margin);
+      Bottom = Bottom && (SourceY > m_SizeY+Margin);
+      }
+
+   return ((NumPositive == 0) || (NumPositive == 4)) && (Left || Right || Top || Bottom);
+   }
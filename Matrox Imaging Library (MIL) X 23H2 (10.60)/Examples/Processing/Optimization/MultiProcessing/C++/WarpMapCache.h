@@ -0,0 +1,111 @@
+﻿//***************************************************************************************
+//
+// File name: WarpMapCache.h
+//
+// Synopsis:  Class that defines a cache of dense warp LUT maps, keyed by the
+//            four corner warp parameters.
+//
+// Copyright © Matrox Electronic Systems Ltd., 1992-2023.
+// All Rights Reserved
+
+#ifndef WARPMAPCACHE_H
+#define WARPMAPCACHE_H
+
+//Number of values of the four corner warp parameters
+static const MIL_INT NUM_FOUR_CORNER_VALUES = 12;
+
+//structure for a cached warp map
+struct WarpMapStruct
+   {
+   MIL_FLOAT   FourCorners[NUM_FOUR_CORNER_VALUES];
+   MIL_FLOAT   Coefficients[9];
+   MIL_ID      MilLutX;
+   MIL_ID      MilLutY;
+   MIL_ID      MilReadyEvent;
+   MIL_INT16*  LutXPtr;
+   MIL_INT16*  LutYPtr;
+   MIL_INT     Pitch;
+   MIL_INT     UseCount;
+   MIL_INT     LastUse;
+   bool        Valid;
+   bool        Ready;
+   };
+
+//*****************************************************************************
+// Class used to keep the dense M_WARP_LUT maps of the last warp parameters in
+// fixed point, so that they are reused across frames, dispatch threads and
+// processing objects. The maps are allocated when they are first needed. A
+// map is generated outside the lock of the cache; the tiles that are known to
+// be the same in the nearest cached map are copied from it.
+//
+// When the maps of the cyclic working set do not all fit, the most recently
+// used map is replaced instead of the least recently used one, which would
+// always be the next one needed.
+//*****************************************************************************
+class CWarpMapCache
+   {
+   public:
+      CWarpMapCache(MIL_ID MilSystem, MIL_INT SizeX, MIL_INT SizeY, MIL_INT Capacity, MIL_INT WorkingSetSize);
+      ~CWarpMapCache();
+
+      //Returns the map of the given four corner parameters, or M_NULL if all
+      //the maps are in use. The map cannot be replaced until it is released.
+      WarpMapStruct* Acquire(const MIL_FLOAT* FourCorners);
+      void Release(WarpMapStruct* WarpMap);
+
+      //Control flag of MimWarp for the maps of the cache
+      inline MIL_INT GetWarpControlFlag() const;
+
+      void PrintStatistics(MIL_CONST_TEXT_PTR Title) const;
+
+   private:
+      //Disallow copy
+      CWarpMapCache(const CWarpMapCache&);
+      CWarpMapCache& operator=(const CWarpMapCache&);
+
+      WarpMapStruct* FindMap(const MIL_FLOAT* FourCorners);
+      WarpMapStruct* FindNearestMap(const MIL_FLOAT* FourCorners);
+      WarpMapStruct* FindFreeMap();
+      void ReserveMap(WarpMapStruct* WarpMap, const MIL_FLOAT* FourCorners);
+      void GenerateMap(WarpMapStruct* WarpMap, const WarpMapStruct* BaseMap,
+                       MIL_INT& NumTilesGenerated, MIL_INT& NumTilesReused);
+      void GenerateTile(WarpMapStruct* WarpMap, MIL_INT StartX, MIL_INT StartY, MIL_INT EndX, MIL_INT EndY);
+      void CopyTile(WarpMapStruct* WarpMap, const WarpMapStruct* BaseMap,
+                    MIL_INT StartX, MIL_INT StartY, MIL_INT EndX, MIL_INT EndY);
+      bool TileChanged(const WarpMapStruct* WarpMap, const WarpMapStruct* BaseMap,
+                       MIL_INT StartX, MIL_INT StartY, MIL_INT EndX, MIL_INT EndY) const;
+      bool TileOutside(const MIL_FLOAT* Coefficients,
+                       MIL_INT StartX, MIL_INT StartY, MIL_INT EndX, MIL_INT EndY) const;
+
+      MIL_ID         m_MilSystem;
+      MIL_ID         m_MilMutex;
+      MIL_ID         m_MilFourCornerBuffer;
+      MIL_ID         m_MilCoefficientsBuffer;
+
+      MIL_INT        m_SizeX;
+      MIL_INT        m_SizeY;
+      MIL_INT        m_FractionBits;
+      MIL_DOUBLE     m_FixedPointScale;
+
+      WarpMapStruct* m_Maps;
+      MIL_INT        m_Capacity;
+      MIL_INT        m_UseCounter;
+      bool           m_ReplaceMostRecent;
+
+      MIL_INT        m_NumHits;
+      MIL_INT        m_NumMisses;
+      MIL_INT        m_NumFull;
+      MIL_INT        m_NumTilesGenerated;
+      MIL_INT        m_NumTilesReused;
+   };
+
+//*****************************************************************************
+// GetWarpControlFlag. Returns the M_WARP_LUT control flag with the fixed
+// point precision of the maps.
+//*****************************************************************************
+inline MIL_INT CWarpMapCache::GetWarpControlFlag() const
+   {
+   return M_WARP_LUT+M_FIXED_POINT+m_FractionBits;
+   }
+
+#endif
@@ -12,6 +12,7 @@
 
 #include <mil.h>
 #include <cmath>
+#include <atomic>
 
 //Image path
 #define EXAMPLE_IMAGE_PATH          M_IMAGE_PATH MIL_TEXT("Multiprocessing/")
@@ -40,6 +41,9 @@ static const MIL_INT STRING_SIZE = 128;
 const MIL_INT MIN_MP_CORES = 2;
 const MIL_INT MAX_MP_CORES = 32;
 
+//Dispatch threads per processing object. More than one runs the frame queue mode.
+const MIL_INT MAX_DISPATCH_THREADS = 8;
+
 //Structure for rectangular areas.  Used to identify button areas.
 struct RectStruct
    {
@@ -51,10 +55,14 @@ struct RectStruct
    };
 
 //Common headers to include
+#include "FrameQueue.h"
 #include "Dispatcher.h"
+#include "WarpMapCache.h"
 #include "MPProcessing.h"
 #include "MPRotateProcessing.h"
 #include "MPWarpProcessing.h"
+#include "MPAutoTuner.h"
+#include "MPHeadless.h"
 #include "MPMenuButton.h"
 #include "MPMenu.h"
 
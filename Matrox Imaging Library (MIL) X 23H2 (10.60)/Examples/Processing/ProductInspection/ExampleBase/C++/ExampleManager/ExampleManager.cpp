@@ -35,6 +35,12 @@ static const MIL_DOUBLE DEFAULT_TEXT_POINT_SIZE  = 14;
 static MIL_CONST_TEXT_PTR TITLE_FONT = M_FONT_DEFAULT_TTF;
 static MIL_CONST_TEXT_PTR TEXT_FONT = M_FONT_DEFAULT_TTF;
 
+// Set to false to inspect the tasks one after the other in the calling thread.
+static const bool PARALLEL_INSPECTION = true;
+
+// The maximum number of threads that inspect the independent tasks.
+static const MIL_INT MAX_INSPECTION_THREADS = 8;
+
 //*****************************************************************************
 // Mouse Callbacks
 //*****************************************************************************
@@ -88,7 +94,20 @@ CExampleMngr::CExampleMngr(MIL_ID MilSystem)
    m_CurProductInfo            (NULL),
    m_HoverLabel                (0),
    m_SelectedLabel             (0),
-   m_CurrentGroupIdx           (0)
+   m_CurrentGroupIdx           (0),
+   m_TaskNodeArray             (NULL),
+   m_NbTaskNodes               (0),
+   m_ReadyTaskArray            (NULL),
+   m_ReadyTaskHead             (0),
+   m_ReadyTaskTail             (0),
+   m_NbTasksDone               (0),
+   m_InspectSampleIdx          (0),
+   m_ExitThreads               (false),
+   m_MilInspectionThreadArray  (NULL),
+   m_NbInspectionThreads       (0),
+   m_MilTaskMutex              (M_NULL),
+   m_MilTaskReadyEvent         (M_NULL),
+   m_MilTasksDoneEvent         (M_NULL)
    {
    // Allocate the display.
    MdispAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_WINDOWED, &m_MilDisplay);
@@ -240,6 +259,10 @@ void CExampleMngr::ResetTasks()
    {
    if(m_CurProductInfo)
       {
+      // Stop the inspection threads and free the dependency graph.
+      StopInspectionThreads();
+      FreeTaskGraph();
+
       for(MIL_INT ViewIdx = 0; ViewIdx < m_CurProductInfo->NbViews; ViewIdx++)
          {
          // Get a reference to the current view task list.
@@ -267,6 +290,231 @@ void CExampleMngr::InitializeTasks()
       for(MIL_INT TaskIdx = 0; TaskIdx < rViewTaskList.NbTasks; TaskIdx++)
          { rViewTaskList.TaskList[TaskIdx]->Init(m_MilSystem, m_MilViewChildArray[0][ViewIdx].SizeX, m_MilViewChildArray[0][ViewIdx].SizeY); }
       }
+
+   // Build the dependency graph of the tasks and start the inspection threads.
+   BuildTaskGraph();
+   StartInspectionThreads();
+   }
+
+//*****************************************************************************
+// Function that returns whether a task uses another task as a provider.
+//*****************************************************************************
+static bool UsesProvider(const CInspectionTask* pTask, const CInspectionTask* pProvider)
+   {
+   return pTask->GetFixtureProvider() == pProvider ||
+          pTask->GetImageProvider()   == pProvider ||
+          pTask->GetRegionProvider()  == pProvider;
+   }
+
+//*****************************************************************************
+// Function that builds the dependency graph of the tasks of all the views.
+// Two tasks are linked when one is a provider of the other, from the task that
+// comes first in the serial order to the other. Each task therefore sees the
+// same provider results as in the serial inspection.
+//*****************************************************************************
+void CExampleMngr::BuildTaskGraph()
+   {
+   // Count the tasks of all the views.
+   m_NbTaskNodes = 0;
+   for(MIL_INT ViewIdx = 0; ViewIdx < m_CurProductInfo->NbViews; ViewIdx++)
+      m_NbTaskNodes += m_CurProductInfo->ImageTasksListArray[ViewIdx].NbTasks;
+
+   // Allocate the nodes and the queue of the ready tasks.
+   m_TaskNodeArray = new STaskNode[m_NbTaskNodes];
+   m_ReadyTaskArray = new MIL_INT[m_NbTaskNodes];
+
+   // Set the nodes in the serial order.
+   for(MIL_INT ViewIdx = 0, NodeIdx = 0; ViewIdx < m_CurProductInfo->NbViews; ViewIdx++)
+      {
+      SImageTaskList &rTaskList = m_CurProductInfo->ImageTasksListArray[ViewIdx];
+      for(MIL_INT TaskIdx = 0; TaskIdx < rTaskList.NbTasks; TaskIdx++, NodeIdx++)
+         {
+         STaskNode &rNode = m_TaskNodeArray[NodeIdx];
+         rNode.pTask              = rTaskList.TaskList[TaskIdx];
+         rNode.ViewIdx            = ViewIdx;
+         rNode.NbProviders        = 0;
+         rNode.NbPendingProviders = 0;
+         rNode.NbDependents       = 0;
+         rNode.DependentArray     = NULL;
+         }
+      }
+
+   // Count the links of each node.
+   for(MIL_INT NodeIdx = 0; NodeIdx < m_NbTaskNodes; NodeIdx++)
+      {
+      for(MIL_INT OtherIdx = NodeIdx+1; OtherIdx < m_NbTaskNodes; OtherIdx++)
+         {
+         if(UsesProvider(m_TaskNodeArray[OtherIdx].pTask, m_TaskNodeArray[NodeIdx].pTask) ||
+            UsesProvider(m_TaskNodeArray[NodeIdx].pTask, m_TaskNodeArray[OtherIdx].pTask))
+            {
+            m_TaskNodeArray[NodeIdx].NbDependents++;
+            m_TaskNodeArray[OtherIdx].NbProviders++;
+            }
+         }
+      }
+
+   // Set the dependents of each node.
+   for(MIL_INT NodeIdx = 0; NodeIdx < m_NbTaskNodes; NodeIdx++)
+      {
+      STaskNode &rNode = m_TaskNodeArray[NodeIdx];
+      if(rNode.NbDependents)
+         rNode.DependentArray = new MIL_INT[rNode.NbDependents];
+
+      for(MIL_INT OtherIdx = NodeIdx+1, DependentIdx = 0; OtherIdx < m_NbTaskNodes; OtherIdx++)
+         {
+         if(UsesProvider(m_TaskNodeArray[OtherIdx].pTask, rNode.pTask) ||
+            UsesProvider(rNode.pTask, m_TaskNodeArray[OtherIdx].pTask))
+            rNode.DependentArray[DependentIdx++] = OtherIdx;
+         }
+      }
+   }
+
+//*****************************************************************************
+// Function that frees the dependency graph of the tasks.
+//*****************************************************************************
+void CExampleMngr::FreeTaskGraph()
+   {
+   if(m_TaskNodeArray)
+      {
+      for(MIL_INT NodeIdx = 0; NodeIdx < m_NbTaskNodes; NodeIdx++)
+         delete [] m_TaskNodeArray[NodeIdx].DependentArray;
+
+      delete [] m_TaskNodeArray;
+      m_TaskNodeArray = NULL;
+      delete [] m_ReadyTaskArray;
+      m_ReadyTaskArray = NULL;
+      m_NbTaskNodes = 0;
+      }
+   }
+
+//*****************************************************************************
+// Function that starts the threads that inspect the independent tasks.
+//*****************************************************************************
+void CExampleMngr::StartInspectionThreads()
+   {
+   // Use one thread per core, up to the number of tasks.
+   MIL_INT NbCores;
+   MappInquireMp(M_DEFAULT, M_CORE_NUM_PROCESS, M_DEFAULT, M_DEFAULT, &NbCores);
+   m_NbInspectionThreads = NbCores < MAX_INSPECTION_THREADS ? NbCores : MAX_INSPECTION_THREADS;
+   m_NbInspectionThreads = m_NbInspectionThreads < m_NbTaskNodes ? m_NbInspectionThreads : m_NbTaskNodes;
+
+   // The tasks are inspected in the calling thread if there is no parallelism.
+   if(!PARALLEL_INSPECTION || m_NbInspectionThreads < 2)
+      {
+      m_NbInspectionThreads = 0;
+      return;
+      }
+
+   // Allocate the synchronization objects.
+   MthrAlloc(m_MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilTaskMutex);
+   MthrAlloc(m_MilSystem, M_EVENT, M_NOT_SIGNALED + M_MANUAL_RESET, M_NULL, M_NULL, &m_MilTaskReadyEvent);
+   MthrAlloc(m_MilSystem, M_EVENT, M_NOT_SIGNALED + M_AUTO_RESET, M_NULL, M_NULL, &m_MilTasksDoneEvent);
+
+   // Start the threads.
+   m_ExitThreads = false;
+   m_ReadyTaskHead = 0;
+   m_ReadyTaskTail = 0;
+   m_MilInspectionThreadArray = new MIL_ID[m_NbInspectionThreads];
+   for(MIL_INT ThreadIdx = 0; ThreadIdx < m_NbInspectionThreads; ThreadIdx++)
+      MthrAlloc(m_MilSystem, M_THREAD, M_DEFAULT, InspectionThreadFunc, (void*)this, &m_MilInspectionThreadArray[ThreadIdx]);
+   }
+
+//*****************************************************************************
+// Function that stops the inspection threads.
+//*****************************************************************************
+void CExampleMngr::StopInspectionThreads()
+   {
+   if(m_MilInspectionThreadArray)
+      {
+      // Signal the threads to exit.
+      MthrControl(m_MilTaskMutex, M_LOCK, M_DEFAULT);
+      m_ExitThreads = true;
+      MthrControl(m_MilTaskReadyEvent, M_EVENT_SET, M_SIGNALED);
+      MthrControl(m_MilTaskMutex, M_UNLOCK, M_DEFAULT);
+
+      // Wait for the end of the threads and free them.
+      for(MIL_INT ThreadIdx = 0; ThreadIdx < m_NbInspectionThreads; ThreadIdx++)
+         {
+         MthrWait(m_MilInspectionThreadArray[ThreadIdx], M_THREAD_END_WAIT, M_NULL);
+         MthrFree(m_MilInspectionThreadArray[ThreadIdx]);
+         }
+      delete [] m_MilInspectionThreadArray;
+      m_MilInspectionThreadArray = NULL;
+      m_NbInspectionThreads = 0;
+
+      // Free the synchronization objects.
+      MthrFree(m_MilTasksDoneEvent);
+      MthrFree(m_MilTaskReadyEvent);
+      MthrFree(m_MilTaskMutex);
+      m_MilTasksDoneEvent = M_NULL;
+      m_MilTaskReadyEvent = M_NULL;
+      m_MilTaskMutex = M_NULL;
+      }
+   }
+
+//*****************************************************************************
+// Function of the inspection threads.
+//*****************************************************************************
+MIL_UINT32 MFTYPE CExampleMngr::InspectionThreadFunc(void* UserDataPtr)
+   {
+   CExampleMngr *pExampleMngr = (CExampleMngr*) UserDataPtr;
+   pExampleMngr->RunInspectionThread();
+   return 0;
+   }
+
+void CExampleMngr::RunInspectionThread()
+   {
+   while(true)
+      {
+      // Wait for a ready task or for the exit.
+      MthrControl(m_MilTaskMutex, M_LOCK, M_DEFAULT);
+      while(m_ReadyTaskHead == m_ReadyTaskTail && !m_ExitThreads)
+         {
+         MthrControl(m_MilTaskMutex, M_UNLOCK, M_DEFAULT);
+         MthrWait(m_MilTaskReadyEvent, M_EVENT_WAIT, M_NULL);
+         MthrControl(m_MilTaskMutex, M_LOCK, M_DEFAULT);
+         }
+
+      if(m_ExitThreads)
+         {
+         MthrControl(m_MilTaskMutex, M_UNLOCK, M_DEFAULT);
+         break;
+         }
+
+      // Take the next ready task.
+      MIL_INT NodeIdx = m_ReadyTaskArray[m_ReadyTaskHead++];
+      if(m_ReadyTaskHead == m_ReadyTaskTail)
+         MthrControl(m_MilTaskReadyEvent, M_EVENT_SET, M_NOT_SIGNALED);
+      MIL_INT SampleIdx = m_InspectSampleIdx;
+      MthrControl(m_MilTaskMutex, M_UNLOCK, M_DEFAULT);
+
+      // Inspect the image of the view of the task.
+      STaskNode &rNode = m_TaskNodeArray[NodeIdx];
+      rNode.pTask->InspectImage(m_MilViewChildArray[SampleIdx][rNode.ViewIdx].MilChild);
+
+      // Queue the dependents whose providers are all inspected.
+      MthrControl(m_MilTaskMutex, M_LOCK, M_DEFAULT);
+      for(MIL_INT DependentIdx = 0; DependentIdx < rNode.NbDependents; DependentIdx++)
+         {
+         STaskNode &rDependent = m_TaskNodeArray[rNode.DependentArray[DependentIdx]];
+         if(--rDependent.NbPendingProviders == 0)
+            QueueReadyTask(rNode.DependentArray[DependentIdx]);
+         }
+
+      // Signal the end of the inspection when all the tasks are done.
+      if(++m_NbTasksDone == m_NbTaskNodes)
+         MthrControl(m_MilTasksDoneEvent, M_EVENT_SET, M_SIGNALED);
+      MthrControl(m_MilTaskMutex, M_UNLOCK, M_DEFAULT);
+      }
+   }
+
+//*****************************************************************************
+// Function that queues a task whose providers are inspected.
+//*****************************************************************************
+void CExampleMngr::QueueReadyTask(MIL_INT NodeIdx)
+   {
+   m_ReadyTaskArray[m_ReadyTaskTail++] = NodeIdx;
+   MthrControl(m_MilTaskReadyEvent, M_EVENT_SET, M_SIGNALED);
    }
 
 //*****************************************************************************
@@ -484,10 +732,33 @@ void CExampleMngr::DisableDisplayHooks()
    }
 
 //*****************************************************************************
-// Function that inspects the products.
+// Function that inspects the products. The independent tasks and views are
+// inspected concurrently by the inspection threads, following the dependency
+// graph of the tasks.
 //*****************************************************************************
 void CExampleMngr::InspectProducts(MIL_INT SampleIdx)
    {
+   if(m_NbInspectionThreads)
+      {
+      // Reset the inspection progress and queue the tasks without providers.
+      MthrControl(m_MilTaskMutex, M_LOCK, M_DEFAULT);
+      m_InspectSampleIdx = SampleIdx;
+      m_ReadyTaskHead = 0;
+      m_ReadyTaskTail = 0;
+      m_NbTasksDone = 0;
+      for(MIL_INT NodeIdx = 0; NodeIdx < m_NbTaskNodes; NodeIdx++)
+         {
+         m_TaskNodeArray[NodeIdx].NbPendingProviders = m_TaskNodeArray[NodeIdx].NbProviders;
+         if(m_TaskNodeArray[NodeIdx].NbProviders == 0)
+            QueueReadyTask(NodeIdx);
+         }
+      MthrControl(m_MilTaskMutex, M_UNLOCK, M_DEFAULT);
+
+      // Wait for the inspection of all the tasks.
+      MthrWait(m_MilTasksDoneEvent, M_EVENT_WAIT, M_NULL);
+      return;
+      }
+
    for(MIL_INT ViewIdx = 0; ViewIdx < m_CurProductInfo->NbViews; ViewIdx++)
       {
       // Get a reference to the task list.
@@ -56,6 +56,17 @@ struct SViewChildInfo
    MIL_INT SizeY;
    };
 
+// Structure containing a node of the dependency graph of the inspection tasks.
+struct STaskNode
+   {
+   CInspectionTask* pTask;
+   MIL_INT          ViewIdx;
+   MIL_INT          NbProviders;
+   MIL_INT          NbPendingProviders;
+   MIL_INT          NbDependents;
+   MIL_INT*         DependentArray;
+   };
+
 class CExampleMngr
    {
    public:
@@ -109,6 +120,21 @@ class CExampleMngr
       // Function that resets the tasks.
       void ResetTasks();
 
+      // Functions that build and free the dependency graph of the tasks.
+      void BuildTaskGraph();
+      void FreeTaskGraph();
+
+      // Functions that start and stop the inspection threads.
+      void StartInspectionThreads();
+      void StopInspectionThreads();
+
+      // Function of the inspection threads.
+      static MIL_UINT32 MFTYPE InspectionThreadFunc(void* UserDataPtr);
+      void RunInspectionThread();
+
+      // Function to queue a task whose providers are inspected. The mutex must be locked.
+      void QueueReadyTask(MIL_INT NodeIdx);
+
       // Function to draw the arrow in the display.
       void DrawArrow();
 
@@ -179,6 +205,25 @@ class CExampleMngr
       // The interactive display label.
       MIL_INT m_SelectedLabel;
       MIL_INT m_HoverLabel;
+
+      // The dependency graph of the tasks of all the views, in the serial order.
+      STaskNode* m_TaskNodeArray;
+      MIL_INT    m_NbTaskNodes;
+
+      // The queue of the tasks ready to be inspected and the inspection progress.
+      MIL_INT* m_ReadyTaskArray;
+      MIL_INT  m_ReadyTaskHead;
+      MIL_INT  m_ReadyTaskTail;
+      MIL_INT  m_NbTasksDone;
+      MIL_INT  m_InspectSampleIdx;
+      bool     m_ExitThreads;
+
+      // The inspection threads and their synchronization objects.
+      MIL_ID*  m_MilInspectionThreadArray;
+      MIL_INT  m_NbInspectionThreads;
+      MIL_ID   m_MilTaskMutex;
+      MIL_ID   m_MilTaskReadyEvent;
+      MIL_ID   m_MilTasksDoneEvent;
    };
 
 #endif // EXAMPLE_MANAGER_H
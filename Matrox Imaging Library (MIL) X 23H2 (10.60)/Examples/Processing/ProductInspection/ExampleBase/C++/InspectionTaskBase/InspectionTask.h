@@ -57,6 +57,11 @@ class CInspectionTask
       const MIL_ID GetInputRegionList() const { return m_RegionProvider->GetOutputRegionList(); }
       bool HasRegionProvider() const { return m_RegionProvider != M_NULL; }
 
+      // Functions to get the providers of the task, if any.
+      CInspectionTask* GetFixtureProvider() const { return m_FixtureProvider; }
+      CInspectionTask* GetImageProvider() const { return m_ImageProvider; }
+      CInspectionTask* GetRegionProvider() const { return m_RegionProvider; }
+
       // Drawing functions.
       void DrawInspectionGraphicalResult(MIL_ID MilGraContext, MIL_ID MilDest);
       virtual void DrawTextResult(MIL_ID MilGraContext, MIL_ID MilDest) = 0;